@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Timing.hpp>
+#include <cstdint>
+#include <iostream>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+// Runs the body until at least the minimum time has passed and prints the mean per iteration
+template <typename Body>
+void Measure(char const* name, size_t itemCount, Body&& body)
+{
+    Milliseconds const minimumTime{ 200 };
+    uint64_t iterations = 0;
+    Clock::time_point const start = Clock::now();
+    Milliseconds elapsed{ 0 };
+    do
+    {
+        body();
+        ++iterations;
+        elapsed = Clock::now() - start;
+    } while (elapsed < minimumTime);
+
+    double const iterationUs = elapsed.count() * 1000.0 / iterations;
+    std::cout << name << " " << itemCount << ": " << iterationUs << " us"
+        << ", " << iterationUs * 1000.0 / itemCount << " ns per item" << std::endl;
+}
+
+// Deterministic checks report failures instead of timings, the run fails when any of them did
+inline uint32_t& GetFailedCheckCount()
+{
+    static uint32_t failedCheckCount = 0;
+    return failedCheckCount;
+}
+
+inline void Check(bool condition, char const* name)
+{
+    if (!condition)
+    {
+        ++GetFailedCheckCount();
+        std::cerr << "Check failed: " << name << std::endl;
+    }
+}
+
+void RunSurfaceStoreBenchmarks();
+
+void RunCullTableBenchmarks();
+
+void RunCullTableChecks();
+
+void RunSceneChecks();
+
+void RunSoftwareRenderChecks();
+
+void RunTileDamageChecks();
+
+void RunFrameSchedulerChecks();
+
+void RunCommitTraceChecks();
+
+void RunQualityGovernorTraces();
+
+} // benchmarks namespace
+} // vkc namespace
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <CommitTrace.hpp>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+// Written to the working directory, which is the build directory under ctest
+char const* const s_tracePath = "CommitTraceCheck.vkctrace";
+
+Surface MakeSurface(vk::Rect2D const& rect, uint32_t client, uint32_t color)
+{
+    Surface surface;
+    surface.rect = rect;
+    surface.client = client;
+    surface.texture.extent = surface.texture.contentExtent = rect.extent;
+    surface.hostPixels.assign(static_cast<size_t>(rect.extent.width) * rect.extent.height, color);
+    return surface;
+}
+
+bool WriteFile(std::vector<uint8_t> const& data)
+{
+    FILE* const pFile = fopen(s_tracePath, "wb");
+    if (!pFile)
+        return false;
+
+    bool const written = fwrite(data.data(), 1, data.size(), pFile) == data.size();
+    return fclose(pFile) == 0 && written;
+}
+
+// A header written by the recorder followed by one hand made record
+std::vector<uint8_t> MakeTrace(CommitRecord const& record, size_t payloadSize)
+{
+    std::vector<uint8_t> data(sizeof(TraceHeader) + sizeof(record) + payloadSize, 0);
+    FILE* const pFile = tmpfile();
+    CommitRecorder recorder;
+    if (pFile && recorder.Start(pFile, { vk::Extent2D(64, 64) }, false))
+    {
+        recorder.Stop();
+        rewind(pFile);
+        if (fread(data.data(), 1, sizeof(TraceHeader), pFile) != sizeof(TraceHeader))
+            std::cerr << "Failed to read trace header." << std::endl;
+    }
+    if (pFile)
+        fclose(pFile);
+
+    std::memcpy(data.data() + sizeof(TraceHeader), &record, sizeof(record));
+    return data;
+}
+
+bool ReadsFirstCommit(std::vector<uint8_t> const& data)
+{
+    CommitTrace trace;
+    CommitTrace::Commit commit;
+    return WriteFile(data) && trace.Open(s_tracePath) && trace.Next(commit);
+}
+
+} // anonymous namespace
+
+void RunCommitTraceChecks()
+{
+    std::cout << "Commit trace checks" << std::endl;
+
+    std::vector<Surface> surfaces;
+    surfaces.push_back(MakeSurface(vk::Rect2D({ 0, 0 }, { 8, 4 }), 1, 0xFF102030));
+    surfaces.push_back(MakeSurface(vk::Rect2D({ 16, 8 }, { 4, 4 }), 2, 0x80402010));
+    surfaces[1].blend = BlendMode::ePremultiplied;
+    surfaces[1].opacity = 0.5f;
+
+    CommitRecorder recorder;
+    FILE* const pOutput = fopen(s_tracePath, "wb");
+    Check(pOutput && recorder.Start(pOutput, { vk::Extent2D(64, 64) }, true), "Commit recording starts");
+    if (!recorder.IsActive())
+        return;
+
+    // The snapshot, then nothing new while the output doesn't render
+    recorder.Record(0, surfaces, 0);
+    recorder.Record(0, surfaces, 1);
+    surfaces[1].damage.push_back(vk::Rect2D({ 16, 8 }, { 2, 2 }));
+    recorder.Record(0, surfaces, 2);
+    recorder.Record(0, surfaces, 3);
+    surfaces[1].damage.push_back(vk::Rect2D({ 18, 10 }, { 2, 2 }));
+    surfaces[1].hostPixels.assign(16, 0xFF0000FF);
+    recorder.Record(0, surfaces, 4);
+
+    // Rendered, the same damage again is new
+    surfaces[1].damage.clear();
+    recorder.OnDamageCleared(0);
+    surfaces[1].damage.push_back(vk::Rect2D({ 18, 10 }, { 2, 2 }));
+    recorder.Record(0, surfaces, 5);
+    recorder.Stop();
+    fclose(pOutput);
+    Check(recorder.GetRecordCount() == 5, "Damage pending on an output that didn't render is recorded once");
+
+    CommitTrace trace;
+    Check(trace.Open(s_tracePath), "Recorded traces open");
+    Check(trace.GetHeader().outputCount == 1 && trace.GetHeader().outputExtents[0][0] == 64
+        && (trace.GetHeader().flags & TraceHeader::s_contentsStored), "The header holds the outputs and flags");
+
+    std::vector<CommitTrace::Commit> commits;
+    CommitTrace::Commit commit;
+    while (trace.Next(commit))
+        commits.push_back(commit);
+    Check(commits.size() == 5, "Every record is read back");
+    if (commits.size() != 5)
+        return;
+
+    Check(commits[0].pRecord->surface == 0 && commits[1].pRecord->surface == 1 && commits[1].pRecord->surfaceCount == 2,
+        "The snapshot holds every surface");
+    Check(commits[2].pRecord->frame == 2 && commits[2].pRecord->damageCount == 1
+        && commits[3].pRecord->frame == 4 && commits[3].pRecord->damageCount == 1 && commits[3].pDamage[0].x == 18,
+        "Only damage added since the last record is written");
+    Check(commits[4].pRecord->frame == 5 && commits[4].pRecord->damageCount == 1, "Damage after a render is recorded again");
+
+    std::vector<Surface> replayed;
+    for (CommitTrace::Commit const& replay : commits)
+        CommitTrace::Apply(replay, replayed);
+    Check(replayed.size() == 2 && replayed[1].rect == surfaces[1].rect && replayed[1].client == 2
+        && replayed[1].blend == BlendMode::ePremultiplied && replayed[1].opacity == 0.5f
+        && replayed[1].hostPixels == surfaces[1].hostPixels && replayed[0].hostPixels == surfaces[0].hostPixels,
+        "Applying the trace reproduces the surfaces");
+    trace.Close();
+
+    CommitRecord record = {};
+    record.size = sizeof(CommitRecord) + 4;
+    Check(!ReadsFirstCommit(MakeTrace(record, 4)), "Records of a size that isn't a multiple of 8 are rejected");
+
+    record.size = sizeof(CommitRecord);
+    record.surfaceCount = 1;
+    record.contentWidth = 1u << 31;
+    record.contentHeight = 1u << 31;
+    record.flags = CommitRecord::s_hasPixels;
+    Check(!ReadsFirstCommit(MakeTrace(record, 0)), "Records with overflowing content sizes are rejected");
+
+    record.contentWidth = 4;
+    record.contentHeight = 4;
+    Check(!ReadsFirstCommit(MakeTrace(record, 0)), "Records shorter than their pixels are rejected");
+
+    record.size = sizeof(CommitRecord) + 64;
+    Check(ReadsFirstCommit(MakeTrace(record, 64)), "Well formed records are accepted");
+
+    std::remove(s_tracePath);
+}
+
+} // benchmarks namespace
+} // vkc namespace
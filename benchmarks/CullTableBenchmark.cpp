@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <CullTable.hpp>
+#include <Scene.hpp>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+// Distinct handles, the table only compares them
+vk::ImageView MakeView(uint64_t id)
+{
+    VkImageView view = VK_NULL_HANDLE;
+    std::memcpy(&view, &id, sizeof(view));
+    return vk::ImageView(view);
+}
+
+Surface MakeSurface(vk::Rect2D const& rect, uint64_t texture, BlendMode blend = BlendMode::eOpaque)
+{
+    Surface surface;
+    surface.rect = rect;
+    surface.blend = blend;
+    surface.texture.view = MakeView(texture);
+    surface.texture.extent = surface.texture.contentExtent = rect.extent;
+    return surface;
+}
+
+std::vector<Surface> MakeSurfaces(size_t count, vk::Extent2D output)
+{
+    // Windows of mixed blending cascading over the output, some of them off it
+    std::mt19937 random(static_cast<uint32_t>(count));
+    std::uniform_int_distribution<int32_t> x(-256, static_cast<int32_t>(output.width));
+    std::uniform_int_distribution<int32_t> y(-256, static_cast<int32_t>(output.height));
+    std::uniform_int_distribution<uint32_t> size(16, 512);
+
+    std::vector<Surface> surfaces;
+    for (size_t i = 0; i < count; ++i)
+    {
+        BlendMode const blend = i % 3 == 0 ? BlendMode::ePremultiplied : BlendMode::eOpaque;
+        surfaces.push_back(MakeSurface(vk::Rect2D({ x(random), y(random) }, { size(random), size(random) }), i + 1, blend));
+    }
+
+    return surfaces;
+}
+
+void ClearDamage(Surface& surface)
+{
+    surface.damage.clear();
+    surface.contentDamaged = false;
+}
+
+bool Matches(CullTable const& a, CullTable const& b)
+{
+    if (a.GetEntries().size() != b.GetEntries().size() || a.GetRuns().size() != b.GetRuns().size())
+        return false;
+
+    // Slots may differ, the textures they hold may not
+    for (size_t i = 0; i < a.GetEntries().size(); ++i)
+    {
+        CullTable::Entry const& entryA = a.GetEntries()[i];
+        CullTable::Entry const& entryB = b.GetEntries()[i];
+        if (entryA.instance != entryB.instance || !(a.GetTexture(entryA.textureIndex) == b.GetTexture(entryB.textureIndex)))
+            return false;
+    }
+    for (size_t i = 0; i < a.GetRuns().size(); ++i)
+    {
+        CullTable::Run const& runA = a.GetRuns()[i];
+        CullTable::Run const& runB = b.GetRuns()[i];
+        if (runA.first != runB.first || runA.count != runB.count || !(runA.key == runB.key))
+            return false;
+    }
+
+    return a.GetMinifiedSurfaces() == b.GetMinifiedSurfaces();
+}
+
+} // anonymous namespace
+
+void RunCullTableBenchmarks()
+{
+    // A video playing in one surface and another one dragged by a pixel every frame. Only the
+    // table update is timed, the scene update logging the changes runs for every path, so a
+    // fixed frame count keeps the larger scenes from running for minutes
+    vk::Extent2D const output(1920, 1080);
+    for (size_t count : { 100, 1000, 10000 })
+    {
+        std::vector<Surface> surfaces = MakeSurfaces(count, output);
+        Scene scene;
+        scene.Resize(output);
+        scene.Update(surfaces);
+
+        CullTable table;
+        table.Reset(static_cast<uint32_t>(count));
+        table.Update(surfaces, scene, vk::Sampler(), 0.5f);
+
+        uint32_t const frameCount = 1000;
+        Milliseconds elapsed{ 0 };
+        std::vector<uint32_t> entries;
+        std::vector<uint32_t> slots;
+        Surface& video = surfaces.front();
+        Surface& dragged = surfaces[count / 2];
+        for (uint32_t frame = 0; frame < frameCount; ++frame)
+        {
+            video.contentDamaged = true;
+            dragged.damage.push_back(dragged.rect);
+            dragged.rect.offset.x += frame % 2 == 0 ? 1 : -1;
+            dragged.damage.push_back(dragged.rect);
+            scene.Update(surfaces);
+
+            Clock::time_point const start = Clock::now();
+            table.Update(surfaces, scene, vk::Sampler(), 0.5f);
+            table.TakeChanges(entries, slots);
+            elapsed += Clock::now() - start;
+
+            ClearDamage(video);
+            ClearDamage(dragged);
+        }
+
+        double const frameUs = elapsed.count() * 1000.0 / frameCount;
+        std::cout << "CullTable::Update " << count << ": " << frameUs << " us"
+            << ", " << frameUs * 1000.0 / count << " ns per item" << std::endl;
+
+        Measure("CullTable rebuild", count, [&]() {
+            table.Reset(static_cast<uint32_t>(count));
+            table.Update(surfaces, scene, vk::Sampler(), 0.5f);
+        });
+    }
+}
+
+void RunCullTableChecks()
+{
+    std::cout << "Cull table checks" << std::endl;
+
+    Scene scene;
+    scene.Resize({ 1024, 768 });
+
+    std::vector<Surface> surfaces;
+    surfaces.push_back(MakeSurface(vk::Rect2D({ 0, 0 }, { 200, 200 }), 1));
+    surfaces.push_back(MakeSurface(vk::Rect2D({ 300, 0 }, { 200, 200 }), 1));
+    surfaces.push_back(MakeSurface(vk::Rect2D({ 600, 0 }, { 200, 200 }), 2, BlendMode::ePremultiplied));
+    surfaces.push_back(MakeSurface(vk::Rect2D({ 2000, 0 }, { 200, 200 }), 3));
+    scene.Update(surfaces);
+
+    CullTable table;
+    table.Reset(2);
+    std::vector<uint32_t> entries;
+    std::vector<uint32_t> slots;
+    Check(table.Update(surfaces, scene, vk::Sampler(), 0.0f), "Surfaces within the slot count are supported");
+    Check(table.TakeChanges(entries, slots) && slots.size() == 2, "The first update writes every table");
+
+    std::vector<CullTable::Entry> const& drawn = table.GetEntries();
+    Check(drawn.size() == 3 && drawn[0].instance == 0 && drawn[2].instance == 2, "Culled surfaces aren't drawn");
+    Check(drawn[0].textureIndex == drawn[1].textureIndex && drawn[1].textureIndex != drawn[2].textureIndex
+        && table.GetTexture(drawn[0].textureIndex).view == MakeView(1), "Surfaces sharing a texture share its slot");
+    Check(table.GetRuns().size() == 2 && table.GetRuns()[0].count == 2 && table.GetRuns()[1].first == 2,
+        "Runs split where the pipeline changes");
+
+    // A new texture on a drawn surface only touches its entry and slots
+    surfaces[1].texture.view = MakeView(4);
+    surfaces[1].contentDamaged = true;
+    scene.Update(surfaces);
+    Check(!table.Update(surfaces, scene, vk::Sampler(), 0.0f), "More distinct textures than slots need the raster path");
+    ClearDamage(surfaces[1]);
+
+    surfaces[0].texture.view = MakeView(4);
+    surfaces[0].contentDamaged = true;
+    scene.Update(surfaces);
+    Check(table.Update(surfaces, scene, vk::Sampler(), 0.0f), "Freed slots are handed out again");
+    ClearDamage(surfaces[0]);
+
+    scene.Update(surfaces);
+    table.TakeChanges(entries, slots);
+    table.Update(surfaces, scene, vk::Sampler(), 0.0f);
+    Check(!table.TakeChanges(entries, slots) && entries.empty() && slots.empty(), "Unchanged surfaces change nothing");
+
+    surfaces[2].texture.view = MakeView(5);
+    surfaces[2].contentDamaged = true;
+    scene.Update(surfaces);
+    table.Update(surfaces, scene, vk::Sampler(), 0.0f);
+    Check(!table.TakeChanges(entries, slots) && entries == std::vector<uint32_t>({ 2 }) && slots.size() == 2,
+        "Replaced textures rewrite their entry and slots only");
+    ClearDamage(surfaces[2]);
+
+    // Moves, occlusion and minification, then the same surfaces from scratch
+    table.Reset(8);
+    surfaces[3].damage.push_back(surfaces[3].rect);
+    surfaces[3].rect.offset = vk::Offset2D(100, 100);
+    surfaces[3].rect.extent = vk::Extent2D(50, 50);
+    surfaces[3].texture.contentExtent = vk::Extent2D(400, 400);
+    surfaces.push_back(MakeSurface(vk::Rect2D({ 550, 0 }, { 300, 300 }), 6));
+    scene.Update(surfaces);
+    table.Update(surfaces, scene, vk::Sampler(), 0.5f);
+
+    surfaces[0].damage.push_back(surfaces[0].rect);
+    surfaces[0].rect.offset = vk::Offset2D(2000, 0);
+    surfaces[1].blend = BlendMode::ePremultiplied;
+    surfaces[1].damage.push_back(surfaces[1].rect);
+    scene.Update(surfaces);
+    table.Update(surfaces, scene, vk::Sampler(), 0.5f);
+    Check(table.GetMinifiedSurfaces() == std::vector<uint32_t>({ 3 }), "Surfaces drawn below the threshold are minified");
+
+    CullTable rebuilt;
+    rebuilt.Reset(8);
+    rebuilt.Update(surfaces, scene, vk::Sampler(), 0.5f);
+    Check(Matches(table, rebuilt), "Updating the changed surfaces matches a rebuild");
+    Check(table.GetEntries().size() == 3, "Moved off and occluded surfaces leave the entries");
+}
+
+} // benchmarks namespace
+} // vkc namespace
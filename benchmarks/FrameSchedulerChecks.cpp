@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <FrameScheduler.hpp>
+#include <chrono>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+// Simulated time that only moves when the scheduler sleeps or the check advances it
+struct FakeClock
+{
+    Clock::time_point now = Clock::time_point(std::chrono::seconds(1));
+    std::vector<Clock::time_point> sleeps;
+
+    FrameScheduler::TimeSource GetTimeSource()
+    {
+        return [this]() { return now; };
+    }
+
+    FrameScheduler::SleepFunction GetSleepFunction()
+    {
+        return [this](Clock::time_point time) {
+            sleeps.push_back(time);
+            now = time;
+        };
+    }
+};
+
+} // anonymous namespace
+
+void RunFrameSchedulerChecks()
+{
+    std::cout << "Frame scheduler checks" << std::endl;
+
+    {
+        FakeClock clock;
+        FrameScheduler scheduler(clock.GetTimeSource(), clock.GetSleepFunction());
+        scheduler.SetRefreshPeriod(milliseconds(16));
+        Check(scheduler.WaitForFrameStart() == clock.now && clock.sleeps.empty(), "Frames start right away without a vblank");
+
+        // Without samples the whole period is reserved for rendering
+        Clock::time_point const vblank = clock.now;
+        scheduler.OnVblank(vblank, true);
+        clock.now = vblank + milliseconds(2);
+        Check(scheduler.GetTargetVblank() == vblank + milliseconds(32) && scheduler.GetFrameStart() == vblank + milliseconds(16),
+            "The first frame targets the first vblank a whole period away");
+
+        for (size_t i = 0; i < FrameScheduler::s_sampleCount; ++i)
+            scheduler.OnFrameDone(clock.now, clock.now + milliseconds(4));
+        Check(scheduler.GetPredictedRenderTime() == milliseconds(4) + scheduler.safetyMargin,
+            "Predicted render time is the measured duration plus the safety margin");
+
+        Clock::time_point const start = vblank + milliseconds(16) - milliseconds(4) - scheduler.safetyMargin;
+        Check(scheduler.WaitForFrameStart() == start && clock.sleeps.size() == 1 && clock.sleeps.back() == start,
+            "Frames start as late as the predicted render time allows");
+        Check(scheduler.GetTargetVblank() == vblank + milliseconds(16), "Frames target the next vblank they can make");
+
+        scheduler.OnFrameDone(start, vblank + milliseconds(17));
+        Check(scheduler.GetMissedDeadlineCount() == 1, "Frames completing after their vblank miss the deadline");
+    }
+
+    {
+        FakeClock clock;
+        FrameScheduler scheduler(clock.GetTimeSource(), clock.GetSleepFunction());
+        scheduler.SetRefreshPeriod(milliseconds(16));
+        for (size_t i = 0; i < FrameScheduler::s_sampleCount - 1; ++i)
+            scheduler.OnFrameDone(clock.now, clock.now + milliseconds(4));
+        scheduler.OnFrameDone(clock.now, clock.now + milliseconds(12));
+        Check(scheduler.GetPredictedRenderTime() == milliseconds(4) + scheduler.safetyMargin,
+            "A single slow frame doesn't move the percentile");
+
+        // Estimated vblanks only move the phase by the gain
+        Clock::time_point const vblank = clock.now;
+        scheduler.OnVblank(vblank, true);
+        scheduler.OnVblank(vblank + milliseconds(17), false);
+        clock.now = vblank + milliseconds(17);
+        Check(scheduler.GetTargetVblank() == vblank + milliseconds(32) + microseconds(100),
+            "Estimated vblanks nudge the phase");
+    }
+
+    {
+        FakeClock clock;
+        FrameScheduler scheduler(clock.GetTimeSource(), clock.GetSleepFunction());
+        scheduler.SetFrameRateLimit(100.0);
+        Clock::time_point const first = scheduler.WaitForFrameStart();
+        Check(first == clock.now, "The first limited frame starts right away");
+        Check(scheduler.WaitForFrameStart() == first + milliseconds(10) && clock.now == first + milliseconds(10),
+            "The frame rate limit spaces frame starts");
+    }
+}
+
+} // benchmarks namespace
+} // vkc namespace
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <cstring>
+
+int main(int argc, char** argv)
+{
+    // --checks skips the timed benchmarks and only runs the deterministic checks
+    bool const checksOnly = argc > 1 && std::strcmp(argv[1], "--checks") == 0;
+    if (!checksOnly)
+    {
+        vkc::benchmarks::RunSurfaceStoreBenchmarks();
+        vkc::benchmarks::RunCullTableBenchmarks();
+    }
+    vkc::benchmarks::RunQualityGovernorTraces();
+    vkc::benchmarks::RunSceneChecks();
+    vkc::benchmarks::RunCullTableChecks();
+    vkc::benchmarks::RunSoftwareRenderChecks();
+    vkc::benchmarks::RunTileDamageChecks();
+    vkc::benchmarks::RunFrameSchedulerChecks();
+    vkc::benchmarks::RunCommitTraceChecks();
+
+    uint32_t const failedCheckCount = vkc::benchmarks::GetFailedCheckCount();
+    if (failedCheckCount > 0)
+        std::cerr << failedCheckCount << " checks failed." << std::endl;
+
+    return failedCheckCount > 0 ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <QualityGovernor.hpp>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+// GPU time at full quality per frame, the governor's levels scale it down, and the
+// outcome the governor has to reach on it
+struct Trace
+{
+    char const* name;
+    std::vector<double> fullQualityMs;
+    uint64_t maxLevelChanges;
+    uint64_t maxOverBudgetFrames;
+    uint32_t finalLevel;
+};
+
+// Relative cost of a frame at each quality level
+double const s_levelCost[] = { 1.0, 0.8, 0.6, 0.5 };
+
+double const s_budgetMs = 1000.0 / 60.0;
+
+double Noise(std::mt19937& random, double amplitude)
+{
+    // Raw engine output only, distributions differ between standard libraries
+    return (static_cast<double>(random() % 2001) / 1000.0 - 1.0) * amplitude;
+}
+
+std::vector<Trace> MakeTraces()
+{
+    std::mt19937 random(42);
+    std::vector<Trace> traces;
+
+    Trace idle{ "idle", {}, 0, 0, 0 };
+    for (uint32_t i = 0; i < 600; ++i)
+        idle.fullQualityMs.push_back(6.0 + Noise(random, 1.0));
+    traces.push_back(idle);
+
+    // Heavy load for a few seconds, then back to idle, one step down and up per level at most
+    Trace step{ "step", {}, 6, 9, 0 };
+    for (uint32_t i = 0; i < 900; ++i)
+        step.fullQualityMs.push_back((i >= 120 && i < 480 ? 22.0 : 7.0) + Noise(random, 1.0));
+    traces.push_back(step);
+
+    // Single slow frames must not cost any quality
+    Trace spikes{ "spikes", {}, 0, 12, 0 };
+    for (uint32_t i = 0; i < 600; ++i)
+        spikes.fullQualityMs.push_back(i % 50 == 0 ? 30.0 : 8.0 + Noise(random, 0.5));
+    traces.push_back(spikes);
+
+    // Right at the degrade threshold, where a policy without hysteresis oscillates, it
+    // has to settle one level down instead
+    Trace edge{ "edge", {}, 1, 0, 1 };
+    for (uint32_t i = 0; i < 900; ++i)
+        edge.fullQualityMs.push_back(s_budgetMs * 0.9 + Noise(random, 1.5));
+    traces.push_back(edge);
+
+    Trace ramp{ "ramp", {}, 6, 9, 0 };
+    for (uint32_t i = 0; i < 1200; ++i)
+        ramp.fullQualityMs.push_back(4.0 + 26.0 * (i < 600 ? i : 1200 - i) / 600.0 + Noise(random, 0.5));
+    traces.push_back(ramp);
+
+    return traces;
+}
+
+void RunTrace(Trace const& trace)
+{
+    QualityGovernor governor;
+    governor.SetBudget(Milliseconds(s_budgetMs));
+
+    std::string timeline;
+    uint64_t fullQualityOverBudget = 0;
+    for (size_t i = 0; i < trace.fullQualityMs.size(); ++i)
+    {
+        double const fullQualityMs = trace.fullQualityMs[i];
+        if (fullQualityMs > s_budgetMs)
+            ++fullQualityOverBudget;
+
+        governor.OnFrame(Milliseconds(fullQualityMs * s_levelCost[governor.GetLevel()]));
+        if (i % 30 == 0)
+            timeline += static_cast<char>('0' + governor.GetLevel());
+    }
+
+    std::cout << "Quality trace " << trace.name << ": " << trace.fullQualityMs.size() << " frames"
+        << ", over budget " << governor.GetOverBudgetFrameCount() << " (" << fullQualityOverBudget << " at full quality)"
+        << ", level changes " << governor.GetLevelChangeCount()
+        << ", final level " << governor.GetLevel()
+        << ", levels " << timeline << std::endl;
+
+    std::string const name = std::string("Quality trace ") + trace.name;
+    Check(governor.GetLevelChangeCount() <= trace.maxLevelChanges, (name + " changes levels too often").c_str());
+    Check(governor.GetOverBudgetFrameCount() <= trace.maxOverBudgetFrames, (name + " stays over budget too long").c_str());
+    Check(governor.GetLevel() == trace.finalLevel, (name + " ends at the wrong level").c_str());
+}
+
+void CheckPolicyReset()
+{
+    QualityGovernor governor;
+    governor.SetBudget(Milliseconds(s_budgetMs));
+    while (governor.GetLevel() == 0)
+        governor.OnFrame(Milliseconds(s_budgetMs * 2.0));
+
+    governor.SetPolicy(std::make_unique<HysteresisQualityPolicy>());
+    Check(governor.GetLevel() == 0, "A new quality policy starts at full quality");
+    Check(governor.OnFrame(Milliseconds(0.0)) && !governor.OnFrame(Milliseconds(0.0)),
+        "The reset to full quality is reported once, even without a GPU time");
+}
+
+} // anonymous namespace
+
+void RunQualityGovernorTraces()
+{
+    // Synthetic traces without any clock, so the output is the same on every run
+    for (Trace const& trace : MakeTraces())
+        RunTrace(trace);
+    CheckPolicyReset();
+}
+
+} // benchmarks namespace
+} // vkc namespace
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <Scene.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+Surface MakeSurface(int32_t x, int32_t y, uint32_t width, uint32_t height, bool opaque = false)
+{
+    // Host pixels give the surface content without a Vulkan device
+    Surface surface;
+    surface.rect = vk::Rect2D({ x, y }, { width, height });
+    surface.blend = opaque ? BlendMode::eOpaque : BlendMode::ePremultiplied;
+    surface.hostPixels.assign(1, 0);
+    return surface;
+}
+
+} // anonymous namespace
+
+void RunSceneChecks()
+{
+    std::cout << "Scene checks" << std::endl;
+
+    Scene scene;
+    scene.Resize({ 1024, 768 });
+
+    // Spans several cells, so queries must report it once
+    std::vector<Surface> surfaces;
+    surfaces.push_back(MakeSurface(0, 0, 400, 300));
+    surfaces.push_back(MakeSurface(200, 100, 100, 100));
+    surfaces.push_back(MakeSurface(2000, 2000, 100, 100));
+    surfaces.push_back(MakeSurface(900, 600, 50, 50));
+    scene.Update(surfaces);
+
+    std::vector<uint32_t> indices;
+    scene.Query(vk::Rect2D({ 0, 0 }, { 1024, 768 }), indices);
+    Check(indices == std::vector<uint32_t>({ 0, 1, 3 }), "Query of the whole output lists every surface on it once, in order");
+
+    scene.Query(vk::Rect2D({ 250, 150 }, { 10, 10 }), indices);
+    Check(indices == std::vector<uint32_t>({ 0, 1 }), "Query lists overlapping surfaces back to front");
+
+    scene.Query(vk::Rect2D({ 600, 500 }, { 10, 10 }), indices);
+    Check(indices.empty(), "Query of an empty area lists nothing");
+
+    scene.QueryDamage({ vk::Rect2D({ 0, 0 }, { 10, 10 }), vk::Rect2D({ 390, 290 }, { 600, 400 }) }, indices);
+    Check(indices == std::vector<uint32_t>({ 0, 3 }), "Damage query reports a surface under several rectangles once");
+
+    Check(scene.HitTest(250, 150) == 1, "Hit test returns the topmost surface");
+    Check(scene.HitTest(50, 50) == 0, "Hit test returns the surface below when the top one misses");
+    Check(scene.HitTest(700, 50) == Scene::s_none, "Hit test misses empty areas");
+    Check(scene.HitTest(-1, 0) == Scene::s_none, "Hit test misses points off the output");
+
+    Check(scene.IsCulled(2) && scene.IsOffOutput(2), "Surfaces off the output are culled");
+    Check(!scene.IsCulled(1) && !scene.IsOffOutput(1), "Visible surfaces are not culled");
+
+    // Moving a surface updates its cells
+    surfaces[3].rect.offset = vk::Offset2D(10, 700);
+    scene.Update(surfaces);
+    scene.Query(vk::Rect2D({ 900, 600 }, { 50, 50 }), indices);
+    Check(indices.empty(), "Moved surfaces leave their old cells");
+    scene.Query(vk::Rect2D({ 0, 700 }, { 100, 10 }), indices);
+    Check(indices == std::vector<uint32_t>({ 3 }), "Moved surfaces enter their new cells");
+
+    // An opaque surface covering another one occludes it
+    surfaces.push_back(MakeSurface(150, 50, 300, 300, true));
+    scene.Update(surfaces);
+    Check(scene.IsCulled(1) && !scene.IsOffOutput(1), "Surfaces behind an opaque surface are occluded but on the output");
+    Check(!scene.IsCulled(0), "Partially covered surfaces are not occluded");
+    Check(scene.GetCulledCount() == 2, "Culled count includes off output and occluded surfaces");
+
+    // Without content the occluder draws nothing and must not hide anything
+    surfaces.back().hostPixels.clear();
+    scene.Update(surfaces);
+    Check(!scene.IsCulled(1), "Occluders without content don't occlude");
+
+    surfaces.back().hostPixels.assign(1, 0);
+    surfaces.back().visible = false;
+    scene.Update(surfaces);
+    Check(!scene.IsCulled(1) && scene.IsCulled(4), "Hidden occluders are culled and don't occlude");
+
+    // The change log lists what moved, got damaged or flipped culling since a version
+    uint64_t const version = scene.GetVersion();
+    scene.Update(surfaces);
+    Check(scene.GetVersion() == version, "Updates without changes keep the version");
+    Check(scene.GetChanges(version, indices) && indices.empty(), "Updates without changes log nothing");
+
+    surfaces[3].rect.offset = vk::Offset2D(20, 700);
+    surfaces[0].contentDamaged = true;
+    scene.Update(surfaces);
+    surfaces[0].contentDamaged = false;
+    Check(scene.GetChanges(version, indices) && indices == std::vector<uint32_t>({ 0, 3 }), "Moved and damaged surfaces are logged");
+
+    uint64_t const movedVersion = scene.GetVersion();
+    surfaces[4].visible = true;
+    scene.Update(surfaces);
+    Check(scene.GetChanges(movedVersion, indices) && std::count(indices.begin(), indices.end(), 1) == 1,
+        "Surfaces occluded by another one's change are logged");
+
+    surfaces.push_back(MakeSurface(0, 0, 10, 10));
+    scene.Update(surfaces);
+    Check(!scene.GetChanges(movedVersion, indices), "Adding surfaces drops the log");
+    Check(scene.GetChanges(scene.GetVersion(), indices) && indices.empty(), "The log starts over after a rebuild");
+}
+
+} // benchmarks namespace
+} // vkc namespace
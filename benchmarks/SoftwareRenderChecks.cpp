@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <Scene.hpp>
+#include <SoftwareRender.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+Surface MakeSurface(vk::Rect2D const& rect, vk::Extent2D content, BlendMode blend, std::vector<uint32_t> const& pixels)
+{
+    Surface surface;
+    surface.rect = rect;
+    surface.blend = blend;
+    surface.texture.extent = surface.texture.contentExtent = content;
+    surface.hostPixels = pixels;
+    return surface;
+}
+
+// Rounded x / 255, written independently of the renderer's kernels
+uint32_t Round255(uint32_t x)
+{
+    return (x * 2 + 255) / 510;
+}
+
+// Premultiplied source over destination with full opacity
+uint32_t Over(uint32_t src, uint32_t dst)
+{
+    uint32_t const alpha = src >> 24;
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8)
+        result |= std::min(((src >> shift) & 0xFF) + Round255(((dst >> shift) & 0xFF) * (255 - alpha)), 255u) << shift;
+    return result;
+}
+
+class Harness
+{
+public:
+    Harness(vk::Extent2D extent, uint32_t threadCount)
+        : render(extent, threadCount)
+    {
+        scene.Resize(extent);
+    }
+
+    void Frame()
+    {
+        scene.Update(surfaces);
+        render.Frame(surfaces, scene);
+        for (Surface& surface : surfaces)
+        {
+            surface.damage.clear();
+            surface.contentDamaged = false;
+        }
+    }
+
+    uint32_t GetPixel(uint32_t x, uint32_t y) const
+    {
+        return render.GetPixels()[static_cast<size_t>(y) * render.GetExtent().width + x];
+    }
+
+    std::vector<Surface> surfaces;
+    Scene scene;
+    SoftwareRender render;
+};
+
+} // anonymous namespace
+
+void RunSoftwareRenderChecks()
+{
+    std::cout << "Software render checks (" << SoftwareRender::GetKernelName() << ")" << std::endl;
+
+    {
+        Harness harness({ 8, 8 }, 1);
+        harness.surfaces.push_back(MakeSurface(vk::Rect2D({ 2, 2 }, { 2, 2 }), { 2, 2 }, BlendMode::eOpaque,
+            { 0x00102030, 0x40506070, 0x8090A0B0, 0xC0D0E0F0 }));
+        harness.Frame();
+        Check(harness.GetPixel(0, 0) == SoftwareRender::s_clearColor, "Uncovered pixels keep the clear color");
+        Check(harness.GetPixel(2, 2) == 0xFF102030 && harness.GetPixel(3, 3) == 0xFFD0E0F0,
+            "Opaque surfaces are copied with their alpha forced opaque");
+
+        harness.surfaces.front().dim = 0.5f;
+        harness.surfaces.front().contentDamaged = true;
+        harness.Frame();
+        Check(harness.GetPixel(2, 2) == 0xFF081018, "Dim scales the color channels");
+    }
+
+    {
+        Harness harness({ 4, 1 }, 1);
+        harness.surfaces.push_back(MakeSurface(vk::Rect2D({ 0, 0 }, { 1, 1 }), { 1, 1 }, BlendMode::ePremultiplied,
+            { 0x80400000 }));
+        harness.surfaces.push_back(MakeSurface(vk::Rect2D({ 1, 0 }, { 1, 1 }), { 1, 1 }, BlendMode::eStraight,
+            { 0x80FF0000 }));
+        harness.Frame();
+        Check(harness.GetPixel(0, 0) == 0xFF407F00, "Premultiplied surfaces blend over the destination");
+        Check(harness.GetPixel(1, 0) == 0xFF807F00, "Straight alpha surfaces are premultiplied before blending");
+    }
+
+    {
+        // Texel centers land on the first and last destination pixels, the ones between are interpolated
+        Harness harness({ 4, 2 }, 1);
+        harness.surfaces.push_back(MakeSurface(vk::Rect2D({ 0, 0 }, { 4, 2 }), { 2, 1 }, BlendMode::eOpaque,
+            { 0xFF000000, 0xFF0000FF }));
+        harness.Frame();
+        Check(harness.GetPixel(0, 0) == 0xFF000000 && harness.GetPixel(1, 0) == 0xFF000040
+            && harness.GetPixel(2, 0) == 0xFF0000BF && harness.GetPixel(3, 0) == 0xFF0000FF,
+            "Magnified surfaces are filtered bilinearly");
+        Check(harness.GetPixel(1, 1) == harness.GetPixel(1, 0), "Filtering clamps at the edges");
+
+        harness.surfaces.front().rect.extent = vk::Extent2D(1, 1);
+        harness.surfaces.front().damage.push_back(vk::Rect2D({ 0, 0 }, { 4, 2 }));
+        harness.Frame();
+        Check(harness.GetPixel(0, 0) == 0xFF000080, "Minified surfaces average the texels under a pixel");
+    }
+
+    {
+        // Wide enough for the SIMD kernels and their scalar tail, split into several bands
+        uint32_t const width = 37;
+        uint32_t const height = 9;
+        std::mt19937 random(7);
+        std::vector<uint32_t> below(width * height);
+        std::vector<uint32_t> above(width * height);
+        for (size_t i = 0; i < below.size(); ++i)
+        {
+            below[i] = random() | 0xFF000000;
+
+            // Premultiplied colors never exceed their alpha
+            uint32_t const alpha = random() & 0xFF;
+            above[i] = alpha << 24;
+            for (uint32_t shift = 0; shift < 24; shift += 8)
+                above[i] |= (alpha == 0 ? 0 : random() % (alpha + 1)) << shift;
+        }
+
+        Harness harness({ width, height }, 4);
+        harness.surfaces.push_back(MakeSurface(vk::Rect2D({ 0, 0 }, { width, height }), { width, height }, BlendMode::eOpaque, below));
+        harness.surfaces.push_back(MakeSurface(vk::Rect2D({ 0, 0 }, { width, height }), { width, height }, BlendMode::ePremultiplied, above));
+        harness.Frame();
+
+        bool matches = true;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+                matches = matches && harness.GetPixel(x, y) == Over(above[y * width + x], below[y * width + x]);
+        }
+        Check(matches, "Every kernel and band blends like the reference");
+
+        // Only the damaged rectangle is recomposed
+        harness.surfaces.back().visible = false;
+        harness.surfaces.back().damage.push_back(vk::Rect2D({ 4, 2 }, { 3, 3 }));
+        harness.Frame();
+        Check(harness.render.GetDamagedPixelCount() == 9, "Damage limits the recomposed pixels");
+        Check(harness.GetPixel(4, 2) == below[2 * width + 4] && harness.GetPixel(7, 2) == Over(above[2 * width + 7], below[2 * width + 7]),
+            "Pixels outside the damage keep their content");
+    }
+}
+
+} // benchmarks namespace
+} // vkc namespace
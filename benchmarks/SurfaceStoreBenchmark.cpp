@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <ImagePool.hpp>
+#include <SurfaceStore.hpp>
+#include <random>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+std::vector<Surface> MakeSurfaces(size_t count, vk::Extent2D output)
+{
+    // Mostly small surfaces, some of them partially or fully off the output
+    std::mt19937 random(static_cast<uint32_t>(count));
+    std::uniform_int_distribution<int32_t> x(-256, static_cast<int32_t>(output.width));
+    std::uniform_int_distribution<int32_t> y(-256, static_cast<int32_t>(output.height));
+    std::uniform_int_distribution<uint32_t> size(16, 512);
+
+    std::vector<Surface> surfaces(count);
+    for (Surface& surface : surfaces)
+    {
+        surface.rect = vk::Rect2D({ x(random), y(random) }, { size(random), size(random) });
+        surface.texture.extent = ImagePool::GetBucketExtent(surface.rect.extent);
+        surface.texture.contentExtent = surface.rect.extent;
+        surface.opacity = 0.9f;
+    }
+
+    return surfaces;
+}
+
+} // anonymous namespace
+
+void RunSurfaceStoreBenchmarks()
+{
+    std::cout << "SurfaceStore kernels: " << SurfaceStore::GetKernelName() << std::endl;
+
+    vk::Extent2D const output(1920, 1080);
+    for (size_t count : { 10, 100, 1000, 10000 })
+    {
+        std::vector<Surface> const surfaces = MakeSurfaces(count, output);
+        std::vector<SurfaceConstants> instances(count);
+        SurfaceStore store;
+
+        Measure("SurfaceStore::Update", count, [&]() { store.Update(surfaces, output); });
+        Measure("SurfaceStore::Pack", count, [&]() { store.Pack(instances.data()); });
+    }
+}
+
+} // benchmarks namespace
+} // vkc namespace
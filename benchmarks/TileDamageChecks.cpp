@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include "Benchmarks.hpp"
+#include <TileDamage.hpp>
+#include <vector>
+
+namespace vkc
+{
+namespace benchmarks
+{
+
+namespace
+{
+
+Surface MakeSurface(int32_t x, int32_t y, uint32_t width, uint32_t height)
+{
+    Surface surface;
+    surface.rect = vk::Rect2D({ x, y }, { width, height });
+    surface.hostPixels.assign(1, 0);
+    return surface;
+}
+
+} // anonymous namespace
+
+void RunTileDamageChecks()
+{
+    std::cout << "Tile damage checks" << std::endl;
+
+    // 4 by 3 tiles of 16 pixels, the last column and row are partial
+    TileDamage damage;
+    damage.Resize({ 60, 40 }, 16);
+
+    std::vector<Surface> surfaces;
+    surfaces.push_back(MakeSurface(0, 0, 20, 20));
+    surfaces.push_back(MakeSurface(40, 20, 10, 10));
+    Check(damage.Update(surfaces) == 12, "The first update damages every tile");
+    Check(damage.Update(surfaces) == 0, "Updates without damage damage nothing");
+
+    surfaces[1].damage.push_back(vk::Rect2D({ 50, 36 }, { 100, 100 }));
+    Check(damage.Update(surfaces) == 1 && damage.IsDamaged(11), "Damage is clipped to the output");
+    surfaces[1].damage.clear();
+
+    surfaces[0].contentDamaged = true;
+    Check(damage.Update(surfaces) == 4 && damage.IsDamaged(0) && damage.IsDamaged(5) && !damage.IsDamaged(2),
+        "New content damages the tiles under the surface without a damage rectangle");
+
+    surfaces[0].visible = false;
+    Check(damage.Update(surfaces) == 0, "New content of hidden surfaces damages nothing");
+    surfaces[0].visible = true;
+    surfaces[0].contentDamaged = false;
+
+    surfaces.push_back(MakeSurface(0, 0, 5, 5));
+    Check(damage.Update(surfaces) == 12, "Added surfaces damage every tile");
+    surfaces.pop_back();
+    Check(damage.Update(surfaces) == 12, "Removed surfaces damage every tile");
+    Check(damage.Update(surfaces) == 0, "The history is valid again after a full redraw");
+
+    damage.Invalidate();
+    Check(damage.Update(surfaces) == 12, "Invalidating damages every tile");
+}
+
+} // benchmarks namespace
+} // vkc namespace
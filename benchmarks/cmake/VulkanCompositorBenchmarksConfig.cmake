@@ -0,0 +1,7 @@
+# Copyright (C) 2018 by Ilya Glushchenko
+# This code is licensed under the MIT license (MIT)
+# (http://opensource.org/licenses/MIT)
+
+set(VULKAN_COMPOSITOR_BENCHMARKS_PROJECT "VulkanCompositorBenchmarks")
+set(VULKAN_COMPOSITOR_BENCHMARKS_NAME "VulkanCompositorBenchmarks")
+set(VULKAN_COMPOSITOR_BENCHMARKS_ROOT "${VULKAN_COMPOSITOR_ROOT}/benchmarks")
@@ -8,7 +8,12 @@
 int main()
 {
     vkc::Compositor compositor;
+
+    // Without a device there is no window to close, so the software fallback runs for ten seconds
+    compositor.headlessFrameLimit = 600;
     compositor.Init();
+    if (compositor.IsHeadless())
+        compositor.GetFrameScheduler().SetFrameRateLimit(60.0);
 
     while (compositor.IsValid())
     {
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Surface.hpp>
+#include <Device.hpp>
+#include <Window.hpp>
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Background blur for translucent panels. The surfaces below a panel are rendered into a
+ * half resolution backdrop, which is blurred with two dual Kawase down and up sample
+ * compute passes. The result is cached per panel and only recomputed when the panel moves
+ * or damage below it intersects the panel, so a panel over static content costs one
+ * extra textured quad per frame.
+ */
+
+/*
+ * Command buffers effect passes are recorded into. With an async compute queue the
+ * backdrop is drawn into the graphics buffer, blurred in the compute buffer and handed
+ * back to the composite buffer, otherwise all three are the same command buffer.
+ */
+struct EffectCommands
+{
+    vk::CommandBuffer graphics;
+    vk::CommandBuffer compute;
+    vk::CommandBuffer composite;
+    bool computeRecorded = false;
+
+    bool IsAsync() const { return compute != composite; }
+};
+
+class BlurEffect
+{
+public:
+    using DrawBackdrop = std::function<void(vk::CommandBuffer cmd, size_t surfaceCount)>;
+
+    static uint32_t const s_downscale = 2;
+    static uint32_t const s_maxPanelCount = 8;
+
+    BlurEffect(Device& device, Window& window);
+
+    ~BlurEffect();
+
+    BlurEffect(BlurEffect&) = delete;
+    BlurEffect(BlurEffect&&) = delete;
+    BlurEffect& operator=(BlurEffect&) = delete;
+    BlurEffect& operator=(BlurEffect&&) = delete;
+
+    bool Init();
+
+    void Shutdown();
+
+    vk::ImageView Prepare(EffectCommands& cmds, std::vector<Surface> const& surfaces, size_t panelIndex,
+        uint64_t frame, vk::ClearValue const& clearValue, DrawBackdrop const& drawBackdrop);
+
+    void Retire(uint64_t completedFrameCount);
+
+    vk::Sampler GetSampler() const;
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+    float offset = 1.5f;
+    uint64_t maxIdleFrames = 120;
+    // Panels are recreated at the new scale on their next use
+    uint32_t downscale = s_downscale;
+
+private:
+    static uint32_t const s_passCount = 4;
+
+    struct Constants
+    {
+        float halfTexel[2];
+        float offset;
+        uint32_t upsample;
+    };
+
+    struct Panel
+    {
+        vk::Rect2D rect;
+        Image backdrop;
+        std::array<Image, 2> levels;
+        Image result;
+        vk::Framebuffer framebuffer;
+        std::array<vk::DescriptorSet, s_passCount> descriptorSets;
+        uint32_t downscale = 0;
+        uint64_t lastUsedFrame = 0;
+        bool valid = false;
+    };
+
+    Device& m_device;
+    Window& m_window;
+    Shader m_shader;
+    vk::Sampler m_sampler;
+    vk::RenderPass m_renderPass;
+    vk::DescriptorSetLayout m_descriptorSetLayout;
+    vk::DescriptorPool m_descriptorPool;
+    vk::PipelineLayout m_pipelineLayout;
+    vk::Pipeline m_pipeline;
+    std::unordered_map<uint64_t, Panel> m_panels;
+
+    bool CreateRenderPass();
+
+    bool CreateDescriptors();
+
+    bool CreatePipeline();
+
+    bool InitPanel(Panel& panel, vk::Rect2D const& rect);
+
+    void DestroyPanel(Panel& panel);
+
+    bool IsBackdropDamaged(std::vector<Surface> const& surfaces, size_t panelIndex) const;
+
+    void RecordBlur(EffectCommands const& cmds, Panel const& panel);
+
+    void RecordOwnershipTransfer(vk::CommandBuffer release, vk::CommandBuffer acquire, Image const& image,
+        vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t srcFamilyIndex, uint32_t dstFamilyIndex,
+        vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess);
+};
+
+} // vkc namespace
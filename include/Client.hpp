@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Input.hpp>
+#include <Timing.hpp>
+#include <vulkan/vulkan.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Pixel buffer shared between a client and the compositor. The client sets busy before
+ * committing the buffer and must not write it again until the compositor has copied
+ * the content and cleared busy, which is the buffer's release.
+ */
+struct ClientBuffer
+{
+    vk::Extent2D extent;
+    std::vector<uint32_t> pixels;
+    std::atomic<bool> busy{ false };
+};
+
+/*
+ * New state of one client surface. Damage is in surface local coordinates, a commit
+ * without a buffer only damages the current content.
+ */
+struct ClientCommit
+{
+    uint32_t output = 0;
+    uint32_t surface = 0;
+    std::shared_ptr<ClientBuffer> pBuffer;
+    std::vector<vk::Rect2D> damage;
+    Clock::time_point timestamp;
+};
+
+using CommitRing = SpscRing<ClientCommit, 64>;
+
+} // vkc namespace
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Surface.hpp>
+#include <Timing.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Trace file of client commits. The file is a header followed by variable sized records,
+ * every record is a fixed layout CommitRecord followed by its damage rectangles and,
+ * if contents were stored, the BGRA8 host pixels of the surface. All fields are little
+ * endian and every part is padded to eight bytes, so a mapped file is read in place.
+ */
+struct TraceHeader
+{
+    static uint32_t const s_version = 1;
+    static uint32_t const s_maxOutputCount = 8;
+    static uint32_t const s_contentsStored = 1;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t outputCount;
+    uint32_t reserved;
+    uint32_t outputExtents[s_maxOutputCount][2];
+};
+
+struct TraceRect
+{
+    int32_t x;
+    int32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
+// A surface state committed by a client, surface is s_none when only the count changed
+struct CommitRecord
+{
+    static uint32_t const s_none = UINT32_MAX;
+    static uint32_t const s_visible = 1;
+    static uint32_t const s_blurBehind = 2;
+    static uint32_t const s_contentDamaged = 4;
+    static uint32_t const s_yuv = 8;
+    static uint32_t const s_hasPixels = 16;
+    // Larger content is rejected when reading, so a corrupt record can't request huge buffers
+    static uint32_t const s_maxContentExtent = 16384;
+
+    uint64_t time;
+    uint64_t frame;
+    uint64_t contentHash;
+    uint32_t size;
+    uint32_t output;
+    uint32_t surface;
+    uint32_t surfaceCount;
+    uint32_t client;
+    TraceRect rect;
+    uint32_t contentWidth;
+    uint32_t contentHeight;
+    uint32_t damageCount;
+    uint32_t flags;
+    uint32_t blend;
+    float opacity;
+    float dim;
+    float cornerRadius;
+    uint32_t padding;
+};
+
+/*
+ * Writes every commit that reaches the compositor into a trace. A commit is a surface
+ * with damage or new content at the start of a frame. Damage stays on the surfaces until
+ * their output renders, so only what was added since the last record is written, and the
+ * owner reports cleared damage through OnDamageCleared. Content is stored as a 64-bit
+ * hash, or in full when requested, which makes traces large but replays pixel exact.
+ */
+class CommitRecorder
+{
+public:
+    CommitRecorder() = default;
+
+    CommitRecorder(CommitRecorder&) = delete;
+    CommitRecorder(CommitRecorder&&) = delete;
+    CommitRecorder& operator=(CommitRecorder&) = delete;
+    CommitRecorder& operator=(CommitRecorder&&) = delete;
+
+    bool Start(FILE* pOutput, std::vector<vk::Extent2D> const& outputExtents, bool storeContents);
+
+    void Stop();
+
+    bool IsActive() const;
+
+    void Record(uint32_t output, std::vector<Surface> const& surfaces, uint64_t frame);
+
+    // The output rendered and cleared the damage of its surfaces
+    void OnDamageCleared(uint32_t output);
+
+    uint64_t GetRecordCount() const;
+
+    uint64_t GetByteCount() const;
+
+    static uint64_t HashContent(std::vector<uint32_t> const& pixels);
+
+private:
+    // What of a surface's pending damage is already in the trace
+    struct RecordedDamage
+    {
+        size_t rectCount = 0;
+        bool content = false;
+    };
+
+    FILE* m_pOutput = nullptr;
+    bool m_storeContents = false;
+    Clock::time_point m_start;
+    std::vector<size_t> m_surfaceCounts;
+    std::vector<std::vector<RecordedDamage>> m_recordedDamage;
+    std::vector<uint8_t> m_record;
+    uint64_t m_recordCount = 0;
+    uint64_t m_byteCount = 0;
+
+    void Write(uint32_t output, std::vector<Surface> const& surfaces, uint32_t surface, size_t firstDamage,
+        bool contentDamaged, uint64_t frame);
+};
+
+/*
+ * Memory mapped trace reader. Records are walked in place, the pointers of a Commit stay
+ * valid until the trace is closed.
+ */
+class CommitTrace
+{
+public:
+    struct Commit
+    {
+        CommitRecord const* pRecord = nullptr;
+        TraceRect const* pDamage = nullptr;
+        uint32_t const* pPixels = nullptr;
+    };
+
+    CommitTrace() = default;
+
+    ~CommitTrace();
+
+    CommitTrace(CommitTrace&) = delete;
+    CommitTrace(CommitTrace&&) = delete;
+    CommitTrace& operator=(CommitTrace&) = delete;
+    CommitTrace& operator=(CommitTrace&&) = delete;
+
+    bool Open(char const* pPath);
+
+    void Close();
+
+    TraceHeader const& GetHeader() const;
+
+    // Returns false at the end of the trace or on a truncated or malformed record
+    bool Next(Commit& commit);
+
+    void Rewind();
+
+    // Applies the commit to the surfaces of its output, content from hashes is synthesized
+    static void Apply(Commit const& commit, std::vector<Surface>& surfaces);
+
+private:
+    uint8_t const* m_pData = nullptr;
+    size_t m_size = 0;
+    size_t m_offset = 0;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+} // vkc namespace
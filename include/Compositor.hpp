@@ -5,26 +5,221 @@
  */
 #pragma once
 
+#include <Client.hpp>
+#include <CommitTrace.hpp>
 #include <Device.hpp>
-#include <Window.hpp>
+#include <FrameScheduler.hpp>
+#include <Input.hpp>
+#include <LatencyHistogram.hpp>
+#include <QualityGovernor.hpp>
+#include <Output.hpp>
 #include <Render.hpp>
+#include <SoftwareRender.hpp>
+#include <Residency.hpp>
+#include <ImagePool.hpp>
+#include <Scene.hpp>
+#include <Surface.hpp>
+#include <Timing.hpp>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 namespace vkc
 {
 
+struct StartupTimings
+{
+    Milliseconds device{ 0 };
+    Milliseconds window{ 0 };
+    Milliseconds shaders{ 0 };
+    Milliseconds pipelines{ 0 };
+    Milliseconds renderResources{ 0 };
+    Milliseconds init{ 0 };
+    Milliseconds firstFrame{ 0 };
+};
+
+/*
+ * Drives one output per entry of outputConfigs on a shared device. Every frame the
+ * outputs that need a frame and have a swapchain image available are recorded in
+ * parallel, submitted in one batch and presented one by one, so an output whose display
+ * is slow or occluded is skipped without holding back the others. Capture and the
+ * Y'CbCr samplers belong to the first output, which also paces the frame scheduler.
+ * Input is timestamped on arrival and goes through a lock-free ring per producer; at the
+ * start of a frame it is hit tested against the scene and forwarded to the ring of the
+ * target client. The time from arrival to the first frame on the target output that
+ * reflects an event is recorded in the input latency histogram, up to the scan-out on the
+ * first output and to the completion of the frame on the others. Events on an output
+ * that needs no frame afterwards are dropped from the histogram and only counted.
+ * Clients commit surface content through their own lock-free ring as well. Commits are
+ * applied at the start of a frame, and the time from a commit to the end of the frame
+ * that shows it is recorded per client.
+ * Under GPU load the quality governor trades blur and filtering quality for frame time,
+ * and restores it once the frames fit the refresh period again.
+ * Without a usable Vulkan device the compositor falls back to the software renderer,
+ * which composites every output headless into host memory. GPU only features, such as
+ * capture, image allocation and Y'CbCr conversion, are unavailable then.
+ */
 class Compositor
 {
+    // Commit applied at the start of a frame, shown by the output's frame with that index
+    struct PendingCommit
+    {
+        uint32_t client;
+        Output const* pOutput;
+        uint64_t frame;
+        Clock::time_point timestamp;
+    };
+
+    // Commits to an output that never presents are evicted oldest first past this many
+    static size_t const s_maxPendingCommits = 4096;
+
 public:
+    ~Compositor();
+
     bool Init();
 
     bool IsValid();
 
     void RenderFrame();
 
+    void SetCompositionPath(CompositionPath path);
+
+    YcbcrSamplers const* GetYcbcrSamplers() const;
+
+    bool StartCapture(FILE* pOutput);
+
+    void StopCapture();
+
+    // Records the surface commits of every output from the next frame on, see CommitRecorder
+    bool StartRecording(FILE* pOutput, bool storeContents = false);
+
+    void StopRecording();
+
+    StartupTimings const& GetStartupTimings() const;
+
+    void LogStartupTimings() const;
+
+    bool AcquireImage(Image& image, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage);
+
+    void ReleaseImage(Image& image);
+
+    vk::DeviceSize GetClientMemoryUsage(uint32_t client) const;
+
+    void LogMemoryBudget() const;
+
+    size_t GetOutputCount() const;
+
+    // Frames submitted on the output, headless frames count once composed
+    uint64_t GetFrameCount(size_t output = 0) const;
+
+    std::vector<Surface>& GetSurfaces(size_t output = 0);
+
+    // Set visible and a texture to show a cursor, pointer motion moves it
+    Surface& GetCursor(size_t output = 0);
+
+    uint32_t HitTest(int32_t x, int32_t y, size_t output = 0) const;
+
+    Scene const& GetScene(size_t output = 0) const;
+
+    bool IsHeadless() const;
+
+    SoftwareRender const* GetSoftwareRender(size_t output = 0) const;
+
+    FrameScheduler& GetFrameScheduler();
+
+    // Fed with the GPU time of every rendered frame, the budget is the refresh period
+    QualityGovernor& GetQualityGovernor();
+
+    void LogQuality() const;
+
+    // Single producer, safe to call from one thread other than the compositor's, window input uses another ring
+    bool PushInput(InputEvent const& event);
+
+    // Created on first use, has to be called on the compositor thread before it is handed out
+    InputRing& GetClientInput(uint32_t client);
+
+    LatencyHistogram const& GetInputLatency() const;
+
+    void LogInputLatency() const;
+
+    // Adds a surface owned by the client and returns its index on the output
+    uint32_t AttachSurface(uint32_t client, uint32_t output, vk::Rect2D const& rect);
+
+    // Created on first use, has to be called on the compositor thread before it is handed out
+    CommitRing& GetClientCommits(uint32_t client);
+
+    // Empty for clients that never committed
+    LatencyHistogram const& GetCommitLatency(uint32_t client);
+
+    void LogCommitLatency() const;
+
+    // Commits evicted before their frame was presented, their latency is missing from the histograms
+    uint64_t GetEvictedCommitCount() const;
+
+    std::vector<OutputConfig> outputConfigs{ { "Compositor", 640, 640 } };
+    // Skips the device and composites every output in software
+    bool headless = false;
+    // Headless outputs have no window to close, so IsValid turns false after this many frames, 0 never stops
+    uint64_t headlessFrameLimit = 0;
+
 private:
     Device device;
-    std::unique_ptr<Window> m_pWindow;
-    std::unique_ptr<Render> m_pRender;
+    std::vector<std::unique_ptr<Output>> m_outputs;
+    std::unique_ptr<ResidencyManager> m_pResidency;
+    std::unique_ptr<ImagePool> m_pImagePool;
+    vk::Fence m_frameFence;
+    FrameScheduler m_scheduler;
+    QualityGovernor m_qualityGovernor;
+    std::unique_ptr<InputRing> m_pInput = std::make_unique<InputRing>();
+    std::unique_ptr<InputRing> m_pWindowInput = std::make_unique<InputRing>();
+    std::unordered_map<uint32_t, std::unique_ptr<InputRing>> m_clientInput;
+    std::vector<std::deque<InputEvent>> m_pendingInput;
+    uint64_t m_unrenderedInputCount = 0;
+    std::unordered_map<uint32_t, std::unique_ptr<CommitRing>> m_clientCommits;
+    std::deque<PendingCommit> m_pendingCommits;
+    uint64_t m_evictedCommitCount = 0;
+    std::unordered_map<uint32_t, LatencyHistogram> m_commitLatency;
+    uint32_t m_focusOutput = 0;
+    uint32_t m_focusSurface = Scene::s_none;
+    LatencyHistogram m_inputLatency;
+    CommitRecorder m_recorder;
+    uint64_t m_frameIndex = 0;
+    bool m_headless = false;
+    std::vector<std::vector<Surface>*> m_surfaceLists;
+    std::vector<Output*> m_frameOutputs;
+    std::vector<Output*> m_presentedOutputs;
+    std::vector<vk::SubmitInfo> m_graphicsSubmits;
+    std::vector<vk::SubmitInfo> m_computeSubmits;
+    StartupTimings m_startupTimings;
+    Clock::time_point m_initStart;
+    bool m_firstFrameDone = false;
+
+    void RenderHeadlessFrame();
+
+    bool RenderOutputs();
+
+    void ObserveVblank();
+
+    void ApplyQuality();
+
+    void DispatchInput();
+
+    void DispatchEvent(InputEvent event);
+
+    void DropUnrenderedInput(size_t output);
+
+    void RecordCommits();
+
+    void DispatchCommits();
+
+    void ApplyCommit(uint32_t client, ClientCommit const& commit);
+
+    void OnCommitsPresented(Output const* pOutput, Clock::time_point time);
+
+    void OnFramePresented(size_t output, uint64_t frame, Clock::time_point time);
+
+    uint64_t GetOutputFrameCount(Output const& output) const;
 };
 
 } // namespace vkc
\ No newline at end of file
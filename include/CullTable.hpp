@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Surface.hpp>
+#include <Scene.hpp>
+#include <Pipelines.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Host side tables of the GPU culled path, kept across frames. Entries list the drawn
+ * surfaces back to front with the texture array slot they sample, runs group consecutive
+ * entries sharing a pipeline, and every distinct texture and sampler pair owns one slot
+ * however many surfaces sample it. Update only revisits the surfaces the scene logged as
+ * changed, so a frame costs the same at any surface count unless surfaces were added or
+ * removed. Changed entries and slots are collected until the owner takes them.
+ */
+class CullTable
+{
+public:
+    static uint32_t const s_none = UINT32_MAX;
+
+    struct Entry
+    {
+        uint32_t instance;
+        uint32_t textureIndex;
+    };
+
+    struct Run
+    {
+        PipelineKey key;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct Texture
+    {
+        vk::Sampler sampler;
+        vk::ImageView view;
+
+        bool operator==(Texture const& other) const { return sampler == other.sampler && view == other.view; }
+        bool operator<(Texture const& other) const;
+    };
+
+    // Clears the tables, everything is rebuilt on the next update
+    void Reset(uint32_t textureCount);
+
+    /*
+     * Drawn surfaces are the ones the scene doesn't cull that have a texture, sampled with
+     * the given sampler until SetTexture replaces it. Surfaces drawn below mipScaleThreshold
+     * are listed as minified, 0 lists none. False while the surfaces need the raster path:
+     * blurred backdrops, multi-planar textures or more distinct textures than slots.
+     */
+    bool Update(std::vector<Surface> const& surfaces, Scene const& scene, vk::Sampler sampler, float mipScaleThreshold);
+
+    // Samples another texture for a drawn surface, such as its mip chain
+    void SetTexture(uint32_t surface, Texture const& texture);
+
+    std::vector<Entry> const& GetEntries() const;
+
+    std::vector<Run> const& GetRuns() const;
+
+    // Empty for free slots
+    Texture const& GetTexture(uint32_t slot) const;
+
+    std::vector<uint32_t> const& GetMinifiedSurfaces() const;
+
+    uint32_t GetTextureCount() const;
+
+    // True when entries were added or removed or runs changed, then every entry is stale
+    bool TakeChanges(std::vector<uint32_t>& entries, std::vector<uint32_t>& slots);
+
+private:
+    struct SurfaceState
+    {
+        PipelineKey key;
+        Texture texture;
+        uint32_t slot = s_none;
+        bool drawn = false;
+        bool minified = false;
+        bool unsupported = false;
+    };
+
+    struct Slot
+    {
+        Texture texture;
+        uint32_t userCount = 0;
+    };
+
+    std::vector<SurfaceState> m_surfaces;
+    std::vector<Entry> m_entries;
+    std::vector<Run> m_runs;
+    std::vector<uint32_t> m_minified;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    std::map<Texture, uint32_t> m_slotIndices;
+    std::vector<uint32_t> m_changes;
+    std::vector<uint32_t> m_changedEntries;
+    std::vector<uint32_t> m_changedSlots;
+    uint64_t m_sceneVersion = 0;
+    vk::Sampler m_sampler;
+    float m_mipScaleThreshold = 0.0f;
+    size_t m_unsupportedCount = 0;
+    size_t m_missingSlotCount = 0;
+    bool m_layoutChanged = false;
+
+    void Rebuild(std::vector<Surface> const& surfaces, Scene const& scene);
+
+    void UpdateSurface(std::vector<Surface> const& surfaces, Scene const& scene, uint32_t index);
+
+    void ReplaceTexture(uint32_t surface, Texture const& texture);
+
+    uint32_t AcquireSlot(Texture const& texture);
+
+    void ReleaseSlot(uint32_t slot);
+
+    void BuildRuns();
+};
+
+} // vkc namespace
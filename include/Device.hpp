@@ -5,7 +5,12 @@
  */
 #pragma once
 
+#include <DeviceConfig.hpp>
+#include <MemoryBudget.hpp>
 #include <vulkan/vulkan.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
 
 namespace vkc
 {
@@ -35,24 +40,54 @@ public:
 
     void Shutdown();
 
+    // What was negotiated and which physical device was picked, and why
+    void LogConfiguration(std::ostream& out) const;
+
     std::string const applicationName = "NewCompositor";
     uint32_t const applicationVersion = 1;
     std::string const engineName = "Compositor";
     uint32_t const engineVersion = 1;
-    std::vector<vk::PhysicalDeviceType> const gpuTypes{ vk::PhysicalDeviceType::eDiscreteGpu };
+    // Read by Init, so changes only apply to a device that is initialized afterwards
+    DeviceConfig config = DeviceConfig::Default();
     vk::Result status = vk::Result::eErrorInitializationFailed;
 
     vk::Instance instance;
     vk::PhysicalDevice physical;
     vk::Device logical;
+    vk::PhysicalDeviceFeatures features;
+    bool samplerYcbcrConversion = false;
+    bool timelineSemaphore = false;
+    bool asyncCompute = false;
+    bool memoryBudgetExtension = false;
+    bool displayTiming = false;
+    bool debugUtils = false;
+    // Host and device timestamps can be sampled together in the host time domain
+    bool calibratedTimestamps = false;
+    // Indirect draws can read their draw count from a buffer
+    bool drawIndirectCount = false;
+    // Nanoseconds per timestamp tick, zero when the graphics queue has no timestamps
+    float timestampPeriod = 0.0f;
+    vk::DispatchLoaderDynamic dispatch;
+    MemoryBudget memoryBudget;
     Queue queue;
+    Queue computeQueue;
+    std::vector<std::string> enabledLayers;
+    std::vector<std::string> enabledInstanceExtensions;
+    std::vector<std::string> enabledDeviceExtensions;
+    std::vector<DeviceCandidate> candidates;
 
 private:
     bool CreateInstance();
 
     bool FindPhysicalDevice();
 
+    PhysicalDeviceTraits GetTraits(vk::PhysicalDevice physicalDevice, uint32_t& graphicsFamily) const;
+
+    void FindComputeQueueFamily(std::vector<vk::QueueFamilyProperties> const& queueFamilyProperties);
+
     bool CreateLogicalDevice();
+
+    bool IsHostTimeDomainCalibrateable() const;
 };
 
 } // vkc namespace
\ No newline at end of file
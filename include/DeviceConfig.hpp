@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vkc
+{
+
+// What a physical device offers the compositor, gathered before one is picked
+struct PhysicalDeviceTraits
+{
+    vk::PhysicalDeviceType type = vk::PhysicalDeviceType::eOther;
+    uint32_t apiVersion = 0;
+    vk::DeviceSize deviceLocalHeapSize = 0;
+    bool graphicsPresentQueue = false;
+    bool dedicatedComputeQueue = false;
+    bool timestamps = false;
+    bool swapchain = false;
+};
+
+struct DeviceCandidate
+{
+    std::string name;
+    vk::PhysicalDeviceType type = vk::PhysicalDeviceType::eOther;
+    // Negative for devices that can't run the compositor
+    int64_t score = -1;
+    std::string reason;
+    bool selected = false;
+};
+
+/*
+ * Layers, instance extensions and physical device preference the device is created with.
+ * Everything listed here is negotiated against what the loader reports, so a missing
+ * layer or optional extension is reported and skipped instead of failing instance
+ * creation. Only the first available validation layer is enabled, the release profile
+ * has none and runs every Vulkan call without layer overhead.
+ */
+struct DeviceConfig
+{
+    enum class Profile
+    {
+        eDebug,
+        eRelease
+    };
+
+    Profile profile = Profile::eRelease;
+    std::vector<std::string> validationLayers;
+    std::vector<std::string> optionalInstanceExtensions{ VK_EXT_DEBUG_UTILS_EXTENSION_NAME };
+    // Preference order, device types missing here are never picked
+    std::vector<vk::PhysicalDeviceType> gpuTypes{
+        vk::PhysicalDeviceType::eDiscreteGpu,
+        vk::PhysicalDeviceType::eIntegratedGpu,
+        vk::PhysicalDeviceType::eCpu
+    };
+
+    static DeviceConfig Debug();
+
+    static DeviceConfig Release();
+
+    // Debug for builds without NDEBUG, VKC_VALIDATION=0 or 1 in the environment overrides it
+    static DeviceConfig Default();
+
+    /*
+     * Device type preference dominates, within a type newer API versions up to the one the
+     * instance requests win, then larger device local heaps, and a dedicated compute queue
+     * and timestamps break ties. Devices without a presentable
+     * graphics queue or swapchain support are rejected with a negative score.
+     */
+    int64_t Score(PhysicalDeviceTraits const& traits, std::string& reason) const;
+
+    char const* GetProfileName() const;
+};
+
+} // vkc namespace
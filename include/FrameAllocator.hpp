@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Device.hpp>
+#include <Structs.hpp>
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace vkc
+{
+
+// Uniforms shared by every surface drawn in a frame
+struct FrameUniforms
+{
+    // Applied to the normalized device coordinates of every quad
+    float transform[16];
+    float outputSize[2];
+    float time;
+    float frame;
+};
+
+/*
+ * Descriptor pool and uniform ring slice for every frame in flight. A frame allocates its
+ * descriptor sets and uniforms out of its own slot and the slot is reset wholesale once
+ * the frame has retired, so steady state frames neither create nor free Vulkan objects.
+ * The ring is persistently mapped and read through a single dynamic uniform buffer
+ * descriptor written at init, draws only pass the offset of their uniforms. A slot whose
+ * pool runs out chains another one of the same size and keeps it for later frames, and
+ * image sets are shared by every draw of a frame sampling the same texture.
+ */
+class FrameAllocator
+{
+public:
+    static uint32_t const s_frameCount = 2;
+
+    FrameAllocator(Device& device);
+
+    ~FrameAllocator();
+
+    FrameAllocator(FrameAllocator&) = delete;
+    FrameAllocator(FrameAllocator&&) = delete;
+    FrameAllocator& operator=(FrameAllocator&) = delete;
+    FrameAllocator& operator=(FrameAllocator&&) = delete;
+
+    // Every slot gets a pool of the given sizes and room for uniformCount blocks of uniformRange bytes
+    bool Init(std::vector<vk::DescriptorPoolSize> const& poolSizes, uint32_t maxSets,
+        vk::DeviceSize uniformRange, uint32_t uniformCount, vk::ShaderStageFlags uniformStages);
+
+    void Shutdown();
+
+    // Selects the slot of the frame, which must not be in flight anymore
+    bool BeginFrame(uint64_t frame);
+
+    // Resets the slots of every frame before completedFrameCount
+    void Retire(uint64_t completedFrameCount);
+
+    vk::DescriptorSet AllocateSet(vk::DescriptorSetLayout layout);
+
+    // Set of the layout with binding 0 sampling the view, written once per frame
+    vk::DescriptorSet GetImageSet(vk::DescriptorSetLayout layout, vk::Sampler sampler, vk::ImageView view);
+
+    // Copies up to the uniform range into the ring, offset is the dynamic offset to bind with
+    bool PushUniforms(void const* pData, size_t size, uint32_t& offset);
+
+    vk::DescriptorSetLayout GetUniformSetLayout() const;
+
+    vk::DescriptorSet GetUniformSet() const;
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+
+private:
+    using ImageSetKey = std::tuple<vk::DescriptorSetLayout, vk::Sampler, vk::ImageView>;
+
+    struct Slot
+    {
+        std::vector<vk::DescriptorPool> pools;
+        size_t poolIndex = 0;
+        std::map<ImageSetKey, vk::DescriptorSet> imageSets;
+        vk::DeviceSize uniformBegin = 0;
+        vk::DeviceSize uniformHead = 0;
+        uint64_t frame = 0;
+        bool inFlight = false;
+    };
+
+    Device& m_device;
+    std::array<Slot, s_frameCount> m_slots;
+    Slot* m_pSlot = nullptr;
+    std::vector<vk::DescriptorPoolSize> m_poolSizes;
+    uint32_t m_maxSets = 0;
+    Buffer m_uniformRing;
+    vk::DeviceSize m_uniformRange = 0;
+    vk::DeviceSize m_uniformStride = 0;
+    vk::DeviceSize m_sliceSize = 0;
+    vk::DescriptorSetLayout m_uniformSetLayout;
+    vk::DescriptorPool m_uniformPool;
+    vk::DescriptorSet m_uniformSet;
+
+    bool AddPool(Slot& slot);
+
+    void ResetSlot(Slot& slot);
+};
+
+} // vkc namespace
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Device.hpp>
+#include <Window.hpp>
+#include <Timing.hpp>
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace vkc
+{
+
+/*
+ * Asynchronous capture of composited frames. Every frame the swapchain image is copied
+ * into one of a ring of persistently mapped host buffers as part of the frame's own
+ * command buffer. Once the frame is known to be complete the slot is handed to a writer
+ * thread which streams it to the output as raw, tightly packed pixels in the swapchain
+ * format. Frames are dropped instead of stalling the render thread when every slot is busy.
+ */
+class FrameCapture
+{
+public:
+    static uint32_t const s_slotCount = 4;
+
+    FrameCapture(Device& device, Window& window);
+
+    ~FrameCapture();
+
+    FrameCapture(FrameCapture&) = delete;
+    FrameCapture(FrameCapture&&) = delete;
+    FrameCapture& operator=(FrameCapture&) = delete;
+    FrameCapture& operator=(FrameCapture&&) = delete;
+
+    bool Start(FILE* pOutput);
+
+    void Stop();
+
+    bool IsActive() const;
+
+    void Record(vk::CommandBuffer cmd, vk::Image image, uint64_t frame);
+
+    void Collect(uint64_t completedFrame);
+
+    uint64_t GetCapturedFrameCount() const;
+
+    uint64_t GetDroppedFrameCount() const;
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+    Milliseconds recordTime{ 0 };
+    Milliseconds collectTime{ 0 };
+
+private:
+    enum class SlotState : uint32_t
+    {
+        eFree,
+        eRecorded,
+        eWriting,
+    };
+
+    struct Slot
+    {
+        Buffer buffer;
+        uint64_t frame = 0;
+        std::atomic<SlotState> state{ SlotState::eFree };
+    };
+
+    Device& m_device;
+    Window& m_window;
+    size_t const m_frameSize;
+    std::array<Slot, s_slotCount> m_slots;
+    uint32_t m_nextSlot = 0;
+    std::deque<uint32_t> m_recordedSlots;
+    FILE* m_pOutput = nullptr;
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<uint32_t> m_writeQueue;
+    bool m_stopWriter = false;
+    std::atomic<uint64_t> m_capturedFrames{ 0 };
+    std::atomic<uint64_t> m_droppedFrames{ 0 };
+
+    void WriterLoop();
+};
+
+} // vkc namespace
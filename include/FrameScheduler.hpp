@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Timing.hpp>
+#include <array>
+#include <cstdint>
+#include <functional>
+
+namespace vkc
+{
+
+/*
+ * Decides when to start composing a frame, as late as possible while still finishing
+ * before the next vblank. Render time is predicted from a high percentile of recent frame
+ * durations plus a safety margin. Durations are wall time from the frame start until the
+ * frame has completed on the GPU, so they cover recording and submission on the CPU as
+ * well as GPU execution, which GPU timestamps alone would miss. Vblanks are extrapolated
+ * from the refresh period and the last observed scan-out: exact times, e.g. from
+ * VK_GOOGLE_display_timing, replace the phase directly, estimated ones only nudge it, so
+ * a noisy source converges instead of jittering. Without a refresh period frames start
+ * right away, unless the frame rate limit holds them back. The clock and the sleep are
+ * injectable together, so the schedule can be driven by simulated time; the default
+ * sleep spins on the given clock at the end.
+ */
+class FrameScheduler
+{
+public:
+    using TimeSource = std::function<Clock::time_point()>;
+    using SleepFunction = std::function<void(Clock::time_point)>;
+
+    static size_t const s_sampleCount = 32;
+
+    FrameScheduler(TimeSource now = &Clock::now, SleepFunction sleepUntil = SleepFunction());
+
+    // The default sleep refers to this instance
+    FrameScheduler(FrameScheduler&) = delete;
+    FrameScheduler(FrameScheduler&&) = delete;
+    FrameScheduler& operator=(FrameScheduler&) = delete;
+    FrameScheduler& operator=(FrameScheduler&&) = delete;
+
+    void SetRefreshPeriod(Clock::duration period);
+
+    void SetFrameRateLimit(double framesPerSecond);
+
+    void OnVblank(Clock::time_point time, bool exact);
+
+    void OnFrameDone(Clock::time_point start, Clock::time_point end);
+
+    Clock::duration GetPredictedRenderTime() const;
+
+    Clock::time_point GetFrameStart() const;
+
+    Clock::time_point GetTargetVblank() const;
+
+    Clock::time_point WaitForFrameStart();
+
+    uint64_t GetMissedDeadlineCount() const;
+
+    Clock::time_point Now() const;
+
+    Clock::duration safetyMargin = std::chrono::microseconds(1500);
+    float phaseGain = 0.1f;
+    float percentile = 0.9f;
+
+private:
+    TimeSource m_now;
+    SleepFunction m_sleepUntil;
+    Clock::duration m_refreshPeriod{ 0 };
+    Clock::duration m_minFrameInterval{ 0 };
+    Clock::time_point m_vblankPhase;
+    bool m_hasPhase = false;
+    std::array<Clock::duration, s_sampleCount> m_samples{};
+    size_t m_sampleCount = 0;
+    size_t m_nextSample = 0;
+    Clock::time_point m_lastFrameStart;
+    Clock::time_point m_targetVblank;
+    bool m_started = false;
+    bool m_hasTarget = false;
+    uint64_t m_missedDeadlines = 0;
+
+    Clock::time_point NextVblank(Clock::time_point time) const;
+
+    void Schedule(Clock::time_point& start, Clock::time_point& vblank) const;
+
+    void PreciseSleepUntil(Clock::time_point time) const;
+};
+
+} // vkc namespace
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Surface.hpp>
+#include <Scene.hpp>
+#include <CullTable.hpp>
+#include <Device.hpp>
+#include <Pipelines.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * GPU driven variant of the raster path. Consecutive surfaces sharing a pipeline form a
+ * run, a compute pre-pass culls every run against the cull rectangle and compacts the
+ * surviving instances into indirect draw commands, which are then drawn with one
+ * indirect count draw per run. Surface textures live in a single descriptor array the
+ * fragment shader indexes per instance, so no descriptor set is allocated per surface.
+ * The entry, run and texture tables persist across frames and only the entries and
+ * array elements a changed surface touches are written again, see CullTable.
+ */
+class GpuCuller
+{
+public:
+    static uint32_t const s_maxTextureCount = 4096;
+
+    GpuCuller(Device& device);
+
+    ~GpuCuller();
+
+    GpuCuller(GpuCuller&) = delete;
+    GpuCuller(GpuCuller&&) = delete;
+    GpuCuller& operator=(GpuCuller&) = delete;
+    GpuCuller& operator=(GpuCuller&&) = delete;
+
+    // The frame set layout is set 0 of the draws, the texture array is set 1
+    bool Init(vk::DescriptorSetLayout frameSetLayout);
+
+    void Shutdown();
+
+    // False while the surfaces need the raster path, see CullTable::Update
+    bool Update(std::vector<Surface> const& surfaces, Scene const& scene, vk::Sampler sampler, float mipScaleThreshold);
+
+    // Drawn surfaces below the mip scale threshold, their texture has to be set every frame
+    std::vector<uint32_t> const& GetMinifiedSurfaces() const;
+
+    void SetTexture(uint32_t surface, vk::Sampler sampler, vk::ImageView view);
+
+    // Layout surface pipelines with PipelineKey::textureArray have to be created with
+    vk::PipelineLayout GetPipelineLayout() const;
+
+    uint32_t GetTextureCount() const;
+
+    /*
+     * Writes the changed tables and records the culling dispatch, which also stores the
+     * texture index of every drawn instance. Has to be recorded after the instances are
+     * written and outside of a render pass, cullRect is left, top, right and bottom in
+     * normalized device coordinates.
+     */
+    void Record(vk::CommandBuffer cmd, vk::Buffer instanceBuffer, float const cullRect[4]);
+
+    // Draws the culled runs, vertex buffers are expected to be bound already
+    void Draw(vk::CommandBuffer cmd, SurfacePipelines& pipelines, vk::DescriptorSet frameSet, uint32_t frameOffset);
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+
+private:
+    struct RunData
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct DrawCommand
+    {
+        uint32_t vertexCount;
+        uint32_t instanceCount;
+        uint32_t firstVertex;
+        uint32_t firstInstance;
+    };
+
+    Device& m_device;
+    uint32_t m_textureCount = 0;
+    uint32_t m_entryCapacity = 0;
+    Buffer m_entryBuffer;
+    Buffer m_runBuffer;
+    Buffer m_drawBuffer;
+    Buffer m_countBuffer;
+    Image m_fallbackTexture;
+    Shader m_shader;
+    vk::DescriptorSetLayout m_cullSetLayout;
+    vk::DescriptorSetLayout m_textureSetLayout;
+    vk::DescriptorPool m_descriptorPool;
+    vk::DescriptorSet m_cullSet;
+    vk::DescriptorSet m_textureSet;
+    vk::PipelineLayout m_cullPipelineLayout;
+    vk::PipelineLayout m_drawPipelineLayout;
+    vk::Pipeline m_cullPipeline;
+    vk::Buffer m_instanceBuffer;
+    vk::Sampler m_sampler;
+    CullTable m_table;
+    bool m_tablesStale = true;
+    bool m_fallbackReady = false;
+    uint32_t m_runCount = 0;
+    std::vector<uint32_t> m_changedEntries;
+    std::vector<uint32_t> m_changedSlots;
+    std::vector<vk::DescriptorImageInfo> m_imageInfos;
+    std::vector<vk::WriteDescriptorSet> m_textureWrites;
+
+    bool CreateBuffers(uint32_t entryCapacity);
+
+    bool CreateDescriptors();
+
+    bool CreatePipelines(vk::DescriptorSetLayout frameSetLayout);
+
+    bool ReserveEntries(size_t count);
+
+    void WriteTables(bool all);
+
+    void UpdateTextures(bool all);
+};
+
+} // vkc namespace
@@ -32,6 +32,22 @@ inline std::tuple<bool, uint32_t> FindMemoryTypeIndex(vk::PhysicalDevice device,
     return std::make_tuple(memoryTypeFound, memoryTypeIndex);
 }
 
+inline std::tuple<bool, uint32_t> FindMemoryTypeIndex(
+    vk::PhysicalDevice device, uint32_t memoryTypeBits, vk::MemoryPropertyFlags flags)
+{
+    vk::PhysicalDeviceMemoryProperties const memoryProperties = device.getMemoryProperties();
+
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+    {
+        if ((memoryTypeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+        {
+            return std::make_tuple(true, i);
+        }
+    }
+
+    return std::make_tuple(false, 0u);
+}
+
 inline bool LoadShader(char const* filename, char*& buffer, long& size)
 {
     FILE* pFile;
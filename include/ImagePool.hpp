@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Device.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Recycles client texture images together with their memory and views. Images are
+ * allocated in size buckets, so a resize usually lands on an image of the same bucket;
+ * contentExtent holds the requested size and samplers scale texture coordinates to it.
+ * Released images only become reusable once the last frame that used them has retired.
+ */
+class ImagePool
+{
+public:
+    ImagePool(Device& device);
+
+    ~ImagePool();
+
+    ImagePool(ImagePool&) = delete;
+    ImagePool(ImagePool&&) = delete;
+    ImagePool& operator=(ImagePool&) = delete;
+    ImagePool& operator=(ImagePool&&) = delete;
+
+    bool Acquire(Image& image, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage,
+        vk::SamplerYcbcrConversion conversion = vk::SamplerYcbcrConversion());
+
+    void Release(Image& image, uint64_t submittedFrameCount);
+
+    void Retire(uint64_t completedFrameCount);
+
+    void Trim();
+
+    void Shutdown();
+
+    static vk::Extent2D GetBucketExtent(vk::Extent2D extent);
+
+    uint32_t maxFreeImagesPerKey = 4;
+    uint64_t maxIdleFrames = 600;
+
+private:
+    struct Key
+    {
+        vk::Format format;
+        uint32_t width;
+        uint32_t height;
+        VkImageUsageFlags usage;
+
+        bool operator==(Key const& other) const;
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(Key const& key) const;
+    };
+
+    struct Entry
+    {
+        Image image;
+        uint64_t frame;
+    };
+
+    Device& m_device;
+    uint64_t m_completedFrameCount = 0;
+    std::vector<Entry> m_pending;
+    std::unordered_map<Key, std::vector<Entry>, KeyHash> m_free;
+
+    static Key MakeKey(Image const& image);
+};
+
+} // vkc namespace
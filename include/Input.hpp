@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Timing.hpp>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace vkc
+{
+
+enum class InputType : uint32_t
+{
+    eKey,
+    eButton,
+    eMotion,
+    eScroll,
+};
+
+/*
+ * Input event timestamped when it arrives. Pointer events carry output space coordinates,
+ * scroll events the scroll offsets in x and y and the pointer position in pointerX and
+ * pointerY. Code, action and mods are GLFW key or button codes, actions and modifiers.
+ * The compositor fills in the target surface and client, and the frame that first
+ * reflects the event, which is the next one rendered on the target output.
+ */
+struct InputEvent
+{
+    InputType type = InputType::eMotion;
+    uint32_t output = 0;
+    double x = 0.0;
+    double y = 0.0;
+    double pointerX = 0.0;
+    double pointerY = 0.0;
+    int32_t code = 0;
+    int32_t action = 0;
+    int32_t mods = 0;
+    Clock::time_point timestamp;
+    uint64_t frame = 0;
+    uint32_t surface = UINT32_MAX;
+    uint32_t client = 0;
+};
+
+/*
+ * Lock-free ring for exactly one producer and one consumer thread. Push never blocks,
+ * when the ring is full the event is dropped and counted instead.
+ */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    static size_t const s_capacity = Capacity;
+
+    bool Push(T const& value)
+    {
+        size_t const tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_items[tail & (Capacity - 1)] = value;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& value)
+    {
+        size_t const head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+
+        value = m_items[head & (Capacity - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t GetSize() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    uint64_t GetDroppedCount() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Producer and consumer indices live on separate cache lines
+    std::atomic<size_t> m_head{ 0 };
+    char m_headPadding[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail{ 0 };
+    char m_tailPadding[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<uint64_t> m_dropped{ 0 };
+    std::array<T, Capacity> m_items;
+};
+
+using InputRing = SpscRing<InputEvent, 1024>;
+
+} // vkc namespace
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Timing.hpp>
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace vkc
+{
+
+/*
+ * Fixed bucket latency histogram, a quarter millisecond per bucket up to 100 ms, longer
+ * samples land in the last bucket. Percentiles are reported at bucket resolution.
+ */
+class LatencyHistogram
+{
+public:
+    static size_t const s_bucketCount = 400;
+
+    void Add(Milliseconds latency);
+
+    void Reset();
+
+    uint64_t GetCount() const;
+
+    Milliseconds GetMean() const;
+
+    Milliseconds GetMax() const;
+
+    Milliseconds GetPercentile(double fraction) const;
+
+    void Log(std::ostream& stream, char const* pName) const;
+
+private:
+    static double constexpr s_bucketWidth = 0.25;
+
+    std::array<uint64_t, s_bucketCount> m_buckets{};
+    uint64_t m_count = 0;
+    double m_sum = 0.0;
+    double m_max = 0.0;
+};
+
+} // vkc namespace
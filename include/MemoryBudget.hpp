@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace vkc
+{
+
+struct HeapBudget
+{
+    vk::DeviceSize allocated = 0;
+    vk::DeviceSize usage = 0;
+    vk::DeviceSize budget = 0;
+    bool deviceLocal = false;
+};
+
+/*
+ * Per heap device memory accounting. Every allocation made through Image and Buffer is
+ * tracked here, allocations may happen on the pipeline initialization threads as well.
+ * When VK_EXT_memory_budget is available usage and budget come from the driver and include
+ * other processes, otherwise usage is our own allocations against a fixed share of the heap.
+ */
+class MemoryBudget
+{
+public:
+    void Init(vk::PhysicalDevice physical, bool budgetExtension);
+
+    void OnAllocate(uint32_t memoryTypeIndex, vk::DeviceSize size);
+
+    void OnFree(uint32_t memoryTypeIndex, vk::DeviceSize size);
+
+    uint32_t GetHeapCount() const;
+
+    HeapBudget GetHeapBudget(uint32_t heapIndex) const;
+
+    bool IsOverBudget(float budgetFraction) const;
+
+    vk::DeviceSize GetOverBudgetSize(float budgetFraction) const;
+
+private:
+    static float constexpr s_defaultBudgetFraction = 0.8f;
+
+    vk::PhysicalDevice m_physical;
+    bool m_budgetExtension = false;
+    vk::PhysicalDeviceMemoryProperties m_properties;
+    std::array<std::atomic<vk::DeviceSize>, VK_MAX_MEMORY_HEAPS> m_allocated{};
+
+    void QueryHeapBudgets(std::array<HeapBudget, VK_MAX_MEMORY_HEAPS>& heaps) const;
+};
+
+} // vkc namespace
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Surface.hpp>
+#include <Device.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <unordered_map>
+
+namespace vkc
+{
+
+/*
+ * Mip chains for surfaces drawn well below their native size, as in overview and thumbnail
+ * modes. A chain starts at half the texture size, is generated with blits only once a
+ * surface is drawn below the scale threshold and is regenerated when its content changes.
+ * Chains are keyed by texture generation, so a recycled image never reuses the chain of
+ * its previous content, and dropped after not being drawn for a while.
+ */
+class MipChainCache
+{
+public:
+    static uint32_t const s_maxLevelCount = 5;
+
+    MipChainCache(Device& device);
+
+    ~MipChainCache();
+
+    MipChainCache(MipChainCache&) = delete;
+    MipChainCache(MipChainCache&&) = delete;
+    MipChainCache& operator=(MipChainCache&) = delete;
+    MipChainCache& operator=(MipChainCache&&) = delete;
+
+    bool Init();
+
+    void Shutdown();
+
+    vk::ImageView Prepare(vk::CommandBuffer cmd, Surface const& surface, uint64_t frame);
+
+    void Retire(uint64_t completedFrameCount);
+
+    vk::Sampler GetSampler() const;
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+    float scaleThreshold = 0.5f;
+    uint64_t maxIdleFrames = 120;
+
+private:
+    struct Chain
+    {
+        Image image;
+        uint64_t lastUsedFrame = 0;
+    };
+
+    Device& m_device;
+    vk::Sampler m_sampler;
+    std::unordered_map<uint64_t, Chain> m_chains;
+
+    bool Supports(Image const& texture) const;
+
+    void RecordGeneration(vk::CommandBuffer cmd, Image const& texture, Image const& chain);
+};
+
+} // vkc namespace
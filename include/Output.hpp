@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Device.hpp>
+#include <Window.hpp>
+#include <Render.hpp>
+#include <SoftwareRender.hpp>
+#include <Scene.hpp>
+#include <Surface.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vkc
+{
+
+struct OutputConfig
+{
+    std::string title;
+    uint32_t width;
+    uint32_t height;
+};
+
+/*
+ * One display with its own surfaces, scene and damage, presented either through a window
+ * and a Vulkan renderer or headless through the software renderer. Surface rects are in
+ * output space. An output only needs a frame when something on it changed, and it keeps
+ * its damage until a frame was actually rendered, so an output that was skipped because
+ * its swapchain had no image available catches up on the next frame.
+ * The cursor is kept apart from the surfaces: moving it alone only damages the cursor,
+ * which the renderer repairs without recomposing the scene.
+ */
+class Output
+{
+public:
+    Output(Device& device, OutputConfig const& config);
+
+    explicit Output(OutputConfig const& config);
+
+    Output(Output&) = delete;
+    Output(Output&&) = delete;
+    Output& operator=(Output&) = delete;
+    Output& operator=(Output&&) = delete;
+
+    bool InitWindow();
+
+    bool InitPipelines();
+
+    bool Init();
+
+    bool IsValid() const;
+
+    bool IsHeadless() const;
+
+    void Update();
+
+    bool NeedsFrame() const;
+
+    bool IsSceneDamaged() const;
+
+    bool IsCursorDamaged() const;
+
+    bool Record();
+
+    void ClearDamage();
+
+    // Forces a full frame, e.g. after the renderer's settings changed
+    void Invalidate();
+
+    Window& GetWindow();
+
+    Render& GetRender();
+
+    Render const& GetRender() const;
+
+    SoftwareRender* GetSoftwareRender();
+
+    SoftwareRender const* GetSoftwareRender() const;
+
+    Scene const& GetScene() const;
+
+    std::vector<Surface> surfaces;
+
+    // Drawn above all surfaces while visible and textured, rect is the cursor image
+    Surface cursor;
+    vk::Offset2D cursorHotspot;
+
+private:
+    // Declared before the renderer, which references it and has to be destroyed first
+    std::unique_ptr<Window> m_pWindow;
+    std::unique_ptr<Render> m_pRender;
+    std::unique_ptr<SoftwareRender> m_pSoftwareRender;
+    Scene m_scene;
+    size_t m_renderedSurfaceCount = 0;
+    bool m_rendered = false;
+    vk::Rect2D m_renderedCursorRect;
+    bool m_renderedCursorVisible = false;
+};
+
+} // vkc namespace
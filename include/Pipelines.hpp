@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Surface.hpp>
+#include <Device.hpp>
+#include <Ycbcr.hpp>
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+namespace vkc
+{
+
+/*
+ * Surface pipeline permutation. Everything except the blend state is passed to the
+ * fragment shader as specialization constants, so a variant only pays for the features
+ * it actually uses. Multi-planar variants use a pipeline layout with an immutable Y'CbCr
+ * conversion sampler.
+ */
+struct PipelineKey
+{
+    BlendMode blend = BlendMode::eOpaque;
+    bool translucent = false;
+    bool dim = false;
+    bool roundedCorners = false;
+    bool yuv = false;
+    PlanarFormat planar = PlanarFormat::eNone;
+    // Samples an array of surface textures in the layout of the GPU culled path
+    bool textureArray = false;
+
+    static PipelineKey FromSurface(Surface const& surface);
+
+    uint32_t Bits() const;
+
+    bool BlendEnabled() const;
+
+    bool operator==(PipelineKey const& other) const { return Bits() == other.Bits(); }
+};
+
+struct PipelineKeyHash
+{
+    size_t operator()(PipelineKey const& key) const { return std::hash<uint32_t>()(key.Bits()); }
+};
+
+class SurfacePipelines
+{
+public:
+    SurfacePipelines(Device& device);
+
+    ~SurfacePipelines();
+
+    SurfacePipelines(SurfacePipelines&) = delete;
+    SurfacePipelines(SurfacePipelines&&) = delete;
+    SurfacePipelines& operator=(SurfacePipelines&) = delete;
+    SurfacePipelines& operator=(SurfacePipelines&&) = delete;
+
+    using Layouts = std::array<vk::PipelineLayout, YcbcrSamplers::s_formatCount>;
+
+    bool Init(vk::RenderPass renderPass, Layouts const& layouts, Shader const& vertexShader, Shader const& fragmentShader);
+
+    void Shutdown();
+
+    vk::Pipeline Get(PipelineKey key);
+
+    // Layout and array length for keys with textureArray, nothing is compiled until first use
+    void SetTextureArrayLayout(vk::PipelineLayout layout, uint32_t textureCount);
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+
+private:
+    struct SpecializationData
+    {
+        uint32_t blendMode;
+        vk::Bool32 translucent;
+        vk::Bool32 dim;
+        vk::Bool32 roundedCorners;
+        vk::Bool32 yuv;
+        uint32_t textureCount;
+    };
+
+    Device& m_device;
+    vk::RenderPass m_renderPass;
+    Layouts m_layouts;
+    vk::PipelineLayout m_textureArrayLayout;
+    uint32_t m_textureArrayCount = 1;
+    vk::PipelineShaderStageCreateInfo m_vertexStage;
+    vk::PipelineShaderStageCreateInfo m_fragmentStage;
+    vk::PipelineCache m_cache;
+    std::unordered_map<PipelineKey, vk::Pipeline, PipelineKeyHash> m_pipelines;
+
+    vk::Pipeline Create(PipelineKey key);
+};
+
+} // vkc namespace
\ No newline at end of file
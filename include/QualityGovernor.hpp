@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Timing.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace vkc
+{
+
+// What the renderer may spend on effects, from full quality down to the cheapest
+struct QualitySettings
+{
+    uint32_t blurDownscale = 2;
+    bool blur = true;
+    bool mipFiltering = true;
+};
+
+/*
+ * Decides the quality level for the next frame from the GPU time of the last one. Level 0
+ * is full quality, higher levels are cheaper. Policies keep their own history and must
+ * only depend on the samples they are given, so a recorded trace always replays the same.
+ */
+class QualityPolicy
+{
+public:
+    virtual ~QualityPolicy() = default;
+
+    virtual uint32_t Evaluate(Milliseconds gpuTime, Milliseconds budget, uint32_t level, uint32_t levelCount) = 0;
+
+    virtual void Reset() = 0;
+};
+
+/*
+ * Steps down one level after a few frames over the degrade threshold and back up one level
+ * only after a long run under the lower restore threshold. The gap between the thresholds
+ * and the longer restore run keep a load close to the budget from flipping levels.
+ */
+class HysteresisQualityPolicy : public QualityPolicy
+{
+public:
+    uint32_t Evaluate(Milliseconds gpuTime, Milliseconds budget, uint32_t level, uint32_t levelCount) override;
+
+    void Reset() override;
+
+    // Fractions of the budget
+    double degradeThreshold = 0.9;
+    double restoreThreshold = 0.6;
+    uint32_t degradeFrameCount = 3;
+    uint32_t restoreFrameCount = 60;
+
+private:
+    uint32_t m_overBudgetFrames = 0;
+    uint32_t m_underBudgetFrames = 0;
+};
+
+/*
+ * Degrades rendering quality under GPU load instead of missing vblanks. The levels go from
+ * full quality over effect passes at reduced scale and disabled blur to plain bilinear
+ * filtering without mip chains. Frames without a GPU time, e.g. when timestamps are not
+ * supported, leave the level as it is.
+ */
+class QualityGovernor
+{
+public:
+    explicit QualityGovernor(std::unique_ptr<QualityPolicy> pPolicy = std::make_unique<HysteresisQualityPolicy>());
+
+    QualityGovernor(QualityGovernor&) = delete;
+    QualityGovernor(QualityGovernor&&) = delete;
+    QualityGovernor& operator=(QualityGovernor&) = delete;
+    QualityGovernor& operator=(QualityGovernor&&) = delete;
+
+    // Starts over at full quality, the next OnFrame reports the change
+    void SetPolicy(std::unique_ptr<QualityPolicy> pPolicy);
+
+    void SetBudget(Milliseconds budget);
+
+    Milliseconds GetBudget() const;
+
+    // Returns true when the level changed
+    bool OnFrame(Milliseconds gpuTime);
+
+    uint32_t GetLevel() const;
+
+    uint32_t GetLevelCount() const;
+
+    QualitySettings const& GetSettings() const;
+
+    uint64_t GetOverBudgetFrameCount() const;
+
+    uint64_t GetLevelChangeCount() const;
+
+private:
+    std::unique_ptr<QualityPolicy> m_pPolicy;
+    std::vector<QualitySettings> m_levels;
+    Milliseconds m_budget{ 1000.0 / 60.0 };
+    uint32_t m_level = 0;
+    bool m_levelReset = false;
+    uint64_t m_overBudgetFrameCount = 0;
+    uint64_t m_levelChangeCount = 0;
+};
+
+} // vkc namespace
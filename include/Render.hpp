@@ -6,56 +6,177 @@
 #pragma once
 
 #include <Structs.hpp>
+#include <Surface.hpp>
 #include <Device.hpp>
 #include <Window.hpp>
+#include <Pipelines.hpp>
+#include <TileCompositor.hpp>
+#include <GpuCuller.hpp>
+#include <FrameCapture.hpp>
+#include <MipChains.hpp>
+#include <Blur.hpp>
+#include <FrameAllocator.hpp>
+#include <Scene.hpp>
+#include <RenderBackend.hpp>
+#include <SurfaceStore.hpp>
+#include <Timing.hpp>
+#include <QualityGovernor.hpp>
 #include <vulkan/vulkan.hpp>
 #include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
 
 namespace vkc
 {
 
-class Render
+enum class CompositionPath
+{
+    eRaster,
+    eComputeTiled,
+    eGpuCulled,
+};
+
+/*
+ * Frame runs a whole frame on its own. Outputs that share a device instead go through
+ * the phases one by one: Acquire without blocking, Record, AppendSubmits into one batch
+ * per queue, Present and EndFrame once the batch has completed. A failed Record is undone
+ * with CancelFrame instead, which keeps the acquired image for the next frame.
+ * The cursor is drawn last in a separate overlay pass that loads the swapchain image.
+ * While the scene hasn't been invalidated since the acquired image was last rendered,
+ * only the cursor rectangle of that image is recomposed and the cursor drawn at its new
+ * place, so pointer motion over a static scene costs two scissored quads.
+ */
+class Render : public RenderBackend
 {
 public:
     Render(Device& device, Window& window);
 
-    ~Render();
+    ~Render() override;
+
+    bool InitPipelines();
 
     bool Init();
 
     void Shutdown();
 
-    bool Frame();
+    bool Frame(std::vector<Surface> const& surfaces, Scene const& scene) override;
+
+    bool Acquire(uint64_t timeout);
+
+    bool Record(std::vector<Surface> const& surfaces, Scene const& scene, Surface const* pCursor = nullptr);
+
+    // Discards a failed recording, the acquired image is kept for the next frame
+    void CancelFrame();
+
+    void InvalidateScene();
+
+    void AppendSubmits(std::vector<vk::SubmitInfo>& graphics, std::vector<vk::SubmitInfo>& compute);
+
+    bool Present();
+
+    bool GetLastPresentTime(uint64_t& frame, Clock::time_point& time);
+
+    void EndFrame();
+
+    YcbcrSamplers const& GetYcbcrSamplers() const;
+
+    bool StartCapture(FILE* pOutput);
+
+    void StopCapture();
+
+    FrameCapture const& GetCapture() const;
+
+    // Of the last completed frame's command buffer, zero without timestamp support
+    Milliseconds GetGpuTime() const;
+
+    uint64_t GetSubmittedFrameCount() const override;
+
+    uint64_t GetCompletedFrameCount() const override;
 
     vk::Result status = vk::Result::eErrorInitializationFailed;
+    CompositionPath compositionPath = CompositionPath::eRaster;
+    QualitySettings quality;
+    Milliseconds shaderInitTime{ 0 };
+    Milliseconds pipelineInitTime{ 0 };
 
 private:
     Device& m_device;
     Window& m_window;
     Buffer m_vertexBuffer;
+    Buffer m_instanceBuffer;
+    size_t m_instanceCapacity = 0;
+    SurfaceStore m_surfaceStore;
     Shader m_vertexShader;
     Shader m_fragmentShader;
     vk::RenderPass m_renderPass;
+    vk::RenderPass m_overlayRenderPass;
     vk::Framebuffer m_framebuffers[2];
     uint32_t const m_framebufferCount = 2;
     uint32_t m_currentFrameBuffer = 0;
+    bool m_imageAcquired = false;
+    uint64_t m_sceneVersion = 1;
+    uint64_t m_instanceSceneVersion = 0;
+    uint64_t m_imageSceneVersions[2] = { 0, 0 };
+    vk::Rect2D m_imageCursorRects[2];
+    std::vector<uint32_t> m_overlaySurfaces;
     uint32_t const m_attachmentCount = 1;
     vk::ClearValue m_colorClearValue{ vk::ClearColorValue(std::array<float, 4>{ 0.0f, 1.0f, 0.0f, 1.0f }) };
-    vk::PipelineLayout m_pipelineLayout;
-    vk::PipelineCache m_pipelineCache;
-    vk::Pipeline m_pipeline;
+    uint32_t const m_maxSurfaceCount = 64;
+    vk::Sampler m_sampler;
+    vk::DescriptorSetLayout m_descriptorSetLayout;
+    FrameAllocator m_frameAllocator;
+    uint32_t m_frameUniformOffset = 0;
+    Clock::time_point m_initTime;
+    SurfacePipelines::Layouts m_pipelineLayouts;
+    YcbcrSamplers m_ycbcr;
+    SurfacePipelines m_pipelines;
     vk::CommandPool m_commandPool;
     std::vector<vk::CommandBuffer> m_commandBuffers;
     vk::Semaphore m_renderDoneSemaphore;
     vk::Semaphore m_imageAvailableSemaphore;
     vk::Fence m_presentFence;
+    vk::QueryPool m_timestampQueryPool;
+    Milliseconds m_gpuTime{ 0 };
+    vk::CommandBuffer m_effectCommandBuffer;
+    vk::CommandPool m_computeCommandPool;
+    vk::CommandBuffer m_computeCommandBuffer;
+    vk::Semaphore m_effectTimeline;
+    uint64_t m_effectTimelineValue = 0;
+    EffectCommands m_effects;
+    vk::PipelineStageFlags m_acquireWaitStage;
+    uint64_t m_backdropTimelineValue = 0;
+    uint64_t m_blurTimelineValue = 0;
+    vk::TimelineSemaphoreSubmitInfo m_backdropTimeline;
+    vk::TimelineSemaphoreSubmitInfo m_blurTimeline;
+    vk::TimelineSemaphoreSubmitInfo m_compositeTimeline;
+    vk::Semaphore m_waitSemaphores[2];
+    vk::PipelineStageFlags m_waitStages[2];
+    vk::PipelineStageFlags const m_blurWaitStage = vk::PipelineStageFlagBits::eComputeShader;
+    uint64_t m_waitValues[2] = { 0, 0 };
+    std::unique_ptr<TileCompositor> m_pTileCompositor;
+    std::future<bool> m_tileCompositorInit;
+    bool m_tileCompositorUnavailable = false;
+    std::unique_ptr<GpuCuller> m_pGpuCuller;
+    std::future<bool> m_gpuCullerInit;
+    bool m_gpuCullerUnavailable = false;
+    FrameCapture m_capture;
+    MipChainCache m_mipChains;
+    std::vector<vk::ImageView> m_mipViews;
+    BlurEffect m_blur;
+    std::vector<vk::ImageView> m_blurViews;
+    std::vector<uint32_t> m_backdropInstances;
+    std::vector<uint32_t> m_viewedSurfaces;
+    uint64_t m_frameIndex = 0;
+
+    bool CreateQueryPool();
 
     bool CreateSemaphores();
 
-    bool CreateShaders();
-
     bool CreateVertexBuffer();
 
+    bool ReserveInstances(size_t count);
+
     bool CreateRenderPass();
 
     bool CreateFramebuffers();
@@ -63,6 +184,41 @@ private:
     bool CreatePipeline();
 
     bool CreateCommandBuffers();
+
+    bool CreateDescriptors();
+
+    bool PushFrameUniforms();
+
+    bool TileCompositorReady();
+
+    bool GpuCullerReady();
+
+    // Adds the timestamps of the completed frame to the trace timeline on the host clock
+    void TraceGpuFrame(uint64_t start, uint64_t end);
+
+    Surface const* FindDirectCopySurface(std::vector<Surface> const& surfaces) const;
+
+    void RecordDirectCopy(vk::CommandBuffer cmd, Surface const& surface);
+
+    bool BeginEffectCommands(EffectCommands& effects);
+
+    bool EndEffectCommands();
+
+    void RecordComposite(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces, Scene const& scene, EffectCommands& effects);
+
+    // Backdrops are drawn outside of the main pass, into the effect commands when they are async
+    void RecordSurfaces(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces, Scene const& scene,
+        size_t surfaceCount, bool mainPass);
+
+    bool CanRepairOverlay(std::vector<Surface> const& surfaces, Scene const& scene);
+
+    void RecordOverlay(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces, Scene const& scene,
+        Surface const* pCursor, bool repair);
+
+    void WriteCursorInstance(Surface const& cursor, uint32_t instance);
+
+    bool RecordQuad(vk::CommandBuffer cmd, PipelineKey const& key, vk::Sampler sampler, vk::ImageView view,
+        uint32_t instance, vk::Pipeline& boundPipeline);
 };
 
 } // vkc namespace
\ No newline at end of file
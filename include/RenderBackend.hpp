@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Surface.hpp>
+#include <Scene.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Per frame interface of a renderer. The Vulkan renderer is the primary backend,
+ * the software renderer takes over when no usable device is found.
+ */
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() = default;
+
+    virtual bool Frame(std::vector<Surface> const& surfaces, Scene const& scene) = 0;
+
+    virtual uint64_t GetSubmittedFrameCount() const = 0;
+
+    virtual uint64_t GetCompletedFrameCount() const = 0;
+};
+
+} // vkc namespace
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Surface.hpp>
+#include <Device.hpp>
+#include <Timing.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Keeps surface textures within the device memory budget. Runs between frames, when the
+ * previous frame has retired. Over budget, textures of hidden surfaces are evicted starting
+ * with the one hidden the longest: RGBA8 class textures are read back into host memory, the
+ * rest are dropped and flagged as lost. Evicted textures are uploaded again once shown.
+ */
+class ResidencyManager
+{
+public:
+    ResidencyManager(Device& device);
+
+    ~ResidencyManager();
+
+    ResidencyManager(ResidencyManager&) = delete;
+    ResidencyManager(ResidencyManager&&) = delete;
+    ResidencyManager& operator=(ResidencyManager&) = delete;
+    ResidencyManager& operator=(ResidencyManager&&) = delete;
+
+    bool Init();
+
+    void Shutdown();
+
+    void Update(std::vector<Surface>& surfaces);
+
+    // Surfaces of every output share one budget
+    void Update(std::vector<std::vector<Surface>*> const& surfaceLists);
+
+    vk::DeviceSize GetClientUsage(uint32_t client) const;
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+    float budgetFraction = 0.9f;
+
+private:
+    Device& m_device;
+    vk::CommandPool m_commandPool;
+    vk::CommandBuffer m_commandBuffer;
+    vk::Fence m_fence;
+    std::unordered_map<uint32_t, vk::DeviceSize> m_clientUsage;
+
+    bool CanKeepHostCopy(Image const& texture) const;
+
+    bool Evict(Surface& surface);
+
+    bool Restore(Surface& surface);
+
+    bool Submit(std::function<void(vk::CommandBuffer)> const& record);
+};
+
+} // vkc namespace
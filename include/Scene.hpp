@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Surface.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Spatial index over the visible surfaces of one output. The output is split into a
+ * uniform grid of square cells, each cell lists the surfaces overlapping it in
+ * back to front order, so a query only looks at the few surfaces sharing its cells.
+ * Update re-inserts just the surfaces that moved, resized or changed visibility, and
+ * marks surfaces culled when they are off the output or fully behind an opaque surface
+ * with content. Occlusion only holds for the final composite, passes that draw a subset
+ * of the surfaces, such as blur backdrops, only skip surfaces off the output.
+ * Every update also logs the surfaces that moved, changed visibility or culling, or carry
+ * damage, so state cached per surface elsewhere only has to revisit those.
+ * Queries share scratch state and are not safe to run concurrently.
+ */
+class Scene
+{
+public:
+    static uint32_t const s_cellSize = 128;
+    static uint32_t const s_none = std::numeric_limits<uint32_t>::max();
+
+    void Resize(vk::Extent2D extent);
+
+    void Update(std::vector<Surface> const& surfaces);
+
+    uint32_t HitTest(int32_t x, int32_t y) const;
+
+    void Query(vk::Rect2D const& rect, std::vector<uint32_t>& indices) const;
+
+    void QueryDamage(std::vector<vk::Rect2D> const& damage, std::vector<uint32_t>& indices) const;
+
+    bool IsCulled(size_t index) const;
+
+    // Hidden or off the output, regardless of the surfaces above it
+    bool IsOffOutput(size_t index) const;
+
+    size_t GetCulledCount() const;
+
+    // Bumped by every update that logged a change
+    uint64_t GetVersion() const;
+
+    // Surfaces changed after the given version, possibly listed more than once. False when
+    // surfaces were added or removed since, or the log was dropped, then all of them changed.
+    bool GetChanges(uint64_t version, std::vector<uint32_t>& indices) const;
+
+private:
+    struct CellRange
+    {
+        uint32_t x0 = 0;
+        uint32_t y0 = 0;
+        uint32_t x1 = 0;
+        uint32_t y1 = 0;
+    };
+
+    struct Entry
+    {
+        vk::Rect2D rect;
+        CellRange cells;
+        bool inserted = false;
+        bool visible = false;
+        bool opaque = false;
+        bool culled = true;
+    };
+
+    // The log holds twice the surface count, but at least this many changes
+    static size_t const s_minChangeLogSize = 256;
+
+    struct Change
+    {
+        uint64_t version;
+        uint32_t index;
+    };
+
+    vk::Extent2D m_extent;
+    uint32_t m_columns = 0;
+    uint32_t m_rows = 0;
+    std::vector<std::vector<uint32_t>> m_cells;
+    std::vector<Entry> m_entries;
+    size_t m_culledCount = 0;
+    uint64_t m_version = 0;
+    uint64_t m_rebuildVersion = 0;
+    std::vector<Change> m_changes;
+    mutable std::vector<uint32_t> m_queryMarks;
+    mutable uint32_t m_queryStamp = 0;
+
+    bool GetCellRange(vk::Rect2D const& rect, CellRange& range) const;
+
+    void Insert(uint32_t index);
+
+    void Remove(uint32_t index);
+
+    void Rebuild(std::vector<Surface> const& surfaces);
+
+    void UpdateCulling();
+
+    void LogChange(uint32_t index);
+
+    void CollectCells(CellRange const& range, vk::Rect2D const& rect, std::vector<uint32_t>& indices) const;
+
+    uint32_t NextQueryStamp() const;
+};
+
+} // vkc namespace
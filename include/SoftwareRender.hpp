@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <RenderBackend.hpp>
+#include <Surface.hpp>
+#include <Scene.hpp>
+#include <vulkan/vulkan.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * CPU compositor into a headless BGRA8 output in host memory. Surfaces are blended
+ * back to front from their host pixels with premultiplied alpha, opacity and dim. Scaled
+ * surfaces are filtered bilinearly with 8 bit weights like the sampler of the raster path,
+ * which they match up to rounding; minified surfaces are not mip filtered, so they differ
+ * from the raster path while mip filtering is enabled. Only damaged rectangles are
+ * recomposed, split into horizontal bands that are rendered in parallel by persistent
+ * worker threads. Every channel is computed with the same exactly rounded integer math in
+ * the SIMD and scalar kernels, so the output is deterministic and serves as a reference
+ * for the Vulkan renderer.
+ * Rounded corners, Y'CbCr conversion and blur are not supported.
+ */
+class SoftwareRender : public RenderBackend
+{
+public:
+    // Same as the clear color of the raster path
+    static uint32_t const s_clearColor = 0xFF00FF00;
+
+    SoftwareRender(vk::Extent2D extent, uint32_t threadCount = std::thread::hardware_concurrency());
+
+    ~SoftwareRender() override;
+
+    SoftwareRender(SoftwareRender&) = delete;
+    SoftwareRender(SoftwareRender&&) = delete;
+    SoftwareRender& operator=(SoftwareRender&) = delete;
+    SoftwareRender& operator=(SoftwareRender&&) = delete;
+
+    bool Frame(std::vector<Surface> const& surfaces, Scene const& scene) override;
+
+    uint64_t GetSubmittedFrameCount() const override;
+
+    uint64_t GetCompletedFrameCount() const override;
+
+    vk::Extent2D GetExtent() const;
+
+    std::vector<uint32_t> const& GetPixels() const;
+
+    uint64_t GetDamagedPixelCount() const;
+
+    static char const* GetKernelName();
+
+private:
+    vk::Extent2D const m_extent;
+    std::vector<uint32_t> m_pixels;
+    std::vector<vk::Rect2D> m_damage;
+    std::vector<std::vector<uint32_t>> m_damageSurfaces;
+    std::vector<std::vector<uint32_t>> m_rowBuffers;
+    std::vector<Surface> const* m_pSurfaces = nullptr;
+    Scene const* m_pScene = nullptr;
+    size_t m_surfaceCount = 0;
+    uint64_t m_frameIndex = 0;
+    uint64_t m_damagedPixelCount = 0;
+
+    uint32_t const m_bandCount;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_startCondition;
+    std::condition_variable m_doneCondition;
+    uint64_t m_generation = 0;
+    uint32_t m_pendingBands = 0;
+    bool m_stopWorkers = false;
+
+    void CollectDamage(std::vector<Surface> const& surfaces);
+
+    void WorkerLoop(uint32_t band);
+
+    void RenderBand(uint32_t band);
+
+    void ComposeRect(vk::Rect2D const& rect, std::vector<uint32_t> const& surfaceIndices, std::vector<uint32_t>& rowBuffer);
+};
+
+} // vkc namespace
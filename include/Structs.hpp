@@ -19,34 +19,80 @@ struct Vertex
 };
 
 constexpr float s_vertices[4 * 6] = {
-    -0.5, -0.5,  0.5,  1,
-    -0.5,  0.5,  0.5,  1,
-     0.5,  0.5,  0.5,  1,
-     0.5, -0.5,  0.5,  1,
-    -0.5, -0.5,  0.5,  1,
-     0.5,  0.5,  0.5,  1,
+    0, 0, 0.5, 1,
+    0, 1, 0.5, 1,
+    1, 1, 0.5, 1,
+    1, 0, 0.5, 1,
+    0, 0, 0.5, 1,
+    1, 1, 0.5, 1,
+};
+
+// Per instance vertex data of a surface quad, three vec4 attributes read by the vertex shader
+struct SurfaceConstants
+{
+    float rect[4];
+    float opacity;
+    float dim;
+    float cornerRadius;
+    // Element of the texture array the GPU culled path samples, raster pipelines ignore it
+    float textureIndex;
+    float size[2];
+    float uvScale[2];
+    static vk::VertexInputBindingDescription const s_inputBindingDescription;
+    static vk::VertexInputAttributeDescription const s_inputAttributeDescriptions[3];
 };
 
 class Image
 {
 public:
+    bool Init(Device& device, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage,
+        vk::SamplerYcbcrConversion conversion = vk::SamplerYcbcrConversion(), uint32_t mipLevels = 1);
+
+    void Destroy(Device& device);
+
     vk::Image image;
     vk::DeviceMemory memory;
     vk::ImageView view;
+    vk::Format format = vk::Format::eUndefined;
+    vk::Extent2D extent;
+    vk::Extent2D contentExtent;
+    vk::ImageUsageFlags usage;
+    uint32_t mipLevels = 1;
+    vk::DeviceSize memorySize = 0;
+    uint32_t memoryTypeIndex = 0;
+    // Unique per created or recycled image, unlike the handle, which drivers and pools reuse
+    uint64_t generation = 0;
+
+    static uint64_t NextGeneration();
+
+private:
+    bool CreateImage(Device& device, vk::ImageUsageFlags usage);
+
+    bool AllocateDeviceMemory(Device& device);
+
+    bool CreateImageView(Device& device, vk::SamplerYcbcrConversion conversion);
 };
 
 class Buffer
 {
 public:
-    bool Stage(Device& device, void const* data, size_t size, vk::BufferUsageFlagBits usage);
+    bool Stage(Device& device, void const* data, size_t size, vk::BufferUsageFlags usage);
+
+    // Host visible, coherent and persistently mapped, preferred properties are added when available
+    bool Allocate(Device& device, size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags preferred = {});
+
+    void Destroy(Device& device);
 
     vk::Buffer buffer;
     vk::DeviceMemory memory;
+    void* mapped = nullptr;
+    vk::DeviceSize memorySize = 0;
+    uint32_t memoryTypeIndex = 0;
 
 private:
-    bool CreateBuffer(Device& device, size_t size, vk::BufferUsageFlagBits usage);
+    bool CreateBuffer(Device& device, size_t size, vk::BufferUsageFlags usage);
 
-    bool AllocateDeviceMemory(Device& device, size_t size, vk::MemoryPropertyFlags flags);
+    bool AllocateDeviceMemory(Device& device, vk::MemoryPropertyFlags flags, vk::MemoryPropertyFlags preferred = {});
 
     bool CopyMemory(Device& device, void const* data, size_t size);
 };
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Timing.hpp>
+#include <vulkan/vulkan.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace vkc
+{
+
+enum class BlendMode : uint32_t
+{
+    eOpaque,
+    ePremultiplied,
+    eStraight,
+};
+
+/*
+ * Residency of a surface texture under memory pressure. An evicted texture either keeps
+ * its pixels in host memory and is uploaded again when shown, or has lost its content
+ * and has to be attached again by the client, which also resets this state.
+ */
+struct SurfaceResidency
+{
+    Clock::time_point lastVisible = Clock::now();
+    std::vector<uint8_t> hostCopy;
+    bool evicted = false;
+    bool contentLost = false;
+};
+
+/*
+ * Client surface as seen by the compositor. Surfaces are composited back to front,
+ * the texture is expected to be in eShaderReadOnlyOptimal layout between frames.
+ * Damage holds output space rectangles changed since the previous frame, including
+ * the old position of a moved or hidden surface, contentDamaged is set by the client
+ * whenever the texture itself was updated. Yuv marks packed single plane textures
+ * holding BT.709 narrow range Y'CbCr samples in the G (Y'), B (Cb) and R (Cr) channels;
+ * multi-planar video textures are recognized by their format and converted by the sampler.
+ * BlurBehind panels are drawn over a blurred copy of the content below them.
+ * HostPixels holds the content for the software renderer as BGRA8 rows of the
+ * texture's contentExtent, it is ignored while compositing on a Vulkan device.
+ */
+struct Surface
+{
+    Image texture;
+    vk::Rect2D rect;
+    std::vector<vk::Rect2D> damage;
+    bool contentDamaged = false;
+    BlendMode blend = BlendMode::eOpaque;
+    float opacity = 1.0f;
+    float dim = 1.0f;
+    float cornerRadius = 0.0f;
+    bool yuv = false;
+    bool visible = true;
+    bool blurBehind = false;
+    uint32_t client = 0;
+    SurfaceResidency residency;
+    std::vector<uint32_t> hostPixels;
+
+    // Something to draw, a texture on a Vulkan device or host pixels for the software renderer
+    bool HasContent() const
+    {
+        return texture.view || !hostPixels.empty();
+    }
+
+    bool IsOpaque() const
+    {
+        return blend == BlendMode::eOpaque && opacity >= 1.0f && cornerRadius <= 0.0f;
+    }
+
+    // Drawn size over content size along the axis shrunk the least, below 1 when minified
+    float GetScale() const
+    {
+        return std::max(static_cast<float>(rect.extent.width) / texture.contentExtent.width,
+            static_cast<float>(rect.extent.height) / texture.contentExtent.height);
+    }
+};
+
+} // vkc namespace
\ No newline at end of file
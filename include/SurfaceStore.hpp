@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Surface.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Structure of arrays copy of the per frame surface parameters. Update gathers the
+ * surfaces into one array per field, then transforms rects to normalized device
+ * coordinates and clips them against the output in SIMD batches. Pack interleaves the
+ * result into SurfaceConstants instance records; it is meant to write straight into
+ * mapped instance buffer memory, so the destination is only ever written, never read.
+ * Arrays are padded to the batch width with empty rects that are never drawable.
+ */
+class SurfaceStore
+{
+public:
+#if defined(VKC_AVX2)
+    static size_t const s_batchSize = 8;
+#else
+    static size_t const s_batchSize = 4;
+#endif
+
+    void Update(std::vector<Surface> const& surfaces, vk::Extent2D output);
+
+    void Pack(SurfaceConstants* pInstances) const;
+
+    size_t GetCount() const;
+
+    bool IsDrawable(size_t index) const;
+
+    static char const* GetKernelName();
+
+private:
+    size_t m_count = 0;
+
+    // Gathered from the surfaces, output space pixels
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_width;
+    std::vector<float> m_height;
+    std::vector<float> m_opacity;
+    std::vector<float> m_dim;
+    std::vector<float> m_cornerRadius;
+    std::vector<float> m_contentWidth;
+    std::vector<float> m_contentHeight;
+    std::vector<float> m_textureWidth;
+    std::vector<float> m_textureHeight;
+
+    // Computed by the kernels
+    std::vector<float> m_ndcX;
+    std::vector<float> m_ndcY;
+    std::vector<float> m_ndcWidth;
+    std::vector<float> m_ndcHeight;
+    std::vector<float> m_uvScaleX;
+    std::vector<float> m_uvScaleY;
+    std::vector<uint8_t> m_drawable;
+
+    void Resize(size_t count);
+};
+
+} // vkc namespace
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Surface.hpp>
+#include <TileDamage.hpp>
+#include <Device.hpp>
+#include <Window.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Compute shader composition path. The output is split into tiles, surfaces are binned
+ * per damaged tile on the CPU and every workgroup blends only the surfaces touching its
+ * tile into a persistent storage image, which is then copied into the swapchain image.
+ * Surfaces sharing a texture share its element of the texture array, whose length is
+ * s_maxTextureCount lowered to the device limits.
+ */
+class TileCompositor
+{
+public:
+    static uint32_t const s_tileSize = 16;
+    static uint32_t const s_maxTextureCount = 4096;
+
+    TileCompositor(Device& device, Window& window);
+
+    ~TileCompositor();
+
+    TileCompositor(TileCompositor&) = delete;
+    TileCompositor(TileCompositor&&) = delete;
+    TileCompositor& operator=(TileCompositor&) = delete;
+    TileCompositor& operator=(TileCompositor&&) = delete;
+
+    bool Init();
+
+    void Shutdown();
+
+    bool Supports(std::vector<Surface> const& surfaces) const;
+
+    void Invalidate();
+
+    void Record(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces,
+        vk::Image target, vk::ClearColorValue const& clearColor);
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+
+private:
+    struct SurfaceData
+    {
+        int32_t rect[4];
+        float uvScale[2];
+        float opacity;
+        uint32_t textureIndex;
+        uint32_t blend;
+        uint32_t padding[3];
+    };
+
+    struct TileData
+    {
+        uint32_t tileIndex;
+        uint32_t first;
+        uint32_t count;
+        uint32_t padding;
+    };
+
+    struct Constants
+    {
+        float clearColor[4];
+        uint32_t tilesX;
+        uint32_t swizzle;
+    };
+
+    Device& m_device;
+    Window& m_window;
+    uint32_t const m_tilesX;
+    uint32_t const m_tilesY;
+    Image m_outputImage;
+    Buffer m_surfaceBuffer;
+    Buffer m_tileBuffer;
+    Buffer m_entryBuffer;
+    Shader m_shader;
+    vk::Sampler m_sampler;
+    vk::DescriptorSetLayout m_descriptorSetLayout;
+    vk::DescriptorPool m_descriptorPool;
+    vk::DescriptorSet m_descriptorSet;
+    vk::PipelineLayout m_pipelineLayout;
+    vk::Pipeline m_pipeline;
+    uint32_t m_textureCount = 0;
+    uint32_t m_surfaceCapacity = 0;
+    uint32_t m_entryCapacity = 0;
+    TileDamage m_damage;
+    std::vector<uint32_t> m_visibleSurfaces;
+    std::vector<SurfaceData> m_surfaceData;
+    std::vector<uint32_t> m_entries;
+    std::vector<vk::DescriptorImageInfo> m_imageInfos;
+    mutable std::vector<vk::ImageView> m_textures;
+
+    bool CreateOutputImage();
+
+    bool CreateBuffers();
+
+    // Grows the surface and entry buffers, which the previous frame no longer reads
+    bool ReserveBuffers(size_t surfaceCount, size_t entryCount);
+
+    bool CreateDescriptors();
+
+    bool CreatePipeline();
+
+    // Sorted distinct views of the visible surfaces, their positions are the array elements
+    size_t CollectTextures(std::vector<Surface> const& surfaces) const;
+
+    uint32_t BinSurfaces(std::vector<Surface> const& surfaces);
+
+    void UpdateDescriptors();
+};
+
+} // vkc namespace
\ No newline at end of file
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Surface.hpp>
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace vkc
+{
+
+/*
+ * Tiles of a persistent output image that have to be composed again. A tile is damaged
+ * when a damage rectangle or the rectangle of a surface with new content touches it,
+ * everything is while there is no history or after surfaces were added or removed.
+ */
+class TileDamage
+{
+public:
+    void Resize(vk::Extent2D extent, uint32_t tileSize);
+
+    // Drops the history, the next update damages every tile
+    void Invalidate();
+
+    // Returns the number of damaged tiles, the history is valid afterwards
+    uint32_t Update(std::vector<Surface> const& surfaces);
+
+    bool IsDamaged(uint32_t tile) const;
+
+    uint32_t GetTileCount() const;
+
+private:
+    vk::Extent2D m_extent;
+    uint32_t m_tileSize = 1;
+    uint32_t m_tilesX = 0;
+    uint32_t m_tilesY = 0;
+    std::vector<bool> m_damagedTiles;
+    size_t m_surfaceCount = 0;
+    bool m_historyValid = false;
+
+    uint32_t MarkRect(vk::Rect2D const& rect);
+};
+
+} // vkc namespace
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <chrono>
+
+namespace vkc
+{
+
+using Clock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(Milliseconds& result)
+        : m_result(result)
+        , m_start(Clock::now())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        m_result = Clock::now() - m_start;
+    }
+
+    ScopedTimer(ScopedTimer&) = delete;
+    ScopedTimer(ScopedTimer&&) = delete;
+    ScopedTimer& operator=(ScopedTimer&) = delete;
+    ScopedTimer& operator=(ScopedTimer&&) = delete;
+
+private:
+    Milliseconds& m_result;
+    Clock::time_point const m_start;
+};
+
+} // vkc namespace
\ No newline at end of file
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Timing.hpp>
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+namespace vkc
+{
+
+struct TraceEvent
+{
+    char const* pName;
+    Clock::time_point start;
+    Clock::duration duration;
+};
+
+/*
+ * Timeline of scoped CPU events and GPU spans, exported in the Chrome trace JSON format
+ * that chrome://tracing and Perfetto load. Every thread writes into its own ring that is
+ * registered on first use, events are stored lock-free and the oldest ones overwritten
+ * once a ring is full. GPU spans are converted to the host clock by the renderer and go
+ * into a ring of their own. Nothing is recorded while the tracer is stopped.
+ * The VKC_TRACE macros below only expand to anything in builds with VKC_TRACING.
+ */
+class Tracer
+{
+public:
+    static size_t const s_ringCapacity = 1 << 16;
+
+    static void Start();
+
+    static void Stop();
+
+    static bool IsEnabled();
+
+    static void AddEvent(char const* pName, Clock::time_point start, Clock::time_point end);
+
+    static void AddGpuSpan(char const* pName, Clock::time_point start, Clock::time_point end);
+
+    static void SetThreadName(char const* pName);
+
+    // Call while no other thread is recording, e.g. after Stop
+    static bool Export(FILE* pOutput);
+
+    // Host time of a timestamp taken in the host time domain of VK_EXT_calibrated_timestamps
+    static Clock::time_point FromCalibratedTimestamp(uint64_t timestamp);
+
+    static vk::TimeDomainEXT GetHostTimeDomain();
+};
+
+class ScopedTraceEvent
+{
+public:
+    explicit ScopedTraceEvent(char const* pName)
+        : m_pName(pName)
+        , m_start(Tracer::IsEnabled() ? Clock::now() : Clock::time_point())
+    {
+    }
+
+    ~ScopedTraceEvent()
+    {
+        if (m_start != Clock::time_point())
+            Tracer::AddEvent(m_pName, m_start, Clock::now());
+    }
+
+    ScopedTraceEvent(ScopedTraceEvent&) = delete;
+    ScopedTraceEvent(ScopedTraceEvent&&) = delete;
+    ScopedTraceEvent& operator=(ScopedTraceEvent&) = delete;
+    ScopedTraceEvent& operator=(ScopedTraceEvent&&) = delete;
+
+private:
+    char const* const m_pName;
+    Clock::time_point const m_start;
+};
+
+// Debug utils label around the commands recorded in its scope, seen in RenderDoc and the like
+class ScopedCommandLabel
+{
+public:
+    ScopedCommandLabel(vk::CommandBuffer cmd, char const* pName, bool enabled, vk::DispatchLoaderDynamic const& dispatch)
+        : m_cmd(enabled ? cmd : vk::CommandBuffer())
+        , m_dispatch(dispatch)
+    {
+        if (m_cmd)
+            m_cmd.beginDebugUtilsLabelEXT(vk::DebugUtilsLabelEXT(pName), m_dispatch);
+    }
+
+    ~ScopedCommandLabel()
+    {
+        if (m_cmd)
+            m_cmd.endDebugUtilsLabelEXT(m_dispatch);
+    }
+
+    ScopedCommandLabel(ScopedCommandLabel&) = delete;
+    ScopedCommandLabel(ScopedCommandLabel&&) = delete;
+    ScopedCommandLabel& operator=(ScopedCommandLabel&) = delete;
+    ScopedCommandLabel& operator=(ScopedCommandLabel&&) = delete;
+
+private:
+    vk::CommandBuffer const m_cmd;
+    vk::DispatchLoaderDynamic const& m_dispatch;
+};
+
+} // vkc namespace
+
+#define VKC_TRACE_CONCAT_INNER(a, b) a##b
+#define VKC_TRACE_CONCAT(a, b) VKC_TRACE_CONCAT_INNER(a, b)
+
+#ifdef VKC_TRACING
+#define VKC_TRACE_SCOPE(name) ::vkc::ScopedTraceEvent VKC_TRACE_CONCAT(traceEvent, __LINE__)(name)
+#define VKC_TRACE_THREAD_NAME(name) ::vkc::Tracer::SetThreadName(name)
+#define VKC_TRACE_COMMAND_LABEL(device, cmd, name) \
+    ::vkc::ScopedCommandLabel VKC_TRACE_CONCAT(commandLabel, __LINE__)(cmd, name, (device).debugUtils, (device).dispatch)
+#else
+#define VKC_TRACE_SCOPE(name) ((void)0)
+#define VKC_TRACE_THREAD_NAME(name) ((void)0)
+#define VKC_TRACE_COMMAND_LABEL(device, cmd, name) ((void)0)
+#endif
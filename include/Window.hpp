@@ -7,8 +7,11 @@
 
 #include <Structs.hpp>
 #include <Device.hpp>
+#include <Input.hpp>
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
+#include <chrono>
+#include <functional>
 
 namespace vkc
 {
@@ -52,9 +55,16 @@ public:
     vk::SurfaceFormatKHR const surfaceFormat{ vk::Format::eB8G8R8A8Unorm, vk::ColorSpaceKHR::eSrgbNonlinear };
     vk::SurfaceKHR surface;
     vk::SwapchainKHR swapchain;
+    vk::ImageUsageFlags swapchainUsage = vk::ImageUsageFlagBits::eColorAttachment;
     std::array<Image, 2> swapchainImages;
     uint32_t const swapchainImageCount = 2;
 
+    // Zero while unknown
+    std::chrono::nanoseconds refreshPeriod{ 0 };
+
+    // Called from glfwPollEvents with every event timestamped on arrival
+    std::function<void(InputEvent const&)> onInput;
+
 private:
     GLFWwindow* m_pWindow = nullptr;
 
@@ -63,6 +73,20 @@ private:
     bool CreateSwapchain();
 
     bool CreateSwapchainImageViews();
+
+    void QueryRefreshPeriod();
+
+    void InstallInputCallbacks();
+
+    void EmitInput(InputEvent& event);
+
+    static void OnKey(GLFWwindow* pWindow, int key, int scancode, int action, int mods);
+
+    static void OnButton(GLFWwindow* pWindow, int button, int action, int mods);
+
+    static void OnMotion(GLFWwindow* pWindow, double x, double y);
+
+    static void OnScroll(GLFWwindow* pWindow, double x, double y);
 };
 
 } // vkc namespace
\ No newline at end of file
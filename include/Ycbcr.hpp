@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <Structs.hpp>
+#include <Device.hpp>
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstdint>
+
+namespace vkc
+{
+
+enum class PlanarFormat : uint32_t
+{
+    eNone,
+    eNv12,
+    eI420,
+    eCount,
+};
+
+inline PlanarFormat GetPlanarFormat(vk::Format format)
+{
+    switch (format)
+    {
+    case vk::Format::eG8B8R82Plane420Unorm:
+        return PlanarFormat::eNv12;
+    case vk::Format::eG8B8R83Plane420Unorm:
+        return PlanarFormat::eI420;
+    default:
+        return PlanarFormat::eNone;
+    }
+}
+
+inline vk::Format GetVkFormat(PlanarFormat format)
+{
+    switch (format)
+    {
+    case PlanarFormat::eNv12:
+        return vk::Format::eG8B8R82Plane420Unorm;
+    case PlanarFormat::eI420:
+        return vk::Format::eG8B8R83Plane420Unorm;
+    default:
+        return vk::Format::eUndefined;
+    }
+}
+
+/*
+ * Immutable samplers converting multi-planar BT.709 narrow range video frames to RGB
+ * while sampling, so client planes are uploaded as they are without a CPU conversion.
+ */
+class YcbcrSamplers
+{
+public:
+    static uint32_t const s_formatCount = static_cast<uint32_t>(PlanarFormat::eCount);
+
+    YcbcrSamplers(Device& device);
+
+    ~YcbcrSamplers();
+
+    YcbcrSamplers(YcbcrSamplers&) = delete;
+    YcbcrSamplers(YcbcrSamplers&&) = delete;
+    YcbcrSamplers& operator=(YcbcrSamplers&) = delete;
+    YcbcrSamplers& operator=(YcbcrSamplers&&) = delete;
+
+    bool Init();
+
+    void Shutdown();
+
+    bool Supports(PlanarFormat format) const;
+
+    vk::DescriptorSetLayout GetDescriptorSetLayout(PlanarFormat format) const;
+
+    vk::SamplerYcbcrConversion GetConversion(PlanarFormat format) const;
+
+    bool InitImage(Image& image, PlanarFormat format, vk::Extent2D extent) const;
+
+    void RecordUpload(vk::CommandBuffer cmd, Image const& image, vk::Buffer planes, vk::DeviceSize offset) const;
+
+    vk::Result status = vk::Result::eErrorInitializationFailed;
+
+private:
+    struct Conversion
+    {
+        vk::SamplerYcbcrConversion conversion;
+        vk::Sampler sampler;
+        vk::DescriptorSetLayout descriptorSetLayout;
+    };
+
+    Device& m_device;
+    std::array<Conversion, s_formatCount> m_conversions;
+
+    bool CreateConversion(PlanarFormat format);
+};
+
+} // vkc namespace
\ No newline at end of file
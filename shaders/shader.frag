@@ -1,8 +1,96 @@
 #version 450
 
+const uint BLEND_OPAQUE = 0;
+const uint BLEND_PREMULTIPLIED = 1;
+const uint BLEND_STRAIGHT = 2;
+
+layout(constant_id = 0) const uint BLEND_MODE = BLEND_OPAQUE;
+layout(constant_id = 1) const bool TRANSLUCENT = false;
+layout(constant_id = 2) const bool DIM = false;
+layout(constant_id = 3) const bool ROUNDED_CORNERS = false;
+layout(constant_id = 4) const bool YUV = false;
+layout(constant_id = 5) const uint TEXTURE_COUNT = 1;
+
+layout(set = 1, binding = 0) uniform sampler2D surfaceTextures[TEXTURE_COUNT];
+
+struct SurfaceParameters
+{
+    float opacity;
+    float dim;
+    float cornerRadius;
+    vec2 size;
+    vec2 uvScale;
+};
+
+layout(location = 0) in vec2 inTexCoord;
+layout(location = 1) flat in vec4 inParameters;
+layout(location = 2) flat in vec4 inSizeUvScale;
+layout(location = 3) flat in uint inTextureIndex;
 layout(location = 0) out vec4 outColor;
 
+SurfaceParameters surface;
+
+vec3 YuvToRgb(vec3 crYCb)
+{
+    float y = (crYCb.g - 16.0 / 255.0) * (255.0 / 219.0);
+    vec2 cbCr = (crYCb.br - 128.0 / 255.0) * (255.0 / 224.0);
+    return vec3(
+        y + 1.5748 * cbCr.y,
+        y - 0.1873 * cbCr.x - 0.4681 * cbCr.y,
+        y + 1.8556 * cbCr.x);
+}
+
+float CornerCoverage()
+{
+    vec2 position = inTexCoord * surface.size;
+    vec2 delta = surface.cornerRadius - min(position, surface.size - position);
+    if (delta.x <= 0.0 || delta.y <= 0.0)
+    {
+        return 1.0;
+    }
+
+    return clamp(surface.cornerRadius - length(delta) + 0.5, 0.0, 1.0);
+}
+
 void main()
 {
-    outColor = vec4(1, 0, 0, 1);
+    surface = SurfaceParameters(inParameters.x, inParameters.y, inParameters.z, inSizeUvScale.xy, inSizeUvScale.zw);
+
+    // Indirect draws of the GPU culled path select their texture out of the whole array
+    uint textureIndex = TEXTURE_COUNT == 1 ? 0 : inTextureIndex;
+    // Pooled images can be larger than their content, the last content texel center is the
+    // limit so that linear filtering never blends in the padding at the right and bottom
+    vec2 contentLimit = surface.uvScale - 0.5 / vec2(textureSize(surfaceTextures[textureIndex], 0));
+    vec4 color = texture(surfaceTextures[textureIndex], min(inTexCoord * surface.uvScale, contentLimit));
+
+    if (YUV)
+    {
+        color.rgb = YuvToRgb(color.rgb);
+    }
+
+    if (BLEND_MODE == BLEND_OPAQUE)
+    {
+        color.a = 1.0;
+    }
+    else if (BLEND_MODE == BLEND_STRAIGHT)
+    {
+        color.rgb *= color.a;
+    }
+
+    if (DIM)
+    {
+        color.rgb *= surface.dim;
+    }
+
+    if (ROUNDED_CORNERS)
+    {
+        color *= CornerCoverage();
+    }
+
+    if (TRANSLUCENT)
+    {
+        color *= surface.opacity;
+    }
+
+    outColor = color;
 }
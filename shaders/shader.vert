@@ -1,8 +1,28 @@
 #version 450
 
 layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inRect;
+layout(location = 2) in vec4 inParameters;
+layout(location = 3) in vec4 inSizeUvScale;
+
+layout(set = 0, binding = 0) uniform FrameUniforms
+{
+    mat4 transform;
+    vec2 outputSize;
+    float time;
+    float frame;
+} frameUniforms;
+
+layout(location = 0) out vec2 outTexCoord;
+layout(location = 1) flat out vec4 outParameters;
+layout(location = 2) flat out vec4 outSizeUvScale;
+layout(location = 3) flat out uint outTextureIndex;
 
 void main()
 {
-    gl_Position = inPosition;
+    outTexCoord = inPosition.xy;
+    outParameters = inParameters;
+    outSizeUvScale = inSizeUvScale;
+    outTextureIndex = uint(inParameters.w);
+    gl_Position = frameUniforms.transform * vec4(inRect.xy + inPosition.xy * inRect.zw, 0, 1);
 }
@@ -0,0 +1,501 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Blur.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace vkc
+{
+
+namespace
+{
+
+bool Intersects(vk::Rect2D const& a, vk::Rect2D const& b)
+{
+    return a.offset.x < b.offset.x + static_cast<int32_t>(b.extent.width)
+        && b.offset.x < a.offset.x + static_cast<int32_t>(a.extent.width)
+        && a.offset.y < b.offset.y + static_cast<int32_t>(b.extent.height)
+        && b.offset.y < a.offset.y + static_cast<int32_t>(a.extent.height);
+}
+
+vk::Extent2D Downscale(vk::Extent2D extent, uint32_t factor)
+{
+    return vk::Extent2D(std::max(extent.width / factor, 1u), std::max(extent.height / factor, 1u));
+}
+
+} // anonymous namespace
+
+BlurEffect::BlurEffect(Device & device, Window & window)
+    : m_device(device)
+    , m_window(window)
+{
+}
+
+BlurEffect::~BlurEffect()
+{
+    Shutdown();
+}
+
+bool BlurEffect::Init()
+{
+    return CreateRenderPass()
+        && CreateDescriptors()
+        && CreatePipeline();
+}
+
+void BlurEffect::Shutdown()
+{
+    for (auto& panel : m_panels)
+        DestroyPanel(panel.second);
+    m_panels.clear();
+
+    if (m_pipeline)
+        m_device.logical.destroyPipeline(m_pipeline);
+    if (m_pipelineLayout)
+        m_device.logical.destroyPipelineLayout(m_pipelineLayout);
+    if (m_descriptorPool)
+        m_device.logical.destroyDescriptorPool(m_descriptorPool);
+    if (m_descriptorSetLayout)
+        m_device.logical.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    if (m_renderPass)
+        m_device.logical.destroyRenderPass(m_renderPass);
+    if (m_sampler)
+        m_device.logical.destroySampler(m_sampler);
+    if (m_shader.shaderModule)
+        m_device.logical.destroyShaderModule(m_shader.shaderModule);
+
+    m_pipeline = vk::Pipeline();
+    m_pipelineLayout = vk::PipelineLayout();
+    m_descriptorPool = vk::DescriptorPool();
+    m_descriptorSetLayout = vk::DescriptorSetLayout();
+    m_renderPass = vk::RenderPass();
+    m_sampler = vk::Sampler();
+    m_shader.shaderModule = vk::ShaderModule();
+}
+
+vk::ImageView BlurEffect::Prepare(EffectCommands& cmds, std::vector<Surface> const& surfaces, size_t panelIndex,
+    uint64_t frame, vk::ClearValue const& clearValue, DrawBackdrop const& drawBackdrop)
+{
+    Surface const& surface = surfaces[panelIndex];
+    if (!m_pipeline || !surface.texture.image)
+        return vk::ImageView();
+
+    auto existing = m_panels.find(surface.texture.generation);
+    if (existing == m_panels.end())
+    {
+        if (m_panels.size() >= s_maxPanelCount)
+            return vk::ImageView();
+        existing = m_panels.emplace(surface.texture.generation, Panel()).first;
+    }
+
+    Panel& panel = existing->second;
+    panel.lastUsedFrame = frame;
+    if (panel.rect.extent != surface.rect.extent || panel.downscale != downscale || !panel.result.image)
+    {
+        DestroyPanel(panel);
+        if (!InitPanel(panel, surface.rect))
+        {
+            DestroyPanel(panel);
+            m_panels.erase(existing);
+            return vk::ImageView();
+        }
+    }
+
+    if (panel.valid && panel.rect == surface.rect && !IsBackdropDamaged(surfaces, panelIndex))
+        return panel.result.view;
+    panel.rect = surface.rect;
+
+    vk::CommandBuffer const cmd = cmds.graphics;
+    vk::RenderPassBeginInfo renderPassBegin;
+    renderPassBegin.setFramebuffer(panel.framebuffer);
+    renderPassBegin.setRenderArea(vk::Rect2D({ 0, 0 }, panel.backdrop.extent));
+    renderPassBegin.setRenderPass(m_renderPass);
+    renderPassBegin.setClearValueCount(1);
+    renderPassBegin.setPClearValues(&clearValue);
+    cmd.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
+    {
+        // The whole output is mapped so that only the area under the panel lands in the backdrop
+        float const scaleX = static_cast<float>(panel.backdrop.extent.width) / panel.rect.extent.width;
+        float const scaleY = static_cast<float>(panel.backdrop.extent.height) / panel.rect.extent.height;
+        vk::Viewport const viewport(-panel.rect.offset.x * scaleX, -panel.rect.offset.y * scaleY,
+            m_window.width * scaleX, m_window.height * scaleY, 0, 1.0f);
+        vk::Rect2D const scissor({ 0, 0 }, panel.backdrop.extent);
+        cmd.setViewport(0, 1, &viewport);
+        cmd.setScissor(0, 1, &scissor);
+
+        drawBackdrop(cmd, panelIndex);
+    }
+    cmd.endRenderPass();
+
+    RecordBlur(cmds, panel);
+    cmds.computeRecorded = true;
+    panel.valid = true;
+
+    return panel.result.view;
+}
+
+void BlurEffect::Retire(uint64_t completedFrameCount)
+{
+    for (auto panel = m_panels.begin(); panel != m_panels.end();)
+    {
+        if (panel->second.lastUsedFrame + maxIdleFrames < completedFrameCount)
+        {
+            DestroyPanel(panel->second);
+            panel = m_panels.erase(panel);
+        }
+        else
+        {
+            ++panel;
+        }
+    }
+}
+
+vk::Sampler BlurEffect::GetSampler() const
+{
+    return m_sampler;
+}
+
+bool BlurEffect::CreateRenderPass()
+{
+    // Same attachment format as the composite render pass, so surface pipelines can draw into the backdrop
+    vk::AttachmentDescription attachmentDescription;
+    attachmentDescription.setFormat(m_window.surfaceFormat.format);
+    attachmentDescription.setSamples(vk::SampleCountFlagBits::e1);
+    attachmentDescription.setInitialLayout(vk::ImageLayout::eUndefined);
+    attachmentDescription.setFinalLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    attachmentDescription.setLoadOp(vk::AttachmentLoadOp::eClear);
+    attachmentDescription.setStoreOp(vk::AttachmentStoreOp::eStore);
+    attachmentDescription.setStencilLoadOp(vk::AttachmentLoadOp::eDontCare);
+    attachmentDescription.setStencilStoreOp(vk::AttachmentStoreOp::eDontCare);
+
+    vk::AttachmentReference attachmentReference;
+    attachmentReference.setAttachment(0);
+    attachmentReference.setLayout(vk::ImageLayout::eColorAttachmentOptimal);
+
+    vk::SubpassDescription subpass;
+    subpass.setColorAttachmentCount(1);
+    subpass.setPColorAttachments(&attachmentReference);
+    subpass.setPipelineBindPoint(vk::PipelineBindPoint::eGraphics);
+
+    vk::SubpassDependency dependency;
+    dependency.setSrcSubpass(0);
+    dependency.setDstSubpass(VK_SUBPASS_EXTERNAL);
+    dependency.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+    dependency.setDstStageMask(vk::PipelineStageFlagBits::eComputeShader);
+    dependency.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite);
+    dependency.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+
+    vk::RenderPassCreateInfo renderPassCreateInfo;
+    renderPassCreateInfo.setAttachmentCount(1);
+    renderPassCreateInfo.setPAttachments(&attachmentDescription);
+    renderPassCreateInfo.setSubpassCount(1);
+    renderPassCreateInfo.setPSubpasses(&subpass);
+    renderPassCreateInfo.setDependencyCount(1);
+    renderPassCreateInfo.setPDependencies(&dependency);
+
+    std::tie(status, m_renderPass) = m_device.logical.createRenderPass(renderPassCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create backdrop render pass." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool BlurEffect::CreateDescriptors()
+{
+    vk::SamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.setMagFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMinFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+
+    std::tie(status, m_sampler) = m_device.logical.createSampler(samplerCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create blur sampler." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetLayoutBinding bindings[2];
+    bindings[0] = vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute);
+    bindings[1] = vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute);
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setBindingCount(2);
+    layoutCreateInfo.setPBindings(bindings);
+
+    std::tie(status, m_descriptorSetLayout) = m_device.logical.createDescriptorSetLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create blur descriptor set layout." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorPoolSize const poolSizes[2] = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, s_maxPanelCount * s_passCount),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, s_maxPanelCount * s_passCount),
+    };
+    vk::DescriptorPoolCreateInfo poolCreateInfo;
+    poolCreateInfo.setFlags(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet);
+    poolCreateInfo.setMaxSets(s_maxPanelCount * s_passCount);
+    poolCreateInfo.setPoolSizeCount(2);
+    poolCreateInfo.setPPoolSizes(poolSizes);
+
+    std::tie(status, m_descriptorPool) = m_device.logical.createDescriptorPool(poolCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create blur descriptor pool." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool BlurEffect::CreatePipeline()
+{
+    if (!m_shader.Init(m_device, "main", "../shaders/kawase.comp.spv", vk::ShaderStageFlagBits::eCompute))
+        return false;
+
+    vk::PushConstantRange const pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants));
+    vk::PipelineLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setSetLayoutCount(1);
+    layoutCreateInfo.setPSetLayouts(&m_descriptorSetLayout);
+    layoutCreateInfo.setPushConstantRangeCount(1);
+    layoutCreateInfo.setPPushConstantRanges(&pushConstantRange);
+
+    std::tie(status, m_pipelineLayout) = m_device.logical.createPipelineLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create blur pipeline layout." << std::endl;
+        return false;
+    }
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.setStage(m_shader.shaderStage);
+    pipelineCreateInfo.setLayout(m_pipelineLayout);
+
+    std::tie(status, m_pipeline) = m_device.logical.createComputePipeline(vk::PipelineCache(), pipelineCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create blur pipeline." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool BlurEffect::InitPanel(Panel & panel, vk::Rect2D const& rect)
+{
+    vk::Extent2D const backdropExtent = Downscale(rect.extent, std::max(downscale, 1u));
+    vk::ImageUsageFlags const storageUsage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+    if (!panel.backdrop.Init(m_device, m_window.surfaceFormat.format, backdropExtent,
+            vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled)
+        || !panel.levels[0].Init(m_device, vk::Format::eR8G8B8A8Unorm, Downscale(backdropExtent, 2), storageUsage)
+        || !panel.levels[1].Init(m_device, vk::Format::eR8G8B8A8Unorm, Downscale(backdropExtent, 4), storageUsage)
+        || !panel.result.Init(m_device, vk::Format::eR8G8B8A8Unorm, backdropExtent, storageUsage))
+    {
+        std::cerr << "Failed to create blur images." << std::endl;
+        return false;
+    }
+
+    vk::FramebufferCreateInfo framebufferCreateInfo;
+    framebufferCreateInfo.setRenderPass(m_renderPass);
+    framebufferCreateInfo.setAttachmentCount(1);
+    framebufferCreateInfo.setPAttachments(&panel.backdrop.view);
+    framebufferCreateInfo.setWidth(backdropExtent.width);
+    framebufferCreateInfo.setHeight(backdropExtent.height);
+    framebufferCreateInfo.setLayers(1);
+
+    std::tie(status, panel.framebuffer) = m_device.logical.createFramebuffer(framebufferCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create backdrop framebuffer." << std::endl;
+        return false;
+    }
+
+    std::array<vk::DescriptorSetLayout, s_passCount> layouts;
+    layouts.fill(m_descriptorSetLayout);
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorPool(m_descriptorPool);
+    allocateInfo.setDescriptorSetCount(s_passCount);
+    allocateInfo.setPSetLayouts(layouts.data());
+
+    status = m_device.logical.allocateDescriptorSets(&allocateInfo, panel.descriptorSets.data());
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate blur descriptor sets." << std::endl;
+        panel.descriptorSets.fill(vk::DescriptorSet());
+        return false;
+    }
+
+    // Down: backdrop -> level 0 -> level 1, up: level 1 -> level 0 -> result
+    Image const* const sources[s_passCount] = { &panel.backdrop, &panel.levels[0], &panel.levels[1], &panel.levels[0] };
+    Image const* const targets[s_passCount] = { &panel.levels[0], &panel.levels[1], &panel.levels[0], &panel.result };
+
+    std::array<vk::DescriptorImageInfo, s_passCount * 2> imageInfos;
+    std::array<vk::WriteDescriptorSet, s_passCount * 2> writes;
+    for (uint32_t i = 0; i < s_passCount; ++i)
+    {
+        vk::ImageLayout const sourceLayout = i == 0 ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eGeneral;
+        imageInfos[i * 2] = vk::DescriptorImageInfo(m_sampler, sources[i]->view, sourceLayout);
+        imageInfos[i * 2 + 1] = vk::DescriptorImageInfo(vk::Sampler(), targets[i]->view, vk::ImageLayout::eGeneral);
+
+        writes[i * 2].setDstSet(panel.descriptorSets[i]);
+        writes[i * 2].setDstBinding(0);
+        writes[i * 2].setDescriptorCount(1);
+        writes[i * 2].setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        writes[i * 2].setPImageInfo(&imageInfos[i * 2]);
+        writes[i * 2 + 1].setDstSet(panel.descriptorSets[i]);
+        writes[i * 2 + 1].setDstBinding(1);
+        writes[i * 2 + 1].setDescriptorCount(1);
+        writes[i * 2 + 1].setDescriptorType(vk::DescriptorType::eStorageImage);
+        writes[i * 2 + 1].setPImageInfo(&imageInfos[i * 2 + 1]);
+    }
+    m_device.logical.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    panel.rect = rect;
+    panel.downscale = downscale;
+    panel.valid = false;
+    return true;
+}
+
+void BlurEffect::DestroyPanel(Panel & panel)
+{
+    if (panel.descriptorSets.front())
+        m_device.logical.freeDescriptorSets(m_descriptorPool, s_passCount, panel.descriptorSets.data());
+    if (panel.framebuffer)
+        m_device.logical.destroyFramebuffer(panel.framebuffer);
+    panel.backdrop.Destroy(m_device);
+    for (Image& level : panel.levels)
+        level.Destroy(m_device);
+    panel.result.Destroy(m_device);
+
+    panel.descriptorSets.fill(vk::DescriptorSet());
+    panel.framebuffer = vk::Framebuffer();
+    panel.valid = false;
+}
+
+bool BlurEffect::IsBackdropDamaged(std::vector<Surface> const& surfaces, size_t panelIndex) const
+{
+    vk::Rect2D const& area = surfaces[panelIndex].rect;
+    for (size_t i = 0; i < panelIndex; ++i)
+    {
+        Surface const& surface = surfaces[i];
+        if (surface.visible && surface.contentDamaged && Intersects(surface.rect, area))
+            return true;
+
+        for (vk::Rect2D const& damage : surface.damage)
+        {
+            if (Intersects(damage, area))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void BlurEffect::RecordBlur(EffectCommands const& cmds, Panel const& panel)
+{
+    vk::CommandBuffer const cmd = cmds.compute;
+    uint32_t const graphicsFamilyIndex = m_device.queue.familyIndex;
+    uint32_t const computeFamilyIndex = m_device.computeQueue.familyIndex;
+
+    // On a separate compute family the backdrop has to change owners before it is sampled,
+    // a compute only queue also can't name the graphics stages that last touched the images
+    vk::PipelineStageFlags srcStage = vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eComputeShader;
+    if (cmds.IsAsync())
+    {
+        RecordOwnershipTransfer(cmds.graphics, cmd, panel.backdrop,
+            vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, graphicsFamilyIndex, computeFamilyIndex,
+            vk::PipelineStageFlagBits::eColorAttachmentOutput, vk::AccessFlagBits::eColorAttachmentWrite,
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderRead);
+        srcStage = vk::PipelineStageFlagBits::eComputeShader;
+    }
+
+    // Intermediate levels are fully rewritten, so their previous content is discarded
+    vk::ImageMemoryBarrier barriers[3];
+    Image const* const storageImages[3] = { &panel.levels[0], &panel.levels[1], &panel.result };
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        barriers[i].setImage(storageImages[i]->image);
+        barriers[i].setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        barriers[i].setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+        barriers[i].setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+        barriers[i].setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+        barriers[i].setDstAccessMask(vk::AccessFlagBits::eShaderWrite);
+        barriers[i].setOldLayout(vk::ImageLayout::eUndefined);
+        barriers[i].setNewLayout(vk::ImageLayout::eGeneral);
+    }
+    cmd.pipelineBarrier(srcStage, vk::PipelineStageFlagBits::eComputeShader, {}, 0, nullptr, 0, nullptr, 3, barriers);
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+
+    Image const* const sources[s_passCount] = { &panel.backdrop, &panel.levels[0], &panel.levels[1], &panel.levels[0] };
+    Image const* const targets[s_passCount] = { &panel.levels[0], &panel.levels[1], &panel.levels[0], &panel.result };
+    for (uint32_t i = 0; i < s_passCount; ++i)
+    {
+        if (i > 0)
+        {
+            vk::MemoryBarrier const memoryBarrier(vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite);
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                {}, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        Constants constants;
+        constants.halfTexel[0] = 0.5f / sources[i]->extent.width;
+        constants.halfTexel[1] = 0.5f / sources[i]->extent.height;
+        constants.offset = offset;
+        constants.upsample = i >= s_passCount / 2 ? 1 : 0;
+
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, 1, &panel.descriptorSets[i], 0, nullptr);
+        cmd.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants), &constants);
+        cmd.dispatch((targets[i]->extent.width + 7) / 8, (targets[i]->extent.height + 7) / 8, 1);
+    }
+
+    if (cmds.IsAsync())
+    {
+        RecordOwnershipTransfer(cmd, cmds.composite, panel.result,
+            vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal, computeFamilyIndex, graphicsFamilyIndex,
+            vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eShaderWrite,
+            vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eShaderRead);
+        return;
+    }
+
+    barriers[2].setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    barriers[2].setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    barriers[2].setOldLayout(vk::ImageLayout::eGeneral);
+    barriers[2].setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader,
+        {}, 0, nullptr, 0, nullptr, 1, &barriers[2]);
+}
+
+void BlurEffect::RecordOwnershipTransfer(vk::CommandBuffer release, vk::CommandBuffer acquire, Image const& image,
+    vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t srcFamilyIndex, uint32_t dstFamilyIndex,
+    vk::PipelineStageFlags srcStage, vk::AccessFlags srcAccess, vk::PipelineStageFlags dstStage, vk::AccessFlags dstAccess)
+{
+    // The release half only makes the writes available, the acquire half makes them visible
+    vk::ImageMemoryBarrier barrier;
+    barrier.setImage(image.image);
+    barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    barrier.setSrcQueueFamilyIndex(srcFamilyIndex);
+    barrier.setDstQueueFamilyIndex(dstFamilyIndex);
+    barrier.setOldLayout(oldLayout);
+    barrier.setNewLayout(newLayout);
+
+    barrier.setSrcAccessMask(srcAccess);
+    barrier.setDstAccessMask({});
+    release.pipelineBarrier(srcStage, vk::PipelineStageFlagBits::eBottomOfPipe, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    barrier.setSrcAccessMask({});
+    barrier.setDstAccessMask(dstAccess);
+    acquire.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, dstStage, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+} // vkc namespace
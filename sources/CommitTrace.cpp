@@ -0,0 +1,388 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <CommitTrace.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vkc
+{
+
+namespace
+{
+
+char const s_magic[8] = { 'V', 'K', 'C', 'T', 'R', 'A', 'C', 'E' };
+
+static_assert(sizeof(TraceHeader) == 88, "Trace header layout changed");
+static_assert(sizeof(TraceRect) == 16, "Trace rect layout changed");
+static_assert(sizeof(CommitRecord) == 96, "Commit record layout changed");
+
+size_t Align(size_t size)
+{
+    return (size + 7) & ~static_cast<size_t>(7);
+}
+
+} // anonymous namespace
+
+bool CommitRecorder::Start(FILE* pOutput, std::vector<vk::Extent2D> const& outputExtents, bool storeContents)
+{
+    Stop();
+    if (!pOutput || outputExtents.size() > TraceHeader::s_maxOutputCount)
+    {
+        std::cerr << "Failed to start commit recording." << std::endl;
+        return false;
+    }
+
+    TraceHeader header = {};
+    std::memcpy(header.magic, s_magic, sizeof(s_magic));
+    header.version = TraceHeader::s_version;
+    header.flags = storeContents ? TraceHeader::s_contentsStored : 0;
+    header.outputCount = static_cast<uint32_t>(outputExtents.size());
+    for (size_t i = 0; i < outputExtents.size(); ++i)
+    {
+        header.outputExtents[i][0] = outputExtents[i].width;
+        header.outputExtents[i][1] = outputExtents[i].height;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, pOutput) != 1)
+    {
+        std::cerr << "Failed to write trace header." << std::endl;
+        return false;
+    }
+
+    // The first commit of every output is a snapshot of all of its surfaces
+    m_pOutput = pOutput;
+    m_storeContents = storeContents;
+    m_start = Clock::now();
+    m_surfaceCounts.assign(outputExtents.size(), SIZE_MAX);
+    m_recordedDamage.assign(outputExtents.size(), std::vector<RecordedDamage>());
+    m_recordCount = 0;
+    m_byteCount = sizeof(header);
+    return true;
+}
+
+void CommitRecorder::Stop()
+{
+    if (m_pOutput)
+        fflush(m_pOutput);
+    m_pOutput = nullptr;
+}
+
+bool CommitRecorder::IsActive() const
+{
+    return m_pOutput != nullptr;
+}
+
+void CommitRecorder::Record(uint32_t output, std::vector<Surface> const& surfaces, uint64_t frame)
+{
+    if (!m_pOutput || output >= m_surfaceCounts.size())
+        return;
+
+    bool const snapshot = m_surfaceCounts[output] == SIZE_MAX;
+    bool const countChanged = surfaces.size() != m_surfaceCounts[output];
+    m_surfaceCounts[output] = surfaces.size();
+
+    // Indices shift when surfaces come and go, so damage is matched by index only while the count holds
+    std::vector<RecordedDamage>& recorded = m_recordedDamage[output];
+    if (countChanged)
+        recorded.assign(surfaces.size(), RecordedDamage());
+
+    bool written = false;
+    for (uint32_t i = 0; m_pOutput && i < surfaces.size(); ++i)
+    {
+        Surface const& surface = surfaces[i];
+        size_t const firstDamage = recorded[i].rectCount <= surface.damage.size() ? recorded[i].rectCount : 0;
+        bool const newContent = surface.contentDamaged && !recorded[i].content;
+        if (snapshot || firstDamage < surface.damage.size() || newContent)
+        {
+            Write(output, surfaces, i, firstDamage, newContent, frame);
+            written = true;
+        }
+
+        recorded[i].rectCount = surface.damage.size();
+        recorded[i].content = surface.contentDamaged;
+    }
+
+    if (m_pOutput && countChanged && !written)
+        Write(output, surfaces, CommitRecord::s_none, 0, false, frame);
+}
+
+void CommitRecorder::OnDamageCleared(uint32_t output)
+{
+    if (output < m_recordedDamage.size())
+        std::fill(m_recordedDamage[output].begin(), m_recordedDamage[output].end(), RecordedDamage());
+}
+
+uint64_t CommitRecorder::GetRecordCount() const
+{
+    return m_recordCount;
+}
+
+uint64_t CommitRecorder::GetByteCount() const
+{
+    return m_byteCount;
+}
+
+uint64_t CommitRecorder::HashContent(std::vector<uint32_t> const& pixels)
+{
+    // FNV-1a over whole pixels, collisions only cost a replay its content change
+    uint64_t hash = 14695981039346656037ull;
+    for (uint32_t pixel : pixels)
+    {
+        hash ^= pixel;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void CommitRecorder::Write(uint32_t output, std::vector<Surface> const& surfaces, uint32_t surface, size_t firstDamage,
+    bool contentDamaged, uint64_t frame)
+{
+    CommitRecord record = {};
+    record.time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count());
+    record.frame = frame;
+    record.output = output;
+    record.surface = surface;
+    record.surfaceCount = static_cast<uint32_t>(surfaces.size());
+
+    size_t damageSize = 0;
+    size_t pixelSize = 0;
+    if (surface != CommitRecord::s_none)
+    {
+        Surface const& source = surfaces[surface];
+        vk::Extent2D const content = source.texture.contentExtent;
+        bool const hasPixels = m_storeContents
+            && source.hostPixels.size() >= static_cast<size_t>(content.width) * content.height;
+
+        record.contentHash = HashContent(source.hostPixels);
+        record.client = source.client;
+        record.rect = { source.rect.offset.x, source.rect.offset.y, source.rect.extent.width, source.rect.extent.height };
+        record.contentWidth = content.width;
+        record.contentHeight = content.height;
+        record.damageCount = static_cast<uint32_t>(source.damage.size() - firstDamage);
+        record.flags = (source.visible ? CommitRecord::s_visible : 0)
+            | (source.blurBehind ? CommitRecord::s_blurBehind : 0)
+            | (contentDamaged ? CommitRecord::s_contentDamaged : 0)
+            | (source.yuv ? CommitRecord::s_yuv : 0)
+            | (hasPixels ? CommitRecord::s_hasPixels : 0);
+        record.blend = static_cast<uint32_t>(source.blend);
+        record.opacity = source.opacity;
+        record.dim = source.dim;
+        record.cornerRadius = source.cornerRadius;
+
+        damageSize = record.damageCount * sizeof(TraceRect);
+        pixelSize = hasPixels ? Align(static_cast<size_t>(content.width) * content.height * sizeof(uint32_t)) : 0;
+    }
+    record.size = static_cast<uint32_t>(sizeof(record) + damageSize + pixelSize);
+
+    m_record.assign(record.size, 0);
+    std::memcpy(m_record.data(), &record, sizeof(record));
+    if (damageSize != 0)
+    {
+        TraceRect* const pDamage = reinterpret_cast<TraceRect*>(m_record.data() + sizeof(record));
+        std::vector<vk::Rect2D> const& damage = surfaces[surface].damage;
+        for (size_t i = firstDamage; i < damage.size(); ++i)
+        {
+            pDamage[i - firstDamage] = { damage[i].offset.x, damage[i].offset.y, damage[i].extent.width,
+                damage[i].extent.height };
+        }
+    }
+    if (pixelSize != 0)
+    {
+        std::memcpy(m_record.data() + sizeof(record) + damageSize, surfaces[surface].hostPixels.data(),
+            static_cast<size_t>(record.contentWidth) * record.contentHeight * sizeof(uint32_t));
+    }
+
+    if (fwrite(m_record.data(), 1, m_record.size(), m_pOutput) != m_record.size())
+    {
+        std::cerr << "Failed to write commit record, recording stopped." << std::endl;
+        Stop();
+        return;
+    }
+
+    ++m_recordCount;
+    m_byteCount += m_record.size();
+}
+
+CommitTrace::~CommitTrace()
+{
+    Close();
+}
+
+bool CommitTrace::Open(char const* pPath)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE const file = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size))
+    {
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        std::cerr << "Failed to open trace " << pPath << "." << std::endl;
+        return false;
+    }
+    m_file = file;
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    m_mapping = m_size != 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    if (m_mapping)
+        m_pData = static_cast<uint8_t const*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+    int const file = open(pPath, O_RDONLY);
+    struct stat info;
+    if (file < 0 || fstat(file, &info) != 0)
+    {
+        if (file >= 0)
+            close(file);
+        std::cerr << "Failed to open trace " << pPath << "." << std::endl;
+        return false;
+    }
+    m_size = static_cast<size_t>(info.st_size);
+
+    // The mapping keeps its own reference to the file
+    void* const pData = m_size != 0 ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    close(file);
+    if (pData != MAP_FAILED)
+        m_pData = static_cast<uint8_t const*>(pData);
+#endif
+
+    if (!m_pData || m_size < sizeof(TraceHeader))
+    {
+        std::cerr << "Failed to map trace " << pPath << "." << std::endl;
+        Close();
+        return false;
+    }
+
+    TraceHeader const& header = GetHeader();
+    if (std::memcmp(header.magic, s_magic, sizeof(s_magic)) != 0 || header.version != TraceHeader::s_version
+        || header.outputCount > TraceHeader::s_maxOutputCount)
+    {
+        std::cerr << "Unsupported trace " << pPath << "." << std::endl;
+        Close();
+        return false;
+    }
+
+    Rewind();
+    return true;
+}
+
+void CommitTrace::Close()
+{
+#ifdef _WIN32
+    if (m_pData)
+        UnmapViewOfFile(m_pData);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    if (m_pData)
+        munmap(const_cast<uint8_t*>(m_pData), m_size);
+#endif
+    m_pData = nullptr;
+    m_size = 0;
+    m_offset = 0;
+}
+
+TraceHeader const& CommitTrace::GetHeader() const
+{
+    return *reinterpret_cast<TraceHeader const*>(m_pData);
+}
+
+bool CommitTrace::Next(Commit& commit)
+{
+    if (!m_pData || m_size - m_offset < sizeof(CommitRecord))
+        return false;
+
+    // Sizes are bounded before they are multiplied any further, so a corrupt record can't overflow them
+    CommitRecord const* const pRecord = reinterpret_cast<CommitRecord const*>(m_pData + m_offset);
+    uint64_t const available = m_size - m_offset;
+    if (pRecord->size % 8 != 0 || pRecord->contentWidth > CommitRecord::s_maxContentExtent
+        || pRecord->contentHeight > CommitRecord::s_maxContentExtent)
+    {
+        std::cerr << "Malformed commit record at offset " << m_offset << "." << std::endl;
+        return false;
+    }
+
+    uint64_t const damageSize = static_cast<uint64_t>(pRecord->damageCount) * sizeof(TraceRect);
+    uint64_t const pixelSize = (pRecord->flags & CommitRecord::s_hasPixels)
+        ? static_cast<uint64_t>(pRecord->contentWidth) * pRecord->contentHeight * sizeof(uint32_t) : 0;
+    if (pRecord->size > available || pRecord->size < sizeof(CommitRecord) + damageSize + pixelSize)
+    {
+        std::cerr << "Truncated commit record at offset " << m_offset << "." << std::endl;
+        return false;
+    }
+
+    uint8_t const* const pPayload = m_pData + m_offset + sizeof(CommitRecord);
+    commit.pRecord = pRecord;
+    commit.pDamage = reinterpret_cast<TraceRect const*>(pPayload);
+    commit.pPixels = pixelSize != 0 ? reinterpret_cast<uint32_t const*>(pPayload + static_cast<size_t>(damageSize)) : nullptr;
+    m_offset += pRecord->size;
+    return true;
+}
+
+void CommitTrace::Rewind()
+{
+    m_offset = sizeof(TraceHeader);
+}
+
+void CommitTrace::Apply(Commit const& commit, std::vector<Surface>& surfaces)
+{
+    CommitRecord const& record = *commit.pRecord;
+    surfaces.resize(record.surfaceCount);
+    if (record.surface >= surfaces.size())
+        return;
+
+    Surface& surface = surfaces[record.surface];
+    surface.rect = vk::Rect2D({ record.rect.x, record.rect.y }, { record.rect.width, record.rect.height });
+    surface.damage.clear();
+    for (uint32_t i = 0; i < record.damageCount; ++i)
+    {
+        TraceRect const& damage = commit.pDamage[i];
+        surface.damage.push_back(vk::Rect2D({ damage.x, damage.y }, { damage.width, damage.height }));
+    }
+    surface.contentDamaged = (record.flags & CommitRecord::s_contentDamaged) != 0;
+    surface.visible = (record.flags & CommitRecord::s_visible) != 0;
+    surface.blurBehind = (record.flags & CommitRecord::s_blurBehind) != 0;
+    surface.yuv = (record.flags & CommitRecord::s_yuv) != 0;
+    surface.blend = static_cast<BlendMode>(record.blend);
+    surface.opacity = record.opacity;
+    surface.dim = record.dim;
+    surface.cornerRadius = record.cornerRadius;
+    surface.client = record.client;
+
+    vk::Extent2D const content(record.contentWidth, record.contentHeight);
+    size_t const pixelCount = static_cast<size_t>(content.width) * content.height;
+    bool const resized = surface.texture.contentExtent != content;
+    surface.texture.extent = content;
+    surface.texture.contentExtent = content;
+    if (commit.pPixels)
+    {
+        surface.hostPixels.assign(commit.pPixels, commit.pPixels + pixelCount);
+    }
+    else if (resized || surface.contentDamaged || surface.hostPixels.size() != pixelCount)
+    {
+        // Without stored contents an opaque color derived from the hash stands in for them
+        uint32_t const color = 0xFF000000u | static_cast<uint32_t>(record.contentHash ^ (record.contentHash >> 32));
+        surface.hostPixels.assign(pixelCount, color);
+    }
+}
+
+} // vkc namespace
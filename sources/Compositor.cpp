@@ -4,35 +4,756 @@
  * (http://opensource.org/licenses/MIT)
  */
 #include <Compositor.hpp>
+#include <Trace.hpp>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <thread>
 
 namespace vkc
 {
 
+Compositor::~Compositor()
+{
+    if (m_frameFence)
+    {
+        device.logical.waitIdle();
+        device.logical.destroyFence(m_frameFence);
+    }
+}
+
 bool Compositor::Init()
 {
-    if (device.Init())
+    m_initStart = Clock::now();
+    ScopedTimer initTimer(m_startupTimings.init);
+    VKC_TRACE_THREAD_NAME("Compositor");
+
+    if (outputConfigs.empty())
     {
-        m_pWindow = std::make_unique<Window>(device);
-        if (m_pWindow->Init())
-        {
-            m_pRender = std::make_unique<Render>(device, *m_pWindow);
-            return m_pRender->Init();
-        }
+        std::cerr << "No outputs configured." << std::endl;
+        return false;
+    }
+
+    bool deviceReady = false;
+    {
+        ScopedTimer timer(m_startupTimings.device);
+        deviceReady = !headless && device.Init();
+    }
+
+    if (!headless)
+        device.LogConfiguration(std::cout);
+    if (!deviceReady)
+    {
+        std::cerr << "No usable Vulkan device, compositing in software." << std::endl;
+        for (OutputConfig const& config : outputConfigs)
+            m_outputs.push_back(std::make_unique<Output>(config));
+        m_pendingInput.resize(m_outputs.size());
+        m_headless = true;
+        return true;
     }
 
-    return false;
+    for (OutputConfig const& config : outputConfigs)
+    {
+        m_outputs.push_back(std::make_unique<Output>(device, config));
+        uint32_t const index = static_cast<uint32_t>(m_outputs.size() - 1);
+        m_outputs.back()->GetWindow().onInput = [this, index](InputEvent const& event) {
+            InputEvent tagged = event;
+            tagged.output = index;
+            m_pWindowInput->Push(tagged);
+        };
+    }
+    m_pendingInput.resize(m_outputs.size());
+    m_pResidency = std::make_unique<ResidencyManager>(device);
+    m_pImagePool = std::make_unique<ImagePool>(device);
+
+    // Shader and pipeline compilation only depends on the surface format and output size,
+    // so it overlaps surface and swapchain setup which has to stay on the main thread
+    std::vector<std::future<bool>> pipelines;
+    for (std::unique_ptr<Output>& pOutput : m_outputs)
+    {
+        Output* const pTarget = pOutput.get();
+        pipelines.push_back(std::async(std::launch::async, [pTarget]() { return pTarget->InitPipelines(); }));
+    }
+
+    bool windowsReady = true;
+    {
+        ScopedTimer timer(m_startupTimings.window);
+        for (std::unique_ptr<Output>& pOutput : m_outputs)
+            windowsReady = pOutput->InitWindow() && windowsReady;
+    }
+
+    bool pipelinesReady = true;
+    for (std::future<bool>& pipeline : pipelines)
+        pipelinesReady = pipeline.get() && pipelinesReady;
+    m_startupTimings.shaders = m_outputs.front()->GetRender().shaderInitTime;
+    m_startupTimings.pipelines = m_outputs.front()->GetRender().pipelineInitTime;
+    if (!windowsReady || !pipelinesReady)
+        return false;
+
+    ScopedTimer timer(m_startupTimings.renderResources);
+    for (std::unique_ptr<Output>& pOutput : m_outputs)
+    {
+        if (!pOutput->Init())
+            return false;
+    }
+
+    m_scheduler.SetRefreshPeriod(m_outputs.front()->GetWindow().refreshPeriod);
+    if (m_outputs.front()->GetWindow().refreshPeriod.count() != 0)
+        m_qualityGovernor.SetBudget(m_outputs.front()->GetWindow().refreshPeriod);
+
+    vk::Result result;
+    std::tie(result, m_frameFence) = device.logical.createFence(vk::FenceCreateInfo());
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create frame fence." << std::endl;
+        return false;
+    }
+
+    return m_pResidency->Init();
 }
 
 bool Compositor::IsValid()
 {
-    return m_pWindow->IsValid();
+    if (m_outputs.empty())
+        return false;
+
+    if (IsHeadless() && headlessFrameLimit != 0 && m_frameIndex >= headlessFrameLimit)
+        return false;
+
+    for (std::unique_ptr<Output> const& pOutput : m_outputs)
+    {
+        if (!pOutput->IsValid())
+            return false;
+    }
+
+    return true;
 }
 
 void Compositor::RenderFrame()
 {
-    glfwPollEvents();
-    m_pRender->Frame();
-    m_pWindow->SwapBuffers();
+    // Everything below, including input, is sampled as late as the deadline allows
+    Clock::time_point frameStart;
+    {
+        VKC_TRACE_SCOPE("Compositor::WaitForFrameStart");
+        frameStart = m_scheduler.WaitForFrameStart();
+    }
+    VKC_TRACE_SCOPE("Compositor::RenderFrame");
+
+    bool rendered = true;
+    if (IsHeadless())
+    {
+        DispatchInput();
+        DispatchCommits();
+        RecordCommits();
+        RenderHeadlessFrame();
+    }
+    else
+    {
+        glfwPollEvents();
+        DispatchInput();
+        DispatchCommits();
+        RecordCommits();
+
+        // Recycled images are the cheapest memory to give back under pressure
+        if (device.memoryBudget.IsOverBudget(m_pResidency->budgetFraction))
+            m_pImagePool->Trim();
+
+        m_surfaceLists.clear();
+        for (std::unique_ptr<Output>& pOutput : m_outputs)
+            m_surfaceLists.push_back(&pOutput->surfaces);
+        m_pResidency->Update(m_surfaceLists);
+
+        rendered = RenderOutputs();
+        m_pImagePool->Retire(m_frameIndex);
+        if (rendered)
+            m_scheduler.OnFrameDone(frameStart, m_scheduler.Now());
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (rendered && !m_firstFrameDone)
+    {
+        m_startupTimings.firstFrame = Clock::now() - m_initStart;
+        m_firstFrameDone = true;
+        LogStartupTimings();
+    }
+}
+
+void Compositor::RecordCommits()
+{
+    // Whatever clients changed since the last frame is pending as damage at this point, on
+    // top of the damage of outputs that haven't rendered since, which the recorder skips
+    if (!m_recorder.IsActive())
+        return;
+
+    VKC_TRACE_SCOPE("Compositor::RecordCommits");
+    for (size_t i = 0; i < m_outputs.size(); ++i)
+        m_recorder.Record(static_cast<uint32_t>(i), m_outputs[i]->surfaces, m_frameIndex);
+}
+
+void Compositor::DispatchCommits()
+{
+    VKC_TRACE_SCOPE("Compositor::DispatchCommits");
+    ClientCommit commit;
+    for (auto& clientCommits : m_clientCommits)
+    {
+        while (clientCommits.second->Pop(commit))
+            ApplyCommit(clientCommits.first, commit);
+    }
+}
+
+void Compositor::ApplyCommit(uint32_t client, ClientCommit const& commit)
+{
+    Surface* pSurface = nullptr;
+    if (commit.output < m_outputs.size() && commit.surface < m_outputs[commit.output]->surfaces.size()
+        && m_outputs[commit.output]->surfaces[commit.surface].client == client)
+    {
+        pSurface = &m_outputs[commit.output]->surfaces[commit.surface];
+    }
+
+    // A buffer is released once its content is copied, even if the commit is invalid
+    if (commit.pBuffer)
+    {
+        if (pSurface)
+        {
+            VKC_TRACE_SCOPE("Compositor::CopyClientBuffer");
+            pSurface->hostPixels.assign(commit.pBuffer->pixels.begin(), commit.pBuffer->pixels.end());
+            if (IsHeadless())
+                pSurface->texture.extent = pSurface->texture.contentExtent = commit.pBuffer->extent;
+        }
+        commit.pBuffer->busy.store(false, std::memory_order_release);
+    }
+
+    if (!pSurface)
+        return;
+
+    for (vk::Rect2D const& damage : commit.damage)
+    {
+        pSurface->damage.push_back(vk::Rect2D(
+            { pSurface->rect.offset.x + damage.offset.x, pSurface->rect.offset.y + damage.offset.y }, damage.extent));
+    }
+
+    // Commits to an output that never renders must not pile up
+    if (m_pendingCommits.size() == s_maxPendingCommits)
+    {
+        m_pendingCommits.pop_front();
+        ++m_evictedCommitCount;
+    }
+    Output const* const pOutput = m_outputs[commit.output].get();
+    m_pendingCommits.push_back({ client, pOutput, GetOutputFrameCount(*pOutput), commit.timestamp });
+}
+
+void Compositor::OnCommitsPresented(Output const* pOutput, Clock::time_point time)
+{
+    uint64_t const frameCount = GetOutputFrameCount(*pOutput);
+    auto const presented = std::remove_if(m_pendingCommits.begin(), m_pendingCommits.end(),
+        [this, pOutput, frameCount, time](PendingCommit const& pending) {
+            if (pending.pOutput != pOutput || pending.frame >= frameCount)
+                return false;
+
+            m_commitLatency[pending.client].Add(time - pending.timestamp);
+            return true;
+        });
+    m_pendingCommits.erase(presented, m_pendingCommits.end());
+}
+
+void Compositor::RenderHeadlessFrame()
+{
+    for (size_t i = 0; i < m_outputs.size(); ++i)
+    {
+        Output& output = *m_outputs[i];
+        output.Update();
+        if (!output.NeedsFrame())
+        {
+            DropUnrenderedInput(i);
+            continue;
+        }
+
+        output.GetSoftwareRender()->Frame(output.surfaces, output.GetScene());
+        output.ClearDamage();
+        m_recorder.OnDamageCleared(static_cast<uint32_t>(i));
+        OnCommitsPresented(&output, Clock::now());
+
+        // Nothing is scanned out, the frame counts as shown once it is composed
+        OnFramePresented(i, GetOutputFrameCount(output) - 1, Clock::now());
+    }
+
+    ++m_frameIndex;
+}
+
+bool Compositor::RenderOutputs()
+{
+    // Acquiring never blocks, an output without a free swapchain image keeps its damage
+    // and is picked up again on a later frame
+    m_frameOutputs.clear();
+    for (size_t i = 0; i < m_outputs.size(); ++i)
+    {
+        Output& output = *m_outputs[i];
+        output.Update();
+        if (!output.NeedsFrame())
+            DropUnrenderedInput(i);
+        else if (output.GetRender().Acquire(0))
+            m_frameOutputs.push_back(&output);
+    }
+
+    if (m_frameOutputs.empty())
+        return false;
+
+    // Every output records its own command buffers, the first one on this thread
+    std::vector<std::future<bool>> records;
+    for (size_t i = 1; i < m_frameOutputs.size(); ++i)
+    {
+        Output* const pOutput = m_frameOutputs[i];
+        records.push_back(std::async(std::launch::async, [pOutput]() {
+            VKC_TRACE_THREAD_NAME("Output recording");
+            return pOutput->Record();
+        }));
+    }
+
+    // A failed output is left out of the batch instead of dropping the whole frame, it keeps
+    // its acquired image and damage for the next one
+    Output* const pFirst = m_frameOutputs.front();
+    std::vector<bool> recorded{ pFirst->Record() };
+    for (std::future<bool>& record : records)
+        recorded.push_back(record.get());
+
+    size_t recordedCount = 0;
+    for (size_t i = 0; i < m_frameOutputs.size(); ++i)
+    {
+        if (recorded[i])
+            m_frameOutputs[recordedCount++] = m_frameOutputs[i];
+        else
+            m_frameOutputs[i]->GetRender().CancelFrame();
+    }
+    m_frameOutputs.resize(recordedCount);
+    if (m_frameOutputs.empty())
+        return false;
+
+    m_graphicsSubmits.clear();
+    m_computeSubmits.clear();
+    for (Output* pOutput : m_frameOutputs)
+        pOutput->GetRender().AppendSubmits(m_graphicsSubmits, m_computeSubmits);
+
+    vk::Result result = device.queue.queue.submit(
+        static_cast<uint32_t>(m_graphicsSubmits.size()), m_graphicsSubmits.data(), m_frameFence);
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to submit frame." << std::endl;
+        return false;
+    }
+
+    if (!m_computeSubmits.empty())
+    {
+        result = device.computeQueue.queue.submit(
+            static_cast<uint32_t>(m_computeSubmits.size()), m_computeSubmits.data(), vk::Fence());
+        if (result != vk::Result::eSuccess)
+        {
+            std::cerr << "Failed to submit blur cmd." << std::endl;
+            return false;
+        }
+    }
+
+    // Presented one by one, so a lost or out of date swapchain only affects its own output,
+    // which keeps its damage and pending commits until a later frame is presented
+    m_presentedOutputs.clear();
+    for (Output* pOutput : m_frameOutputs)
+    {
+        if (pOutput->GetRender().Present())
+            m_presentedOutputs.push_back(pOutput);
+        pOutput->GetWindow().SwapBuffers();
+    }
+
+    {
+        VKC_TRACE_SCOPE("Compositor::WaitFence");
+        while (device.logical.waitForFences(1, &m_frameFence, true, UINT64_MAX) == vk::Result::eTimeout);
+    }
+    device.logical.resetFences(1, &m_frameFence);
+
+    // The outputs share the GPU, so the batch as a whole has to fit the budget
+    Milliseconds gpuTime{ 0 };
+    Clock::time_point const frameDone = Clock::now();
+    for (Output* pOutput : m_frameOutputs)
+    {
+        pOutput->GetRender().EndFrame();
+        gpuTime += pOutput->GetRender().GetGpuTime();
+    }
+    for (size_t i = 0; i < m_outputs.size(); ++i)
+    {
+        Output* const pOutput = m_outputs[i].get();
+        if (std::find(m_presentedOutputs.begin(), m_presentedOutputs.end(), pOutput) == m_presentedOutputs.end())
+            continue;
+
+        pOutput->ClearDamage();
+        m_recorder.OnDamageCleared(static_cast<uint32_t>(i));
+        OnCommitsPresented(pOutput, frameDone);
+
+        // Only the first output observes scan-out, frames on the others count as shown once completed
+        if (i != 0)
+            OnFramePresented(i, GetOutputFrameCount(*pOutput) - 1, frameDone);
+    }
+    ++m_frameIndex;
+
+    if (m_qualityGovernor.OnFrame(gpuTime))
+        ApplyQuality();
+
+    if (!m_presentedOutputs.empty() && m_presentedOutputs.front() == m_outputs.front().get())
+        ObserveVblank();
+
+    return true;
+}
+
+void Compositor::ObserveVblank()
+{
+    Render& render = m_outputs.front()->GetRender();
+    uint64_t presentedFrame = 0;
+    Clock::time_point presentTime;
+    if (render.GetLastPresentTime(presentedFrame, presentTime))
+    {
+        m_scheduler.OnVblank(presentTime, true);
+        OnFramePresented(0, presentedFrame, presentTime);
+        return;
+    }
+
+    // Both swapchain images are busy until the frame just presented is scanned out, so
+    // acquiring the next one ahead of time returns close to that vblank
+    uint64_t const timeout = static_cast<uint64_t>(m_outputs.front()->GetWindow().refreshPeriod.count());
+    if (timeout != 0 && render.Acquire(timeout))
+        m_scheduler.OnVblank(m_scheduler.Now(), false);
+
+    // Without any vblank the completed frame is the closest estimate there is
+    OnFramePresented(0, render.GetSubmittedFrameCount() - 1, m_scheduler.Now());
+}
+
+void Compositor::DispatchInput()
+{
+    VKC_TRACE_SCOPE("Compositor::DispatchInput");
+    // Window callbacks push from glfwPollEvents on this thread and PushInput from another
+    // one, so each producer has a ring of its own
+    InputEvent event;
+    while (m_pWindowInput->Pop(event))
+        DispatchEvent(event);
+    while (m_pInput->Pop(event))
+        DispatchEvent(event);
+}
+
+void Compositor::DispatchEvent(InputEvent event)
+{
+    if (event.output >= m_outputs.size())
+        return;
+
+    // Keys go to the surface focused by the last click, everything else to the one under the pointer
+    Scene const& scene = m_outputs[event.output]->GetScene();
+    if (event.type == InputType::eKey)
+    {
+        event.output = m_focusOutput;
+        event.surface = m_focusSurface;
+    }
+    else
+    {
+        // Only the cursor is damaged by motion, the scene under it stays as rendered
+        if (event.type == InputType::eMotion)
+        {
+            Output& output = *m_outputs[event.output];
+            output.cursor.rect.offset = vk::Offset2D(static_cast<int32_t>(event.x) - output.cursorHotspot.x,
+                static_cast<int32_t>(event.y) - output.cursorHotspot.y);
+        }
+
+        bool const scroll = event.type == InputType::eScroll;
+        event.surface = scene.HitTest(static_cast<int32_t>(scroll ? event.pointerX : event.x),
+            static_cast<int32_t>(scroll ? event.pointerY : event.y));
+        if (event.type == InputType::eButton)
+        {
+            m_focusOutput = event.output;
+            m_focusSurface = event.surface;
+        }
+    }
+
+    Output const& output = *m_outputs[event.output];
+    event.frame = GetOutputFrameCount(output);
+    if (event.surface < output.surfaces.size())
+    {
+        event.client = output.surfaces[event.surface].client;
+        auto const clientInput = m_clientInput.find(event.client);
+        if (clientInput != m_clientInput.end())
+            clientInput->second->Push(event);
+    }
+
+    // Bounded, input on an output that can't render must not pile up
+    std::deque<InputEvent>& pending = m_pendingInput[event.output];
+    if (pending.size() == InputRing::s_capacity)
+        pending.pop_front();
+    pending.push_back(event);
+}
+
+void Compositor::DropUnrenderedInput(size_t output)
+{
+    // Nothing on the output changed in response, so no frame reflects these events and
+    // waiting for the next unrelated one would only inflate the latency
+    std::deque<InputEvent>& pending = m_pendingInput[output];
+    uint64_t const frameCount = GetOutputFrameCount(*m_outputs[output]);
+    while (!pending.empty() && pending.back().frame >= frameCount)
+    {
+        pending.pop_back();
+        ++m_unrenderedInputCount;
+    }
+}
+
+void Compositor::OnFramePresented(size_t output, uint64_t frame, Clock::time_point time)
+{
+    std::deque<InputEvent>& pending = m_pendingInput[output];
+    while (!pending.empty() && pending.front().frame <= frame)
+    {
+        m_inputLatency.Add(time - pending.front().timestamp);
+        pending.pop_front();
+    }
+}
+
+uint64_t Compositor::GetFrameCount(size_t output) const
+{
+    return GetOutputFrameCount(*m_outputs[output]);
+}
+
+uint64_t Compositor::GetOutputFrameCount(Output const& output) const
+{
+    return IsHeadless() ? output.GetSoftwareRender()->GetSubmittedFrameCount() : output.GetRender().GetSubmittedFrameCount();
+}
+
+void Compositor::SetCompositionPath(CompositionPath path)
+{
+    if (IsHeadless())
+        return;
+
+    for (std::unique_ptr<Output>& pOutput : m_outputs)
+        pOutput->GetRender().compositionPath = path;
+}
+
+YcbcrSamplers const* Compositor::GetYcbcrSamplers() const
+{
+    return IsHeadless() || m_outputs.empty() ? nullptr : &m_outputs.front()->GetRender().GetYcbcrSamplers();
+}
+
+bool Compositor::StartCapture(FILE* pOutput)
+{
+    return !IsHeadless() && !m_outputs.empty() && m_outputs.front()->GetRender().StartCapture(pOutput);
+}
+
+void Compositor::StopCapture()
+{
+    if (IsHeadless() || m_outputs.empty())
+        return;
+
+    Render& render = m_outputs.front()->GetRender();
+    render.StopCapture();
+
+    FrameCapture const& capture = render.GetCapture();
+    std::cout << "Capture: " << capture.GetCapturedFrameCount() << " frames written, "
+        << capture.GetDroppedFrameCount() << " dropped" << std::endl;
+}
+
+bool Compositor::StartRecording(FILE* pOutput, bool storeContents)
+{
+    std::vector<vk::Extent2D> extents;
+    for (OutputConfig const& config : outputConfigs)
+        extents.push_back({ config.width, config.height });
+    return m_recorder.Start(pOutput, extents, storeContents);
+}
+
+void Compositor::StopRecording()
+{
+    if (!m_recorder.IsActive())
+        return;
+
+    m_recorder.Stop();
+    std::cout << "Recording: " << m_recorder.GetRecordCount() << " commits, "
+        << m_recorder.GetByteCount() << " bytes" << std::endl;
+}
+
+StartupTimings const& Compositor::GetStartupTimings() const
+{
+    return m_startupTimings;
+}
+
+bool Compositor::AcquireImage(Image& image, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage)
+{
+    if (IsHeadless())
+        return false;
+
+    YcbcrSamplers const& samplers = *GetYcbcrSamplers();
+    PlanarFormat const planar = GetPlanarFormat(format);
+    if (planar != PlanarFormat::eNone && !samplers.Supports(planar))
+        return false;
+
+    return m_pImagePool->Acquire(image, format, extent, usage, samplers.GetConversion(planar));
+}
+
+void Compositor::ReleaseImage(Image& image)
+{
+    if (!IsHeadless())
+        m_pImagePool->Release(image, m_frameIndex);
+}
+
+vk::DeviceSize Compositor::GetClientMemoryUsage(uint32_t client) const
+{
+    return IsHeadless() ? 0 : m_pResidency->GetClientUsage(client);
+}
+
+void Compositor::LogMemoryBudget() const
+{
+    for (uint32_t i = 0; i < device.memoryBudget.GetHeapCount(); ++i)
+    {
+        HeapBudget const heap = device.memoryBudget.GetHeapBudget(i);
+        std::cout << "Heap " << i << (heap.deviceLocal ? " (device local)" : "")
+            << ": allocated " << heap.allocated / (1024 * 1024) << " MiB"
+            << ", usage " << heap.usage / (1024 * 1024) << " MiB"
+            << ", budget " << heap.budget / (1024 * 1024) << " MiB" << std::endl;
+    }
+}
+
+size_t Compositor::GetOutputCount() const
+{
+    return m_outputs.size();
+}
+
+std::vector<Surface>& Compositor::GetSurfaces(size_t output)
+{
+    return m_outputs[output]->surfaces;
+}
+
+Surface& Compositor::GetCursor(size_t output)
+{
+    return m_outputs[output]->cursor;
+}
+
+uint32_t Compositor::HitTest(int32_t x, int32_t y, size_t output) const
+{
+    return m_outputs[output]->GetScene().HitTest(x, y);
+}
+
+Scene const& Compositor::GetScene(size_t output) const
+{
+    return m_outputs[output]->GetScene();
+}
+
+bool Compositor::IsHeadless() const
+{
+    return m_headless;
+}
+
+SoftwareRender const* Compositor::GetSoftwareRender(size_t output) const
+{
+    return m_outputs[output]->GetSoftwareRender();
+}
+
+FrameScheduler& Compositor::GetFrameScheduler()
+{
+    return m_scheduler;
+}
+
+QualityGovernor& Compositor::GetQualityGovernor()
+{
+    return m_qualityGovernor;
+}
+
+void Compositor::ApplyQuality()
+{
+    // Everything on screen was rendered at the old quality
+    QualitySettings const& settings = m_qualityGovernor.GetSettings();
+    for (std::unique_ptr<Output>& pOutput : m_outputs)
+    {
+        if (pOutput->IsHeadless())
+            continue;
+
+        pOutput->GetRender().quality = settings;
+        pOutput->Invalidate();
+    }
+}
+
+bool Compositor::PushInput(InputEvent const& event)
+{
+    return m_pInput->Push(event);
+}
+
+InputRing& Compositor::GetClientInput(uint32_t client)
+{
+    std::unique_ptr<InputRing>& pRing = m_clientInput[client];
+    if (!pRing)
+        pRing = std::make_unique<InputRing>();
+    return *pRing;
+}
+
+uint32_t Compositor::AttachSurface(uint32_t client, uint32_t output, vk::Rect2D const& rect)
+{
+    Surface surface;
+    surface.client = client;
+    surface.rect = rect;
+    if (IsHeadless())
+        surface.texture.extent = surface.texture.contentExtent = rect.extent;
+
+    std::vector<Surface>& surfaces = m_outputs[output]->surfaces;
+    surfaces.push_back(surface);
+    return static_cast<uint32_t>(surfaces.size() - 1);
+}
+
+CommitRing& Compositor::GetClientCommits(uint32_t client)
+{
+    std::unique_ptr<CommitRing>& pRing = m_clientCommits[client];
+    if (!pRing)
+        pRing = std::make_unique<CommitRing>();
+    return *pRing;
+}
+
+LatencyHistogram const& Compositor::GetCommitLatency(uint32_t client)
+{
+    return m_commitLatency[client];
+}
+
+void Compositor::LogCommitLatency() const
+{
+    for (auto const& latency : m_commitLatency)
+    {
+        std::string const name = "Client " + std::to_string(latency.first) + " commit to present latency";
+        latency.second.Log(std::cout, name.c_str());
+    }
+    std::cout << "Commits evicted before present: " << m_evictedCommitCount << std::endl;
+}
+
+uint64_t Compositor::GetEvictedCommitCount() const
+{
+    return m_evictedCommitCount;
+}
+
+LatencyHistogram const& Compositor::GetInputLatency() const
+{
+    return m_inputLatency;
+}
+
+void Compositor::LogInputLatency() const
+{
+    m_inputLatency.Log(std::cout, "Input to photon latency");
+    std::cout << "Input events dropped: " << m_pWindowInput->GetDroppedCount() + m_pInput->GetDroppedCount()
+        << ", without a frame: " << m_unrenderedInputCount << std::endl;
+}
+
+void Compositor::LogQuality() const
+{
+    QualitySettings const& settings = m_qualityGovernor.GetSettings();
+    std::cout << "Quality level " << m_qualityGovernor.GetLevel() << ": blur " << (settings.blur ? "on" : "off")
+        << " at 1/" << settings.blurDownscale << ", mip filtering " << (settings.mipFiltering ? "on" : "off")
+        << ", " << m_qualityGovernor.GetLevelChangeCount() << " level changes"
+        << ", " << m_qualityGovernor.GetOverBudgetFrameCount() << " frames over budget" << std::endl;
+}
+
+void Compositor::LogStartupTimings() const
+{
+    std::cout << "Startup: device " << m_startupTimings.device.count() << " ms"
+        << ", window " << m_startupTimings.window.count() << " ms"
+        << ", shaders " << m_startupTimings.shaders.count() << " ms"
+        << ", pipelines " << m_startupTimings.pipelines.count() << " ms"
+        << ", render resources " << m_startupTimings.renderResources.count() << " ms"
+        << ", init " << m_startupTimings.init.count() << " ms"
+        << ", first frame " << m_startupTimings.firstFrame.count() << " ms" << std::endl;
 }
 
 } // vkc namespace
\ No newline at end of file
@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <CullTable.hpp>
+#include <Ycbcr.hpp>
+#include <algorithm>
+#include <tuple>
+
+namespace vkc
+{
+
+namespace
+{
+
+bool IsBefore(CullTable::Entry const& entry, uint32_t instance)
+{
+    return entry.instance < instance;
+}
+
+} // anonymous namespace
+
+bool CullTable::Texture::operator<(Texture const& other) const
+{
+    return std::tie(sampler, view) < std::tie(other.sampler, other.view);
+}
+
+void CullTable::Reset(uint32_t textureCount)
+{
+    m_surfaces.clear();
+    m_entries.clear();
+    m_runs.clear();
+    m_minified.clear();
+    m_slots.assign(textureCount, Slot());
+    m_slotIndices.clear();
+    m_changedEntries.clear();
+    m_changedSlots.clear();
+    m_unsupportedCount = 0;
+    m_missingSlotCount = 0;
+    m_layoutChanged = true;
+
+    // Handed out lowest first
+    m_freeSlots.resize(textureCount);
+    for (uint32_t i = 0; i < textureCount; ++i)
+        m_freeSlots[i] = textureCount - 1 - i;
+}
+
+bool CullTable::Update(std::vector<Surface> const& surfaces, Scene const& scene, vk::Sampler sampler, float mipScaleThreshold)
+{
+    // Surfaces short of a slot are only retried once something changed
+    bool const changesKnown = scene.GetChanges(m_sceneVersion, m_changes);
+    if (!changesKnown || surfaces.size() != m_surfaces.size() || sampler != m_sampler
+        || mipScaleThreshold != m_mipScaleThreshold || (m_missingSlotCount > 0 && !m_changes.empty()))
+    {
+        m_sampler = sampler;
+        m_mipScaleThreshold = mipScaleThreshold;
+        Rebuild(surfaces, scene);
+    }
+    else
+    {
+        for (uint32_t index : m_changes)
+            UpdateSurface(surfaces, scene, index);
+    }
+    m_sceneVersion = scene.GetVersion();
+
+    if (m_layoutChanged)
+        BuildRuns();
+
+    return m_unsupportedCount == 0 && m_missingSlotCount == 0;
+}
+
+void CullTable::SetTexture(uint32_t surface, Texture const& texture)
+{
+    SurfaceState const& state = m_surfaces[surface];
+    if (state.drawn && !(state.texture == texture))
+        ReplaceTexture(surface, texture);
+}
+
+std::vector<CullTable::Entry> const& CullTable::GetEntries() const
+{
+    return m_entries;
+}
+
+std::vector<CullTable::Run> const& CullTable::GetRuns() const
+{
+    return m_runs;
+}
+
+CullTable::Texture const& CullTable::GetTexture(uint32_t slot) const
+{
+    return m_slots[slot].texture;
+}
+
+std::vector<uint32_t> const& CullTable::GetMinifiedSurfaces() const
+{
+    return m_minified;
+}
+
+uint32_t CullTable::GetTextureCount() const
+{
+    return static_cast<uint32_t>(m_slots.size());
+}
+
+bool CullTable::TakeChanges(std::vector<uint32_t>& entries, std::vector<uint32_t>& slots)
+{
+    entries.swap(m_changedEntries);
+    slots.swap(m_changedSlots);
+    m_changedEntries.clear();
+    m_changedSlots.clear();
+
+    // Entries move when others are added or removed, so their positions only hold without
+    bool const layoutChanged = m_layoutChanged;
+    if (layoutChanged)
+        entries.clear();
+    m_layoutChanged = false;
+    return layoutChanged;
+}
+
+void CullTable::Rebuild(std::vector<Surface> const& surfaces, Scene const& scene)
+{
+    // Released first, so surfaces keeping their texture mostly get their slot back
+    for (SurfaceState const& state : m_surfaces)
+        ReleaseSlot(state.slot);
+
+    m_surfaces.assign(surfaces.size(), SurfaceState());
+    m_entries.clear();
+    m_minified.clear();
+    m_unsupportedCount = 0;
+    m_missingSlotCount = 0;
+    for (uint32_t i = 0; i < surfaces.size(); ++i)
+        UpdateSurface(surfaces, scene, i);
+    m_layoutChanged = true;
+}
+
+void CullTable::UpdateSurface(std::vector<Surface> const& surfaces, Scene const& scene, uint32_t index)
+{
+    Surface const& surface = surfaces[index];
+    SurfaceState& state = m_surfaces[index];
+
+    // Blurred backdrops are interleaved with the surfaces and multi-planar textures need
+    // their immutable conversion samplers, both stay on the raster path
+    bool const unsupported = surface.visible && surface.texture.view
+        && (surface.blurBehind || GetPlanarFormat(surface.texture.format) != PlanarFormat::eNone);
+    m_unsupportedCount = m_unsupportedCount + unsupported - state.unsupported;
+    state.unsupported = unsupported;
+
+    PipelineKey key = PipelineKey::FromSurface(surface);
+    key.textureArray = true;
+    bool const drawn = !scene.IsCulled(index) && surface.texture.view;
+    bool const minified = drawn && m_mipScaleThreshold > 0.0f && surface.GetScale() < m_mipScaleThreshold;
+
+    if (minified != state.minified)
+    {
+        auto const position = std::lower_bound(m_minified.begin(), m_minified.end(), index);
+        if (minified)
+            m_minified.insert(position, index);
+        else
+            m_minified.erase(position);
+        state.minified = minified;
+    }
+
+    if (!(key == state.key))
+    {
+        state.key = key;
+        m_layoutChanged = m_layoutChanged || drawn;
+    }
+
+    // Minified surfaces keep their mip chain until the owner sets their texture again
+    Texture const texture = { m_sampler, surface.texture.view };
+    if (drawn != state.drawn)
+    {
+        auto const position = std::lower_bound(m_entries.begin(), m_entries.end(), index, IsBefore);
+        if (drawn)
+        {
+            state.texture = texture;
+            state.slot = AcquireSlot(texture);
+            m_missingSlotCount += state.slot == s_none;
+            m_entries.insert(position, { index, state.slot });
+        }
+        else
+        {
+            m_missingSlotCount -= state.slot == s_none;
+            ReleaseSlot(state.slot);
+            state.slot = s_none;
+            state.texture = Texture();
+            m_entries.erase(position);
+        }
+        state.drawn = drawn;
+        m_layoutChanged = true;
+    }
+    else if (drawn && !minified && !(state.texture == texture))
+    {
+        ReplaceTexture(index, texture);
+    }
+}
+
+void CullTable::ReplaceTexture(uint32_t surface, Texture const& texture)
+{
+    SurfaceState& state = m_surfaces[surface];
+    m_missingSlotCount -= state.slot == s_none;
+    ReleaseSlot(state.slot);
+    state.texture = texture;
+    state.slot = AcquireSlot(texture);
+    m_missingSlotCount += state.slot == s_none;
+
+    auto const position = std::lower_bound(m_entries.begin(), m_entries.end(), surface, IsBefore);
+    position->textureIndex = state.slot;
+    m_changedEntries.push_back(static_cast<uint32_t>(position - m_entries.begin()));
+}
+
+uint32_t CullTable::AcquireSlot(Texture const& texture)
+{
+    auto const found = m_slotIndices.find(texture);
+    if (found != m_slotIndices.end())
+    {
+        ++m_slots[found->second].userCount;
+        return found->second;
+    }
+
+    if (m_freeSlots.empty())
+        return s_none;
+
+    uint32_t const slot = m_freeSlots.back();
+    m_freeSlots.pop_back();
+    m_slots[slot].texture = texture;
+    m_slots[slot].userCount = 1;
+    m_slotIndices.emplace(texture, slot);
+    m_changedSlots.push_back(slot);
+    return slot;
+}
+
+void CullTable::ReleaseSlot(uint32_t slot)
+{
+    if (slot == s_none || --m_slots[slot].userCount > 0)
+        return;
+
+    // Freed slots are written again, their texture may be destroyed while the array is bound
+    m_slotIndices.erase(m_slots[slot].texture);
+    m_slots[slot].texture = Texture();
+    m_freeSlots.push_back(slot);
+    m_changedSlots.push_back(slot);
+}
+
+void CullTable::BuildRuns()
+{
+    // Runs split wherever the pipeline changes so that draw order is kept across runs
+    m_runs.clear();
+    for (uint32_t i = 0; i < m_entries.size(); ++i)
+    {
+        PipelineKey const& key = m_surfaces[m_entries[i].instance].key;
+        if (m_runs.empty() || !(m_runs.back().key == key))
+            m_runs.push_back({ key, i, 0 });
+        ++m_runs.back().count;
+    }
+}
+
+} // vkc namespace
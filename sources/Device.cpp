@@ -4,6 +4,7 @@
  * (http://opensource.org/licenses/MIT)
  */
 #include <Device.hpp>
+#include <Trace.hpp>
 #include <GLFW/glfw3.h>
 #include <iostream>
 
@@ -15,8 +16,8 @@ Device::Device(const char * appName, uint32_t appVersion, const char * engineNam
     , applicationVersion(appVersion)
     , engineName(engineName)
     , engineVersion(engineVersion)
-    , gpuTypes(gpuTypes)
 {
+    config.gpuTypes = gpuTypes;
 }
 
 Device::~Device() { Shutdown(); }
@@ -44,14 +45,56 @@ bool Device::CreateInstance()
         return false;
     }
 
+    // Layers and optional extensions are enabled only if the loader reports them
+    std::vector<vk::LayerProperties> layerProperties;
+    std::tie(status, layerProperties) = vk::enumerateInstanceLayerProperties();
+    enabledLayers.clear();
+    for (std::string const& layer : config.validationLayers)
+    {
+        auto const found = std::find_if(layerProperties.begin(), layerProperties.end(),
+            [&layer](vk::LayerProperties const& properties) { return std::string(properties.layerName) == layer; });
+        if (found != layerProperties.end())
+        {
+            enabledLayers.push_back(layer);
+            break;
+        }
+    }
+
+    std::vector<vk::ExtensionProperties> extensionProperties;
+    std::tie(status, extensionProperties) = vk::enumerateInstanceExtensionProperties();
+    auto const isAvailable = [&extensionProperties](std::string const& name) {
+        return std::any_of(extensionProperties.begin(), extensionProperties.end(),
+            [&name](vk::ExtensionProperties const& properties) { return std::string(properties.extensionName) == name; });
+    };
+
     uint32_t glfwExtCount = 0;
     const char** glfwExts = glfwGetRequiredInstanceExtensions(&glfwExtCount);
-    std::vector<char const*> enabledInstanceExtensions(glfwExts, glfwExts + glfwExtCount);
-    enabledInstanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
-    std::vector<char const*> enabledInstanceLayers{ "VK_LAYER_LUNARG_standard_validation" };
+    enabledInstanceExtensions.assign(glfwExts, glfwExts + glfwExtCount);
+    for (std::string const& extension : enabledInstanceExtensions)
+    {
+        if (!isAvailable(extension))
+        {
+            std::cerr << "Required instance extension " << extension << " is not available." << std::endl;
+            return false;
+        }
+    }
+    for (std::string const& extension : config.optionalInstanceExtensions)
+    {
+        if (isAvailable(extension))
+            enabledInstanceExtensions.push_back(extension);
+    }
+    debugUtils = std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(),
+        VK_EXT_DEBUG_UTILS_EXTENSION_NAME) != enabledInstanceExtensions.end();
+
+    std::vector<char const*> enabledInstanceLayerNames;
+    for (std::string const& layer : enabledLayers)
+        enabledInstanceLayerNames.push_back(layer.c_str());
+    std::vector<char const*> enabledInstanceExtensionNames;
+    for (std::string const& extension : enabledInstanceExtensions)
+        enabledInstanceExtensionNames.push_back(extension.c_str());
 
     vk::ApplicationInfo appInfo;
-    appInfo.setApiVersion(VK_API_VERSION_1_1);
+    appInfo.setApiVersion(VK_API_VERSION_1_2);
     appInfo.setApplicationVersion(applicationVersion);
     appInfo.setPApplicationName(applicationName.c_str());
     appInfo.setPEngineName(engineName.c_str());
@@ -59,11 +102,10 @@ bool Device::CreateInstance()
 
     vk::InstanceCreateInfo instanceCreateInfo;
     instanceCreateInfo.setPApplicationInfo(&appInfo);
-    instanceCreateInfo.setEnabledLayerCount(1);
-    instanceCreateInfo.setEnabledLayerCount(static_cast<uint32_t>(enabledInstanceLayers.size()));
-    instanceCreateInfo.setPpEnabledLayerNames(enabledInstanceLayers.data());
-    instanceCreateInfo.setEnabledExtensionCount(static_cast<uint32_t>(enabledInstanceExtensions.size()));
-    instanceCreateInfo.setPpEnabledExtensionNames(enabledInstanceExtensions.data());
+    instanceCreateInfo.setEnabledLayerCount(static_cast<uint32_t>(enabledInstanceLayerNames.size()));
+    instanceCreateInfo.setPpEnabledLayerNames(enabledInstanceLayerNames.data());
+    instanceCreateInfo.setEnabledExtensionCount(static_cast<uint32_t>(enabledInstanceExtensionNames.size()));
+    instanceCreateInfo.setPpEnabledExtensionNames(enabledInstanceExtensionNames.data());
 
     std::tie(status, instance) = vk::createInstance(instanceCreateInfo);
     if (status != vk::Result::eSuccess)
@@ -85,50 +127,175 @@ bool Device::FindPhysicalDevice()
         return false;
     }
 
-    for (auto gpu : gpuTypes)
+    candidates.clear();
+    int64_t bestScore = -1;
+    size_t best = 0;
+    for (vk::PhysicalDevice const& physicalDevice : physicalDevices)
     {
-        auto physicalDevice = std::find_if(physicalDevices.begin(), physicalDevices.end(),
-            [gpu](vk::PhysicalDevice& device) {
-            return (device.getProperties().deviceType == gpu);
-        });
+        uint32_t graphicsFamily = 0;
+        PhysicalDeviceTraits const traits = GetTraits(physicalDevice, graphicsFamily);
 
-        if (physicalDevice != physicalDevices.end())
+        DeviceCandidate candidate;
+        candidate.name = std::string(physicalDevice.getProperties().deviceName);
+        candidate.type = traits.type;
+        candidate.score = config.Score(traits, candidate.reason);
+        if (candidate.score > bestScore)
         {
-            auto const queueFamilyProperties = physicalDevice->getQueueFamilyProperties();
-
-            for (uint32_t i = 0; i < queueFamilyProperties.size(); ++i)
-            {
-                if ((queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics)
-                    && glfwGetPhysicalDevicePresentationSupport(instance, *physicalDevice, i))
-                {
-                    physical = *physicalDevice;
-                    queue.familyIndex = i;
-                    return true;
-                }
-            }
+            bestScore = candidate.score;
+            best = candidates.size();
+            physical = physicalDevice;
+            queue.familyIndex = graphicsFamily;
+        }
+        candidates.push_back(candidate);
+    }
+
+    if (bestScore < 0)
+    {
+        status = vk::Result::eErrorInitializationFailed;
+        std::cerr << "Failed to find a gpu that can present." << std::endl;
+        return false;
+    }
+    candidates[best].selected = true;
 
+    auto const queueFamilyProperties = physical.getQueueFamilyProperties();
+    if (queueFamilyProperties[queue.familyIndex].timestampValidBits != 0)
+        timestampPeriod = physical.getProperties().limits.timestampPeriod;
+    FindComputeQueueFamily(queueFamilyProperties);
+    return true;
+}
+
+PhysicalDeviceTraits Device::GetTraits(vk::PhysicalDevice physicalDevice, uint32_t& graphicsFamily) const
+{
+    PhysicalDeviceTraits traits;
+    vk::PhysicalDeviceProperties const properties = physicalDevice.getProperties();
+    traits.type = properties.deviceType;
+    traits.apiVersion = properties.apiVersion;
+
+    vk::PhysicalDeviceMemoryProperties const memoryProperties = physicalDevice.getMemoryProperties();
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+    {
+        if (memoryProperties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+            traits.deviceLocalHeapSize = std::max(traits.deviceLocalHeapSize, memoryProperties.memoryHeaps[i].size);
+    }
+
+    auto const queueFamilyProperties = physicalDevice.getQueueFamilyProperties();
+    for (uint32_t i = 0; i < queueFamilyProperties.size(); ++i)
+    {
+        vk::QueueFlags const flags = queueFamilyProperties[i].queueFlags;
+        if (!traits.graphicsPresentQueue && (flags & vk::QueueFlagBits::eGraphics)
+            && glfwGetPhysicalDevicePresentationSupport(instance, physicalDevice, i))
+        {
+            traits.graphicsPresentQueue = true;
+            traits.timestamps = queueFamilyProperties[i].timestampValidBits != 0;
+            graphicsFamily = i;
         }
+        if ((flags & vk::QueueFlagBits::eCompute) && !(flags & vk::QueueFlagBits::eGraphics))
+            traits.dedicatedComputeQueue = true;
     }
 
-    status = vk::Result::eErrorInitializationFailed;
-    std::cerr << "Failed to find discrete gpu." << std::endl;
-    return false;
+    std::vector<vk::ExtensionProperties> extensionProperties;
+    vk::Result result;
+    std::tie(result, extensionProperties) = physicalDevice.enumerateDeviceExtensionProperties();
+    traits.swapchain = std::any_of(extensionProperties.begin(), extensionProperties.end(),
+        [](vk::ExtensionProperties const& extension) { return std::string(extension.extensionName) == VK_KHR_SWAPCHAIN_EXTENSION_NAME; });
+
+    return traits;
+}
+
+void Device::FindComputeQueueFamily(std::vector<vk::QueueFamilyProperties> const& queueFamilyProperties)
+{
+    // Only a dedicated compute family runs effect passes alongside the graphics queue
+    computeQueue.familyIndex = queue.familyIndex;
+    for (uint32_t i = 0; i < queueFamilyProperties.size(); ++i)
+    {
+        if ((queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eCompute)
+            && !(queueFamilyProperties[i].queueFlags & vk::QueueFlagBits::eGraphics))
+        {
+            computeQueue.familyIndex = i;
+            return;
+        }
+    }
 }
 
 bool Device::CreateLogicalDevice()
 {
-    vk::DeviceQueueCreateInfo deviceQueueCreateInfo;
     float const priority = 1.0f;
-    deviceQueueCreateInfo.setPQueuePriorities(&priority);
-    deviceQueueCreateInfo.setQueueCount(1);
-    deviceQueueCreateInfo.setQueueFamilyIndex(queue.familyIndex);
+    vk::DeviceQueueCreateInfo deviceQueueCreateInfos[2];
+    deviceQueueCreateInfos[0].setPQueuePriorities(&priority);
+    deviceQueueCreateInfos[0].setQueueCount(1);
+    deviceQueueCreateInfos[0].setQueueFamilyIndex(queue.familyIndex);
+    deviceQueueCreateInfos[1].setPQueuePriorities(&priority);
+    deviceQueueCreateInfos[1].setQueueCount(1);
+    deviceQueueCreateInfos[1].setQueueFamilyIndex(computeQueue.familyIndex);
+
+    vk::PhysicalDeviceFeatures const supportedFeatures = physical.getFeatures();
+    features.setShaderSampledImageArrayDynamicIndexing(supportedFeatures.shaderSampledImageArrayDynamicIndexing);
+    features.setMultiDrawIndirect(supportedFeatures.multiDrawIndirect);
+    features.setDrawIndirectFirstInstance(supportedFeatures.drawIndirectFirstInstance);
+
+    uint32_t const apiVersion = physical.getProperties().apiVersion;
+    vk::PhysicalDeviceSamplerYcbcrConversionFeatures ycbcrFeatures;
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineFeatures;
+    if (apiVersion >= VK_API_VERSION_1_1)
+    {
+        ycbcrFeatures.setPNext(apiVersion >= VK_API_VERSION_1_2 ? &timelineFeatures : nullptr);
+        vk::PhysicalDeviceFeatures2 supportedFeatures2;
+        supportedFeatures2.setPNext(&ycbcrFeatures);
+        physical.getFeatures2(&supportedFeatures2);
+    }
+    samplerYcbcrConversion = ycbcrFeatures.samplerYcbcrConversion == VK_TRUE;
+    timelineSemaphore = timelineFeatures.timelineSemaphore == VK_TRUE;
+    asyncCompute = timelineSemaphore && computeQueue.familyIndex != queue.familyIndex;
+
+    // Enabled feature structs are chained in the same order they were queried in
+    void* pEnabledFeatures = nullptr;
+    timelineFeatures.setPNext(nullptr);
+    ycbcrFeatures.setPNext(nullptr);
+    if (timelineSemaphore)
+    {
+        timelineFeatures.setPNext(pEnabledFeatures);
+        pEnabledFeatures = &timelineFeatures;
+    }
+    if (samplerYcbcrConversion)
+    {
+        ycbcrFeatures.setPNext(pEnabledFeatures);
+        pEnabledFeatures = &ycbcrFeatures;
+    }
+
+    std::vector<char const*> deviceExtensionNames{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    std::vector<vk::ExtensionProperties> extensionProperties;
+    std::tie(status, extensionProperties) = physical.enumerateDeviceExtensionProperties();
+    for (vk::ExtensionProperties const& extension : extensionProperties)
+    {
+        if (std::string(extension.extensionName) == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+        {
+            memoryBudgetExtension = true;
+            deviceExtensionNames.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+        else if (std::string(extension.extensionName) == VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME)
+        {
+            displayTiming = true;
+            deviceExtensionNames.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+        }
+        else if (std::string(extension.extensionName) == VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)
+        {
+            calibratedTimestamps = true;
+            deviceExtensionNames.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        }
+        else if (std::string(extension.extensionName) == VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+        {
+            drawIndirectCount = true;
+            deviceExtensionNames.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+        }
+    }
 
-    char const* deviceExtensionNames = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
     vk::DeviceCreateInfo deviceCreateInfo;
-    deviceCreateInfo.setQueueCreateInfoCount(1);
-    deviceCreateInfo.setPQueueCreateInfos(&deviceQueueCreateInfo);
-    deviceCreateInfo.setEnabledExtensionCount(1);
-    deviceCreateInfo.setPpEnabledExtensionNames(&deviceExtensionNames);
+    deviceCreateInfo.setQueueCreateInfoCount(asyncCompute ? 2 : 1);
+    deviceCreateInfo.setPQueueCreateInfos(deviceQueueCreateInfos);
+    deviceCreateInfo.setEnabledExtensionCount(static_cast<uint32_t>(deviceExtensionNames.size()));
+    deviceCreateInfo.setPpEnabledExtensionNames(deviceExtensionNames.data());
+    deviceCreateInfo.setPEnabledFeatures(&features);
+    deviceCreateInfo.setPNext(pEnabledFeatures);
 
     std::tie(status, logical) = physical.createDevice(deviceCreateInfo);
     if (status != vk::Result::eSuccess)
@@ -138,7 +305,73 @@ bool Device::CreateLogicalDevice()
     }
 
     queue.queue = logical.getQueue(queue.familyIndex, 0);
+    if (!asyncCompute)
+        computeQueue.familyIndex = queue.familyIndex;
+    computeQueue.queue = logical.getQueue(computeQueue.familyIndex, 0);
+    memoryBudget.Init(physical, memoryBudgetExtension);
+
+    // Extension entry points are not exported by the loader, so they are looked up
+    dispatch = vk::DispatchLoaderDynamic(instance, vkGetInstanceProcAddr, logical);
+    enabledDeviceExtensions.assign(deviceExtensionNames.begin(), deviceExtensionNames.end());
+    calibratedTimestamps = calibratedTimestamps && timestampPeriod != 0.0f && IsHostTimeDomainCalibrateable();
     return true;
 }
 
+void Device::LogConfiguration(std::ostream& out) const
+{
+    out << "Device profile " << config.GetProfileName() << ", layers:";
+    if (enabledLayers.empty())
+        out << " none";
+    for (std::string const& layer : enabledLayers)
+        out << " " << layer;
+    out << std::endl;
+
+    for (std::string const& layer : config.validationLayers)
+    {
+        if (std::find(enabledLayers.begin(), enabledLayers.end(), layer) == enabledLayers.end())
+            out << "  " << layer << " not enabled" << std::endl;
+    }
+    for (std::string const& extension : config.optionalInstanceExtensions)
+    {
+        if (std::find(enabledInstanceExtensions.begin(), enabledInstanceExtensions.end(), extension) == enabledInstanceExtensions.end())
+            out << "  " << extension << " unavailable" << std::endl;
+    }
+
+    out << "Instance extensions:";
+    for (std::string const& extension : enabledInstanceExtensions)
+        out << " " << extension;
+    out << std::endl;
+
+    for (DeviceCandidate const& candidate : candidates)
+    {
+        out << (candidate.selected ? "* " : "  ") << candidate.name << ": ";
+        if (candidate.score < 0)
+            out << "rejected, " << candidate.reason << std::endl;
+        else
+            out << "score " << candidate.score << ", " << candidate.reason << std::endl;
+    }
+
+    if (logical)
+    {
+        out << "Device extensions:";
+        for (std::string const& extension : enabledDeviceExtensions)
+            out << " " << extension;
+        out << std::endl;
+    }
+}
+
+bool Device::IsHostTimeDomainCalibrateable() const
+{
+    uint32_t count = 0;
+    if (physical.getCalibrateableTimeDomainsEXT(&count, nullptr, dispatch) != vk::Result::eSuccess)
+        return false;
+
+    std::vector<vk::TimeDomainEXT> timeDomains(count);
+    if (physical.getCalibrateableTimeDomainsEXT(&count, timeDomains.data(), dispatch) != vk::Result::eSuccess)
+        return false;
+
+    return std::find(timeDomains.begin(), timeDomains.end(), Tracer::GetHostTimeDomain()) != timeDomains.end()
+        && std::find(timeDomains.begin(), timeDomains.end(), vk::TimeDomainEXT::eDevice) != timeDomains.end();
+}
+
 } // vkc namespace
\ No newline at end of file
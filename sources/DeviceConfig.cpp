@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <DeviceConfig.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace vkc
+{
+
+DeviceConfig DeviceConfig::Debug()
+{
+    DeviceConfig config;
+    config.profile = Profile::eDebug;
+    config.validationLayers = { "VK_LAYER_KHRONOS_validation", "VK_LAYER_LUNARG_standard_validation" };
+    config.optionalInstanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
+    return config;
+}
+
+DeviceConfig DeviceConfig::Release()
+{
+    return DeviceConfig();
+}
+
+DeviceConfig DeviceConfig::Default()
+{
+    char const* const pValidation = std::getenv("VKC_VALIDATION");
+    if (pValidation && std::strcmp(pValidation, "0") == 0)
+        return Release();
+    if (pValidation && std::strcmp(pValidation, "1") == 0)
+        return Debug();
+
+#ifdef NDEBUG
+    return Release();
+#else
+    return Debug();
+#endif
+}
+
+int64_t DeviceConfig::Score(PhysicalDeviceTraits const& traits, std::string& reason) const
+{
+    auto const type = std::find(gpuTypes.begin(), gpuTypes.end(), traits.type);
+    if (type == gpuTypes.end())
+    {
+        reason = "device type not allowed";
+        return -1;
+    }
+    if (!traits.graphicsPresentQueue)
+    {
+        reason = "no graphics queue with presentation support";
+        return -1;
+    }
+    if (!traits.swapchain)
+    {
+        reason = "no " VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+        return -1;
+    }
+
+    // Heap sizes in MiB stay well below the weight of one API version, and the versions
+    // the instance can use below the weight of one step in type preference. Versions past
+    // the requested one add nothing, while older ones lose timeline semaphores, async
+    // compute and indirect count draws
+    int64_t const typeWeight = int64_t(1) << 32;
+    int64_t const versionWeight = int64_t(1) << 28;
+    uint32_t const apiVersion = std::min<uint32_t>(traits.apiVersion, VK_API_VERSION_1_2);
+    int64_t score = static_cast<int64_t>(gpuTypes.end() - type) * typeWeight;
+    score += static_cast<int64_t>(VK_VERSION_MINOR(apiVersion)) * versionWeight;
+    score += static_cast<int64_t>(traits.deviceLocalHeapSize >> 20) * 4;
+    reason = vk::to_string(traits.type) + ", Vulkan " + std::to_string(VK_VERSION_MAJOR(traits.apiVersion)) + "."
+        + std::to_string(VK_VERSION_MINOR(traits.apiVersion)) + ", " + std::to_string(traits.deviceLocalHeapSize >> 20) + " MiB device local";
+    if (traits.dedicatedComputeQueue)
+    {
+        score += 2;
+        reason += ", dedicated compute queue";
+    }
+    if (traits.timestamps)
+    {
+        score += 1;
+        reason += ", timestamps";
+    }
+
+    return score;
+}
+
+char const* DeviceConfig::GetProfileName() const
+{
+    return profile == Profile::eDebug ? "debug" : "release";
+}
+
+} // vkc namespace
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <FrameAllocator.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace vkc
+{
+
+FrameAllocator::FrameAllocator(Device& device)
+    : m_device(device)
+{
+}
+
+FrameAllocator::~FrameAllocator()
+{
+    Shutdown();
+}
+
+bool FrameAllocator::Init(std::vector<vk::DescriptorPoolSize> const& poolSizes, uint32_t maxSets,
+    vk::DeviceSize uniformRange, uint32_t uniformCount, vk::ShaderStageFlags uniformStages)
+{
+    vk::DeviceSize const alignment = std::max<vk::DeviceSize>(
+        m_device.physical.getProperties().limits.minUniformBufferOffsetAlignment, 1);
+    m_uniformRange = uniformRange;
+    m_uniformStride = (uniformRange + alignment - 1) / alignment * alignment;
+    m_sliceSize = m_uniformStride * uniformCount;
+    if (!m_uniformRing.Allocate(m_device, static_cast<size_t>(m_sliceSize * s_frameCount), vk::BufferUsageFlagBits::eUniformBuffer))
+    {
+        std::cerr << "Failed to allocate uniform ring." << std::endl;
+        return false;
+    }
+
+    m_poolSizes = poolSizes;
+    m_maxSets = maxSets;
+    for (uint32_t i = 0; i < s_frameCount; ++i)
+    {
+        if (!AddPool(m_slots[i]))
+            return false;
+        m_slots[i].uniformBegin = m_sliceSize * i;
+    }
+
+    vk::DescriptorSetLayoutBinding binding;
+    binding.setBinding(0);
+    binding.setDescriptorCount(1);
+    binding.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic);
+    binding.setStageFlags(uniformStages);
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setBindingCount(1);
+    layoutCreateInfo.setPBindings(&binding);
+    std::tie(status, m_uniformSetLayout) = m_device.logical.createDescriptorSetLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create uniform descriptor set layout." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorPoolSize const uniformPoolSize(vk::DescriptorType::eUniformBufferDynamic, 1);
+    vk::DescriptorPoolCreateInfo uniformPoolCreateInfo;
+    uniformPoolCreateInfo.setMaxSets(1);
+    uniformPoolCreateInfo.setPoolSizeCount(1);
+    uniformPoolCreateInfo.setPPoolSizes(&uniformPoolSize);
+    std::tie(status, m_uniformPool) = m_device.logical.createDescriptorPool(uniformPoolCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create uniform descriptor pool." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorPool(m_uniformPool);
+    allocateInfo.setDescriptorSetCount(1);
+    allocateInfo.setPSetLayouts(&m_uniformSetLayout);
+    status = m_device.logical.allocateDescriptorSets(&allocateInfo, &m_uniformSet);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate uniform descriptor set." << std::endl;
+        return false;
+    }
+
+    // Written once, every draw selects its block with a dynamic offset
+    vk::DescriptorBufferInfo bufferInfo(m_uniformRing.buffer, 0, m_uniformRange);
+    vk::WriteDescriptorSet write;
+    write.setDstSet(m_uniformSet);
+    write.setDstBinding(0);
+    write.setDescriptorCount(1);
+    write.setDescriptorType(vk::DescriptorType::eUniformBufferDynamic);
+    write.setPBufferInfo(&bufferInfo);
+    m_device.logical.updateDescriptorSets(1, &write, 0, nullptr);
+
+    return true;
+}
+
+void FrameAllocator::Shutdown()
+{
+    for (Slot& slot : m_slots)
+    {
+        for (vk::DescriptorPool pool : slot.pools)
+            m_device.logical.destroyDescriptorPool(pool);
+        slot = Slot();
+    }
+    m_pSlot = nullptr;
+
+    if (m_uniformPool)
+        m_device.logical.destroyDescriptorPool(m_uniformPool);
+    m_uniformPool = vk::DescriptorPool();
+    m_uniformSet = vk::DescriptorSet();
+    if (m_uniformSetLayout)
+        m_device.logical.destroyDescriptorSetLayout(m_uniformSetLayout);
+    m_uniformSetLayout = vk::DescriptorSetLayout();
+    m_uniformRing.Destroy(m_device);
+}
+
+bool FrameAllocator::BeginFrame(uint64_t frame)
+{
+    Slot& slot = m_slots[frame % s_frameCount];
+    if (slot.inFlight && slot.frame != frame)
+    {
+        std::cerr << "Frame descriptor pool is still in flight." << std::endl;
+        return false;
+    }
+
+    // The same frame again means its previous recording was never submitted
+    if (slot.inFlight)
+        ResetSlot(slot);
+
+    slot.frame = frame;
+    slot.uniformHead = 0;
+    slot.inFlight = true;
+    m_pSlot = &slot;
+    return true;
+}
+
+void FrameAllocator::Retire(uint64_t completedFrameCount)
+{
+    for (Slot& slot : m_slots)
+    {
+        if (slot.inFlight && slot.frame < completedFrameCount)
+        {
+            ResetSlot(slot);
+            slot.uniformHead = 0;
+            slot.inFlight = false;
+        }
+    }
+}
+
+vk::DescriptorSet FrameAllocator::AllocateSet(vk::DescriptorSetLayout layout)
+{
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorSetCount(1);
+    allocateInfo.setPSetLayouts(&layout);
+
+    // Full pools move on to the next one, which is only created the first time it's needed
+    for (;;)
+    {
+        allocateInfo.setDescriptorPool(m_pSlot->pools[m_pSlot->poolIndex]);
+        vk::DescriptorSet descriptorSet;
+        vk::Result const result = m_device.logical.allocateDescriptorSets(&allocateInfo, &descriptorSet);
+        if (result == vk::Result::eSuccess)
+            return descriptorSet;
+        if (result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool)
+            return vk::DescriptorSet();
+
+        if (m_pSlot->poolIndex + 1 == m_pSlot->pools.size() && !AddPool(*m_pSlot))
+            return vk::DescriptorSet();
+        ++m_pSlot->poolIndex;
+    }
+}
+
+vk::DescriptorSet FrameAllocator::GetImageSet(vk::DescriptorSetLayout layout, vk::Sampler sampler, vk::ImageView view)
+{
+    ImageSetKey const key(layout, sampler, view);
+    auto const found = m_pSlot->imageSets.find(key);
+    if (found != m_pSlot->imageSets.end())
+        return found->second;
+
+    vk::DescriptorSet const descriptorSet = AllocateSet(layout);
+    if (!descriptorSet)
+        return vk::DescriptorSet();
+
+    vk::DescriptorImageInfo imageInfo(sampler, view, vk::ImageLayout::eShaderReadOnlyOptimal);
+    vk::WriteDescriptorSet write;
+    write.setDstSet(descriptorSet);
+    write.setDstBinding(0);
+    write.setDescriptorCount(1);
+    write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    write.setPImageInfo(&imageInfo);
+    m_device.logical.updateDescriptorSets(1, &write, 0, nullptr);
+
+    m_pSlot->imageSets.emplace(key, descriptorSet);
+    return descriptorSet;
+}
+
+bool FrameAllocator::PushUniforms(void const* pData, size_t size, uint32_t& offset)
+{
+    if (size > m_uniformRange || m_pSlot->uniformHead + m_uniformStride > m_sliceSize)
+        return false;
+
+    vk::DeviceSize const begin = m_pSlot->uniformBegin + m_pSlot->uniformHead;
+    std::memcpy(static_cast<uint8_t*>(m_uniformRing.mapped) + begin, pData, size);
+    m_pSlot->uniformHead += m_uniformStride;
+    offset = static_cast<uint32_t>(begin);
+    return true;
+}
+
+bool FrameAllocator::AddPool(Slot& slot)
+{
+    vk::DescriptorPoolCreateInfo createInfo;
+    createInfo.setMaxSets(m_maxSets);
+    createInfo.setPoolSizeCount(static_cast<uint32_t>(m_poolSizes.size()));
+    createInfo.setPPoolSizes(m_poolSizes.data());
+
+    vk::DescriptorPool pool;
+    std::tie(status, pool) = m_device.logical.createDescriptorPool(createInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create frame descriptor pool." << std::endl;
+        return false;
+    }
+
+    slot.pools.push_back(pool);
+    return true;
+}
+
+void FrameAllocator::ResetSlot(Slot& slot)
+{
+    // Chained pools are kept, a frame that needed them once likely needs them again
+    for (size_t i = 0; i <= slot.poolIndex; ++i)
+        m_device.logical.resetDescriptorPool(slot.pools[i]);
+    slot.poolIndex = 0;
+    slot.imageSets.clear();
+}
+
+vk::DescriptorSetLayout FrameAllocator::GetUniformSetLayout() const
+{
+    return m_uniformSetLayout;
+}
+
+vk::DescriptorSet FrameAllocator::GetUniformSet() const
+{
+    return m_uniformSet;
+}
+
+} // vkc namespace
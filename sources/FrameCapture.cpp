@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <FrameCapture.hpp>
+#include <iostream>
+#ifndef _WIN32
+#include <csignal>
+#include <pthread.h>
+#endif
+
+namespace vkc
+{
+
+FrameCapture::FrameCapture(Device & device, Window & window)
+    : m_device(device)
+    , m_window(window)
+    , m_frameSize(static_cast<size_t>(window.width) * window.height * 4)
+{
+}
+
+FrameCapture::~FrameCapture()
+{
+    Stop();
+}
+
+bool FrameCapture::Start(FILE* pOutput)
+{
+    if (IsActive())
+        return true;
+
+    if (!pOutput)
+    {
+        std::cerr << "Frame capture requires an output stream." << std::endl;
+        status = vk::Result::eErrorInitializationFailed;
+        return false;
+    }
+
+    if (!(m_window.swapchainUsage & vk::ImageUsageFlagBits::eTransferSrc))
+    {
+        std::cerr << "Swapchain images can not be copied, frame capture is unavailable." << std::endl;
+        status = vk::Result::eErrorFeatureNotPresent;
+        return false;
+    }
+
+    for (Slot& slot : m_slots)
+    {
+        // Read back by the CPU, which is much faster from cached memory
+        if (!slot.buffer.Allocate(m_device, m_frameSize, vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eHostCached))
+        {
+            std::cerr << "Failed to allocate frame capture buffer." << std::endl;
+            status = vk::Result::eErrorOutOfDeviceMemory;
+            for (Slot& allocated : m_slots)
+                allocated.buffer.Destroy(m_device);
+            return false;
+        }
+        slot.state = SlotState::eFree;
+    }
+
+    m_pOutput = pOutput;
+    m_nextSlot = 0;
+    m_stopWriter = false;
+    m_capturedFrames = 0;
+    m_droppedFrames = 0;
+    m_writer = std::thread(&FrameCapture::WriterLoop, this);
+
+    status = vk::Result::eSuccess;
+    return true;
+}
+
+void FrameCapture::Stop()
+{
+    if (!IsActive())
+        return;
+
+    // Frames still on the GPU are not waited for, the caller stops capture once the device is idle
+    Collect(UINT64_MAX);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopWriter = true;
+    }
+    m_condition.notify_one();
+    m_writer.join();
+
+    for (Slot& slot : m_slots)
+    {
+        slot.buffer.Destroy(m_device);
+        slot.state = SlotState::eFree;
+    }
+    m_pOutput = nullptr;
+}
+
+bool FrameCapture::IsActive() const
+{
+    return m_pOutput != nullptr;
+}
+
+void FrameCapture::Record(vk::CommandBuffer cmd, vk::Image image, uint64_t frame)
+{
+    ScopedTimer timer(recordTime);
+
+    Slot& slot = m_slots[m_nextSlot];
+    if (slot.state != SlotState::eFree)
+    {
+        ++m_droppedFrames;
+        return;
+    }
+
+    vk::ImageSubresourceRange const range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+    vk::ImageMemoryBarrier imageBarrier;
+    imageBarrier.setImage(image);
+    imageBarrier.setSubresourceRange(range);
+    imageBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    imageBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    imageBarrier.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eTransferWrite);
+    imageBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    imageBarrier.setOldLayout(vk::ImageLayout::ePresentSrcKHR);
+    imageBarrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+
+    vk::BufferImageCopy region;
+    region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1));
+    region.setImageExtent({ m_window.width, m_window.height, 1 });
+    cmd.copyImageToBuffer(image, vk::ImageLayout::eTransferSrcOptimal, slot.buffer.buffer, 1, &region);
+
+    imageBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+    imageBarrier.setDstAccessMask({});
+    imageBarrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    imageBarrier.setNewLayout(vk::ImageLayout::ePresentSrcKHR);
+
+    vk::BufferMemoryBarrier bufferBarrier;
+    bufferBarrier.setBuffer(slot.buffer.buffer);
+    bufferBarrier.setSize(VK_WHOLE_SIZE);
+    bufferBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    bufferBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    bufferBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    bufferBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eHost | vk::PipelineStageFlagBits::eBottomOfPipe,
+        {}, 0, nullptr, 1, &bufferBarrier, 1, &imageBarrier);
+
+    slot.frame = frame;
+    slot.state = SlotState::eRecorded;
+    m_recordedSlots.push_back(m_nextSlot);
+    m_nextSlot = (m_nextSlot + 1) % s_slotCount;
+}
+
+void FrameCapture::Collect(uint64_t completedFrame)
+{
+    ScopedTimer timer(collectTime);
+
+    // Slots are recorded in frame order, so completed ones are always at the front
+    bool handedOff = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_recordedSlots.empty() && m_slots[m_recordedSlots.front()].frame <= completedFrame)
+        {
+            m_slots[m_recordedSlots.front()].state = SlotState::eWriting;
+            m_writeQueue.push_back(m_recordedSlots.front());
+            m_recordedSlots.pop_front();
+            handedOff = true;
+        }
+    }
+
+    if (handedOff)
+        m_condition.notify_one();
+}
+
+uint64_t FrameCapture::GetCapturedFrameCount() const
+{
+    return m_capturedFrames;
+}
+
+uint64_t FrameCapture::GetDroppedFrameCount() const
+{
+    return m_droppedFrames;
+}
+
+void FrameCapture::WriterLoop()
+{
+#ifndef _WIN32
+    // Writes to a closed pipe raise SIGPIPE, which terminates the process by default. It is
+    // blocked for this thread only, so the write fails with EPIPE instead, and every write
+    // including the final flush happens on this thread
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+#endif
+
+    bool writeFailed = false;
+    for (;;)
+    {
+        uint32_t slotIndex = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopWriter || !m_writeQueue.empty(); });
+            if (m_writeQueue.empty())
+            {
+                if (!writeFailed)
+                    fflush(m_pOutput);
+                return;
+            }
+
+            slotIndex = m_writeQueue.front();
+            m_writeQueue.pop_front();
+        }
+
+        Slot& slot = m_slots[slotIndex];
+        if (!writeFailed && fwrite(slot.buffer.mapped, 1, m_frameSize, m_pOutput) != m_frameSize)
+        {
+            // A closed pipe should not take the compositor down, the remaining frames are discarded
+            std::cerr << "Failed to write captured frame." << std::endl;
+            writeFailed = true;
+        }
+
+        if (writeFailed)
+            ++m_droppedFrames;
+        else
+            ++m_capturedFrames;
+        slot.state = SlotState::eFree;
+    }
+}
+
+} // vkc namespace
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <FrameScheduler.hpp>
+#include <algorithm>
+#include <thread>
+
+namespace vkc
+{
+
+namespace
+{
+
+// Plain sleeps overshoot by up to a scheduler tick, the remainder is spun
+std::chrono::microseconds const s_spinThreshold(1000);
+
+} // anonymous namespace
+
+// Bound to a reference by std::min, so it needs a definition
+size_t const FrameScheduler::s_sampleCount;
+
+FrameScheduler::FrameScheduler(TimeSource now, SleepFunction sleepUntil)
+    : m_now(std::move(now))
+    , m_sleepUntil(std::move(sleepUntil))
+{
+    if (!m_sleepUntil)
+        m_sleepUntil = [this](Clock::time_point time) { PreciseSleepUntil(time); };
+}
+
+void FrameScheduler::SetRefreshPeriod(Clock::duration period)
+{
+    m_refreshPeriod = period;
+}
+
+void FrameScheduler::SetFrameRateLimit(double framesPerSecond)
+{
+    m_minFrameInterval = framesPerSecond > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond))
+        : Clock::duration(0);
+}
+
+void FrameScheduler::OnVblank(Clock::time_point time, bool exact)
+{
+    if (exact || !m_hasPhase || m_refreshPeriod.count() == 0)
+    {
+        m_vblankPhase = time;
+        m_hasPhase = true;
+        return;
+    }
+
+    // Residual against the closest predicted vblank, within half a period either way
+    Clock::time_point const predicted = NextVblank(time - m_refreshPeriod / 2);
+    Clock::duration const residual = time - predicted;
+    m_vblankPhase = predicted + std::chrono::duration_cast<Clock::duration>(residual * phaseGain);
+}
+
+void FrameScheduler::OnFrameDone(Clock::time_point start, Clock::time_point end)
+{
+    m_samples[m_nextSample] = end - start;
+    m_nextSample = (m_nextSample + 1) % s_sampleCount;
+    m_sampleCount = std::min(m_sampleCount + 1, s_sampleCount);
+
+    if (m_hasTarget && end > m_targetVblank)
+        ++m_missedDeadlines;
+}
+
+Clock::duration FrameScheduler::GetPredictedRenderTime() const
+{
+    // Nothing measured yet, so the first frame gets the whole period
+    if (m_sampleCount == 0)
+        return m_refreshPeriod;
+
+    std::array<Clock::duration, s_sampleCount> sorted = m_samples;
+    size_t const index = static_cast<size_t>(percentile * (m_sampleCount - 1) + 0.5f);
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.begin() + m_sampleCount);
+    return sorted[index] + safetyMargin;
+}
+
+Clock::time_point FrameScheduler::GetFrameStart() const
+{
+    Clock::time_point start;
+    Clock::time_point vblank;
+    Schedule(start, vblank);
+    return start;
+}
+
+Clock::time_point FrameScheduler::GetTargetVblank() const
+{
+    Clock::time_point start;
+    Clock::time_point vblank;
+    Schedule(start, vblank);
+    return vblank;
+}
+
+Clock::time_point FrameScheduler::WaitForFrameStart()
+{
+    Clock::time_point start;
+    Clock::time_point vblank;
+    Schedule(start, vblank);
+    if (start > m_now())
+        m_sleepUntil(start);
+
+    m_lastFrameStart = start;
+    m_targetVblank = vblank;
+    m_hasTarget = m_hasPhase && m_refreshPeriod.count() != 0;
+    m_started = true;
+    return start;
+}
+
+uint64_t FrameScheduler::GetMissedDeadlineCount() const
+{
+    return m_missedDeadlines;
+}
+
+Clock::time_point FrameScheduler::Now() const
+{
+    return m_now();
+}
+
+Clock::time_point FrameScheduler::NextVblank(Clock::time_point time) const
+{
+    if (!m_hasPhase || m_refreshPeriod.count() == 0)
+        return time;
+
+    Clock::rep const offset = (time - m_vblankPhase).count();
+    Clock::rep const period = m_refreshPeriod.count();
+    Clock::rep const cycles = offset >= 0 ? (offset + period - 1) / period : -(-offset / period);
+    return m_vblankPhase + m_refreshPeriod * cycles;
+}
+
+void FrameScheduler::Schedule(Clock::time_point& start, Clock::time_point& vblank) const
+{
+    Clock::time_point earliest = m_now();
+    if (m_started && m_minFrameInterval.count() != 0)
+        earliest = std::max(earliest, m_lastFrameStart + m_minFrameInterval);
+
+    if (!m_hasPhase || m_refreshPeriod.count() == 0)
+    {
+        start = vblank = earliest;
+        return;
+    }
+
+    // The first vblank that a frame started now can make, started as late as it allows
+    Clock::duration const renderTime = GetPredictedRenderTime();
+    vblank = NextVblank(earliest + renderTime);
+    start = vblank - renderTime;
+}
+
+void FrameScheduler::PreciseSleepUntil(Clock::time_point time) const
+{
+    Clock::duration const remaining = time - m_now();
+    if (remaining > s_spinThreshold)
+        std::this_thread::sleep_for(remaining - s_spinThreshold);
+
+    while (m_now() < time)
+        std::this_thread::yield();
+}
+
+} // vkc namespace
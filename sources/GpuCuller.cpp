@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <GpuCuller.hpp>
+#include <Ycbcr.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace vkc
+{
+
+GpuCuller::GpuCuller(Device & device)
+    : m_device(device)
+{
+}
+
+GpuCuller::~GpuCuller()
+{
+    Shutdown();
+}
+
+bool GpuCuller::Init(vk::DescriptorSetLayout frameSetLayout)
+{
+    if (!m_device.drawIndirectCount || !m_device.features.multiDrawIndirect
+        || !m_device.features.drawIndirectFirstInstance || !m_device.features.shaderSampledImageArrayDynamicIndexing)
+    {
+        std::cerr << "GPU culling requires indirect count draws, multi draw indirect with first instance "
+            "and sampled image array dynamic indexing." << std::endl;
+        status = vk::Result::eErrorFeatureNotPresent;
+        return false;
+    }
+
+    vk::PhysicalDeviceLimits const limits = m_device.physical.getProperties().limits;
+    m_textureCount = std::min({ s_maxTextureCount, limits.maxPerStageDescriptorSamplers,
+        limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+    m_table.Reset(m_textureCount);
+    m_imageInfos.resize(m_textureCount);
+
+    // Free array elements sample it, never drawn but always a valid descriptor
+    if (!m_fallbackTexture.Init(m_device, vk::Format::eR8G8B8A8Unorm, vk::Extent2D(1, 1), vk::ImageUsageFlagBits::eSampled))
+    {
+        std::cerr << "Failed to create fallback texture." << std::endl;
+        return false;
+    }
+
+    return CreateDescriptors()
+        && CreatePipelines(frameSetLayout);
+}
+
+void GpuCuller::Shutdown()
+{
+    if (!m_device.logical)
+        return;
+
+    m_device.logical.waitIdle();
+
+    if (m_cullPipeline)
+        m_device.logical.destroyPipeline(m_cullPipeline);
+    if (m_cullPipelineLayout)
+        m_device.logical.destroyPipelineLayout(m_cullPipelineLayout);
+    if (m_drawPipelineLayout)
+        m_device.logical.destroyPipelineLayout(m_drawPipelineLayout);
+    if (m_descriptorPool)
+        m_device.logical.destroyDescriptorPool(m_descriptorPool);
+    if (m_cullSetLayout)
+        m_device.logical.destroyDescriptorSetLayout(m_cullSetLayout);
+    if (m_textureSetLayout)
+        m_device.logical.destroyDescriptorSetLayout(m_textureSetLayout);
+    if (m_shader.shaderModule)
+        m_device.logical.destroyShaderModule(m_shader.shaderModule);
+    for (Buffer* pBuffer : { &m_entryBuffer, &m_runBuffer, &m_drawBuffer, &m_countBuffer })
+        pBuffer->Destroy(m_device);
+    m_fallbackTexture.Destroy(m_device);
+
+    m_cullPipeline = vk::Pipeline();
+    m_cullPipelineLayout = vk::PipelineLayout();
+    m_drawPipelineLayout = vk::PipelineLayout();
+    m_descriptorPool = vk::DescriptorPool();
+    m_cullSetLayout = vk::DescriptorSetLayout();
+    m_textureSetLayout = vk::DescriptorSetLayout();
+    m_shader.shaderModule = vk::ShaderModule();
+    m_instanceBuffer = vk::Buffer();
+    m_entryCapacity = 0;
+    m_runCount = 0;
+    m_tablesStale = true;
+    m_fallbackReady = false;
+    m_table.Reset(0);
+    m_imageInfos.clear();
+}
+
+bool GpuCuller::Update(std::vector<Surface> const& surfaces, Scene const& scene, vk::Sampler sampler, float mipScaleThreshold)
+{
+    m_sampler = sampler;
+    if (m_table.Update(surfaces, scene, sampler, mipScaleThreshold))
+        return true;
+
+    // Nothing is recorded meanwhile, so the tables are written in full once the path is back
+    m_table.TakeChanges(m_changedEntries, m_changedSlots);
+    m_tablesStale = true;
+    return false;
+}
+
+std::vector<uint32_t> const& GpuCuller::GetMinifiedSurfaces() const
+{
+    return m_table.GetMinifiedSurfaces();
+}
+
+void GpuCuller::SetTexture(uint32_t surface, vk::Sampler sampler, vk::ImageView view)
+{
+    m_table.SetTexture(surface, { sampler, view });
+}
+
+vk::PipelineLayout GpuCuller::GetPipelineLayout() const
+{
+    return m_drawPipelineLayout;
+}
+
+uint32_t GpuCuller::GetTextureCount() const
+{
+    return m_textureCount;
+}
+
+void GpuCuller::Record(vk::CommandBuffer cmd, vk::Buffer instanceBuffer, float const cullRect[4])
+{
+    bool const all = m_table.TakeChanges(m_changedEntries, m_changedSlots) || m_tablesStale;
+    if (all && !ReserveEntries(m_table.GetEntries().size()))
+    {
+        std::cerr << "Failed to allocate culling buffers." << std::endl;
+        m_tablesStale = true;
+        m_runCount = 0;
+        return;
+    }
+
+    WriteTables(all);
+    UpdateTextures(m_tablesStale);
+    m_tablesStale = false;
+
+    if (!m_fallbackReady)
+    {
+        vk::ImageMemoryBarrier barrier;
+        barrier.setImage(m_fallbackTexture.image);
+        barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+        barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+        barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+        barrier.setOldLayout(vk::ImageLayout::eUndefined);
+        barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eFragmentShader,
+            {}, 0, nullptr, 0, nullptr, 1, &barrier);
+        m_fallbackReady = true;
+    }
+
+    m_runCount = static_cast<uint32_t>(m_table.GetRuns().size());
+    if (m_runCount == 0)
+        return;
+
+    if (instanceBuffer != m_instanceBuffer)
+    {
+        vk::DescriptorBufferInfo const bufferInfo(instanceBuffer, 0, VK_WHOLE_SIZE);
+        vk::WriteDescriptorSet write;
+        write.setDstSet(m_cullSet);
+        write.setDstBinding(0);
+        write.setDescriptorCount(1);
+        write.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        write.setPBufferInfo(&bufferInfo);
+        m_device.logical.updateDescriptorSets(1, &write, 0, nullptr);
+        m_instanceBuffer = instanceBuffer;
+    }
+
+    cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_cullPipeline);
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_cullPipelineLayout, 0, 1, &m_cullSet, 0, nullptr);
+    cmd.pushConstants(m_cullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, 4 * sizeof(float), cullRect);
+    cmd.dispatch(m_runCount, 1, 1);
+
+    // The pass also writes the texture indices of the instances it draws
+    vk::MemoryBarrier barrier;
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderWrite);
+    barrier.setDstAccessMask(vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eVertexAttributeRead);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput,
+        {}, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCuller::Draw(vk::CommandBuffer cmd, SurfacePipelines& pipelines, vk::DescriptorSet frameSet, uint32_t frameOffset)
+{
+    if (m_runCount == 0)
+        return;
+
+    vk::DescriptorSet const descriptorSets[2] = { frameSet, m_textureSet };
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, m_drawPipelineLayout, 0, 2, descriptorSets, 1, &frameOffset);
+
+    std::vector<CullTable::Run> const& runs = m_table.GetRuns();
+    vk::Pipeline boundPipeline;
+    for (uint32_t i = 0; i < m_runCount; ++i)
+    {
+        vk::Pipeline const pipeline = pipelines.Get(runs[i].key);
+        if (!pipeline)
+            continue;
+
+        if (pipeline != boundPipeline)
+        {
+            cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+            boundPipeline = pipeline;
+        }
+        cmd.drawIndirectCountKHR(m_drawBuffer.buffer, runs[i].first * sizeof(DrawCommand),
+            m_countBuffer.buffer, i * sizeof(uint32_t), runs[i].count, sizeof(DrawCommand), m_device.dispatch);
+    }
+}
+
+void GpuCuller::WriteTables(bool all)
+{
+    std::vector<CullTable::Entry> const& entries = m_table.GetEntries();
+    CullTable::Entry* const pEntries = static_cast<CullTable::Entry*>(m_entryBuffer.mapped);
+    if (!all)
+    {
+        for (uint32_t entry : m_changedEntries)
+            pEntries[entry] = entries[entry];
+        return;
+    }
+
+    if (entries.empty())
+        return;
+
+    std::copy(entries.begin(), entries.end(), pEntries);
+    std::vector<CullTable::Run> const& runs = m_table.GetRuns();
+    RunData* const pRuns = static_cast<RunData*>(m_runBuffer.mapped);
+    for (uint32_t i = 0; i < runs.size(); ++i)
+    {
+        pRuns[i].first = runs[i].first;
+        pRuns[i].count = runs[i].count;
+    }
+}
+
+void GpuCuller::UpdateTextures(bool all)
+{
+    // Free elements sample the fallback texture, so every descriptor of the array stays valid
+    if (all)
+    {
+        m_changedSlots.resize(m_textureCount);
+        for (uint32_t i = 0; i < m_textureCount; ++i)
+            m_changedSlots[i] = i;
+    }
+
+    m_textureWrites.clear();
+    for (uint32_t slot : m_changedSlots)
+    {
+        CullTable::Texture const& texture = m_table.GetTexture(slot);
+        vk::DescriptorImageInfo& imageInfo = m_imageInfos[slot];
+        imageInfo.setSampler(texture.view ? texture.sampler : m_sampler);
+        imageInfo.setImageView(texture.view ? texture.view : m_fallbackTexture.view);
+        imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        vk::WriteDescriptorSet write;
+        write.setDstSet(m_textureSet);
+        write.setDstBinding(0);
+        write.setDstArrayElement(slot);
+        write.setDescriptorCount(1);
+        write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+        write.setPImageInfo(&imageInfo);
+        m_textureWrites.push_back(write);
+    }
+
+    if (!m_textureWrites.empty())
+        m_device.logical.updateDescriptorSets(static_cast<uint32_t>(m_textureWrites.size()), m_textureWrites.data(), 0, nullptr);
+}
+
+bool GpuCuller::ReserveEntries(size_t count)
+{
+    if (count <= m_entryCapacity)
+        return true;
+
+    // The previous frame has retired by now, so the old buffers can go right away
+    uint32_t const capacity = std::max(static_cast<uint32_t>(count), m_entryCapacity * 2);
+    if (!CreateBuffers(capacity))
+    {
+        for (Buffer* pBuffer : { &m_entryBuffer, &m_runBuffer, &m_drawBuffer, &m_countBuffer })
+            pBuffer->Destroy(m_device);
+        m_entryCapacity = 0;
+        return false;
+    }
+    m_entryCapacity = capacity;
+
+    vk::DescriptorBufferInfo const bufferInfos[4] = {
+        vk::DescriptorBufferInfo(m_entryBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_runBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_drawBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_countBuffer.buffer, 0, VK_WHOLE_SIZE),
+    };
+
+    vk::WriteDescriptorSet write;
+    write.setDstSet(m_cullSet);
+    write.setDstBinding(1);
+    write.setDescriptorCount(4);
+    write.setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    write.setPBufferInfo(bufferInfos);
+    m_device.logical.updateDescriptorSets(1, &write, 0, nullptr);
+
+    return true;
+}
+
+bool GpuCuller::CreateBuffers(uint32_t entryCapacity)
+{
+    for (Buffer* pBuffer : { &m_entryBuffer, &m_runBuffer, &m_drawBuffer, &m_countBuffer })
+        pBuffer->Destroy(m_device);
+
+    // Every entry may start a run of its own
+    vk::BufferUsageFlags const indirectUsage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer;
+    return m_entryBuffer.Allocate(m_device, entryCapacity * sizeof(CullTable::Entry), vk::BufferUsageFlagBits::eStorageBuffer)
+        && m_runBuffer.Allocate(m_device, entryCapacity * sizeof(RunData), vk::BufferUsageFlagBits::eStorageBuffer)
+        && m_drawBuffer.Allocate(m_device, entryCapacity * sizeof(DrawCommand), indirectUsage)
+        && m_countBuffer.Allocate(m_device, entryCapacity * sizeof(uint32_t), indirectUsage);
+}
+
+bool GpuCuller::CreateDescriptors()
+{
+    vk::DescriptorSetLayoutBinding cullBindings[5];
+    for (uint32_t i = 0; i < 5; ++i)
+        cullBindings[i] = vk::DescriptorSetLayoutBinding(i, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setBindingCount(5);
+    layoutCreateInfo.setPBindings(cullBindings);
+
+    std::tie(status, m_cullSetLayout) = m_device.logical.createDescriptorSetLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create culling descriptor set layout." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetLayoutBinding const textureBinding(
+        0, vk::DescriptorType::eCombinedImageSampler, m_textureCount, vk::ShaderStageFlagBits::eFragment);
+    layoutCreateInfo.setBindingCount(1);
+    layoutCreateInfo.setPBindings(&textureBinding);
+
+    std::tie(status, m_textureSetLayout) = m_device.logical.createDescriptorSetLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create texture array descriptor set layout." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorPoolSize const poolSizes[2] = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 5),
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, m_textureCount),
+    };
+    vk::DescriptorPoolCreateInfo poolCreateInfo;
+    poolCreateInfo.setMaxSets(2);
+    poolCreateInfo.setPoolSizeCount(2);
+    poolCreateInfo.setPPoolSizes(poolSizes);
+
+    std::tie(status, m_descriptorPool) = m_device.logical.createDescriptorPool(poolCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create descriptor pool." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetLayout const setLayouts[2] = { m_cullSetLayout, m_textureSetLayout };
+    vk::DescriptorSet descriptorSets[2];
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorPool(m_descriptorPool);
+    allocateInfo.setDescriptorSetCount(2);
+    allocateInfo.setPSetLayouts(setLayouts);
+
+    status = m_device.logical.allocateDescriptorSets(&allocateInfo, descriptorSets);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate descriptor sets." << std::endl;
+        return false;
+    }
+
+    // The instance and table buffers are reallocated as surfaces are added, they are bound on first use
+    m_cullSet = descriptorSets[0];
+    m_textureSet = descriptorSets[1];
+
+    return true;
+}
+
+bool GpuCuller::CreatePipelines(vk::DescriptorSetLayout frameSetLayout)
+{
+    vk::DescriptorSetLayout const drawSetLayouts[2] = { frameSetLayout, m_textureSetLayout };
+    vk::PipelineLayoutCreateInfo drawLayoutCreateInfo;
+    drawLayoutCreateInfo.setSetLayoutCount(2);
+    drawLayoutCreateInfo.setPSetLayouts(drawSetLayouts);
+
+    std::tie(status, m_drawPipelineLayout) = m_device.logical.createPipelineLayout(drawLayoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create texture array pipeline layout." << std::endl;
+        return false;
+    }
+
+    if (!m_shader.Init(m_device, "main", "../shaders/cull.comp.spv", vk::ShaderStageFlagBits::eCompute))
+        return false;
+
+    vk::PushConstantRange const pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, 4 * sizeof(float));
+    vk::PipelineLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setSetLayoutCount(1);
+    layoutCreateInfo.setPSetLayouts(&m_cullSetLayout);
+    layoutCreateInfo.setPushConstantRangeCount(1);
+    layoutCreateInfo.setPPushConstantRanges(&pushConstantRange);
+
+    std::tie(status, m_cullPipelineLayout) = m_device.logical.createPipelineLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create culling pipeline layout." << std::endl;
+        return false;
+    }
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.setStage(m_shader.shaderStage);
+    pipelineCreateInfo.setLayout(m_cullPipelineLayout);
+
+    std::tie(status, m_cullPipeline) = m_device.logical.createComputePipeline(vk::PipelineCache(), pipelineCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create culling pipeline." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+} // vkc namespace
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <ImagePool.hpp>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+namespace vkc
+{
+
+bool ImagePool::Key::operator==(Key const& other) const
+{
+    return format == other.format && width == other.width && height == other.height && usage == other.usage;
+}
+
+size_t ImagePool::KeyHash::operator()(Key const& key) const
+{
+    size_t hash = std::hash<uint32_t>()(static_cast<uint32_t>(key.format));
+    hash = hash * 31 + std::hash<uint32_t>()(key.width);
+    hash = hash * 31 + std::hash<uint32_t>()(key.height);
+    hash = hash * 31 + std::hash<uint32_t>()(key.usage);
+
+    return hash;
+}
+
+ImagePool::ImagePool(Device & device)
+    : m_device(device)
+{
+}
+
+ImagePool::~ImagePool()
+{
+    Shutdown();
+}
+
+bool ImagePool::Acquire(Image & image, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage,
+    vk::SamplerYcbcrConversion conversion)
+{
+    vk::Extent2D const bucket = GetBucketExtent(extent);
+    Key const key{ format, bucket.width, bucket.height, static_cast<VkImageUsageFlags>(usage) };
+
+    auto const freeImages = m_free.find(key);
+    if (freeImages != m_free.end() && !freeImages->second.empty())
+    {
+        image = freeImages->second.back().image;
+        image.generation = Image::NextGeneration();
+        freeImages->second.pop_back();
+    }
+    else if (!image.Init(m_device, format, bucket, usage, conversion))
+    {
+        std::cerr << "Failed to allocate pooled image." << std::endl;
+        image.Destroy(m_device);
+        return false;
+    }
+
+    image.contentExtent = extent;
+    return true;
+}
+
+void ImagePool::Release(Image & image, uint64_t submittedFrameCount)
+{
+    if (image.image)
+        m_pending.push_back({ image, submittedFrameCount });
+
+    image = Image();
+}
+
+void ImagePool::Retire(uint64_t completedFrameCount)
+{
+    m_completedFrameCount = completedFrameCount;
+
+    // Images used by frames still in flight stay pending, the rest become reusable
+    auto const retired = std::stable_partition(m_pending.begin(), m_pending.end(),
+        [completedFrameCount](Entry const& entry) { return entry.frame > completedFrameCount; });
+    for (auto entry = retired; entry != m_pending.end(); ++entry)
+    {
+        std::vector<Entry>& freeImages = m_free[MakeKey(entry->image)];
+        if (freeImages.size() < maxFreeImagesPerKey)
+            freeImages.push_back({ entry->image, completedFrameCount });
+        else
+            entry->image.Destroy(m_device);
+    }
+    m_pending.erase(retired, m_pending.end());
+
+    for (auto& freeImages : m_free)
+    {
+        auto const idle = std::remove_if(freeImages.second.begin(), freeImages.second.end(),
+            [this](Entry& entry) {
+                if (entry.frame + maxIdleFrames > m_completedFrameCount)
+                    return false;
+                entry.image.Destroy(m_device);
+                return true;
+            });
+        freeImages.second.erase(idle, freeImages.second.end());
+    }
+}
+
+void ImagePool::Trim()
+{
+    for (auto& freeImages : m_free)
+    {
+        for (Entry& entry : freeImages.second)
+            entry.image.Destroy(m_device);
+    }
+    m_free.clear();
+}
+
+void ImagePool::Shutdown()
+{
+    Trim();
+    for (Entry& entry : m_pending)
+        entry.image.Destroy(m_device);
+    m_pending.clear();
+}
+
+vk::Extent2D ImagePool::GetBucketExtent(vk::Extent2D extent)
+{
+    // Small popups and tooltips get fine buckets, large windows coarse ones to bound the waste
+    auto const roundUp = [](uint32_t size) {
+        uint32_t const granularity = size < 512 ? 64 : 256;
+        return std::max(granularity, (size + granularity - 1) / granularity * granularity);
+    };
+
+    return vk::Extent2D(roundUp(extent.width), roundUp(extent.height));
+}
+
+ImagePool::Key ImagePool::MakeKey(Image const& image)
+{
+    return Key{ image.format, image.extent.width, image.extent.height, static_cast<VkImageUsageFlags>(image.usage) };
+}
+
+} // vkc namespace
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <LatencyHistogram.hpp>
+#include <algorithm>
+
+namespace vkc
+{
+
+void LatencyHistogram::Add(Milliseconds latency)
+{
+    double const value = std::max(latency.count(), 0.0);
+    size_t const bucket = std::min(static_cast<size_t>(value / s_bucketWidth), s_bucketCount - 1);
+    ++m_buckets[bucket];
+    ++m_count;
+    m_sum += value;
+    m_max = std::max(m_max, value);
+}
+
+void LatencyHistogram::Reset()
+{
+    m_buckets.fill(0);
+    m_count = 0;
+    m_sum = 0.0;
+    m_max = 0.0;
+}
+
+uint64_t LatencyHistogram::GetCount() const
+{
+    return m_count;
+}
+
+Milliseconds LatencyHistogram::GetMean() const
+{
+    return Milliseconds(m_count ? m_sum / m_count : 0.0);
+}
+
+Milliseconds LatencyHistogram::GetMax() const
+{
+    return Milliseconds(m_max);
+}
+
+Milliseconds LatencyHistogram::GetPercentile(double fraction) const
+{
+    if (m_count == 0)
+        return Milliseconds(0.0);
+
+    // Upper edge of the bucket holding the requested rank
+    uint64_t const rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * m_count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < s_bucketCount; ++i)
+    {
+        seen += m_buckets[i];
+        if (seen >= rank)
+            return Milliseconds(std::min((i + 1) * s_bucketWidth, m_max));
+    }
+
+    return Milliseconds(m_max);
+}
+
+void LatencyHistogram::Log(std::ostream& stream, char const* pName) const
+{
+    stream << pName << ": " << m_count << " samples"
+        << ", mean " << GetMean().count() << " ms"
+        << ", p50 " << GetPercentile(0.5).count() << " ms"
+        << ", p90 " << GetPercentile(0.9).count() << " ms"
+        << ", p99 " << GetPercentile(0.99).count() << " ms"
+        << ", max " << GetMax().count() << " ms" << std::endl;
+}
+
+} // vkc namespace
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <MemoryBudget.hpp>
+#include <algorithm>
+
+namespace vkc
+{
+
+void MemoryBudget::Init(vk::PhysicalDevice physical, bool budgetExtension)
+{
+    m_physical = physical;
+    m_budgetExtension = budgetExtension;
+    m_properties = physical.getMemoryProperties();
+    for (auto& allocated : m_allocated)
+        allocated = 0;
+}
+
+void MemoryBudget::OnAllocate(uint32_t memoryTypeIndex, vk::DeviceSize size)
+{
+    m_allocated[m_properties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+}
+
+void MemoryBudget::OnFree(uint32_t memoryTypeIndex, vk::DeviceSize size)
+{
+    m_allocated[m_properties.memoryTypes[memoryTypeIndex].heapIndex] -= size;
+}
+
+uint32_t MemoryBudget::GetHeapCount() const
+{
+    return m_properties.memoryHeapCount;
+}
+
+HeapBudget MemoryBudget::GetHeapBudget(uint32_t heapIndex) const
+{
+    std::array<HeapBudget, VK_MAX_MEMORY_HEAPS> heaps;
+    QueryHeapBudgets(heaps);
+
+    return heaps[heapIndex];
+}
+
+bool MemoryBudget::IsOverBudget(float budgetFraction) const
+{
+    return GetOverBudgetSize(budgetFraction) > 0;
+}
+
+vk::DeviceSize MemoryBudget::GetOverBudgetSize(float budgetFraction) const
+{
+    std::array<HeapBudget, VK_MAX_MEMORY_HEAPS> heaps;
+    QueryHeapBudgets(heaps);
+
+    // Only device local heaps are worth evicting from, host heaps back the evicted copies
+    vk::DeviceSize overBudget = 0;
+    for (uint32_t i = 0; i < m_properties.memoryHeapCount; ++i)
+    {
+        vk::DeviceSize const limit = static_cast<vk::DeviceSize>(heaps[i].budget * budgetFraction);
+        if (heaps[i].deviceLocal && heaps[i].usage > limit)
+            overBudget = std::max(overBudget, heaps[i].usage - limit);
+    }
+
+    return overBudget;
+}
+
+void MemoryBudget::QueryHeapBudgets(std::array<HeapBudget, VK_MAX_MEMORY_HEAPS>& heaps) const
+{
+    vk::PhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+    if (m_budgetExtension)
+    {
+        vk::PhysicalDeviceMemoryProperties2 properties;
+        properties.setPNext(&budgetProperties);
+        m_physical.getMemoryProperties2(&properties);
+    }
+
+    for (uint32_t i = 0; i < m_properties.memoryHeapCount; ++i)
+    {
+        heaps[i].allocated = m_allocated[i];
+        heaps[i].deviceLocal = static_cast<bool>(m_properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+        if (m_budgetExtension)
+        {
+            heaps[i].usage = budgetProperties.heapUsage[i];
+            heaps[i].budget = budgetProperties.heapBudget[i];
+        }
+        else
+        {
+            heaps[i].usage = heaps[i].allocated;
+            heaps[i].budget = static_cast<vk::DeviceSize>(m_properties.memoryHeaps[i].size * s_defaultBudgetFraction);
+        }
+    }
+}
+
+} // vkc namespace
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <MipChains.hpp>
+#include <Ycbcr.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace vkc
+{
+
+MipChainCache::MipChainCache(Device & device)
+    : m_device(device)
+{
+}
+
+MipChainCache::~MipChainCache()
+{
+    Shutdown();
+}
+
+bool MipChainCache::Init()
+{
+    vk::SamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.setMagFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMinFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eLinear);
+    samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setMinLod(0.0f);
+    samplerCreateInfo.setMaxLod(static_cast<float>(s_maxLevelCount));
+
+    std::tie(status, m_sampler) = m_device.logical.createSampler(samplerCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create mip chain sampler." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void MipChainCache::Shutdown()
+{
+    for (auto& chain : m_chains)
+        chain.second.image.Destroy(m_device);
+    m_chains.clear();
+
+    if (m_sampler)
+        m_device.logical.destroySampler(m_sampler);
+    m_sampler = vk::Sampler();
+}
+
+vk::ImageView MipChainCache::Prepare(vk::CommandBuffer cmd, Surface const& surface, uint64_t frame)
+{
+    Image const& texture = surface.texture;
+    if (surface.GetScale() >= scaleThreshold || !Supports(texture))
+        return vk::ImageView();
+
+    vk::Extent2D const extent(std::max(texture.contentExtent.width / 2, 1u), std::max(texture.contentExtent.height / 2, 1u));
+    uint32_t levelCount = 1;
+    while (levelCount < s_maxLevelCount && (std::max(extent.width, extent.height) >> levelCount) > 0)
+        ++levelCount;
+
+    Chain& chain = m_chains[texture.generation];
+    bool const stale = !chain.image.image || chain.image.extent != extent || chain.image.format != texture.format;
+    if (stale)
+    {
+        chain.image.Destroy(m_device);
+        if (!chain.image.Init(m_device, texture.format, extent,
+            vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+            vk::SamplerYcbcrConversion(), levelCount))
+        {
+            chain.image.Destroy(m_device);
+            m_chains.erase(texture.generation);
+            return vk::ImageView();
+        }
+    }
+
+    if (stale || surface.contentDamaged)
+        RecordGeneration(cmd, texture, chain.image);
+    chain.lastUsedFrame = frame;
+
+    return chain.image.view;
+}
+
+void MipChainCache::Retire(uint64_t completedFrameCount)
+{
+    for (auto chain = m_chains.begin(); chain != m_chains.end();)
+    {
+        if (chain->second.lastUsedFrame + maxIdleFrames < completedFrameCount)
+        {
+            chain->second.image.Destroy(m_device);
+            chain = m_chains.erase(chain);
+        }
+        else
+        {
+            ++chain;
+        }
+    }
+}
+
+vk::Sampler MipChainCache::GetSampler() const
+{
+    return m_sampler;
+}
+
+bool MipChainCache::Supports(Image const& texture) const
+{
+    if (!texture.image || GetPlanarFormat(texture.format) != PlanarFormat::eNone
+        || texture.contentExtent.width < 2 || texture.contentExtent.height < 2)
+    {
+        return false;
+    }
+
+    vk::FormatFeatureFlags const features = m_device.physical.getFormatProperties(texture.format).optimalTilingFeatures;
+    return (features & vk::FormatFeatureFlagBits::eBlitSrc)
+        && (features & vk::FormatFeatureFlagBits::eBlitDst)
+        && (features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear);
+}
+
+void MipChainCache::RecordGeneration(vk::CommandBuffer cmd, Image const& texture, Image const& chain)
+{
+    vk::ImageMemoryBarrier barriers[2];
+    for (vk::ImageMemoryBarrier& barrier : barriers)
+    {
+        barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+        barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    }
+
+    barriers[0].setImage(texture.image);
+    barriers[0].setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    barriers[0].setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferWrite);
+    barriers[0].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    barriers[0].setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    barriers[0].setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+    barriers[1].setImage(chain.image);
+    barriers[1].setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, chain.mipLevels, 0, 1));
+    barriers[1].setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+    barriers[1].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barriers[1].setOldLayout(vk::ImageLayout::eUndefined);
+    barriers[1].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 2, barriers);
+
+    // The first level is downsampled from the used part of the texture, every further level from the previous one
+    vk::ImageBlit region;
+    region.setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1));
+    region.setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1));
+    region.setSrcOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(
+        static_cast<int32_t>(texture.contentExtent.width), static_cast<int32_t>(texture.contentExtent.height), 1) });
+    region.setDstOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(
+        static_cast<int32_t>(chain.extent.width), static_cast<int32_t>(chain.extent.height), 1) });
+    cmd.blitImage(texture.image, vk::ImageLayout::eTransferSrcOptimal,
+        chain.image, vk::ImageLayout::eTransferDstOptimal, 1, &region, vk::Filter::eLinear);
+
+    barriers[1].setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barriers[1].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    barriers[1].setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    barriers[1].setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+    for (uint32_t level = 1; level < chain.mipLevels; ++level)
+    {
+        barriers[1].setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level - 1, 1, 0, 1));
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
+            {}, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+
+        region.setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - 1, 0, 1));
+        region.setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1));
+        region.setSrcOffsets({ vk::Offset3D(0, 0, 0), region.dstOffsets[1] });
+        region.setDstOffsets({ vk::Offset3D(0, 0, 0), vk::Offset3D(
+            std::max(region.dstOffsets[1].x / 2, 1), std::max(region.dstOffsets[1].y / 2, 1), 1) });
+        cmd.blitImage(chain.image, vk::ImageLayout::eTransferSrcOptimal,
+            chain.image, vk::ImageLayout::eTransferDstOptimal, 1, &region, vk::Filter::eLinear);
+    }
+
+    // All levels but the last are transfer sources now, the last one is still a transfer destination
+    vk::ImageMemoryBarrier finalBarriers[3] = { barriers[0], barriers[1], barriers[1] };
+    finalBarriers[0].setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+    finalBarriers[0].setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    finalBarriers[0].setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    finalBarriers[0].setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    finalBarriers[1].setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, chain.mipLevels - 1, 1, 0, 1));
+    finalBarriers[1].setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    finalBarriers[1].setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    finalBarriers[1].setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    finalBarriers[1].setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    finalBarriers[2].setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, chain.mipLevels - 1, 0, 1));
+    finalBarriers[2].setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+    finalBarriers[2].setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    finalBarriers[2].setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    finalBarriers[2].setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    uint32_t const finalBarrierCount = chain.mipLevels > 1 ? 3 : 2;
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+        {}, 0, nullptr, 0, nullptr, finalBarrierCount, finalBarriers);
+}
+
+} // vkc namespace
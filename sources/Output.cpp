@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Output.hpp>
+
+namespace vkc
+{
+
+Output::Output(Device& device, OutputConfig const& config)
+    : m_pWindow(std::make_unique<Window>(device, config.title.c_str(), config.width, config.height))
+{
+    cursor.visible = false;
+    m_pRender = std::make_unique<Render>(device, *m_pWindow);
+}
+
+Output::Output(OutputConfig const& config)
+    : m_pSoftwareRender(std::make_unique<SoftwareRender>(vk::Extent2D(config.width, config.height)))
+{
+    // The software renderer draws no cursor
+    cursor.visible = false;
+    m_scene.Resize({ config.width, config.height });
+}
+
+bool Output::InitWindow()
+{
+    return m_pWindow->Init();
+}
+
+bool Output::InitPipelines()
+{
+    return m_pRender->InitPipelines();
+}
+
+bool Output::Init()
+{
+    m_scene.Resize({ m_pWindow->width, m_pWindow->height });
+    return m_pRender->Init();
+}
+
+bool Output::IsValid() const
+{
+    return IsHeadless() || m_pWindow->IsValid();
+}
+
+bool Output::IsHeadless() const
+{
+    return m_pSoftwareRender != nullptr;
+}
+
+void Output::Update()
+{
+    m_scene.Update(surfaces);
+}
+
+bool Output::NeedsFrame() const
+{
+    if (m_pRender && m_pRender->GetCapture().IsActive())
+        return true;
+
+    return IsSceneDamaged() || IsCursorDamaged();
+}
+
+bool Output::IsSceneDamaged() const
+{
+    if (!m_rendered || surfaces.size() != m_renderedSurfaceCount)
+        return true;
+
+    for (Surface const& surface : surfaces)
+    {
+        if (!surface.damage.empty() || (surface.visible && surface.contentDamaged))
+            return true;
+    }
+
+    return false;
+}
+
+bool Output::IsCursorDamaged() const
+{
+    if (cursor.visible != m_renderedCursorVisible)
+        return true;
+
+    return cursor.visible && (cursor.rect != m_renderedCursorRect || cursor.contentDamaged);
+}
+
+bool Output::Record()
+{
+    if (IsSceneDamaged())
+        m_pRender->InvalidateScene();
+
+    bool const drawCursor = cursor.visible && cursor.texture.view;
+    return m_pRender->Record(surfaces, m_scene, drawCursor ? &cursor : nullptr);
+}
+
+void Output::ClearDamage()
+{
+    for (Surface& surface : surfaces)
+    {
+        surface.damage.clear();
+        surface.contentDamaged = false;
+    }
+    cursor.damage.clear();
+    cursor.contentDamaged = false;
+
+    m_renderedSurfaceCount = surfaces.size();
+    m_renderedCursorRect = cursor.rect;
+    m_renderedCursorVisible = cursor.visible;
+    m_rendered = true;
+}
+
+void Output::Invalidate()
+{
+    m_rendered = false;
+}
+
+Window& Output::GetWindow()
+{
+    return *m_pWindow;
+}
+
+Render& Output::GetRender()
+{
+    return *m_pRender;
+}
+
+Render const& Output::GetRender() const
+{
+    return *m_pRender;
+}
+
+SoftwareRender* Output::GetSoftwareRender()
+{
+    return m_pSoftwareRender.get();
+}
+
+SoftwareRender const* Output::GetSoftwareRender() const
+{
+    return m_pSoftwareRender.get();
+}
+
+Scene const& Output::GetScene() const
+{
+    return m_scene;
+}
+
+} // vkc namespace
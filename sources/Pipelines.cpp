@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Pipelines.hpp>
+#include <cstddef>
+#include <iostream>
+
+namespace vkc
+{
+
+PipelineKey PipelineKey::FromSurface(Surface const& surface)
+{
+    PipelineKey key;
+    key.blend = surface.blend;
+    key.translucent = surface.opacity < 1.0f;
+    key.dim = surface.dim < 1.0f;
+    key.roundedCorners = surface.cornerRadius > 0.0f;
+    key.planar = GetPlanarFormat(surface.texture.format);
+    key.yuv = surface.yuv && key.planar == PlanarFormat::eNone;
+
+    return key;
+}
+
+uint32_t PipelineKey::Bits() const
+{
+    return static_cast<uint32_t>(blend)
+        | static_cast<uint32_t>(translucent) << 2
+        | static_cast<uint32_t>(dim) << 3
+        | static_cast<uint32_t>(roundedCorners) << 4
+        | static_cast<uint32_t>(yuv) << 5
+        | static_cast<uint32_t>(planar) << 6
+        | static_cast<uint32_t>(textureArray) << 10;
+}
+
+bool PipelineKey::BlendEnabled() const
+{
+    return blend != BlendMode::eOpaque || translucent || roundedCorners;
+}
+
+SurfacePipelines::SurfacePipelines(Device & device)
+    : m_device(device)
+{
+}
+
+SurfacePipelines::~SurfacePipelines()
+{
+    Shutdown();
+}
+
+bool SurfacePipelines::Init(vk::RenderPass renderPass, Layouts const& layouts, Shader const& vertexShader, Shader const& fragmentShader)
+{
+    m_renderPass = renderPass;
+    m_layouts = layouts;
+    m_vertexStage = vertexShader.shaderStage;
+    m_fragmentStage = fragmentShader.shaderStage;
+
+    vk::PipelineCacheCreateInfo cacheCreateInfo;
+    std::tie(status, m_cache) = m_device.logical.createPipelineCache(cacheCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create pipeline cache." << std::endl;
+        return false;
+    }
+
+    // Plain opaque and premultiplied windows are the common case, everything else is compiled on first use
+    PipelineKey premultiplied;
+    premultiplied.blend = BlendMode::ePremultiplied;
+
+    return Get(PipelineKey()) && Get(premultiplied);
+}
+
+void SurfacePipelines::Shutdown()
+{
+    for (auto const& pipeline : m_pipelines)
+    {
+        if (pipeline.second)
+            m_device.logical.destroyPipeline(pipeline.second);
+    }
+    m_pipelines.clear();
+
+    if (m_cache)
+        m_device.logical.destroyPipelineCache(m_cache);
+    m_cache = vk::PipelineCache();
+}
+
+vk::Pipeline SurfacePipelines::Get(PipelineKey key)
+{
+    auto const pipeline = m_pipelines.find(key);
+    if (pipeline != m_pipelines.end())
+        return pipeline->second;
+
+    // Failed variants are cached as null handles so they are not recompiled every frame
+    return m_pipelines[key] = Create(key);
+}
+
+void SurfacePipelines::SetTextureArrayLayout(vk::PipelineLayout layout, uint32_t textureCount)
+{
+    m_textureArrayLayout = layout;
+    m_textureArrayCount = textureCount;
+}
+
+vk::Pipeline SurfacePipelines::Create(PipelineKey key)
+{
+    vk::PipelineLayout const layout = key.textureArray ? m_textureArrayLayout : m_layouts[static_cast<uint32_t>(key.planar)];
+    if (!layout)
+    {
+        std::cerr << "No pipeline layout for planar format " << static_cast<uint32_t>(key.planar)
+            << (key.textureArray ? " with texture array." : ".") << std::endl;
+        return vk::Pipeline();
+    }
+
+    // Quad corners come from the vertex buffer, everything else per surface from the instance buffer
+    vk::VertexInputBindingDescription const bindings[2] = {
+        Vertex::s_inputBindingDescription, SurfaceConstants::s_inputBindingDescription };
+    vk::VertexInputAttributeDescription const attributes[4] = {
+        Vertex::s_inputAttributeDescription,
+        SurfaceConstants::s_inputAttributeDescriptions[0],
+        SurfaceConstants::s_inputAttributeDescriptions[1],
+        SurfaceConstants::s_inputAttributeDescriptions[2],
+    };
+
+    vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo;
+    vertexInputCreateInfo.setVertexAttributeDescriptionCount(4);
+    vertexInputCreateInfo.setPVertexAttributeDescriptions(attributes);
+    vertexInputCreateInfo.setVertexBindingDescriptionCount(2);
+    vertexInputCreateInfo.setPVertexBindingDescriptions(bindings);
+
+    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
+    inputAssemblyCreateInfo.setTopology(vk::PrimitiveTopology::eTriangleList);
+    inputAssemblyCreateInfo.setPrimitiveRestartEnable(false);
+
+    SpecializationData specializationData;
+    specializationData.blendMode = static_cast<uint32_t>(key.blend);
+    specializationData.translucent = key.translucent;
+    specializationData.dim = key.dim;
+    specializationData.roundedCorners = key.roundedCorners;
+    specializationData.yuv = key.yuv;
+    specializationData.textureCount = key.textureArray ? m_textureArrayCount : 1;
+
+    vk::SpecializationMapEntry const specializationEntries[6] = {
+        vk::SpecializationMapEntry(0, offsetof(SpecializationData, blendMode), sizeof(uint32_t)),
+        vk::SpecializationMapEntry(1, offsetof(SpecializationData, translucent), sizeof(vk::Bool32)),
+        vk::SpecializationMapEntry(2, offsetof(SpecializationData, dim), sizeof(vk::Bool32)),
+        vk::SpecializationMapEntry(3, offsetof(SpecializationData, roundedCorners), sizeof(vk::Bool32)),
+        vk::SpecializationMapEntry(4, offsetof(SpecializationData, yuv), sizeof(vk::Bool32)),
+        vk::SpecializationMapEntry(5, offsetof(SpecializationData, textureCount), sizeof(uint32_t)),
+    };
+
+    vk::SpecializationInfo specializationInfo;
+    specializationInfo.setMapEntryCount(6);
+    specializationInfo.setPMapEntries(specializationEntries);
+    specializationInfo.setDataSize(sizeof(SpecializationData));
+    specializationInfo.setPData(&specializationData);
+
+    vk::PipelineShaderStageCreateInfo shaderStages[2] = { m_vertexStage, m_fragmentStage };
+    shaderStages[1].setPSpecializationInfo(&specializationInfo);
+
+    vk::PipelineViewportStateCreateInfo viewportCreateInfo;
+    viewportCreateInfo.setScissorCount(1);
+    viewportCreateInfo.setViewportCount(1);
+
+    vk::DynamicState const dynamicStates[2] = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+    vk::PipelineDynamicStateCreateInfo dynamicCreateInfo;
+    dynamicCreateInfo.setDynamicStateCount(2);
+    dynamicCreateInfo.setPDynamicStates(dynamicStates);
+
+    vk::PipelineRasterizationStateCreateInfo rasterizationCreateInfo;
+    rasterizationCreateInfo.setCullMode(vk::CullModeFlagBits::eNone);
+    rasterizationCreateInfo.setPolygonMode(vk::PolygonMode::eFill);
+    rasterizationCreateInfo.setFrontFace(vk::FrontFace::eClockwise);
+    rasterizationCreateInfo.setLineWidth(1.0f);
+    rasterizationCreateInfo.setDepthClampEnable(false);
+    rasterizationCreateInfo.setDepthBiasEnable(false);
+    rasterizationCreateInfo.setRasterizerDiscardEnable(false);
+
+    vk::PipelineMultisampleStateCreateInfo multisamplingCreateInfo;
+    multisamplingCreateInfo.setSampleShadingEnable(false);
+    multisamplingCreateInfo.setRasterizationSamples(vk::SampleCountFlagBits::e1);
+
+    // The fragment shader always outputs premultiplied color
+    vk::PipelineColorBlendAttachmentState colorBlendAttachmentState;
+    colorBlendAttachmentState.setBlendEnable(key.BlendEnabled());
+    colorBlendAttachmentState.setSrcColorBlendFactor(vk::BlendFactor::eOne);
+    colorBlendAttachmentState.setDstColorBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha);
+    colorBlendAttachmentState.setColorBlendOp(vk::BlendOp::eAdd);
+    colorBlendAttachmentState.setSrcAlphaBlendFactor(vk::BlendFactor::eOne);
+    colorBlendAttachmentState.setDstAlphaBlendFactor(vk::BlendFactor::eOneMinusSrcAlpha);
+    colorBlendAttachmentState.setAlphaBlendOp(vk::BlendOp::eAdd);
+    colorBlendAttachmentState.setColorWriteMask(
+        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+
+    vk::PipelineColorBlendStateCreateInfo colorBlendCreateInfo;
+    colorBlendCreateInfo.setAttachmentCount(1);
+    colorBlendCreateInfo.setPAttachments(&colorBlendAttachmentState);
+    colorBlendCreateInfo.setLogicOpEnable(false);
+
+    vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.setPVertexInputState(&vertexInputCreateInfo);
+    pipelineCreateInfo.setPInputAssemblyState(&inputAssemblyCreateInfo);
+    pipelineCreateInfo.setStageCount(2);
+    pipelineCreateInfo.setPStages(shaderStages);
+    pipelineCreateInfo.setPViewportState(&viewportCreateInfo);
+    pipelineCreateInfo.setPDynamicState(&dynamicCreateInfo);
+    pipelineCreateInfo.setPRasterizationState(&rasterizationCreateInfo);
+    pipelineCreateInfo.setPMultisampleState(&multisamplingCreateInfo);
+    pipelineCreateInfo.setPColorBlendState(&colorBlendCreateInfo);
+    pipelineCreateInfo.setRenderPass(m_renderPass);
+    pipelineCreateInfo.setSubpass(0);
+    pipelineCreateInfo.setLayout(layout);
+
+    vk::Pipeline pipeline;
+    std::tie(status, pipeline) = m_device.logical.createGraphicsPipeline(m_cache, pipelineCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create graphics pipeline variant " << key.Bits() << "." << std::endl;
+        return vk::Pipeline();
+    }
+
+    return pipeline;
+}
+
+} // vkc namespace
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <QualityGovernor.hpp>
+#include <algorithm>
+
+namespace vkc
+{
+
+uint32_t HysteresisQualityPolicy::Evaluate(Milliseconds gpuTime, Milliseconds budget, uint32_t level, uint32_t levelCount)
+{
+    double const load = gpuTime.count() / budget.count();
+    if (load > degradeThreshold)
+    {
+        m_underBudgetFrames = 0;
+        if (++m_overBudgetFrames >= degradeFrameCount && level + 1 < levelCount)
+        {
+            m_overBudgetFrames = 0;
+            return level + 1;
+        }
+    }
+    else if (load < restoreThreshold)
+    {
+        m_overBudgetFrames = 0;
+        if (++m_underBudgetFrames >= restoreFrameCount && level > 0)
+        {
+            m_underBudgetFrames = 0;
+            return level - 1;
+        }
+    }
+    else
+    {
+        // Between the thresholds neither direction builds up
+        m_overBudgetFrames = 0;
+        m_underBudgetFrames = 0;
+    }
+
+    return level;
+}
+
+void HysteresisQualityPolicy::Reset()
+{
+    m_overBudgetFrames = 0;
+    m_underBudgetFrames = 0;
+}
+
+QualityGovernor::QualityGovernor(std::unique_ptr<QualityPolicy> pPolicy)
+    : m_pPolicy(std::move(pPolicy))
+{
+    QualitySettings settings;
+    m_levels.push_back(settings);
+
+    settings.blurDownscale = 4;
+    m_levels.push_back(settings);
+
+    settings.blur = false;
+    m_levels.push_back(settings);
+
+    settings.mipFiltering = false;
+    m_levels.push_back(settings);
+}
+
+void QualityGovernor::SetPolicy(std::unique_ptr<QualityPolicy> pPolicy)
+{
+    m_pPolicy = std::move(pPolicy);
+    if (m_level == 0)
+        return;
+
+    // The next frame reports the change, so full quality reaches the renderer again
+    m_level = 0;
+    m_levelReset = true;
+    ++m_levelChangeCount;
+}
+
+void QualityGovernor::SetBudget(Milliseconds budget)
+{
+    if (budget.count() > 0.0)
+        m_budget = budget;
+}
+
+Milliseconds QualityGovernor::GetBudget() const
+{
+    return m_budget;
+}
+
+bool QualityGovernor::OnFrame(Milliseconds gpuTime)
+{
+    bool const reset = m_levelReset;
+    m_levelReset = false;
+    if (gpuTime.count() <= 0.0 || !m_pPolicy)
+        return reset;
+
+    if (gpuTime > m_budget)
+        ++m_overBudgetFrameCount;
+
+    uint32_t const level = std::min(m_pPolicy->Evaluate(gpuTime, m_budget, m_level, GetLevelCount()), GetLevelCount() - 1);
+    if (level == m_level)
+        return reset;
+
+    m_level = level;
+    ++m_levelChangeCount;
+    return true;
+}
+
+uint32_t QualityGovernor::GetLevel() const
+{
+    return m_level;
+}
+
+uint32_t QualityGovernor::GetLevelCount() const
+{
+    return static_cast<uint32_t>(m_levels.size());
+}
+
+QualitySettings const& QualityGovernor::GetSettings() const
+{
+    return m_levels[m_level];
+}
+
+uint64_t QualityGovernor::GetOverBudgetFrameCount() const
+{
+    return m_overBudgetFrameCount;
+}
+
+uint64_t QualityGovernor::GetLevelChangeCount() const
+{
+    return m_levelChangeCount;
+}
+
+} // vkc namespace
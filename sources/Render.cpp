@@ -4,6 +4,8 @@
  * (http://opensource.org/licenses/MIT)
  */
 #include <Render.hpp>
+#include <Trace.hpp>
+#include <algorithm>
 #include <iostream>
 
 namespace vkc
@@ -12,6 +14,12 @@ namespace vkc
 Render::Render(Device & device, Window & window)
     : m_device(device)
     , m_window(window)
+    , m_frameAllocator(device)
+    , m_ycbcr(device)
+    , m_pipelines(device)
+    , m_capture(device, window)
+    , m_mipChains(device)
+    , m_blur(device, window)
 {
 }
 
@@ -20,23 +28,71 @@ Render::~Render()
     Shutdown();
 }
 
+bool Render::InitPipelines()
+{
+    Clock::time_point const start = Clock::now();
+
+    // Shader modules load on worker threads while the remaining pipeline state is created
+    std::future<bool> vertexShader = std::async(std::launch::async, [this]() {
+        return m_vertexShader.Init(m_device, "main", "../shaders/shader.vert.spv", vk::ShaderStageFlagBits::eVertex);
+    });
+    std::future<bool> fragmentShader = std::async(std::launch::async, [this]() {
+        return m_fragmentShader.Init(m_device, "main", "../shaders/shader.frag.spv", vk::ShaderStageFlagBits::eFragment);
+    });
+
+    bool const stateReady = CreateVertexBuffer()
+        && m_ycbcr.Init()
+        && CreateDescriptors()
+        && CreateRenderPass();
+    bool const vertexShaderReady = vertexShader.get();
+    bool const fragmentShaderReady = fragmentShader.get();
+    shaderInitTime = Clock::now() - start;
+
+    if (!stateReady || !vertexShaderReady || !fragmentShaderReady)
+        return false;
+
+    ScopedTimer timer(pipelineInitTime);
+    return CreatePipeline();
+}
+
 bool Render::Init()
 {
+    if (!m_pipelineLayouts.front() && !InitPipelines())
+        return false;
+
+    m_initTime = Clock::now();
+
     return CreateSemaphores()
-        && CreateShaders()
-        && CreateVertexBuffer()
-        && CreateRenderPass()
+        && CreateQueryPool()
         && CreateFramebuffers()
-        && CreatePipeline()
-        && CreateCommandBuffers();
+        && CreateCommandBuffers()
+        && m_mipChains.Init()
+        && m_blur.Init();
 }
 
 void Render::Shutdown()
 {
+    if (m_tileCompositorInit.valid())
+        m_tileCompositorInit.wait();
+    if (m_gpuCullerInit.valid())
+        m_gpuCullerInit.wait();
     m_device.logical.waitIdle();
 
+    m_capture.Stop();
+    m_mipChains.Shutdown();
+    m_blur.Shutdown();
+    m_pTileCompositor.reset();
+    m_pGpuCuller.reset();
     if (m_presentFence)
         m_device.logical.destroyFence(m_presentFence);
+    if (m_timestampQueryPool)
+        m_device.logical.destroyQueryPool(m_timestampQueryPool);
+    if (m_effectTimeline)
+        m_device.logical.destroySemaphore(m_effectTimeline);
+    if (m_computeCommandPool)
+        m_device.logical.destroyCommandPool(m_computeCommandPool);
+    if (m_effectCommandBuffer)
+        m_device.logical.freeCommandBuffers(m_commandPool, 1, &m_effectCommandBuffer);
     if (m_commandPool)
         m_device.logical.freeCommandBuffers(
             m_commandPool, static_cast<uint32_t>(m_commandBuffers.size()), m_commandBuffers.data());
@@ -50,32 +106,104 @@ void Render::Shutdown()
         m_device.logical.destroyShaderModule(m_vertexShader.shaderModule);
     if (m_fragmentShader.shaderModule)
         m_device.logical.destroyShaderModule(m_fragmentShader.shaderModule);
-    if (m_vertexBuffer.buffer)
-        m_device.logical.destroyBuffer(m_vertexBuffer.buffer);
-    if (m_vertexBuffer.memory)
-        m_device.logical.freeMemory(m_vertexBuffer.memory);
+    m_vertexBuffer.Destroy(m_device);
+    m_instanceBuffer.Destroy(m_device);
+    m_instanceCapacity = 0;
     if (m_renderPass)
         m_device.logical.destroyRenderPass(m_renderPass);
+    if (m_overlayRenderPass)
+        m_device.logical.destroyRenderPass(m_overlayRenderPass);
     for (auto fb : m_framebuffers)
         if (fb) m_device.logical.destroyFramebuffer(fb);
-    if (m_pipeline)
-        m_device.logical.destroyPipeline(m_pipeline);
-    if (m_pipelineCache)
-        m_device.logical.destroyPipelineCache(m_pipelineCache);
-    if (m_pipelineLayout)
-        m_device.logical.destroyPipelineLayout(m_pipelineLayout);
+    m_pipelines.Shutdown();
+    for (vk::PipelineLayout& layout : m_pipelineLayouts)
+    {
+        if (layout)
+            m_device.logical.destroyPipelineLayout(layout);
+        layout = vk::PipelineLayout();
+    }
+    m_ycbcr.Shutdown();
+    m_frameAllocator.Shutdown();
+    if (m_descriptorSetLayout)
+        m_device.logical.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    if (m_sampler)
+        m_device.logical.destroySampler(m_sampler);
 }
 
-bool Render::Frame()
+bool Render::Frame(std::vector<Surface> const& surfaces, Scene const& scene)
 {
+    VKC_TRACE_SCOPE("Render::Frame");
+    // Without damage tracking every frame is a full one
+    InvalidateScene();
+    if (!Acquire(UINT64_MAX))
+        return false;
+
+    if (!Record(surfaces, scene))
+    {
+        CancelFrame();
+        return false;
+    }
+
+    std::vector<vk::SubmitInfo> graphicsSubmits;
+    std::vector<vk::SubmitInfo> computeSubmits;
+    AppendSubmits(graphicsSubmits, computeSubmits);
+
+    vk::Result result = m_device.queue.queue.submit(
+        static_cast<uint32_t>(graphicsSubmits.size()), graphicsSubmits.data(), m_presentFence);
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to submit cmd." << std::endl;
+        return false;
+    }
+
+    if (!computeSubmits.empty())
+    {
+        result = m_device.computeQueue.queue.submit(
+            static_cast<uint32_t>(computeSubmits.size()), computeSubmits.data(), vk::Fence());
+        if (result != vk::Result::eSuccess)
+        {
+            std::cerr << "Failed to submit blur cmd." << std::endl;
+            return false;
+        }
+    }
+
+    bool const presented = Present();
+
+    {
+        VKC_TRACE_SCOPE("Render::WaitFence");
+        while (m_device.logical.waitForFences(1, &m_presentFence, true, UINT64_MAX) == vk::Result::eTimeout);
+    }
+    m_device.logical.resetFences(1, &m_presentFence);
+    EndFrame();
+
+    return presented;
+}
+
+bool Render::Acquire(uint64_t timeout)
+{
+    // An image acquired ahead of time is kept until a frame is rendered into it
+    if (m_imageAcquired)
+        return true;
+
+    VKC_TRACE_SCOPE("Render::Acquire");
     std::tie(status, m_currentFrameBuffer) = m_device.logical.acquireNextImageKHR(
-        m_window.swapchain, UINT64_MAX, m_imageAvailableSemaphore, {});
-    if (status != vk::Result::eSuccess)
+        m_window.swapchain, timeout, m_imageAvailableSemaphore, {});
+    if (status == vk::Result::eTimeout || status == vk::Result::eNotReady)
+        return false;
+
+    if (status != vk::Result::eSuccess && status != vk::Result::eSuboptimalKHR)
     {
         std::cerr << "Failed to acquire framebuffer image." << std::endl;
         return false;
     }
 
+    m_imageAcquired = true;
+    return true;
+}
+
+bool Render::Record(std::vector<Surface> const& surfaces, Scene const& scene, Surface const* pCursor)
+{
+    VKC_TRACE_SCOPE("Render::Record");
     vk::CommandBufferBeginInfo beginInfo;
     beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     vk::Result result = m_commandBuffers.back().begin(beginInfo);
@@ -85,20 +213,58 @@ bool Render::Frame()
         return false;
     }
 
-    vk::RenderPassBeginInfo renderPassBegin;
-    renderPassBegin.setFramebuffer(m_framebuffers[m_currentFrameBuffer]);
-    renderPassBegin.setRenderArea(vk::Rect2D({ 0, 0 }, { m_window.width, m_window.height }));
-    renderPassBegin.setRenderPass(m_renderPass);
-    renderPassBegin.setClearValueCount(m_attachmentCount);
-    renderPassBegin.setPClearValues(&m_colorClearValue);
-    m_commandBuffers.back().beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
+    m_effects = EffectCommands();
+    m_effects.graphics = m_effects.compute = m_effects.composite = m_commandBuffers.back();
+    if (!m_frameAllocator.BeginFrame(m_frameIndex) || !PushFrameUniforms())
+        return false;
+    if (m_timestampQueryPool)
+    {
+        m_commandBuffers.back().resetQueryPool(m_timestampQueryPool, 0, 2);
+        m_commandBuffers.back().writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, m_timestampQueryPool, 0);
+    }
+
+    // The acquired image still shows the current scene, only the cursor changed
+    bool const overlayOnly = m_imageSceneVersions[m_currentFrameBuffer] == m_sceneVersion
+        && CanRepairOverlay(surfaces, scene);
+    Surface const* pDirectCopySurface = overlayOnly ? nullptr : FindDirectCopySurface(surfaces);
+    bool const computeTiled = !overlayOnly && compositionPath == CompositionPath::eComputeTiled
+        && TileCompositorReady() && m_pTileCompositor->Supports(surfaces);
+    m_acquireWaitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+    if (overlayOnly)
+    {
+        // The image keeps its scene, RecordOverlay below repairs the old cursor rectangle
+    }
+    else if (pDirectCopySurface)
     {
-        m_commandBuffers.back().bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipeline);
-        vk::DeviceSize offsets[1] = { 0 };
-        m_commandBuffers.back().bindVertexBuffers(0, 1, &m_vertexBuffer.buffer, offsets);
-        m_commandBuffers.back().draw(6, 1, 0, 0);
+        RecordDirectCopy(m_commandBuffers.back(), *pDirectCopySurface);
+        m_acquireWaitStage = vk::PipelineStageFlagBits::eTransfer;
     }
-    m_commandBuffers.back().endRenderPass();
+    else if (computeTiled)
+    {
+        VKC_TRACE_COMMAND_LABEL(m_device, m_commandBuffers.back(), "Tiled composite");
+        m_pTileCompositor->Record(m_commandBuffers.back(), surfaces,
+            m_window.swapchainImages[m_currentFrameBuffer].image, m_colorClearValue.color);
+        m_acquireWaitStage = vk::PipelineStageFlagBits::eTransfer;
+    }
+    else
+    {
+        if (m_device.asyncCompute && !BeginEffectCommands(m_effects))
+            return false;
+        RecordComposite(m_commandBuffers.back(), surfaces, scene, m_effects);
+    }
+
+    RecordOverlay(m_commandBuffers.back(), surfaces, scene, pCursor, overlayOnly);
+    m_imageSceneVersions[m_currentFrameBuffer] = m_sceneVersion;
+
+    if (m_capture.IsActive())
+        m_capture.Record(m_commandBuffers.back(), m_window.swapchainImages[m_currentFrameBuffer].image, m_frameIndex);
+
+    // Tiles keep their content only while every full frame goes through the tiled path
+    if (m_pTileCompositor && !m_tileCompositorInit.valid() && !computeTiled && !overlayOnly)
+        m_pTileCompositor->Invalidate();
+
+    if (m_timestampQueryPool)
+        m_commandBuffers.back().writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, m_timestampQueryPool, 1);
 
     result = m_commandBuffers.back().end();
     if (result != vk::Result::eSuccess)
@@ -107,39 +273,769 @@ bool Render::Frame()
         return false;
     }
 
+    return !m_effects.IsAsync() || EndEffectCommands();
+}
+
+void Render::CancelFrame()
+{
+    // Nothing was submitted, so the image available semaphore stays signaled and the next
+    // Acquire hands out the same image together with it
+    m_commandBuffers.back().reset({});
+    if (m_device.asyncCompute)
+    {
+        m_effectCommandBuffer.reset({});
+        m_computeCommandBuffer.reset({});
+    }
+    m_effects = EffectCommands();
+
+    // The image may have been marked as showing the scene before recording failed
+    m_imageSceneVersions[m_currentFrameBuffer] = 0;
+}
+
+void Render::InvalidateScene()
+{
+    ++m_sceneVersion;
+}
+
+void Render::AppendSubmits(std::vector<vk::SubmitInfo>& graphics, std::vector<vk::SubmitInfo>& compute)
+{
+    // Submit infos point into members and stay valid until the next call
+    bool const asyncEffects = m_effects.IsAsync() && m_effects.computeRecorded;
+    if (asyncEffects)
+    {
+        // Backdrops are drawn on the graphics queue, then blurred on the compute queue, the
+        // timeline orders the two and lets the composite submission wait for the result
+        m_backdropTimelineValue = ++m_effectTimelineValue;
+        m_blurTimelineValue = ++m_effectTimelineValue;
+
+        m_backdropTimeline = vk::TimelineSemaphoreSubmitInfo();
+        m_backdropTimeline.setSignalSemaphoreValueCount(1);
+        m_backdropTimeline.setPSignalSemaphoreValues(&m_backdropTimelineValue);
+
+        vk::SubmitInfo backdropSubmit;
+        backdropSubmit.setPNext(&m_backdropTimeline);
+        backdropSubmit.setCommandBufferCount(1);
+        backdropSubmit.setPCommandBuffers(&m_effectCommandBuffer);
+        backdropSubmit.setSignalSemaphoreCount(1);
+        backdropSubmit.setPSignalSemaphores(&m_effectTimeline);
+        graphics.push_back(backdropSubmit);
+
+        m_blurTimeline = vk::TimelineSemaphoreSubmitInfo();
+        m_blurTimeline.setWaitSemaphoreValueCount(1);
+        m_blurTimeline.setPWaitSemaphoreValues(&m_backdropTimelineValue);
+        m_blurTimeline.setSignalSemaphoreValueCount(1);
+        m_blurTimeline.setPSignalSemaphoreValues(&m_blurTimelineValue);
+
+        vk::SubmitInfo blurSubmit;
+        blurSubmit.setPNext(&m_blurTimeline);
+        blurSubmit.setCommandBufferCount(1);
+        blurSubmit.setPCommandBuffers(&m_computeCommandBuffer);
+        blurSubmit.setWaitSemaphoreCount(1);
+        blurSubmit.setPWaitSemaphores(&m_effectTimeline);
+        blurSubmit.setPWaitDstStageMask(&m_blurWaitStage);
+        blurSubmit.setSignalSemaphoreCount(1);
+        blurSubmit.setPSignalSemaphores(&m_effectTimeline);
+        compute.push_back(blurSubmit);
+    }
+
+    // Composition only waits for blurred backdrops where it samples them, mip generation
+    // and everything before the fragment stage overlap the compute queue
+    m_waitSemaphores[0] = m_imageAvailableSemaphore;
+    m_waitSemaphores[1] = m_effectTimeline;
+    m_waitStages[0] = m_acquireWaitStage;
+    m_waitStages[1] = vk::PipelineStageFlagBits::eFragmentShader;
+    m_waitValues[0] = 0;
+    m_waitValues[1] = m_blurTimelineValue;
+    uint32_t const waitSemaphoreCount = asyncEffects ? 2 : 1;
+
+    m_compositeTimeline = vk::TimelineSemaphoreSubmitInfo();
+    m_compositeTimeline.setWaitSemaphoreValueCount(waitSemaphoreCount);
+    m_compositeTimeline.setPWaitSemaphoreValues(m_waitValues);
+
     vk::SubmitInfo submitInfo;
+    submitInfo.setPNext(asyncEffects ? &m_compositeTimeline : nullptr);
     submitInfo.setCommandBufferCount(static_cast<uint32_t>(m_commandBuffers.size()));
     submitInfo.setPCommandBuffers(m_commandBuffers.data());
-    vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
-    submitInfo.setPWaitDstStageMask(&waitStage);
-    submitInfo.setWaitSemaphoreCount(1);
-    submitInfo.setPWaitSemaphores(&m_imageAvailableSemaphore);
+    submitInfo.setPWaitDstStageMask(m_waitStages);
+    submitInfo.setWaitSemaphoreCount(waitSemaphoreCount);
+    submitInfo.setPWaitSemaphores(m_waitSemaphores);
     submitInfo.setSignalSemaphoreCount(1);
     submitInfo.setPSignalSemaphores(&m_renderDoneSemaphore);
+    graphics.push_back(submitInfo);
+}
 
-    result = m_device.queue.queue.submit(1, &submitInfo, m_presentFence);
-    if (result != vk::Result::eSuccess)
-    {
-        std::cerr << "Failed to submit cmd." << std::endl;
-        return false;
-    }
+bool Render::Present()
+{
+    VKC_TRACE_SCOPE("Render::Present");
+    // Ids let the past presentation timings be matched to frames
+    vk::PresentTimeGOOGLE const presentTime(static_cast<uint32_t>(m_frameIndex + 1), 0);
+    vk::PresentTimesInfoGOOGLE presentTimesInfo;
+    presentTimesInfo.setSwapchainCount(1);
+    presentTimesInfo.setPTimes(&presentTime);
 
     vk::PresentInfoKHR presentInfo;
+    presentInfo.setPNext(m_device.displayTiming ? &presentTimesInfo : nullptr);
     presentInfo.setWaitSemaphoreCount(1);
     presentInfo.setPWaitSemaphores(&m_renderDoneSemaphore);
     presentInfo.setPSwapchains(&m_window.swapchain);
     presentInfo.setSwapchainCount(1);
     presentInfo.setPImageIndices(&m_currentFrameBuffer);
-    result = m_device.queue.queue.presentKHR(presentInfo);
-    if (result != vk::Result::eSuccess)
+    vk::Result const result = m_device.queue.queue.presentKHR(presentInfo);
+    if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR)
     {
         std::cerr << "Failed to present queue." << std::endl;
         return false;
     }
 
-    while (m_device.logical.waitForFences(1, &m_presentFence, true, UINT64_MAX) == vk::Result::eTimeout);
-    m_device.logical.resetFences(1, &m_presentFence);
+    return true;
+}
+
+bool Render::GetLastPresentTime(uint64_t& frame, Clock::time_point& time)
+{
+    if (!m_device.displayTiming)
+        return false;
+
+    std::vector<vk::PastPresentationTimingGOOGLE> timings;
+    vk::Result result;
+    std::tie(result, timings) = m_device.logical.getPastPresentationTimingGOOGLE(m_window.swapchain, m_device.dispatch);
+    if (result != vk::Result::eSuccess || timings.empty())
+        return false;
+
+    // Reported on the monotonic clock, which is what the steady clock reads on Linux
+    frame = timings.back().presentID - 1;
+    time = Clock::time_point(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::nanoseconds(timings.back().actualPresentTime)));
+    return true;
+}
+
+void Render::EndFrame()
+{
+    VKC_TRACE_SCOPE("Render::EndFrame");
+    // The frame has completed, so its timestamps are available without waiting
+    uint64_t timestamps[2] = { 0, 0 };
+    if (m_timestampQueryPool && m_device.logical.getQueryPoolResults(m_timestampQueryPool, 0, 2, sizeof(timestamps),
+            timestamps, sizeof(uint64_t), vk::QueryResultFlagBits::e64) == vk::Result::eSuccess
+        && timestamps[1] > timestamps[0])
+    {
+        m_gpuTime = Milliseconds((timestamps[1] - timestamps[0]) * static_cast<double>(m_device.timestampPeriod) / 1e6);
+#ifdef VKC_TRACING
+        if (Tracer::IsEnabled())
+            TraceGpuFrame(timestamps[0], timestamps[1]);
+#endif
+    }
+
+    m_imageAcquired = false;
     m_commandBuffers.back().reset({});
+    if (m_effects.IsAsync())
+    {
+        m_effectCommandBuffer.reset({});
+        m_computeCommandBuffer.reset({});
+    }
+
+    if (m_capture.IsActive())
+        m_capture.Collect(m_frameIndex);
+    ++m_frameIndex;
+    m_frameAllocator.Retire(m_frameIndex);
+    m_mipChains.Retire(m_frameIndex);
+    m_blur.Retire(m_frameIndex);
+}
+
+void Render::TraceGpuFrame(uint64_t start, uint64_t end)
+{
+    // Device ticks are placed on the host clock relative to an anchor sampled in both domains,
+    // without calibrated timestamps the frame end is approximated by the time it is read back
+    uint64_t anchorTicks = end;
+    Clock::time_point anchorTime = Clock::now();
+    if (m_device.calibratedTimestamps)
+    {
+        vk::CalibratedTimestampInfoEXT const infos[2] = {
+            vk::CalibratedTimestampInfoEXT(vk::TimeDomainEXT::eDevice),
+            vk::CalibratedTimestampInfoEXT(Tracer::GetHostTimeDomain())
+        };
+        uint64_t values[2] = { 0, 0 };
+        uint64_t maxDeviation = 0;
+        if (m_device.logical.getCalibratedTimestampsEXT(2, infos, values, &maxDeviation, m_device.dispatch) == vk::Result::eSuccess)
+        {
+            anchorTicks = values[0];
+            anchorTime = Tracer::FromCalibratedTimestamp(values[1]);
+        }
+    }
+
+    auto const toHost = [&](uint64_t ticks) {
+        double const nanoseconds = static_cast<double>(static_cast<int64_t>(ticks - anchorTicks)) * m_device.timestampPeriod;
+        return anchorTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::nano>(nanoseconds));
+    };
+    Tracer::AddGpuSpan("GPU frame", toHost(start), toHost(end));
+}
+
+bool Render::TileCompositorReady()
+{
+    // The compute pipeline is rarely used, so it is compiled in the background on first
+    // request and the raster path keeps producing frames until it is ready
+    if (m_tileCompositorInit.valid())
+    {
+        if (m_tileCompositorInit.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+
+        if (!m_tileCompositorInit.get())
+        {
+            std::cerr << "Tiled compute composition is unavailable, using raster path." << std::endl;
+            m_pTileCompositor.reset();
+            m_tileCompositorUnavailable = true;
+        }
+    }
+    else if (!m_pTileCompositor && !m_tileCompositorUnavailable)
+    {
+        m_pTileCompositor = std::make_unique<TileCompositor>(m_device, m_window);
+        m_tileCompositorInit = std::async(std::launch::async, [this]() { return m_pTileCompositor->Init(); });
+        return false;
+    }
+
+    return m_pTileCompositor != nullptr;
+}
+
+bool Render::GpuCullerReady()
+{
+    // Compiled in the background like the tiled path, the raster path draws meanwhile
+    if (m_gpuCullerInit.valid())
+    {
+        if (m_gpuCullerInit.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+
+        if (m_gpuCullerInit.get())
+        {
+            m_pipelines.SetTextureArrayLayout(m_pGpuCuller->GetPipelineLayout(), m_pGpuCuller->GetTextureCount());
+        }
+        else
+        {
+            std::cerr << "GPU culling is unavailable, using raster path." << std::endl;
+            m_pGpuCuller.reset();
+            m_gpuCullerUnavailable = true;
+        }
+    }
+    else if (!m_pGpuCuller && !m_gpuCullerUnavailable)
+    {
+        m_pGpuCuller = std::make_unique<GpuCuller>(m_device);
+        vk::DescriptorSetLayout const frameSetLayout = m_frameAllocator.GetUniformSetLayout();
+        m_gpuCullerInit = std::async(std::launch::async, [this, frameSetLayout]() { return m_pGpuCuller->Init(frameSetLayout); });
+        return false;
+    }
+
+    return m_pGpuCuller != nullptr;
+}
+
+YcbcrSamplers const& Render::GetYcbcrSamplers() const
+{
+    return m_ycbcr;
+}
+
+bool Render::StartCapture(FILE* pOutput)
+{
+    return m_capture.Start(pOutput);
+}
+
+void Render::StopCapture()
+{
+    m_capture.Stop();
+}
+
+FrameCapture const& Render::GetCapture() const
+{
+    return m_capture;
+}
+
+Milliseconds Render::GetGpuTime() const
+{
+    return m_gpuTime;
+}
+
+uint64_t Render::GetSubmittedFrameCount() const
+{
+    return m_frameIndex;
+}
+
+uint64_t Render::GetCompletedFrameCount() const
+{
+    // Frame waits for its own fence, so every submitted frame has completed once it returns
+    return m_frameIndex;
+}
+
+Surface const* Render::FindDirectCopySurface(std::vector<Surface> const& surfaces) const
+{
+    if (!(m_window.swapchainUsage & vk::ImageUsageFlagBits::eTransferDst))
+        return nullptr;
+
+    // Surfaces below the topmost one are fully occluded when it covers the whole output,
+    // any overlay on top of it becomes the topmost surface and disables the fast path.
+    auto const top = std::find_if(surfaces.rbegin(), surfaces.rend(),
+        [](Surface const& surface) { return surface.visible; });
+    if (top == surfaces.rend() || !top->texture.image)
+        return nullptr;
+
+    bool const opaque = top->IsOpaque() && top->dim >= 1.0f && !top->yuv
+        && GetPlanarFormat(top->texture.format) == PlanarFormat::eNone;
+    bool const fullscreen = top->rect.offset.x == 0 && top->rect.offset.y == 0
+        && top->rect.extent.width == m_window.width && top->rect.extent.height == m_window.height;
+    bool const nativeSize = top->texture.contentExtent == top->rect.extent;
+    if (!opaque || !fullscreen || !nativeSize)
+        return nullptr;
+
+    if (top->texture.format != m_window.surfaceFormat.format)
+    {
+        vk::FormatProperties const srcProperties = m_device.physical.getFormatProperties(top->texture.format);
+        vk::FormatProperties const dstProperties = m_device.physical.getFormatProperties(m_window.surfaceFormat.format);
+        if (!(srcProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitSrc)
+            || !(dstProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitDst))
+            return nullptr;
+    }
+
+    return &*top;
+}
+
+void Render::RecordDirectCopy(vk::CommandBuffer cmd, Surface const& surface)
+{
+    VKC_TRACE_COMMAND_LABEL(m_device, cmd, "Direct copy");
+    vk::ImageSubresourceRange const range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    vk::Image const target = m_window.swapchainImages[m_currentFrameBuffer].image;
+
+    vk::ImageMemoryBarrier barriers[2];
+    barriers[0].setImage(surface.texture.image);
+    barriers[0].setSubresourceRange(range);
+    barriers[0].setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barriers[0].setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barriers[0].setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferWrite);
+    barriers[0].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    barriers[0].setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    barriers[0].setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+    barriers[1].setImage(target);
+    barriers[1].setSubresourceRange(range);
+    barriers[1].setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barriers[1].setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barriers[1].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barriers[1].setOldLayout(vk::ImageLayout::eUndefined);
+    barriers[1].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 2, barriers);
+
+    vk::ImageSubresourceLayers const layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    if (surface.texture.format == m_window.surfaceFormat.format)
+    {
+        vk::ImageCopy region;
+        region.setSrcSubresource(layers);
+        region.setDstSubresource(layers);
+        region.setExtent({ m_window.width, m_window.height, 1 });
+        cmd.copyImage(surface.texture.image, vk::ImageLayout::eTransferSrcOptimal,
+            target, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+    }
+    else
+    {
+        vk::Offset3D const corner(static_cast<int32_t>(m_window.width), static_cast<int32_t>(m_window.height), 1);
+        vk::ImageBlit region;
+        region.setSrcSubresource(layers);
+        region.setDstSubresource(layers);
+        region.setSrcOffsets({ vk::Offset3D(0, 0, 0), corner });
+        region.setDstOffsets({ vk::Offset3D(0, 0, 0), corner });
+        cmd.blitImage(surface.texture.image, vk::ImageLayout::eTransferSrcOptimal,
+            target, vk::ImageLayout::eTransferDstOptimal, 1, &region, vk::Filter::eNearest);
+    }
+
+    barriers[0].setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+    barriers[0].setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    barriers[0].setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
+    barriers[0].setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    barriers[1].setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barriers[1].setDstAccessMask({});
+    barriers[1].setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    barriers[1].setNewLayout(vk::ImageLayout::ePresentSrcKHR);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eBottomOfPipe,
+        {}, 0, nullptr, 0, nullptr, 2, barriers);
+}
+
+bool Render::BeginEffectCommands(EffectCommands & effects)
+{
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    if (m_effectCommandBuffer.begin(beginInfo) != vk::Result::eSuccess
+        || m_computeCommandBuffer.begin(beginInfo) != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to begin effect command buffers." << std::endl;
+        return false;
+    }
+
+    effects.graphics = m_effectCommandBuffer;
+    effects.compute = m_computeCommandBuffer;
+    return true;
+}
+
+bool Render::EndEffectCommands()
+{
+    // Both command buffers stay empty while every blurred backdrop is cached, they are
+    // only submitted once something was recorded for the compute queue
+    if (m_effectCommandBuffer.end() != vk::Result::eSuccess
+        || m_computeCommandBuffer.end() != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to end effect command buffers." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Render::RecordComposite(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces, Scene const& scene, EffectCommands& effects)
+{
+    VKC_TRACE_SCOPE("Render::RecordComposite");
+    VKC_TRACE_COMMAND_LABEL(m_device, cmd, "Composite");
+    // Surface instances are followed by one record per blurred panel backdrop, the cursor and
+    // copies of the surface instances that sample their full texture while drawing backdrops
+    m_surfaceStore.Update(surfaces, { m_window.width, m_window.height });
+    bool const instancesReady = ReserveInstances(surfaces.size() * 2 + BlurEffect::s_maxPanelCount + 1);
+    size_t const backdropSourceBase = surfaces.size() + BlurEffect::s_maxPanelCount + 1;
+    SurfaceConstants* const pInstances = static_cast<SurfaceConstants*>(m_instanceBuffer.mapped);
+    if (instancesReady)
+        m_surfaceStore.Pack(pInstances);
+
+    // Views are only reset where the last composite set them
+    if (m_mipViews.size() != surfaces.size())
+    {
+        m_mipViews.assign(surfaces.size(), vk::ImageView());
+        m_blurViews.assign(surfaces.size(), vk::ImageView());
+        m_backdropInstances.assign(surfaces.size(), 0);
+    }
+    else
+    {
+        for (uint32_t index : m_viewedSurfaces)
+        {
+            m_mipViews[index] = vk::ImageView();
+            m_blurViews[index] = vk::ImageView();
+            m_backdropInstances[index] = 0;
+        }
+    }
+    m_viewedSurfaces.clear();
+
+    // Mip chains and blurred backdrops are recorded outside of the composite render pass,
+    // mip chains always on the graphics queue since blits aren't available to compute queues
+    auto const prepareMipChain = [this, &surfaces, pInstances, backdropSourceBase, cmd](uint32_t index) {
+        m_mipViews[index] = m_mipChains.Prepare(cmd, surfaces[index], m_frameIndex);
+        if (!m_mipViews[index])
+            return;
+
+        m_viewedSurfaces.push_back(index);
+        pInstances[backdropSourceBase + index] = pInstances[index];
+        pInstances[index].uvScale[0] = 1.0f;
+        pInstances[index].uvScale[1] = 1.0f;
+    };
+
+    // The culled path keeps its tables across frames and only visits the surfaces that
+    // changed, and its minified surfaces for their mip chains, culled against the whole
+    // output since a full composite clears all of it
+    float const mipScaleThreshold = quality.mipFiltering ? m_mipChains.scaleThreshold : 0.0f;
+    bool const gpuCulled = instancesReady && compositionPath == CompositionPath::eGpuCulled
+        && GpuCullerReady() && m_pGpuCuller->Update(surfaces, scene, m_sampler, mipScaleThreshold);
+    if (gpuCulled)
+    {
+        for (uint32_t index : m_pGpuCuller->GetMinifiedSurfaces())
+        {
+            prepareMipChain(index);
+            m_pGpuCuller->SetTexture(index, m_mipViews[index] ? m_mipChains.GetSampler() : m_sampler,
+                m_mipViews[index] ? m_mipViews[index] : surfaces[index].texture.view);
+        }
+
+        float const cullRect[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+        m_pGpuCuller->Record(cmd, m_instanceBuffer.buffer, cullRect);
+    }
+    else
+    {
+        for (uint32_t i = 0; instancesReady && quality.mipFiltering && i < surfaces.size(); ++i)
+        {
+            if (!scene.IsCulled(i) && m_surfaceStore.IsDrawable(i))
+                prepareMipChain(i);
+        }
+    }
+
+    // Without blur a panel is drawn as it is over the surfaces below it
+    m_blur.downscale = quality.blurDownscale;
+    uint32_t backdropInstance = static_cast<uint32_t>(surfaces.size());
+    for (size_t i = 0; instancesReady && quality.blur && !gpuCulled && i < surfaces.size(); ++i)
+    {
+        if (scene.IsCulled(i) || !surfaces[i].blurBehind)
+            continue;
+
+        m_blurViews[i] = m_blur.Prepare(effects, surfaces, i, m_frameIndex, m_colorClearValue,
+            [this, &surfaces, &scene](vk::CommandBuffer backdropCmd, size_t surfaceCount) {
+                RecordSurfaces(backdropCmd, surfaces, scene, surfaceCount, false);
+            });
+        if (!m_blurViews[i])
+            continue;
+
+        // The blurred backdrop is drawn as an opaque quad with the panel's shape
+        Surface const& surface = surfaces[i];
+        SurfaceConstants& backdrop = pInstances[backdropInstance];
+        backdrop.rect[0] = surface.rect.offset.x * 2.0f / m_window.width - 1.0f;
+        backdrop.rect[1] = surface.rect.offset.y * 2.0f / m_window.height - 1.0f;
+        backdrop.rect[2] = surface.rect.extent.width * 2.0f / m_window.width;
+        backdrop.rect[3] = surface.rect.extent.height * 2.0f / m_window.height;
+        backdrop.opacity = 1.0f;
+        backdrop.dim = 1.0f;
+        backdrop.cornerRadius = surface.cornerRadius;
+        backdrop.textureIndex = 0.0f;
+        backdrop.size[0] = static_cast<float>(surface.rect.extent.width);
+        backdrop.size[1] = static_cast<float>(surface.rect.extent.height);
+        backdrop.uvScale[0] = 1.0f;
+        backdrop.uvScale[1] = 1.0f;
+        m_backdropInstances[i] = backdropInstance++;
+        m_viewedSurfaces.push_back(static_cast<uint32_t>(i));
+    }
+
+    vk::RenderPassBeginInfo renderPassBegin;
+    renderPassBegin.setFramebuffer(m_framebuffers[m_currentFrameBuffer]);
+    renderPassBegin.setRenderArea(vk::Rect2D({ 0, 0 }, { m_window.width, m_window.height }));
+    renderPassBegin.setRenderPass(m_renderPass);
+    renderPassBegin.setClearValueCount(m_attachmentCount);
+    renderPassBegin.setPClearValues(&m_colorClearValue);
+    cmd.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
+    {
+        vk::Viewport const viewport(0, 0, static_cast<float>(m_window.width), static_cast<float>(m_window.height), 0, 1.0f);
+        vk::Rect2D const scissor({ 0, 0 }, { m_window.width, m_window.height });
+        cmd.setViewport(0, 1, &viewport);
+        cmd.setScissor(0, 1, &scissor);
+
+        if (gpuCulled)
+        {
+            vk::Buffer const buffers[2] = { m_vertexBuffer.buffer, m_instanceBuffer.buffer };
+            vk::DeviceSize const offsets[2] = { 0, 0 };
+            cmd.bindVertexBuffers(0, 2, buffers, offsets);
+            m_pGpuCuller->Draw(cmd, m_pipelines, m_frameAllocator.GetUniformSet(), m_frameUniformOffset);
+        }
+        else if (instancesReady)
+        {
+            RecordSurfaces(cmd, surfaces, scene, surfaces.size(), true);
+        }
+    }
+    cmd.endRenderPass();
+
+    if (instancesReady)
+        m_instanceSceneVersion = m_sceneVersion;
+}
+
+bool Render::CanRepairOverlay(std::vector<Surface> const& surfaces, Scene const& scene)
+{
+    // Repairs reuse the surface instances, mip chains and backdrops of the last composite
+    if (m_instanceSceneVersion != m_sceneVersion)
+        return false;
+
+    m_overlaySurfaces.clear();
+    vk::Rect2D const& rect = m_imageCursorRects[m_currentFrameBuffer];
+    if (rect.extent.width == 0 || rect.extent.height == 0)
+        return true;
+
+    scene.Query(rect, m_overlaySurfaces);
+    for (uint32_t index : m_overlaySurfaces)
+    {
+        if (scene.IsCulled(index) || !m_surfaceStore.IsDrawable(index))
+            continue;
+
+        // Blurred backdrops and mip chains are only kept current by full frames
+        if (m_blurViews[index] || m_mipViews[index])
+            return false;
+    }
+
+    return true;
+}
+
+void Render::RecordOverlay(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces, Scene const& scene,
+    Surface const* pCursor, bool repair)
+{
+    VKC_TRACE_SCOPE("Render::RecordOverlay");
+    VKC_TRACE_COMMAND_LABEL(m_device, cmd, "Overlay");
+    vk::Rect2D const output({ 0, 0 }, { m_window.width, m_window.height });
+    vk::Rect2D const repairRect = repair ? m_imageCursorRects[m_currentFrameBuffer] : vk::Rect2D();
+    vk::Rect2D cursorRect;
+    if (pCursor && pCursor->texture.view)
+    {
+        int32_t const left = std::max(pCursor->rect.offset.x, 0);
+        int32_t const top = std::max(pCursor->rect.offset.y, 0);
+        int32_t const right = std::min(pCursor->rect.offset.x + static_cast<int32_t>(pCursor->rect.extent.width), static_cast<int32_t>(output.extent.width));
+        int32_t const bottom = std::min(pCursor->rect.offset.y + static_cast<int32_t>(pCursor->rect.extent.height), static_cast<int32_t>(output.extent.height));
+        if (left < right && top < bottom)
+            cursorRect = vk::Rect2D({ left, top }, { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) });
+    }
+    m_imageCursorRects[m_currentFrameBuffer] = cursorRect;
+
+    bool const hasRepair = repairRect.extent.width != 0 && repairRect.extent.height != 0;
+    bool const hasCursor = cursorRect.extent.width != 0 && cursorRect.extent.height != 0;
+    uint32_t const cursorInstance = static_cast<uint32_t>(surfaces.size() + BlurEffect::s_maxPanelCount);
+    if (hasCursor && (!ReserveInstances(cursorInstance + 1) || (repair && m_instanceSceneVersion != m_sceneVersion)))
+        return;
+    if (!hasRepair && !hasCursor)
+        return;
+    if (hasCursor)
+        WriteCursorInstance(*pCursor, cursorInstance);
+
+    // Only the bounds of both rectangles are touched, the rest of the image is loaded as is
+    vk::Rect2D area = hasRepair ? repairRect : cursorRect;
+    if (hasRepair && hasCursor)
+    {
+        int32_t const left = std::min(repairRect.offset.x, cursorRect.offset.x);
+        int32_t const top = std::min(repairRect.offset.y, cursorRect.offset.y);
+        int32_t const right = std::max(repairRect.offset.x + static_cast<int32_t>(repairRect.extent.width), cursorRect.offset.x + static_cast<int32_t>(cursorRect.extent.width));
+        int32_t const bottom = std::max(repairRect.offset.y + static_cast<int32_t>(repairRect.extent.height), cursorRect.offset.y + static_cast<int32_t>(cursorRect.extent.height));
+        area = vk::Rect2D({ left, top }, { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) });
+    }
+
+    vk::RenderPassBeginInfo renderPassBegin;
+    renderPassBegin.setFramebuffer(m_framebuffers[m_currentFrameBuffer]);
+    renderPassBegin.setRenderArea(area);
+    renderPassBegin.setRenderPass(m_overlayRenderPass);
+    cmd.beginRenderPass(renderPassBegin, vk::SubpassContents::eInline);
+    {
+        vk::Viewport const viewport(0, 0, static_cast<float>(m_window.width), static_cast<float>(m_window.height), 0, 1.0f);
+        cmd.setViewport(0, 1, &viewport);
+
+        vk::Buffer const buffers[2] = { m_vertexBuffer.buffer, m_instanceBuffer.buffer };
+        vk::DeviceSize const offsets[2] = { 0, 0 };
+        cmd.bindVertexBuffers(0, 2, buffers, offsets);
+
+        vk::Pipeline boundPipeline;
+        if (hasRepair)
+        {
+            // The old cursor rectangle is composed again from the surfaces below it
+            cmd.setScissor(0, 1, &repairRect);
+            vk::ClearAttachment const clear(vk::ImageAspectFlagBits::eColor, 0, m_colorClearValue);
+            vk::ClearRect const clearRect(repairRect, 0, 1);
+            cmd.clearAttachments(1, &clear, 1, &clearRect);
+
+            for (uint32_t index : m_overlaySurfaces)
+            {
+                Surface const& surface = surfaces[index];
+                if (scene.IsCulled(index) || !m_surfaceStore.IsDrawable(index))
+                    continue;
+
+                if (!RecordQuad(cmd, PipelineKey::FromSurface(surface), m_sampler, surface.texture.view, index, boundPipeline))
+                    break;
+            }
+        }
+
+        if (hasCursor)
+        {
+            cmd.setScissor(0, 1, &cursorRect);
+            RecordQuad(cmd, PipelineKey::FromSurface(*pCursor), m_sampler, pCursor->texture.view, cursorInstance, boundPipeline);
+        }
+    }
+    cmd.endRenderPass();
+}
+
+void Render::WriteCursorInstance(Surface const& cursor, uint32_t instance)
+{
+    SurfaceConstants& record = static_cast<SurfaceConstants*>(m_instanceBuffer.mapped)[instance];
+    record.rect[0] = cursor.rect.offset.x * 2.0f / m_window.width - 1.0f;
+    record.rect[1] = cursor.rect.offset.y * 2.0f / m_window.height - 1.0f;
+    record.rect[2] = cursor.rect.extent.width * 2.0f / m_window.width;
+    record.rect[3] = cursor.rect.extent.height * 2.0f / m_window.height;
+    record.opacity = cursor.opacity;
+    record.dim = cursor.dim;
+    record.cornerRadius = cursor.cornerRadius;
+    record.textureIndex = 0.0f;
+    record.size[0] = static_cast<float>(cursor.rect.extent.width);
+    record.size[1] = static_cast<float>(cursor.rect.extent.height);
+    record.uvScale[0] = static_cast<float>(cursor.texture.contentExtent.width) / std::max(cursor.texture.extent.width, 1u);
+    record.uvScale[1] = static_cast<float>(cursor.texture.contentExtent.height) / std::max(cursor.texture.extent.height, 1u);
+}
+
+void Render::RecordSurfaces(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces, Scene const& scene,
+    size_t surfaceCount, bool mainPass)
+{
+    vk::Buffer const buffers[2] = { m_vertexBuffer.buffer, m_instanceBuffer.buffer };
+    vk::DeviceSize const offsets[2] = { 0, 0 };
+    cmd.bindVertexBuffers(0, 2, buffers, offsets);
+
+    vk::Pipeline boundPipeline;
+    for (size_t i = 0; i < surfaceCount; ++i)
+    {
+        // Culled surfaces are hidden, off the output or fully behind an opaque surface, the
+        // occluder of a surface below a panel may be above the panel and not in its backdrop
+        Surface const& surface = surfaces[i];
+        bool const culled = mainPass ? scene.IsCulled(i) : scene.IsOffOutput(i);
+        if (culled || !m_surfaceStore.IsDrawable(i))
+            continue;
+
+        if (mainPass && m_blurViews[i])
+        {
+            // The blurred backdrop goes right below the panel
+            PipelineKey backdropKey;
+            backdropKey.roundedCorners = surface.cornerRadius > 0.0f;
+            if (!RecordQuad(cmd, backdropKey, m_blur.GetSampler(), m_blurViews[i], m_backdropInstances[i], boundPipeline))
+                break;
+        }
+
+        // Mip chains are generated in the composite command buffer, which async backdrops
+        // are submitted ahead of, and the backdrop is blurred anyway. Their instance keeps
+        // the texture coordinate scale of the full texture
+        vk::Sampler sampler = m_sampler;
+        vk::ImageView view = surface.texture.view;
+        uint32_t instance = static_cast<uint32_t>(i);
+        if (m_mipViews[i] && mainPass)
+        {
+            sampler = m_mipChains.GetSampler();
+            view = m_mipViews[i];
+        }
+        else if (m_mipViews[i])
+        {
+            instance = static_cast<uint32_t>(surfaces.size() + BlurEffect::s_maxPanelCount + 1 + i);
+        }
+
+        if (!RecordQuad(cmd, PipelineKey::FromSurface(surface), sampler, view, instance, boundPipeline))
+            break;
+    }
+}
+
+bool Render::RecordQuad(vk::CommandBuffer cmd, PipelineKey const& key, vk::Sampler sampler, vk::ImageView view,
+    uint32_t instance, vk::Pipeline& boundPipeline)
+{
+    vk::Pipeline const pipeline = m_pipelines.Get(key);
+    if (!pipeline)
+        return true;
+
+    vk::DescriptorSetLayout const setLayout = key.planar == PlanarFormat::eNone
+        ? m_descriptorSetLayout : m_ycbcr.GetDescriptorSetLayout(key.planar);
+    vk::PipelineLayout const pipelineLayout = m_pipelineLayouts[static_cast<uint32_t>(key.planar)];
+
+    // Pools grow with the frame, so this only fails when the device is out of memory
+    vk::DescriptorSet const descriptorSet = m_frameAllocator.GetImageSet(setLayout, sampler, view);
+    if (!descriptorSet)
+    {
+        std::cerr << "Failed to allocate surface descriptor set, dropping the rest of the pass." << std::endl;
+        return false;
+    }
+
+    if (pipeline != boundPipeline)
+    {
+        cmd.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        boundPipeline = pipeline;
+    }
+    vk::DescriptorSet const descriptorSets[2] = { m_frameAllocator.GetUniformSet(), descriptorSet };
+    cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 2, descriptorSets, 1, &m_frameUniformOffset);
+    cmd.draw(6, 1, 0, instance);
+
+    return true;
+}
+
+bool Render::CreateQueryPool()
+{
+    // GPU frame times are optional, without timestamps they simply stay zero
+    if (m_device.timestampPeriod == 0.0f)
+        return true;
+
+    vk::QueryPoolCreateInfo createInfo;
+    createInfo.setQueryType(vk::QueryType::eTimestamp);
+    createInfo.setQueryCount(2);
+
+    std::tie(status, m_timestampQueryPool) = m_device.logical.createQueryPool(createInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create timestamp query pool." << std::endl;
+        return false;
+    }
 
     return true;
 }
@@ -169,18 +1065,47 @@ bool Render::CreateSemaphores()
         return false;
     }
 
+    if (m_device.asyncCompute)
+    {
+        vk::SemaphoreTypeCreateInfo typeCreateInfo(vk::SemaphoreType::eTimeline, 0);
+        vk::SemaphoreCreateInfo timelineCreateInfo;
+        timelineCreateInfo.setPNext(&typeCreateInfo);
+        std::tie(status, m_effectTimeline) = m_device.logical.createSemaphore(timelineCreateInfo);
+        if (status != vk::Result::eSuccess)
+        {
+            std::cerr << "Failed to create effect timeline semaphore." << std::endl;
+            return false;
+        }
+    }
+
     return true;
 }
 
-bool Render::CreateShaders()
+bool Render::CreateVertexBuffer()
 {
-    return m_vertexShader.Init(m_device, "main", "../shaders/shader.vert.spv", vk::ShaderStageFlagBits::eVertex)
-        && m_fragmentShader.Init(m_device, "main", "../shaders/shader.frag.spv", vk::ShaderStageFlagBits::eFragment);
+    return m_vertexBuffer.Stage(m_device, s_vertices, sizeof(s_vertices), vk::BufferUsageFlagBits::eVertexBuffer);
 }
 
-bool Render::CreateVertexBuffer()
+bool Render::ReserveInstances(size_t count)
 {
-    return m_vertexBuffer.Stage(m_device, s_vertices, sizeof(s_vertices), vk::BufferUsageFlagBits::eVertexBuffer);
+    if (count <= m_instanceCapacity)
+        return true;
+
+    // The previous frame has retired by now, so the old buffer can go right away
+    m_instanceBuffer.Destroy(m_device);
+    m_instanceSceneVersion = 0;
+    m_instanceCapacity = std::max(count, m_instanceCapacity * 2);
+    // Also read as a storage buffer by the GPU culling pass
+    vk::BufferUsageFlags const usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+    if (!m_instanceBuffer.Allocate(m_device, m_instanceCapacity * sizeof(SurfaceConstants), usage))
+    {
+        std::cerr << "Failed to allocate surface instance buffer." << std::endl;
+        m_instanceBuffer.Destroy(m_device);
+        m_instanceCapacity = 0;
+        return false;
+    }
+
+    return true;
 }
 
 bool Render::CreateRenderPass()
@@ -217,6 +1142,28 @@ bool Render::CreateRenderPass()
         return false;
     }
 
+    // The overlay pass is compatible with the composite one, but keeps what is in the image
+    // and waits for whatever wrote it earlier in the frame
+    attachmentDescription.setInitialLayout(vk::ImageLayout::ePresentSrcKHR);
+    attachmentDescription.setLoadOp(vk::AttachmentLoadOp::eLoad);
+
+    vk::SubpassDependency dependency;
+    dependency.setSrcSubpass(VK_SUBPASS_EXTERNAL);
+    dependency.setDstSubpass(0);
+    dependency.setSrcStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer);
+    dependency.setSrcAccessMask(vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eTransferWrite);
+    dependency.setDstStageMask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+    dependency.setDstAccessMask(vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite);
+    renderPassCreateInfo.setDependencyCount(1);
+    renderPassCreateInfo.setPDependencies(&dependency);
+
+    std::tie(status, m_overlayRenderPass) = m_device.logical.createRenderPass(renderPassCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create overlay render pass." << std::endl;
+        return false;
+    }
+
     return true;
 }
 
@@ -245,94 +1192,32 @@ bool Render::CreateFramebuffers()
 
 bool Render::CreatePipeline()
 {
-    vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo;
-    vertexInputCreateInfo.setVertexAttributeDescriptionCount(1);
-    vertexInputCreateInfo.setPVertexAttributeDescriptions(&Vertex::s_inputAttributeDescription);
-    vertexInputCreateInfo.setVertexBindingDescriptionCount(1);
-    vertexInputCreateInfo.setPVertexBindingDescriptions(&Vertex::s_inputBindingDescription);
-
-    vk::PipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo;
-    inputAssemblyCreateInfo.setTopology(vk::PrimitiveTopology::eTriangleList);
-    inputAssemblyCreateInfo.setPrimitiveRestartEnable(false);
-
-    vk::PipelineShaderStageCreateInfo const shaderStages[2] = {
-        m_vertexShader.shaderStage, m_fragmentShader.shaderStage
-    };
-
-    vk::Viewport viewport;
-    viewport.setWidth(static_cast<float>(m_window.width));
-    viewport.setHeight(static_cast<float>(m_window.height));
-    viewport.setX(0);
-    viewport.setY(0);
-    viewport.setMaxDepth(1.0f);
-    viewport.setMinDepth(0);
-
-    vk::Rect2D scissor;
-    scissor.setOffset({ 0, 0 });
-    scissor.setExtent({ m_window.width, m_window.height });
-
-    vk::PipelineViewportStateCreateInfo viewportCreateInfo;
-    viewportCreateInfo.setScissorCount(1);
-    viewportCreateInfo.setPScissors(&scissor);
-    viewportCreateInfo.setViewportCount(1);
-    viewportCreateInfo.setPViewports(&viewport);
-
-    vk::PipelineRasterizationStateCreateInfo rasterizationCreateInfo;
-    rasterizationCreateInfo.setCullMode(vk::CullModeFlagBits::eNone);
-    rasterizationCreateInfo.setPolygonMode(vk::PolygonMode::eFill);
-    rasterizationCreateInfo.setFrontFace(vk::FrontFace::eClockwise);
-    rasterizationCreateInfo.setLineWidth(1.0f);
-    rasterizationCreateInfo.setDepthClampEnable(false);
-    rasterizationCreateInfo.setDepthBiasEnable(false);
-    rasterizationCreateInfo.setRasterizerDiscardEnable(false);
-
-    vk::PipelineMultisampleStateCreateInfo multisamplingCreateInfo;
-    multisamplingCreateInfo.setSampleShadingEnable(false);
-    multisamplingCreateInfo.setRasterizationSamples(vk::SampleCountFlagBits::e1);
-
-    vk::PipelineColorBlendAttachmentState colorBlendAttachmentState;
-    colorBlendAttachmentState.setBlendEnable(false);
-    colorBlendAttachmentState.setColorWriteMask(
-        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
-
-    vk::PipelineColorBlendStateCreateInfo colorBlendCreateInfo;
-    colorBlendCreateInfo.setAttachmentCount(1);
-    colorBlendCreateInfo.setPAttachments(&colorBlendAttachmentState);
-    colorBlendCreateInfo.setLogicOpEnable(false);
-
-    vk::PipelineLayoutCreateInfo layoutCreateInfo;
-    std::tie(status, m_pipelineLayout) = m_device.logical.createPipelineLayout(layoutCreateInfo);
-    if (status != vk::Result::eSuccess)
+    // Every planar format gets its own layout since its sampler is baked into the set layout
+    for (uint32_t i = 0; i < YcbcrSamplers::s_formatCount; ++i)
     {
-        std::cerr << "Failed to create pipeline layout." << std::endl;
-        return false;
-    }
+        PlanarFormat const format = static_cast<PlanarFormat>(i);
+        if (format != PlanarFormat::eNone && !m_ycbcr.Supports(format))
+            continue;
 
-    vk::PipelineCacheCreateInfo cacheCreateInfo;
-    std::tie(status, m_pipelineCache) = m_device.logical.createPipelineCache(cacheCreateInfo);
-    if (status != vk::Result::eSuccess)
-    {
-        std::cerr << "Failed to create pipeline cache." << std::endl;
-        return false;
-    }
+        vk::DescriptorSetLayout const setLayout = format == PlanarFormat::eNone
+            ? m_descriptorSetLayout : m_ycbcr.GetDescriptorSetLayout(format);
 
-    vk::GraphicsPipelineCreateInfo pipelineCreateInfo;
-    pipelineCreateInfo.setPVertexInputState(&vertexInputCreateInfo);
-    pipelineCreateInfo.setPInputAssemblyState(&inputAssemblyCreateInfo);
-    pipelineCreateInfo.setStageCount(2);
-    pipelineCreateInfo.setPStages(shaderStages);
-    pipelineCreateInfo.setPViewportState(&viewportCreateInfo);
-    pipelineCreateInfo.setPRasterizationState(&rasterizationCreateInfo);
-    pipelineCreateInfo.setPMultisampleState(&multisamplingCreateInfo);
-    pipelineCreateInfo.setPColorBlendState(&colorBlendCreateInfo);
-    pipelineCreateInfo.setRenderPass(m_renderPass);
-    pipelineCreateInfo.setSubpass(0);
-    pipelineCreateInfo.setLayout(m_pipelineLayout);
+        // Frame uniforms come first, so their set stays compatible across planar formats
+        vk::DescriptorSetLayout const setLayouts[2] = { m_frameAllocator.GetUniformSetLayout(), setLayout };
+        vk::PipelineLayoutCreateInfo layoutCreateInfo;
+        layoutCreateInfo.setSetLayoutCount(2);
+        layoutCreateInfo.setPSetLayouts(setLayouts);
+        std::tie(status, m_pipelineLayouts[i]) = m_device.logical.createPipelineLayout(layoutCreateInfo);
+        if (status != vk::Result::eSuccess)
+        {
+            std::cerr << "Failed to create pipeline layout." << std::endl;
+            return false;
+        }
+    }
 
-    std::tie(status, m_pipeline) = m_device.logical.createGraphicsPipeline(m_pipelineCache, pipelineCreateInfo);
-    if (status != vk::Result::eSuccess)
+    if (!m_pipelines.Init(m_renderPass, m_pipelineLayouts, m_vertexShader, m_fragmentShader))
     {
-        std::cerr << "Failed to create graphics pipeline." << std::endl;
+        status = m_pipelines.status;
         return false;
     }
 
@@ -364,6 +1249,101 @@ bool Render::CreateCommandBuffers()
         return false;
     }
 
+    if (!m_device.asyncCompute)
+        return true;
+
+    // Effect passes get a graphics command buffer for backdrops and one for the compute queue
+    status = m_device.logical.allocateCommandBuffers(&cmdAllocInfo, &m_effectCommandBuffer);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate effect command buffer." << std::endl;
+        return false;
+    }
+
+    cmdPoolCreateInfo.setQueueFamilyIndex(m_device.computeQueue.familyIndex);
+    std::tie(status, m_computeCommandPool) = m_device.logical.createCommandPool(cmdPoolCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate compute command buffer pool." << std::endl;
+        return false;
+    }
+
+    cmdAllocInfo.setCommandPool(m_computeCommandPool);
+    status = m_device.logical.allocateCommandBuffers(&cmdAllocInfo, &m_computeCommandBuffer);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate compute command buffer." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Render::CreateDescriptors()
+{
+    vk::SamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.setMagFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMinFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+
+    std::tie(status, m_sampler) = m_device.logical.createSampler(samplerCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create sampler." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetLayoutBinding binding;
+    binding.setBinding(0);
+    binding.setDescriptorCount(1);
+    binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setBindingCount(1);
+    layoutCreateInfo.setPBindings(&binding);
+
+    std::tie(status, m_descriptorSetLayout) = m_device.logical.createDescriptorSetLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create descriptor set layout." << std::endl;
+        return false;
+    }
+
+    // Y'CbCr conversion samplers may consume up to one descriptor per plane
+    // Blurred panel backdrops draw the surfaces below them a second time, and frames with
+    // more distinct textures than this chain further pools
+    std::vector<vk::DescriptorPoolSize> const poolSizes{
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, m_maxSurfaceCount * 4 * 3)
+    };
+    if (!m_frameAllocator.Init(poolSizes, m_maxSurfaceCount * 4, sizeof(FrameUniforms), 1, vk::ShaderStageFlagBits::eVertex))
+    {
+        status = m_frameAllocator.status;
+        return false;
+    }
+
+    return true;
+}
+
+bool Render::PushFrameUniforms()
+{
+    FrameUniforms uniforms = {};
+    for (uint32_t i = 0; i < 4; ++i)
+        uniforms.transform[i * 4 + i] = 1.0f;
+    uniforms.outputSize[0] = static_cast<float>(m_window.width);
+    uniforms.outputSize[1] = static_cast<float>(m_window.height);
+    uniforms.time = std::chrono::duration<float>(Clock::now() - m_initTime).count();
+    uniforms.frame = static_cast<float>(m_frameIndex);
+
+    if (!m_frameAllocator.PushUniforms(&uniforms, sizeof(uniforms), m_frameUniformOffset))
+    {
+        std::cerr << "Failed to push frame uniforms." << std::endl;
+        return false;
+    }
+
     return true;
 }
 
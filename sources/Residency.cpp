@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Residency.hpp>
+#include <Trace.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace vkc
+{
+
+ResidencyManager::ResidencyManager(Device & device)
+    : m_device(device)
+{
+}
+
+ResidencyManager::~ResidencyManager()
+{
+    Shutdown();
+}
+
+bool ResidencyManager::Init()
+{
+    vk::CommandPoolCreateInfo cmdPoolCreateInfo;
+    cmdPoolCreateInfo.setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer);
+    cmdPoolCreateInfo.setQueueFamilyIndex(m_device.queue.familyIndex);
+
+    std::tie(status, m_commandPool) = m_device.logical.createCommandPool(cmdPoolCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate residency command pool." << std::endl;
+        return false;
+    }
+
+    vk::CommandBufferAllocateInfo cmdAllocInfo;
+    cmdAllocInfo.setCommandBufferCount(1);
+    cmdAllocInfo.setCommandPool(m_commandPool);
+    cmdAllocInfo.setLevel(vk::CommandBufferLevel::ePrimary);
+
+    std::vector<vk::CommandBuffer> commandBuffers;
+    std::tie(status, commandBuffers) = m_device.logical.allocateCommandBuffers(cmdAllocInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate residency command buffer." << std::endl;
+        return false;
+    }
+    m_commandBuffer = commandBuffers.front();
+
+    vk::FenceCreateInfo fenceCreateInfo;
+    std::tie(status, m_fence) = m_device.logical.createFence(fenceCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create residency fence." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void ResidencyManager::Shutdown()
+{
+    if (m_fence)
+        m_device.logical.destroyFence(m_fence);
+    if (m_commandPool)
+        m_device.logical.destroyCommandPool(m_commandPool);
+
+    m_fence = vk::Fence();
+    m_commandBuffer = vk::CommandBuffer();
+    m_commandPool = vk::CommandPool();
+}
+
+void ResidencyManager::Update(std::vector<Surface>& surfaces)
+{
+    std::vector<std::vector<Surface>*> surfaceLists{ &surfaces };
+    Update(surfaceLists);
+}
+
+void ResidencyManager::Update(std::vector<std::vector<Surface>*> const& surfaceLists)
+{
+    VKC_TRACE_SCOPE("ResidencyManager::Update");
+    Clock::time_point const now = Clock::now();
+    m_clientUsage.clear();
+
+    for (std::vector<Surface>* pSurfaces : surfaceLists)
+    {
+        for (Surface& surface : *pSurfaces)
+        {
+            if (surface.visible)
+            {
+                surface.residency.lastVisible = now;
+                if (surface.residency.evicted && !surface.residency.contentLost)
+                    Restore(surface);
+            }
+            m_clientUsage[surface.client] += surface.texture.memorySize;
+        }
+    }
+
+    vk::DeviceSize overBudget = m_device.memoryBudget.GetOverBudgetSize(budgetFraction);
+    if (overBudget == 0)
+        return;
+
+    // Hidden surfaces are evicted starting with the one that has been hidden the longest
+    std::vector<Surface*> candidates;
+    for (std::vector<Surface>* pSurfaces : surfaceLists)
+    {
+        for (Surface& surface : *pSurfaces)
+        {
+            if (!surface.visible && surface.texture.memory)
+                candidates.push_back(&surface);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [](Surface const* pLeft, Surface const* pRight) {
+        return pLeft->residency.lastVisible < pRight->residency.lastVisible;
+    });
+
+    for (Surface* pSurface : candidates)
+    {
+        if (overBudget == 0)
+            break;
+
+        vk::DeviceSize const size = pSurface->texture.memorySize;
+        if (Evict(*pSurface))
+        {
+            m_clientUsage[pSurface->client] -= size;
+            overBudget = size < overBudget ? overBudget - size : 0;
+        }
+    }
+}
+
+vk::DeviceSize ResidencyManager::GetClientUsage(uint32_t client) const
+{
+    auto const usage = m_clientUsage.find(client);
+    return usage != m_clientUsage.end() ? usage->second : 0;
+}
+
+bool ResidencyManager::CanKeepHostCopy(Image const& texture) const
+{
+    bool const readable = static_cast<bool>(texture.usage & vk::ImageUsageFlagBits::eTransferSrc);
+    switch (texture.format)
+    {
+    case vk::Format::eB8G8R8A8Unorm:
+    case vk::Format::eB8G8R8A8Srgb:
+    case vk::Format::eR8G8B8A8Unorm:
+    case vk::Format::eR8G8B8A8Srgb:
+        return readable;
+    default:
+        return false;
+    }
+}
+
+bool ResidencyManager::Evict(Surface & surface)
+{
+    Image& texture = surface.texture;
+    surface.residency.contentLost = true;
+
+    if (CanKeepHostCopy(texture))
+    {
+        size_t const size = static_cast<size_t>(texture.extent.width) * texture.extent.height * 4;
+        Buffer readback;
+        bool const copied = readback.Allocate(m_device, size, vk::BufferUsageFlagBits::eTransferDst)
+            && Submit([&](vk::CommandBuffer cmd) {
+                vk::ImageMemoryBarrier barrier;
+                barrier.setImage(texture.image);
+                barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+                barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+                barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+                barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eTransferWrite);
+                barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+                barrier.setOldLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+                barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
+                cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eTransfer,
+                    vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                vk::BufferImageCopy region;
+                region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1));
+                region.setImageExtent({ texture.extent.width, texture.extent.height, 1 });
+                cmd.copyImageToBuffer(texture.image, vk::ImageLayout::eTransferSrcOptimal, readback.buffer, 1, &region);
+
+                vk::BufferMemoryBarrier bufferBarrier;
+                bufferBarrier.setBuffer(readback.buffer);
+                bufferBarrier.setSize(VK_WHOLE_SIZE);
+                bufferBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+                bufferBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+                bufferBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+                bufferBarrier.setDstAccessMask(vk::AccessFlagBits::eHostRead);
+                cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost,
+                    {}, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+            });
+
+        if (copied)
+        {
+            surface.residency.hostCopy.resize(size);
+            memcpy(surface.residency.hostCopy.data(), readback.mapped, size);
+            surface.residency.contentLost = false;
+        }
+        readback.Destroy(m_device);
+    }
+
+    texture.Destroy(m_device);
+    surface.residency.evicted = true;
+
+    return true;
+}
+
+bool ResidencyManager::Restore(Surface & surface)
+{
+    VKC_TRACE_SCOPE("ResidencyManager::Restore");
+    Image& texture = surface.texture;
+    std::vector<uint8_t>& hostCopy = surface.residency.hostCopy;
+
+    vk::Extent2D const contentExtent = texture.contentExtent;
+    Buffer staging;
+    bool const restored = texture.Init(m_device, texture.format, texture.extent, texture.usage | vk::ImageUsageFlagBits::eTransferDst)
+        && staging.Stage(m_device, hostCopy.data(), hostCopy.size(), vk::BufferUsageFlagBits::eTransferSrc)
+        && Submit([&](vk::CommandBuffer cmd) {
+            vk::ImageMemoryBarrier barrier;
+            barrier.setImage(texture.image);
+            barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+            barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+            barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+            barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+            barrier.setOldLayout(vk::ImageLayout::eUndefined);
+            barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+                {}, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            vk::BufferImageCopy region;
+            region.setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1));
+            region.setImageExtent({ texture.extent.width, texture.extent.height, 1 });
+            cmd.copyBufferToImage(staging.buffer, texture.image, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+
+            barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+            barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+            barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+            barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+            cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+                {}, 0, nullptr, 0, nullptr, 1, &barrier);
+        });
+    staging.Destroy(m_device);
+
+    if (!restored)
+    {
+        // Keep the host copy around and try again next frame
+        std::cerr << "Failed to restore evicted surface texture." << std::endl;
+        texture.Destroy(m_device);
+        return false;
+    }
+
+    texture.contentExtent = contentExtent;
+    hostCopy.clear();
+    hostCopy.shrink_to_fit();
+    surface.residency.evicted = false;
+    surface.damage.push_back(surface.rect);
+    surface.contentDamaged = true;
+
+    return true;
+}
+
+bool ResidencyManager::Submit(std::function<void(vk::CommandBuffer)> const& record)
+{
+    vk::CommandBufferBeginInfo beginInfo;
+    beginInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    status = m_commandBuffer.begin(beginInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to begin residency command buffer." << std::endl;
+        return false;
+    }
+
+    record(m_commandBuffer);
+
+    status = m_commandBuffer.end();
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to end residency command buffer." << std::endl;
+        return false;
+    }
+
+    vk::SubmitInfo submitInfo;
+    submitInfo.setCommandBufferCount(1);
+    submitInfo.setPCommandBuffers(&m_commandBuffer);
+    status = m_device.queue.queue.submit(1, &submitInfo, m_fence);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to submit residency cmd." << std::endl;
+        return false;
+    }
+
+    // Eviction and restore are rare, waiting here keeps the frame loop free of extra state
+    while (m_device.logical.waitForFences(1, &m_fence, true, UINT64_MAX) == vk::Result::eTimeout);
+    m_device.logical.resetFences(1, &m_fence);
+    m_commandBuffer.reset({});
+
+    return true;
+}
+
+} // vkc namespace
@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Scene.hpp>
+#include <algorithm>
+
+namespace vkc
+{
+
+namespace
+{
+
+bool Intersects(vk::Rect2D const& a, vk::Rect2D const& b)
+{
+    return a.offset.x < b.offset.x + static_cast<int32_t>(b.extent.width)
+        && b.offset.x < a.offset.x + static_cast<int32_t>(a.extent.width)
+        && a.offset.y < b.offset.y + static_cast<int32_t>(b.extent.height)
+        && b.offset.y < a.offset.y + static_cast<int32_t>(a.extent.height);
+}
+
+bool Contains(vk::Rect2D const& outer, vk::Rect2D const& inner)
+{
+    return outer.offset.x <= inner.offset.x && outer.offset.y <= inner.offset.y
+        && outer.offset.x + static_cast<int64_t>(outer.extent.width) >= inner.offset.x + static_cast<int64_t>(inner.extent.width)
+        && outer.offset.y + static_cast<int64_t>(outer.extent.height) >= inner.offset.y + static_cast<int64_t>(inner.extent.height);
+}
+
+} // anonymous namespace
+
+// Bound to a reference by std::max, so it needs a definition
+size_t const Scene::s_minChangeLogSize;
+
+void Scene::Resize(vk::Extent2D extent)
+{
+    m_extent = extent;
+    m_columns = (extent.width + s_cellSize - 1) / s_cellSize;
+    m_rows = (extent.height + s_cellSize - 1) / s_cellSize;
+    m_cells.assign(static_cast<size_t>(m_columns) * m_rows, std::vector<uint32_t>());
+
+    // Every entry lands in different cells now, so they are all inserted again on the next update
+    m_entries.clear();
+}
+
+void Scene::Update(std::vector<Surface> const& surfaces)
+{
+    // Added or removed surfaces shift the indices of everything above them
+    if (surfaces.size() != m_entries.size())
+    {
+        Rebuild(surfaces);
+        return;
+    }
+
+    // Anything else a client changes on a surface comes with damage
+    bool changed = false;
+    for (uint32_t i = 0; i < surfaces.size(); ++i)
+    {
+        Surface const& surface = surfaces[i];
+        Entry& entry = m_entries[i];
+        bool const opaque = surface.IsOpaque() && surface.HasContent();
+        if (entry.rect == surface.rect && entry.visible == surface.visible && entry.opaque == opaque)
+        {
+            if (!surface.damage.empty() || surface.contentDamaged)
+                LogChange(i);
+            continue;
+        }
+
+        Remove(i);
+        entry.rect = surface.rect;
+        entry.visible = surface.visible;
+        entry.opaque = opaque;
+        Insert(i);
+        LogChange(i);
+        changed = true;
+    }
+
+    if (changed)
+        UpdateCulling();
+    if (!m_changes.empty() && m_changes.back().version > m_version)
+        ++m_version;
+}
+
+uint32_t Scene::HitTest(int32_t x, int32_t y) const
+{
+    if (x < 0 || y < 0 || static_cast<uint32_t>(x) >= m_extent.width || static_cast<uint32_t>(y) >= m_extent.height)
+        return s_none;
+
+    // Cells keep surfaces in back to front order, so the first hit from the back is the topmost one
+    std::vector<uint32_t> const& cell = m_cells[(y / s_cellSize) * m_columns + x / s_cellSize];
+    vk::Rect2D const point({ x, y }, { 1, 1 });
+    for (auto index = cell.rbegin(); index != cell.rend(); ++index)
+    {
+        if (Intersects(m_entries[*index].rect, point))
+            return *index;
+    }
+
+    return s_none;
+}
+
+void Scene::Query(vk::Rect2D const& rect, std::vector<uint32_t>& indices) const
+{
+    indices.clear();
+    CellRange range;
+    if (!GetCellRange(rect, range))
+        return;
+
+    NextQueryStamp();
+    CollectCells(range, rect, indices);
+    std::sort(indices.begin(), indices.end());
+}
+
+void Scene::QueryDamage(std::vector<vk::Rect2D> const& damage, std::vector<uint32_t>& indices) const
+{
+    indices.clear();
+
+    // One stamp for all rectangles, so a surface under several of them is reported once
+    NextQueryStamp();
+    for (vk::Rect2D const& rect : damage)
+    {
+        CellRange range;
+        if (GetCellRange(rect, range))
+            CollectCells(range, rect, indices);
+    }
+    std::sort(indices.begin(), indices.end());
+}
+
+bool Scene::IsCulled(size_t index) const
+{
+    return index >= m_entries.size() || m_entries[index].culled;
+}
+
+bool Scene::IsOffOutput(size_t index) const
+{
+    return index >= m_entries.size() || !m_entries[index].inserted;
+}
+
+size_t Scene::GetCulledCount() const
+{
+    return m_culledCount;
+}
+
+uint64_t Scene::GetVersion() const
+{
+    return m_version;
+}
+
+bool Scene::GetChanges(uint64_t version, std::vector<uint32_t>& indices) const
+{
+    indices.clear();
+    if (version < m_rebuildVersion)
+        return false;
+
+    auto const first = std::upper_bound(m_changes.begin(), m_changes.end(), version,
+        [](uint64_t value, Change const& change) { return value < change.version; });
+    for (auto change = first; change != m_changes.end(); ++change)
+        indices.push_back(change->index);
+    return true;
+}
+
+bool Scene::GetCellRange(vk::Rect2D const& rect, CellRange& range) const
+{
+    int64_t const right = std::min<int64_t>(rect.offset.x + static_cast<int64_t>(rect.extent.width), m_extent.width);
+    int64_t const bottom = std::min<int64_t>(rect.offset.y + static_cast<int64_t>(rect.extent.height), m_extent.height);
+    int64_t const left = std::max<int64_t>(rect.offset.x, 0);
+    int64_t const top = std::max<int64_t>(rect.offset.y, 0);
+    if (left >= right || top >= bottom)
+        return false;
+
+    range.x0 = static_cast<uint32_t>(left) / s_cellSize;
+    range.y0 = static_cast<uint32_t>(top) / s_cellSize;
+    range.x1 = static_cast<uint32_t>(right - 1) / s_cellSize;
+    range.y1 = static_cast<uint32_t>(bottom - 1) / s_cellSize;
+    return true;
+}
+
+void Scene::Insert(uint32_t index)
+{
+    Entry& entry = m_entries[index];
+    if (!entry.visible || !GetCellRange(entry.rect, entry.cells))
+        return;
+
+    for (uint32_t y = entry.cells.y0; y <= entry.cells.y1; ++y)
+    {
+        for (uint32_t x = entry.cells.x0; x <= entry.cells.x1; ++x)
+        {
+            std::vector<uint32_t>& cell = m_cells[y * m_columns + x];
+            cell.insert(std::lower_bound(cell.begin(), cell.end(), index), index);
+        }
+    }
+    entry.inserted = true;
+}
+
+void Scene::Remove(uint32_t index)
+{
+    Entry& entry = m_entries[index];
+    if (!entry.inserted)
+        return;
+
+    for (uint32_t y = entry.cells.y0; y <= entry.cells.y1; ++y)
+    {
+        for (uint32_t x = entry.cells.x0; x <= entry.cells.x1; ++x)
+        {
+            std::vector<uint32_t>& cell = m_cells[y * m_columns + x];
+            auto const position = std::lower_bound(cell.begin(), cell.end(), index);
+            if (position != cell.end() && *position == index)
+                cell.erase(position);
+        }
+    }
+    entry.inserted = false;
+}
+
+void Scene::Rebuild(std::vector<Surface> const& surfaces)
+{
+    for (std::vector<uint32_t>& cell : m_cells)
+        cell.clear();
+
+    // Appending in surface order keeps every cell sorted without a search per insert
+    m_entries.assign(surfaces.size(), Entry());
+    for (uint32_t i = 0; i < surfaces.size(); ++i)
+    {
+        Entry& entry = m_entries[i];
+        entry.rect = surfaces[i].rect;
+        entry.visible = surfaces[i].visible;
+        entry.opaque = surfaces[i].IsOpaque() && surfaces[i].HasContent();
+        if (!entry.visible || !GetCellRange(entry.rect, entry.cells))
+            continue;
+
+        for (uint32_t y = entry.cells.y0; y <= entry.cells.y1; ++y)
+        {
+            for (uint32_t x = entry.cells.x0; x <= entry.cells.x1; ++x)
+                m_cells[y * m_columns + x].push_back(i);
+        }
+        entry.inserted = true;
+    }
+
+    UpdateCulling();
+
+    // Every surface changed, readers of older versions start over
+    m_changes.clear();
+    m_rebuildVersion = ++m_version;
+}
+
+void Scene::UpdateCulling()
+{
+    // An occluder covers the whole surface, so it is listed in every cell of it and the first cell is enough
+    m_culledCount = 0;
+    for (uint32_t i = 0; i < m_entries.size(); ++i)
+    {
+        Entry& entry = m_entries[i];
+        bool const wasCulled = entry.culled;
+        entry.culled = !entry.inserted;
+        if (entry.inserted)
+        {
+            std::vector<uint32_t> const& cell = m_cells[entry.cells.y0 * m_columns + entry.cells.x0];
+            for (auto above = std::upper_bound(cell.begin(), cell.end(), i); above != cell.end(); ++above)
+            {
+                Entry const& occluder = m_entries[*above];
+                if (occluder.opaque && Contains(occluder.rect, entry.rect))
+                {
+                    entry.culled = true;
+                    break;
+                }
+            }
+        }
+
+        if (entry.culled)
+            ++m_culledCount;
+        if (entry.culled != wasCulled)
+            LogChange(i);
+    }
+}
+
+void Scene::LogChange(uint32_t index)
+{
+    // Replaying a log longer than the surfaces costs more than starting over
+    if (m_changes.size() >= std::max(m_entries.size() * 2, s_minChangeLogSize))
+    {
+        m_changes.clear();
+        m_rebuildVersion = m_version + 1;
+    }
+
+    m_changes.push_back({ m_version + 1, index });
+}
+
+void Scene::CollectCells(CellRange const& range, vk::Rect2D const& rect, std::vector<uint32_t>& indices) const
+{
+    for (uint32_t y = range.y0; y <= range.y1; ++y)
+    {
+        for (uint32_t x = range.x0; x <= range.x1; ++x)
+        {
+            for (uint32_t index : m_cells[y * m_columns + x])
+            {
+                if (m_queryMarks[index] == m_queryStamp || !Intersects(m_entries[index].rect, rect))
+                    continue;
+
+                m_queryMarks[index] = m_queryStamp;
+                indices.push_back(index);
+            }
+        }
+    }
+}
+
+uint32_t Scene::NextQueryStamp() const
+{
+    if (m_queryMarks.size() != m_entries.size())
+        m_queryMarks.assign(m_entries.size(), 0);
+
+    // Marks are only cleared when the stamp wraps around
+    if (++m_queryStamp == 0)
+    {
+        std::fill(m_queryMarks.begin(), m_queryMarks.end(), 0);
+        m_queryStamp = 1;
+    }
+
+    return m_queryStamp;
+}
+
+} // vkc namespace
@@ -0,0 +1,452 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <SoftwareRender.hpp>
+#include <Trace.hpp>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKC_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(VKC_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace vkc
+{
+
+namespace
+{
+
+/*
+ * Source pixels are optionally forced opaque or premultiplied, then color channels are
+ * scaled by dim times opacity and alpha by opacity, and the result goes over the
+ * destination. Factors are in [0, 255].
+ */
+struct BlendParams
+{
+    bool forceOpaque;
+    bool straight;
+    uint16_t colorFactor;
+    uint16_t alphaFactor;
+};
+
+uint16_t ToFactor(float value)
+{
+    return static_cast<uint16_t>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// Exactly rounded x / 255 for x in [0, 255 * 255]
+inline uint32_t Div255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void BlendScalar(uint32_t* pDst, uint32_t const* pSrc, size_t count, BlendParams const& params)
+{
+    for (size_t x = 0; x < count; ++x)
+    {
+        uint32_t const src = pSrc[x];
+        uint32_t const dst = pDst[x];
+        uint32_t const sourceAlpha = params.forceOpaque ? 255 : src >> 24;
+        uint32_t const alpha = Div255(sourceAlpha * params.alphaFactor);
+
+        uint32_t result = 0;
+        for (uint32_t shift = 0; shift < 24; shift += 8)
+        {
+            uint32_t channel = (src >> shift) & 0xFF;
+            if (params.straight)
+                channel = Div255(channel * sourceAlpha);
+            channel = Div255(channel * params.colorFactor) + Div255(((dst >> shift) & 0xFF) * (255 - alpha));
+            result |= std::min(channel, 255u) << shift;
+        }
+        result |= std::min(alpha + Div255((dst >> 24) * (255 - alpha)), 255u) << 24;
+
+        pDst[x] = result;
+    }
+}
+
+#if defined(VKC_SSE)
+inline __m128i Div255(__m128i x)
+{
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+inline __m128i BroadcastAlpha(__m128i pixels)
+{
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Two pixels unpacked to 16 bit channels
+inline __m128i BlendPixels(__m128i src, __m128i dst, __m128i factors, bool straight)
+{
+    if (straight)
+    {
+        __m128i const colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        __m128i const alphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        __m128i const alpha = _mm_or_si128(_mm_and_si128(BroadcastAlpha(src), colorLanes), alphaLanes);
+        src = Div255(_mm_mullo_epi16(src, alpha));
+    }
+
+    src = Div255(_mm_mullo_epi16(src, factors));
+    __m128i const inverseAlpha = _mm_sub_epi16(_mm_set1_epi16(255), BroadcastAlpha(src));
+    return _mm_add_epi16(src, Div255(_mm_mullo_epi16(dst, inverseAlpha)));
+}
+#endif
+
+#if defined(VKC_AVX2)
+inline __m256i Div255(__m256i x)
+{
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+inline __m256i BroadcastAlpha(__m256i pixels)
+{
+    return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Four pixels unpacked to 16 bit channels
+inline __m256i BlendPixels(__m256i src, __m256i dst, __m256i factors, bool straight)
+{
+    if (straight)
+    {
+        __m256i const colorLanes = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1);
+        __m256i const alphaLanes = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+        __m256i const alpha = _mm256_or_si256(_mm256_and_si256(BroadcastAlpha(src), colorLanes), alphaLanes);
+        src = Div255(_mm256_mullo_epi16(src, alpha));
+    }
+
+    src = Div255(_mm256_mullo_epi16(src, factors));
+    __m256i const inverseAlpha = _mm256_sub_epi16(_mm256_set1_epi16(255), BroadcastAlpha(src));
+    return _mm256_add_epi16(src, Div255(_mm256_mullo_epi16(dst, inverseAlpha)));
+}
+#endif
+
+void BlendRow(uint32_t* pDst, uint32_t const* pSrc, size_t count, BlendParams const& params)
+{
+    size_t x = 0;
+#if defined(VKC_AVX2) || defined(VKC_SSE)
+    int32_t const opaqueMask = params.forceOpaque ? static_cast<int32_t>(0xFF000000) : 0;
+    int16_t const color = static_cast<int16_t>(params.colorFactor);
+    int16_t const alpha = static_cast<int16_t>(params.alphaFactor);
+#endif
+
+#if defined(VKC_AVX2)
+    __m256i const zero256 = _mm256_setzero_si256();
+    __m256i const opaque256 = _mm256_set1_epi32(opaqueMask);
+    __m256i const factors256 = _mm256_set_epi16(alpha, color, color, color, alpha, color, color, color,
+        alpha, color, color, color, alpha, color, color, color);
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256i const src = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(pSrc + x)), opaque256);
+        __m256i const dst = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(pDst + x));
+        __m256i const low = BlendPixels(_mm256_unpacklo_epi8(src, zero256), _mm256_unpacklo_epi8(dst, zero256),
+            factors256, params.straight);
+        __m256i const high = BlendPixels(_mm256_unpackhi_epi8(src, zero256), _mm256_unpackhi_epi8(dst, zero256),
+            factors256, params.straight);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pDst + x), _mm256_packus_epi16(low, high));
+    }
+#endif
+
+#if defined(VKC_SSE)
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const opaque = _mm_set1_epi32(opaqueMask);
+    __m128i const factors = _mm_set_epi16(alpha, color, color, color, alpha, color, color, color);
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128i const src = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(pSrc + x)), opaque);
+        __m128i const dst = _mm_loadu_si128(reinterpret_cast<__m128i const*>(pDst + x));
+        __m128i const low = BlendPixels(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero), factors, params.straight);
+        __m128i const high = BlendPixels(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero), factors, params.straight);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + x), _mm_packus_epi16(low, high));
+    }
+#endif
+
+    BlendScalar(pDst + x, pSrc + x, count - x, params);
+}
+
+/*
+ * Texel coordinate of a destination pixel center in 1/256 texel units, with the texel
+ * centers at whole units like a linear filter sees them, clamped to the edge texels.
+ */
+struct FilterTap
+{
+    uint32_t first;
+    uint32_t second;
+    uint32_t weight;
+};
+
+inline FilterTap GetFilterTap(uint64_t position, uint32_t sourceSize, uint32_t targetSize)
+{
+    int64_t const coordinate = static_cast<int64_t>((position * 2 + 1) * sourceSize * 256 / (targetSize * 2ull)) - 128;
+    if (coordinate <= 0)
+        return { 0, 0, 0 };
+
+    uint32_t const first = static_cast<uint32_t>(coordinate >> 8);
+    if (first + 1 >= sourceSize)
+        return { sourceSize - 1, sourceSize - 1, 0 };
+
+    return { first, first + 1, static_cast<uint32_t>(coordinate & 0xFF) };
+}
+
+// Weights are in [0, 256], the result is rounded
+inline uint32_t FilterTexels(uint32_t topLeft, uint32_t topRight, uint32_t bottomLeft, uint32_t bottomRight,
+    uint32_t weightX, uint32_t weightY)
+{
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8)
+    {
+        uint32_t const top = ((topLeft >> shift) & 0xFF) * (256 - weightX) + ((topRight >> shift) & 0xFF) * weightX;
+        uint32_t const bottom = ((bottomLeft >> shift) & 0xFF) * (256 - weightX) + ((bottomRight >> shift) & 0xFF) * weightX;
+        result |= ((top * (256 - weightY) + bottom * weightY + 32768) >> 16) << shift;
+    }
+    return result;
+}
+
+bool Intersect(vk::Rect2D const& a, vk::Rect2D const& b, vk::Rect2D& result)
+{
+    int64_t const left = std::max<int64_t>(a.offset.x, b.offset.x);
+    int64_t const top = std::max<int64_t>(a.offset.y, b.offset.y);
+    int64_t const right = std::min<int64_t>(a.offset.x + static_cast<int64_t>(a.extent.width), b.offset.x + static_cast<int64_t>(b.extent.width));
+    int64_t const bottom = std::min<int64_t>(a.offset.y + static_cast<int64_t>(a.extent.height), b.offset.y + static_cast<int64_t>(b.extent.height));
+    if (left >= right || top >= bottom)
+        return false;
+
+    result = vk::Rect2D({ static_cast<int32_t>(left), static_cast<int32_t>(top) },
+        { static_cast<uint32_t>(right - left), static_cast<uint32_t>(bottom - top) });
+    return true;
+}
+
+} // anonymous namespace
+
+// Bound to references by std::fill and the pixel vector, so it needs a definition
+uint32_t const SoftwareRender::s_clearColor;
+
+SoftwareRender::SoftwareRender(vk::Extent2D extent, uint32_t threadCount)
+    : m_extent(extent)
+    , m_pixels(static_cast<size_t>(extent.width) * extent.height, s_clearColor)
+    , m_bandCount(std::max(1u, std::min(threadCount, extent.height)))
+{
+    m_rowBuffers.assign(m_bandCount, std::vector<uint32_t>(extent.width));
+
+    // The calling thread renders the first band itself
+    for (uint32_t band = 1; band < m_bandCount; ++band)
+        m_workers.emplace_back(&SoftwareRender::WorkerLoop, this, band);
+}
+
+SoftwareRender::~SoftwareRender()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopWorkers = true;
+    }
+    m_startCondition.notify_all();
+
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+bool SoftwareRender::Frame(std::vector<Surface> const& surfaces, Scene const& scene)
+{
+    VKC_TRACE_SCOPE("SoftwareRender::Frame");
+    CollectDamage(surfaces);
+    ++m_frameIndex;
+    if (m_damage.empty())
+        return true;
+
+    // Scene queries share scratch state, so candidates are looked up before the bands start
+    m_damageSurfaces.resize(m_damage.size());
+    for (size_t i = 0; i < m_damage.size(); ++i)
+        scene.Query(m_damage[i], m_damageSurfaces[i]);
+
+    m_pSurfaces = &surfaces;
+    m_pScene = &scene;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingBands = m_bandCount - 1;
+        ++m_generation;
+    }
+    m_startCondition.notify_all();
+
+    RenderBand(0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCondition.wait(lock, [this]() { return m_pendingBands == 0; });
+    m_pSurfaces = nullptr;
+    m_pScene = nullptr;
+
+    return true;
+}
+
+uint64_t SoftwareRender::GetSubmittedFrameCount() const
+{
+    return m_frameIndex;
+}
+
+uint64_t SoftwareRender::GetCompletedFrameCount() const
+{
+    return m_frameIndex;
+}
+
+vk::Extent2D SoftwareRender::GetExtent() const
+{
+    return m_extent;
+}
+
+std::vector<uint32_t> const& SoftwareRender::GetPixels() const
+{
+    return m_pixels;
+}
+
+uint64_t SoftwareRender::GetDamagedPixelCount() const
+{
+    return m_damagedPixelCount;
+}
+
+char const* SoftwareRender::GetKernelName()
+{
+#if defined(VKC_AVX2)
+    return "avx2";
+#elif defined(VKC_SSE)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void SoftwareRender::CollectDamage(std::vector<Surface> const& surfaces)
+{
+    vk::Rect2D const output({ 0, 0 }, m_extent);
+    m_damage.clear();
+    m_damagedPixelCount = 0;
+
+    // Added or removed surfaces don't necessarily come with damage, so they redraw everything
+    if (m_frameIndex == 0 || surfaces.size() != m_surfaceCount)
+    {
+        m_surfaceCount = surfaces.size();
+        m_damage.push_back(output);
+        m_damagedPixelCount = static_cast<uint64_t>(m_extent.width) * m_extent.height;
+        return;
+    }
+
+    vk::Rect2D clipped;
+    for (Surface const& surface : surfaces)
+    {
+        for (vk::Rect2D const& damage : surface.damage)
+        {
+            if (Intersect(damage, output, clipped))
+                m_damage.push_back(clipped);
+        }
+
+        if (surface.visible && surface.contentDamaged && Intersect(surface.rect, output, clipped))
+            m_damage.push_back(clipped);
+    }
+
+    for (vk::Rect2D const& damage : m_damage)
+        m_damagedPixelCount += static_cast<uint64_t>(damage.extent.width) * damage.extent.height;
+}
+
+void SoftwareRender::WorkerLoop(uint32_t band)
+{
+    VKC_TRACE_THREAD_NAME("Software band worker");
+    uint64_t generation = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_startCondition.wait(lock, [this, generation]() { return m_stopWorkers || m_generation != generation; });
+            if (m_stopWorkers)
+                return;
+            generation = m_generation;
+        }
+
+        RenderBand(band);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_pendingBands;
+        }
+        m_doneCondition.notify_one();
+    }
+}
+
+void SoftwareRender::RenderBand(uint32_t band)
+{
+    VKC_TRACE_SCOPE("SoftwareRender::RenderBand");
+    uint32_t const top = static_cast<uint32_t>(static_cast<uint64_t>(m_extent.height) * band / m_bandCount);
+    uint32_t const bottom = static_cast<uint32_t>(static_cast<uint64_t>(m_extent.height) * (band + 1) / m_bandCount);
+    vk::Rect2D const bandRect({ 0, static_cast<int32_t>(top) }, { m_extent.width, bottom - top });
+
+    vk::Rect2D rect;
+    for (size_t i = 0; i < m_damage.size(); ++i)
+    {
+        if (Intersect(m_damage[i], bandRect, rect))
+            ComposeRect(rect, m_damageSurfaces[i], m_rowBuffers[band]);
+    }
+}
+
+void SoftwareRender::ComposeRect(vk::Rect2D const& rect, std::vector<uint32_t> const& surfaceIndices, std::vector<uint32_t>& rowBuffer)
+{
+    for (uint32_t y = 0; y < rect.extent.height; ++y)
+    {
+        uint32_t* const pRow = m_pixels.data() + static_cast<size_t>(rect.offset.y + y) * m_extent.width + rect.offset.x;
+        std::fill(pRow, pRow + rect.extent.width, s_clearColor);
+    }
+
+    vk::Rect2D area;
+    for (uint32_t index : surfaceIndices)
+    {
+        Surface const& surface = (*m_pSurfaces)[index];
+        vk::Extent2D const content = surface.texture.contentExtent;
+        if (m_pScene->IsCulled(index) || content.width == 0 || content.height == 0
+            || surface.hostPixels.size() < static_cast<size_t>(content.width) * content.height
+            || !Intersect(surface.rect, rect, area))
+        {
+            continue;
+        }
+
+        BlendParams params;
+        params.forceOpaque = surface.blend == BlendMode::eOpaque;
+        params.straight = surface.blend == BlendMode::eStraight;
+        params.colorFactor = ToFactor(surface.opacity * surface.dim);
+        params.alphaFactor = ToFactor(surface.opacity);
+
+        // Scaled surfaces are filtered bilinearly with clamped edges, like the sampler of the raster path
+        bool const native = surface.rect.extent == content;
+        uint64_t const left = static_cast<uint64_t>(area.offset.x - surface.rect.offset.x);
+        uint64_t const top = static_cast<uint64_t>(area.offset.y - surface.rect.offset.y);
+        for (uint32_t y = 0; y < area.extent.height; ++y)
+        {
+            uint32_t const* pSource = nullptr;
+            if (native)
+            {
+                pSource = surface.hostPixels.data() + (top + y) * content.width + left;
+            }
+            else
+            {
+                FilterTap const tapY = GetFilterTap(top + y, content.height, surface.rect.extent.height);
+                uint32_t const* const pFirstRow = surface.hostPixels.data() + static_cast<size_t>(tapY.first) * content.width;
+                uint32_t const* const pSecondRow = surface.hostPixels.data() + static_cast<size_t>(tapY.second) * content.width;
+                for (uint32_t x = 0; x < area.extent.width; ++x)
+                {
+                    FilterTap const tapX = GetFilterTap(left + x, content.width, surface.rect.extent.width);
+                    rowBuffer[x] = FilterTexels(pFirstRow[tapX.first], pFirstRow[tapX.second],
+                        pSecondRow[tapX.first], pSecondRow[tapX.second], tapX.weight, tapY.weight);
+                }
+                pSource = rowBuffer.data();
+            }
+
+            uint32_t* const pRow = m_pixels.data() + static_cast<size_t>(area.offset.y + y) * m_extent.width + area.offset.x;
+            BlendRow(pRow, pSource, area.extent.width, params);
+        }
+    }
+}
+
+} // vkc namespace
@@ -5,6 +5,7 @@
  */
 #include <Helpers.hpp>
 #include <Structs.hpp>
+#include <atomic>
 
 namespace vkc
 {
@@ -13,15 +14,180 @@ vk::VertexInputBindingDescription const Vertex::s_inputBindingDescription = {
     0, sizeof(Vertex), vk::VertexInputRate::eVertex };
 vk::VertexInputAttributeDescription const Vertex::s_inputAttributeDescription = {
     0, 0, vk::Format::eR32G32B32A32Sfloat, offsetof(Vertex, x) };
+vk::VertexInputBindingDescription const SurfaceConstants::s_inputBindingDescription = {
+    1, sizeof(SurfaceConstants), vk::VertexInputRate::eInstance };
+vk::VertexInputAttributeDescription const SurfaceConstants::s_inputAttributeDescriptions[3] = {
+    { 1, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(SurfaceConstants, rect) },
+    { 2, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(SurfaceConstants, opacity) },
+    { 3, 1, vk::Format::eR32G32B32A32Sfloat, offsetof(SurfaceConstants, size) },
+};
 
-bool Buffer::Stage(Device & device, void const * data, size_t size, vk::BufferUsageFlagBits usage)
+bool Image::Init(Device & device, vk::Format format, vk::Extent2D extent, vk::ImageUsageFlags usage,
+    vk::SamplerYcbcrConversion conversion, uint32_t mipLevels)
+{
+    this->format = format;
+    this->extent = extent;
+    this->contentExtent = extent;
+    this->usage = usage;
+    this->mipLevels = mipLevels;
+    this->generation = NextGeneration();
+
+    return CreateImage(device, usage)
+        && AllocateDeviceMemory(device)
+        && CreateImageView(device, conversion);
+}
+
+void Image::Destroy(Device & device)
+{
+    if (view)
+        device.logical.destroyImageView(view);
+    if (image)
+        device.logical.destroyImage(image);
+    if (memory)
+    {
+        device.logical.freeMemory(memory);
+        device.memoryBudget.OnFree(memoryTypeIndex, memorySize);
+    }
+
+    view = vk::ImageView();
+    image = vk::Image();
+    memory = vk::DeviceMemory();
+    memorySize = 0;
+}
+
+uint64_t Image::NextGeneration()
+{
+    static std::atomic<uint64_t> s_generation{ 0 };
+    return ++s_generation;
+}
+
+bool Image::CreateImage(Device & device, vk::ImageUsageFlags usage)
+{
+    vk::ImageCreateInfo imageCreateInfo;
+    imageCreateInfo.setImageType(vk::ImageType::e2D);
+    imageCreateInfo.setFormat(format);
+    imageCreateInfo.setExtent({ extent.width, extent.height, 1 });
+    imageCreateInfo.setMipLevels(mipLevels);
+    imageCreateInfo.setArrayLayers(1);
+    imageCreateInfo.setSamples(vk::SampleCountFlagBits::e1);
+    imageCreateInfo.setTiling(vk::ImageTiling::eOptimal);
+    imageCreateInfo.setUsage(usage);
+    imageCreateInfo.setSharingMode(vk::SharingMode::eExclusive);
+    imageCreateInfo.setInitialLayout(vk::ImageLayout::eUndefined);
+
+    vk::Result result;
+    std::tie(result, image) = device.logical.createImage(imageCreateInfo);
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create image." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Image::AllocateDeviceMemory(Device & device)
+{
+    vk::MemoryRequirements const memoryRequirements = device.logical.getImageMemoryRequirements(image);
+
+    bool memoryAvailable = false;
+    std::tie(memoryAvailable, memoryTypeIndex) = FindMemoryTypeIndex(
+        device.physical, memoryRequirements.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if (!memoryAvailable)
+    {
+        std::cerr << "Failed to find memory type." << std::endl;
+        return false;
+    }
+
+    vk::MemoryAllocateInfo memoryAllocateInfo;
+    memoryAllocateInfo.setAllocationSize(memoryRequirements.size);
+    memoryAllocateInfo.setMemoryTypeIndex(memoryTypeIndex);
+    vk::Result result;
+    std::tie(result, memory) = device.logical.allocateMemory(memoryAllocateInfo);
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate memory." << std::endl;
+        return false;
+    }
+    memorySize = memoryRequirements.size;
+    device.memoryBudget.OnAllocate(memoryTypeIndex, memorySize);
+
+    result = device.logical.bindImageMemory(image, memory, 0);
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to bind memory to image." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Image::CreateImageView(Device & device, vk::SamplerYcbcrConversion conversion)
+{
+    // Multi-planar images are only sampled through their Y'CbCr conversion
+    vk::SamplerYcbcrConversionInfo conversionInfo(conversion);
+
+    vk::ImageViewCreateInfo imageViewCreateInfo;
+    imageViewCreateInfo.setPNext(conversion ? &conversionInfo : nullptr);
+    imageViewCreateInfo.setFormat(format);
+    imageViewCreateInfo.setImage(image);
+    imageViewCreateInfo.setViewType(vk::ImageViewType::e2D);
+    imageViewCreateInfo.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1));
+
+    vk::Result result;
+    std::tie(result, view) = device.logical.createImageView(imageViewCreateInfo);
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create image view." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Buffer::Stage(Device & device, void const * data, size_t size, vk::BufferUsageFlags usage)
 {
     return CreateBuffer(device, size, usage)
-        && AllocateDeviceMemory(device, size, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
+        && AllocateDeviceMemory(device, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)
         && CopyMemory(device, data, size);
 }
 
-bool Buffer::CreateBuffer(Device & device, size_t size, vk::BufferUsageFlagBits usage)
+bool Buffer::Allocate(Device & device, size_t size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags preferred)
+{
+    if (!CreateBuffer(device, size, usage)
+        || !AllocateDeviceMemory(device, vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, preferred))
+    {
+        return false;
+    }
+
+    vk::Result result;
+    std::tie(result, mapped) = device.logical.mapMemory(memory, 0, size);
+    if (result != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to map memory" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Buffer::Destroy(Device & device)
+{
+    if (buffer)
+        device.logical.destroyBuffer(buffer);
+    if (memory)
+    {
+        device.logical.freeMemory(memory);
+        device.memoryBudget.OnFree(memoryTypeIndex, memorySize);
+    }
+
+    buffer = vk::Buffer();
+    memory = vk::DeviceMemory();
+    mapped = nullptr;
+    memorySize = 0;
+}
+
+bool Buffer::CreateBuffer(Device & device, size_t size, vk::BufferUsageFlags usage)
 {
     vk::BufferCreateInfo bufferCreateInfo;
     bufferCreateInfo.setQueueFamilyIndexCount(1);
@@ -41,11 +207,20 @@ bool Buffer::CreateBuffer(Device & device, size_t size, vk::BufferUsageFlagBits
     return true;
 }
 
-bool Buffer::AllocateDeviceMemory(Device & device, size_t size, vk::MemoryPropertyFlags flags)
+bool Buffer::AllocateDeviceMemory(Device & device, vk::MemoryPropertyFlags flags, vk::MemoryPropertyFlags preferred)
 {
+    vk::MemoryRequirements const memoryRequirements = device.logical.getBufferMemoryRequirements(buffer);
     bool memoryAvailable = false;
-    uint32_t memoryTypeIndex = 0;
-    std::tie(memoryAvailable, memoryTypeIndex) = FindMemoryTypeIndex(device.physical, flags);
+    if (preferred)
+    {
+        std::tie(memoryAvailable, memoryTypeIndex) = FindMemoryTypeIndex(
+            device.physical, memoryRequirements.memoryTypeBits, flags | preferred);
+    }
+    if (!memoryAvailable)
+    {
+        std::tie(memoryAvailable, memoryTypeIndex) = FindMemoryTypeIndex(
+            device.physical, memoryRequirements.memoryTypeBits, flags);
+    }
 
     if (!memoryAvailable)
     {
@@ -53,9 +228,7 @@ bool Buffer::AllocateDeviceMemory(Device & device, size_t size, vk::MemoryProper
         return false;
     }
 
-
     vk::MemoryAllocateInfo memoryAllocateInfo;
-    vk::MemoryRequirements memoryRequirements = device.logical.getBufferMemoryRequirements(buffer);
     memoryAllocateInfo.setAllocationSize(memoryRequirements.size);
     memoryAllocateInfo.setMemoryTypeIndex(memoryTypeIndex);
     vk::Result result;
@@ -65,6 +238,8 @@ bool Buffer::AllocateDeviceMemory(Device & device, size_t size, vk::MemoryProper
         std::cerr << "Failed to allocate memory." << std::endl;
         return false;
     }
+    memorySize = memoryRequirements.size;
+    device.memoryBudget.OnAllocate(memoryTypeIndex, memorySize);
 
     result = device.logical.bindBufferMemory(buffer, memory, 0);
     if (result != vk::Result::eSuccess)
@@ -108,6 +283,7 @@ bool Shader::Init(Device & device, char const * name, char const * path, vk::Sha
     shaderModuleCreateInfo.setCodeSize(static_cast<size_t>(shaderCodeSize));
     shaderModuleCreateInfo.setPCode(reinterpret_cast<uint32_t*>(shaderCodeBuffer));
     std::tie(state, shaderModule) = device.logical.createShaderModule(shaderModuleCreateInfo);
+    free(shaderCodeBuffer);
     if (state != vk::Result::eSuccess)
     {
         std::cerr << "Failed to create shader module: " << name << " " << path << std::endl;
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <SurfaceStore.hpp>
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKC_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(VKC_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace vkc
+{
+
+namespace
+{
+
+struct TransformArgs
+{
+    float const* pX;
+    float const* pY;
+    float const* pWidth;
+    float const* pHeight;
+    float const* pContentWidth;
+    float const* pContentHeight;
+    float const* pTextureWidth;
+    float const* pTextureHeight;
+    float* pNdcX;
+    float* pNdcY;
+    float* pNdcWidth;
+    float* pNdcHeight;
+    float* pUvScaleX;
+    float* pUvScaleY;
+    uint8_t* pDrawable;
+    float outputWidth;
+    float outputHeight;
+};
+
+// The drawable array holds whether a surface is shown and textured on input and is
+// narrowed down to the surfaces that overlap the output
+#if defined(VKC_AVX2)
+void Transform(TransformArgs const& args, size_t count)
+{
+    __m256 const scaleX = _mm256_set1_ps(2.0f / args.outputWidth);
+    __m256 const scaleY = _mm256_set1_ps(2.0f / args.outputHeight);
+    __m256 const outputWidth = _mm256_set1_ps(args.outputWidth);
+    __m256 const outputHeight = _mm256_set1_ps(args.outputHeight);
+    __m256 const one = _mm256_set1_ps(1.0f);
+    __m256 const zero = _mm256_setzero_ps();
+
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256 const x = _mm256_loadu_ps(args.pX + i);
+        __m256 const y = _mm256_loadu_ps(args.pY + i);
+        __m256 const width = _mm256_loadu_ps(args.pWidth + i);
+        __m256 const height = _mm256_loadu_ps(args.pHeight + i);
+
+        _mm256_storeu_ps(args.pNdcX + i, _mm256_sub_ps(_mm256_mul_ps(x, scaleX), one));
+        _mm256_storeu_ps(args.pNdcY + i, _mm256_sub_ps(_mm256_mul_ps(y, scaleY), one));
+        _mm256_storeu_ps(args.pNdcWidth + i, _mm256_mul_ps(width, scaleX));
+        _mm256_storeu_ps(args.pNdcHeight + i, _mm256_mul_ps(height, scaleY));
+        _mm256_storeu_ps(args.pUvScaleX + i,
+            _mm256_div_ps(_mm256_loadu_ps(args.pContentWidth + i), _mm256_loadu_ps(args.pTextureWidth + i)));
+        _mm256_storeu_ps(args.pUvScaleY + i,
+            _mm256_div_ps(_mm256_loadu_ps(args.pContentHeight + i), _mm256_loadu_ps(args.pTextureHeight + i)));
+
+        __m256 overlap = _mm256_and_ps(_mm256_cmp_ps(x, outputWidth, _CMP_LT_OQ),
+            _mm256_cmp_ps(_mm256_add_ps(x, width), zero, _CMP_GT_OQ));
+        overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(y, outputHeight, _CMP_LT_OQ));
+        overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(_mm256_add_ps(y, height), zero, _CMP_GT_OQ));
+        overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(width, zero, _CMP_GT_OQ));
+        overlap = _mm256_and_ps(overlap, _mm256_cmp_ps(height, zero, _CMP_GT_OQ));
+
+        int const mask = _mm256_movemask_ps(overlap);
+        for (size_t lane = 0; lane < 8; ++lane)
+            args.pDrawable[i + lane] &= static_cast<uint8_t>((mask >> lane) & 1);
+    }
+}
+#elif defined(VKC_SSE)
+void Transform(TransformArgs const& args, size_t count)
+{
+    __m128 const scaleX = _mm_set1_ps(2.0f / args.outputWidth);
+    __m128 const scaleY = _mm_set1_ps(2.0f / args.outputHeight);
+    __m128 const outputWidth = _mm_set1_ps(args.outputWidth);
+    __m128 const outputHeight = _mm_set1_ps(args.outputHeight);
+    __m128 const one = _mm_set1_ps(1.0f);
+    __m128 const zero = _mm_setzero_ps();
+
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m128 const x = _mm_loadu_ps(args.pX + i);
+        __m128 const y = _mm_loadu_ps(args.pY + i);
+        __m128 const width = _mm_loadu_ps(args.pWidth + i);
+        __m128 const height = _mm_loadu_ps(args.pHeight + i);
+
+        _mm_storeu_ps(args.pNdcX + i, _mm_sub_ps(_mm_mul_ps(x, scaleX), one));
+        _mm_storeu_ps(args.pNdcY + i, _mm_sub_ps(_mm_mul_ps(y, scaleY), one));
+        _mm_storeu_ps(args.pNdcWidth + i, _mm_mul_ps(width, scaleX));
+        _mm_storeu_ps(args.pNdcHeight + i, _mm_mul_ps(height, scaleY));
+        _mm_storeu_ps(args.pUvScaleX + i,
+            _mm_div_ps(_mm_loadu_ps(args.pContentWidth + i), _mm_loadu_ps(args.pTextureWidth + i)));
+        _mm_storeu_ps(args.pUvScaleY + i,
+            _mm_div_ps(_mm_loadu_ps(args.pContentHeight + i), _mm_loadu_ps(args.pTextureHeight + i)));
+
+        __m128 overlap = _mm_and_ps(_mm_cmplt_ps(x, outputWidth), _mm_cmpgt_ps(_mm_add_ps(x, width), zero));
+        overlap = _mm_and_ps(overlap, _mm_cmplt_ps(y, outputHeight));
+        overlap = _mm_and_ps(overlap, _mm_cmpgt_ps(_mm_add_ps(y, height), zero));
+        overlap = _mm_and_ps(overlap, _mm_cmpgt_ps(width, zero));
+        overlap = _mm_and_ps(overlap, _mm_cmpgt_ps(height, zero));
+
+        int const mask = _mm_movemask_ps(overlap);
+        for (size_t lane = 0; lane < 4; ++lane)
+            args.pDrawable[i + lane] &= static_cast<uint8_t>((mask >> lane) & 1);
+    }
+}
+#else
+void Transform(TransformArgs const& args, size_t count)
+{
+    float const scaleX = 2.0f / args.outputWidth;
+    float const scaleY = 2.0f / args.outputHeight;
+    for (size_t i = 0; i < count; ++i)
+    {
+        args.pNdcX[i] = args.pX[i] * scaleX - 1.0f;
+        args.pNdcY[i] = args.pY[i] * scaleY - 1.0f;
+        args.pNdcWidth[i] = args.pWidth[i] * scaleX;
+        args.pNdcHeight[i] = args.pHeight[i] * scaleY;
+        args.pUvScaleX[i] = args.pContentWidth[i] / args.pTextureWidth[i];
+        args.pUvScaleY[i] = args.pContentHeight[i] / args.pTextureHeight[i];
+
+        bool const overlap = args.pX[i] < args.outputWidth && args.pX[i] + args.pWidth[i] > 0.0f
+            && args.pY[i] < args.outputHeight && args.pY[i] + args.pHeight[i] > 0.0f
+            && args.pWidth[i] > 0.0f && args.pHeight[i] > 0.0f;
+        args.pDrawable[i] &= static_cast<uint8_t>(overlap);
+    }
+}
+#endif
+
+} // anonymous namespace
+
+void SurfaceStore::Update(std::vector<Surface> const& surfaces, vk::Extent2D output)
+{
+    Resize(surfaces.size());
+
+    for (size_t i = 0; i < m_count; ++i)
+    {
+        Surface const& surface = surfaces[i];
+        m_x[i] = static_cast<float>(surface.rect.offset.x);
+        m_y[i] = static_cast<float>(surface.rect.offset.y);
+        m_width[i] = static_cast<float>(surface.rect.extent.width);
+        m_height[i] = static_cast<float>(surface.rect.extent.height);
+        m_opacity[i] = surface.opacity;
+        m_dim[i] = surface.dim;
+        m_cornerRadius[i] = surface.cornerRadius;
+        m_contentWidth[i] = static_cast<float>(surface.texture.contentExtent.width);
+        m_contentHeight[i] = static_cast<float>(surface.texture.contentExtent.height);
+        m_textureWidth[i] = static_cast<float>(std::max(surface.texture.extent.width, 1u));
+        m_textureHeight[i] = static_cast<float>(std::max(surface.texture.extent.height, 1u));
+        m_drawable[i] = surface.visible && surface.texture.view;
+    }
+
+    TransformArgs args;
+    args.pX = m_x.data();
+    args.pY = m_y.data();
+    args.pWidth = m_width.data();
+    args.pHeight = m_height.data();
+    args.pContentWidth = m_contentWidth.data();
+    args.pContentHeight = m_contentHeight.data();
+    args.pTextureWidth = m_textureWidth.data();
+    args.pTextureHeight = m_textureHeight.data();
+    args.pNdcX = m_ndcX.data();
+    args.pNdcY = m_ndcY.data();
+    args.pNdcWidth = m_ndcWidth.data();
+    args.pNdcHeight = m_ndcHeight.data();
+    args.pUvScaleX = m_uvScaleX.data();
+    args.pUvScaleY = m_uvScaleY.data();
+    args.pDrawable = m_drawable.data();
+    args.outputWidth = static_cast<float>(std::max(output.width, 1u));
+    args.outputHeight = static_cast<float>(std::max(output.height, 1u));
+    Transform(args, m_x.size());
+}
+
+void SurfaceStore::Pack(SurfaceConstants* pInstances) const
+{
+    size_t i = 0;
+
+#if defined(VKC_SSE)
+    // Four surfaces at a time, every field group is transposed into one vec4 attribute per surface.
+    // Non temporal stores keep write combined instance memory from being read into the cache.
+    bool const aligned = reinterpret_cast<uintptr_t>(pInstances) % 16 == 0;
+    __m128 const zero = _mm_setzero_ps();
+    for (; i + 4 <= m_count; i += 4)
+    {
+        __m128 rect[4] = { _mm_loadu_ps(&m_ndcX[i]), _mm_loadu_ps(&m_ndcY[i]),
+            _mm_loadu_ps(&m_ndcWidth[i]), _mm_loadu_ps(&m_ndcHeight[i]) };
+        __m128 parameters[4] = { _mm_loadu_ps(&m_opacity[i]), _mm_loadu_ps(&m_dim[i]),
+            _mm_loadu_ps(&m_cornerRadius[i]), zero };
+        __m128 sizeUvScale[4] = { _mm_loadu_ps(&m_width[i]), _mm_loadu_ps(&m_height[i]),
+            _mm_loadu_ps(&m_uvScaleX[i]), _mm_loadu_ps(&m_uvScaleY[i]) };
+        _MM_TRANSPOSE4_PS(rect[0], rect[1], rect[2], rect[3]);
+        _MM_TRANSPOSE4_PS(parameters[0], parameters[1], parameters[2], parameters[3]);
+        _MM_TRANSPOSE4_PS(sizeUvScale[0], sizeUvScale[1], sizeUvScale[2], sizeUvScale[3]);
+
+        for (size_t lane = 0; lane < 4; ++lane)
+        {
+            float* const pDst = reinterpret_cast<float*>(pInstances + i + lane);
+            if (aligned)
+            {
+                _mm_stream_ps(pDst, rect[lane]);
+                _mm_stream_ps(pDst + 4, parameters[lane]);
+                _mm_stream_ps(pDst + 8, sizeUvScale[lane]);
+            }
+            else
+            {
+                _mm_storeu_ps(pDst, rect[lane]);
+                _mm_storeu_ps(pDst + 4, parameters[lane]);
+                _mm_storeu_ps(pDst + 8, sizeUvScale[lane]);
+            }
+        }
+    }
+    _mm_sfence();
+#endif
+
+    for (; i < m_count; ++i)
+    {
+        SurfaceConstants& instance = pInstances[i];
+        instance.rect[0] = m_ndcX[i];
+        instance.rect[1] = m_ndcY[i];
+        instance.rect[2] = m_ndcWidth[i];
+        instance.rect[3] = m_ndcHeight[i];
+        instance.opacity = m_opacity[i];
+        instance.dim = m_dim[i];
+        instance.cornerRadius = m_cornerRadius[i];
+        instance.textureIndex = 0.0f;
+        instance.size[0] = m_width[i];
+        instance.size[1] = m_height[i];
+        instance.uvScale[0] = m_uvScaleX[i];
+        instance.uvScale[1] = m_uvScaleY[i];
+    }
+}
+
+size_t SurfaceStore::GetCount() const
+{
+    return m_count;
+}
+
+bool SurfaceStore::IsDrawable(size_t index) const
+{
+    return index < m_count && m_drawable[index] != 0;
+}
+
+char const* SurfaceStore::GetKernelName()
+{
+#if defined(VKC_AVX2)
+    return "avx2";
+#elif defined(VKC_SSE)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+void SurfaceStore::Resize(size_t count)
+{
+    m_count = count;
+
+    // Lanes past the count are padding or left over from a larger surface list, the kernels
+    // process them as whole batches but nothing past the count is ever read back
+    size_t const padded = (count + s_batchSize - 1) / s_batchSize * s_batchSize;
+    if (padded == m_x.size())
+        return;
+
+    for (std::vector<float>* pArray : { &m_x, &m_y, &m_width, &m_height, &m_opacity, &m_dim, &m_cornerRadius,
+        &m_contentWidth, &m_contentHeight, &m_ndcX, &m_ndcY, &m_ndcWidth, &m_ndcHeight, &m_uvScaleX, &m_uvScaleY })
+    {
+        pArray->assign(padded, 0.0f);
+    }
+    m_textureWidth.assign(padded, 1.0f);
+    m_textureHeight.assign(padded, 1.0f);
+    m_drawable.assign(padded, 0);
+}
+
+} // vkc namespace
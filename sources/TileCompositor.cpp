@@ -0,0 +1,493 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <TileCompositor.hpp>
+#include <Ycbcr.hpp>
+#include <algorithm>
+#include <iostream>
+
+namespace vkc
+{
+
+TileCompositor::TileCompositor(Device & device, Window & window)
+    : m_device(device)
+    , m_window(window)
+    , m_tilesX((window.width + s_tileSize - 1) / s_tileSize)
+    , m_tilesY((window.height + s_tileSize - 1) / s_tileSize)
+{
+}
+
+TileCompositor::~TileCompositor()
+{
+    Shutdown();
+}
+
+bool TileCompositor::Init()
+{
+    if (!m_device.features.shaderSampledImageArrayDynamicIndexing)
+    {
+        std::cerr << "Tiled composition requires sampled image array dynamic indexing." << std::endl;
+        status = vk::Result::eErrorFeatureNotPresent;
+        return false;
+    }
+
+    vk::PhysicalDeviceLimits const limits = m_device.physical.getProperties().limits;
+    m_textureCount = std::min({ s_maxTextureCount, limits.maxPerStageDescriptorSamplers,
+        limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSamplers, limits.maxDescriptorSetSampledImages });
+    m_imageInfos.assign(m_textureCount, vk::DescriptorImageInfo());
+
+    return CreateOutputImage()
+        && CreateBuffers()
+        && CreateDescriptors()
+        && CreatePipeline();
+}
+
+void TileCompositor::Shutdown()
+{
+    if (!m_device.logical)
+        return;
+
+    m_device.logical.waitIdle();
+
+    if (m_pipeline)
+        m_device.logical.destroyPipeline(m_pipeline);
+    if (m_pipelineLayout)
+        m_device.logical.destroyPipelineLayout(m_pipelineLayout);
+    if (m_descriptorPool)
+        m_device.logical.destroyDescriptorPool(m_descriptorPool);
+    if (m_descriptorSetLayout)
+        m_device.logical.destroyDescriptorSetLayout(m_descriptorSetLayout);
+    if (m_sampler)
+        m_device.logical.destroySampler(m_sampler);
+    if (m_shader.shaderModule)
+        m_device.logical.destroyShaderModule(m_shader.shaderModule);
+    for (Buffer* pBuffer : { &m_surfaceBuffer, &m_tileBuffer, &m_entryBuffer })
+        pBuffer->Destroy(m_device);
+    m_outputImage.Destroy(m_device);
+
+    m_pipeline = vk::Pipeline();
+    m_pipelineLayout = vk::PipelineLayout();
+    m_descriptorPool = vk::DescriptorPool();
+    m_descriptorSetLayout = vk::DescriptorSetLayout();
+    m_sampler = vk::Sampler();
+    m_shader.shaderModule = vk::ShaderModule();
+    m_surfaceCapacity = 0;
+    m_entryCapacity = 0;
+}
+
+bool TileCompositor::Supports(std::vector<Surface> const& surfaces) const
+{
+    if (!(m_window.swapchainUsage & vk::ImageUsageFlagBits::eTransferDst))
+        return false;
+
+    // Dimming, rounded corners, Y'CbCr sampling and blur are only implemented by the raster path
+    for (Surface const& surface : surfaces)
+    {
+        if (!surface.visible || !surface.texture.view)
+            continue;
+        if (surface.dim < 1.0f || surface.cornerRadius > 0.0f || surface.yuv || surface.blurBehind
+            || GetPlanarFormat(surface.texture.format) != PlanarFormat::eNone)
+            return false;
+    }
+
+    return CollectTextures(surfaces) <= m_textureCount;
+}
+
+void TileCompositor::Invalidate()
+{
+    m_damage.Invalidate();
+}
+
+void TileCompositor::Record(vk::CommandBuffer cmd, std::vector<Surface> const& surfaces,
+    vk::Image target, vk::ClearColorValue const& clearColor)
+{
+    m_visibleSurfaces.clear();
+    for (uint32_t i = 0; i < surfaces.size(); ++i)
+    {
+        if (surfaces[i].visible && surfaces[i].texture.view)
+            m_visibleSurfaces.push_back(i);
+    }
+
+    bool const swizzle = m_window.surfaceFormat.format == vk::Format::eB8G8R8A8Unorm
+        || m_window.surfaceFormat.format == vk::Format::eB8G8R8A8Srgb;
+    uint32_t const damagedTileCount = m_damage.Update(surfaces);
+    vk::ImageSubresourceRange const range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+    vk::ImageMemoryBarrier outputBarrier;
+    outputBarrier.setImage(m_outputImage.image);
+    outputBarrier.setSubresourceRange(range);
+    outputBarrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    outputBarrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    outputBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
+    outputBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+    // Nothing of the previous content survives when every tile is composed again
+    bool const redrawAll = damagedTileCount == m_damage.GetTileCount();
+    outputBarrier.setOldLayout(redrawAll ? vk::ImageLayout::eUndefined : vk::ImageLayout::eGeneral);
+    outputBarrier.setNewLayout(vk::ImageLayout::eGeneral);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+        {}, 0, nullptr, 0, nullptr, 1, &outputBarrier);
+
+    if (m_visibleSurfaces.empty())
+    {
+        if (damagedTileCount > 0)
+        {
+            vk::ClearColorValue clear = clearColor;
+            if (swizzle)
+                std::swap(clear.float32[0], clear.float32[2]);
+            cmd.clearColorImage(m_outputImage.image, vk::ImageLayout::eGeneral, &clear, 1, &range);
+        }
+    }
+    else if (damagedTileCount > 0)
+    {
+        CollectTextures(surfaces);
+        m_surfaceData.resize(m_visibleSurfaces.size());
+        for (uint32_t i = 0; i < m_visibleSurfaces.size(); ++i)
+        {
+            Surface const& surface = surfaces[m_visibleSurfaces[i]];
+            SurfaceData& data = m_surfaceData[i];
+            data.rect[0] = surface.rect.offset.x;
+            data.rect[1] = surface.rect.offset.y;
+            data.rect[2] = static_cast<int32_t>(surface.rect.extent.width);
+            data.rect[3] = static_cast<int32_t>(surface.rect.extent.height);
+            data.uvScale[0] = static_cast<float>(surface.texture.contentExtent.width) / surface.texture.extent.width;
+            data.uvScale[1] = static_cast<float>(surface.texture.contentExtent.height) / surface.texture.extent.height;
+            data.opacity = surface.opacity;
+            data.textureIndex = static_cast<uint32_t>(
+                std::lower_bound(m_textures.begin(), m_textures.end(), surface.texture.view) - m_textures.begin());
+            data.blend = static_cast<uint32_t>(surface.blend);
+        }
+
+        uint32_t const tileCount = BinSurfaces(surfaces);
+        if (!ReserveBuffers(m_surfaceData.size(), m_entries.size()))
+        {
+            // The previous content is shown meanwhile, it's composed in full once the buffers fit
+            std::cerr << "Failed to allocate tile composition buffers." << std::endl;
+            m_damage.Invalidate();
+        }
+        else
+        {
+            std::copy(m_surfaceData.begin(), m_surfaceData.end(), static_cast<SurfaceData*>(m_surfaceBuffer.mapped));
+            std::copy(m_entries.begin(), m_entries.end(), static_cast<uint32_t*>(m_entryBuffer.mapped));
+            UpdateDescriptors();
+
+            Constants constants;
+            for (uint32_t i = 0; i < 4; ++i)
+                constants.clearColor[i] = clearColor.float32[i];
+            constants.tilesX = m_tilesX;
+            constants.swizzle = swizzle;
+
+            cmd.bindPipeline(vk::PipelineBindPoint::eCompute, m_pipeline);
+            cmd.bindDescriptorSets(vk::PipelineBindPoint::eCompute, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+            cmd.pushConstants(m_pipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants), &constants);
+            cmd.dispatch(tileCount, 1, 1);
+        }
+    }
+
+    vk::ImageMemoryBarrier barriers[2];
+    barriers[0] = outputBarrier;
+    barriers[0].setSrcAccessMask(vk::AccessFlagBits::eShaderWrite | vk::AccessFlagBits::eTransferWrite);
+    barriers[0].setDstAccessMask(vk::AccessFlagBits::eTransferRead);
+    barriers[0].setOldLayout(vk::ImageLayout::eGeneral);
+    barriers[1].setImage(target);
+    barriers[1].setSubresourceRange(range);
+    barriers[1].setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barriers[1].setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barriers[1].setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barriers[1].setOldLayout(vk::ImageLayout::eUndefined);
+    barriers[1].setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer, {}, 0, nullptr, 0, nullptr, 2, barriers);
+
+    vk::ImageSubresourceLayers const layers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    vk::ImageCopy region;
+    region.setSrcSubresource(layers);
+    region.setDstSubresource(layers);
+    region.setExtent({ m_window.width, m_window.height, 1 });
+    cmd.copyImage(m_outputImage.image, vk::ImageLayout::eGeneral, target, vk::ImageLayout::eTransferDstOptimal, 1, &region);
+
+    barriers[1].setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barriers[1].setDstAccessMask({});
+    barriers[1].setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    barriers[1].setNewLayout(vk::ImageLayout::ePresentSrcKHR);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+        {}, 0, nullptr, 0, nullptr, 1, &barriers[1]);
+}
+
+uint32_t TileCompositor::BinSurfaces(std::vector<Surface> const& surfaces)
+{
+    // Tiles are fixed, entries depend on the overlap and are gathered before the buffer is sized
+    TileData* pTiles = static_cast<TileData*>(m_tileBuffer.mapped);
+    int32_t const tileSize = static_cast<int32_t>(s_tileSize);
+    uint32_t tileCount = 0;
+    m_entries.clear();
+
+    for (uint32_t tile = 0; tile < m_tilesX * m_tilesY; ++tile)
+    {
+        if (!m_damage.IsDamaged(tile))
+            continue;
+
+        int32_t const x0 = static_cast<int32_t>(tile % m_tilesX) * tileSize;
+        int32_t const y0 = static_cast<int32_t>(tile / m_tilesX) * tileSize;
+        int32_t const x1 = std::min(x0 + tileSize, static_cast<int32_t>(m_window.width));
+        int32_t const y1 = std::min(y0 + tileSize, static_cast<int32_t>(m_window.height));
+
+        TileData& data = pTiles[tileCount++];
+        data.tileIndex = tile;
+        data.first = static_cast<uint32_t>(m_entries.size());
+        data.count = 0;
+
+        for (uint32_t i = 0; i < m_visibleSurfaces.size(); ++i)
+        {
+            Surface const& surface = surfaces[m_visibleSurfaces[i]];
+            int32_t const left = surface.rect.offset.x;
+            int32_t const top = surface.rect.offset.y;
+            int32_t const right = left + static_cast<int32_t>(surface.rect.extent.width);
+            int32_t const bottom = top + static_cast<int32_t>(surface.rect.extent.height);
+            if (right <= x0 || left >= x1 || bottom <= y0 || top >= y1)
+                continue;
+
+            // Everything below an opaque surface covering the whole tile is occluded
+            bool const covers = left <= x0 && top <= y0 && right >= x1 && bottom >= y1;
+            if (covers && surface.IsOpaque())
+            {
+                m_entries.resize(data.first);
+                data.count = 0;
+            }
+
+            m_entries.push_back(i);
+            ++data.count;
+        }
+    }
+
+    return tileCount;
+}
+
+size_t TileCompositor::CollectTextures(std::vector<Surface> const& surfaces) const
+{
+    m_textures.clear();
+    for (Surface const& surface : surfaces)
+    {
+        if (surface.visible && surface.texture.view)
+            m_textures.push_back(surface.texture.view);
+    }
+
+    std::sort(m_textures.begin(), m_textures.end());
+    m_textures.erase(std::unique(m_textures.begin(), m_textures.end()), m_textures.end());
+    return m_textures.size();
+}
+
+void TileCompositor::UpdateDescriptors()
+{
+    // Unused array elements alias the last texture so that every descriptor is valid, the
+    // array is only written when a texture changed since the previous frame
+    bool changed = false;
+    for (uint32_t i = 0; i < m_textureCount; ++i)
+    {
+        vk::ImageView const view = m_textures[std::min<size_t>(i, m_textures.size() - 1)];
+        vk::DescriptorImageInfo& imageInfo = m_imageInfos[i];
+        if (imageInfo.imageView == view)
+            continue;
+
+        imageInfo.setSampler(m_sampler);
+        imageInfo.setImageView(view);
+        imageInfo.setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+        changed = true;
+    }
+
+    if (!changed)
+        return;
+
+    vk::WriteDescriptorSet write;
+    write.setDstSet(m_descriptorSet);
+    write.setDstBinding(4);
+    write.setDescriptorCount(m_textureCount);
+    write.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    write.setPImageInfo(m_imageInfos.data());
+    m_device.logical.updateDescriptorSets(1, &write, 0, nullptr);
+}
+
+bool TileCompositor::CreateOutputImage()
+{
+    m_damage.Resize({ m_window.width, m_window.height }, s_tileSize);
+
+    return m_outputImage.Init(m_device, vk::Format::eR8G8B8A8Unorm, { m_window.width, m_window.height },
+        vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst);
+}
+
+bool TileCompositor::CreateBuffers()
+{
+    // Room for a tile's worth of surfaces to start with, the rest grows as scenes do
+    uint32_t const tileCount = m_tilesX * m_tilesY;
+    m_surfaceCapacity = s_tileSize;
+    m_entryCapacity = tileCount * s_tileSize;
+
+    return m_surfaceBuffer.Allocate(m_device, m_surfaceCapacity * sizeof(SurfaceData), vk::BufferUsageFlagBits::eStorageBuffer)
+        && m_tileBuffer.Allocate(m_device, tileCount * sizeof(TileData), vk::BufferUsageFlagBits::eStorageBuffer)
+        && m_entryBuffer.Allocate(m_device, m_entryCapacity * sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer);
+}
+
+bool TileCompositor::ReserveBuffers(size_t surfaceCount, size_t entryCount)
+{
+    vk::DescriptorBufferInfo bufferInfos[2];
+    vk::WriteDescriptorSet writes[2];
+    uint32_t writeCount = 0;
+    auto const reserve = [&](Buffer& buffer, uint32_t& capacity, size_t count, size_t stride, uint32_t binding) {
+        if (count <= capacity)
+            return true;
+
+        capacity = std::max(static_cast<uint32_t>(count), capacity * 2);
+        buffer.Destroy(m_device);
+        if (!buffer.Allocate(m_device, capacity * stride, vk::BufferUsageFlagBits::eStorageBuffer))
+        {
+            capacity = 0;
+            return false;
+        }
+
+        bufferInfos[writeCount] = vk::DescriptorBufferInfo(buffer.buffer, 0, VK_WHOLE_SIZE);
+        writes[writeCount].setDstSet(m_descriptorSet);
+        writes[writeCount].setDstBinding(binding);
+        writes[writeCount].setDescriptorCount(1);
+        writes[writeCount].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+        writes[writeCount].setPBufferInfo(&bufferInfos[writeCount]);
+        ++writeCount;
+        return true;
+    };
+
+    bool const reserved = reserve(m_surfaceBuffer, m_surfaceCapacity, surfaceCount, sizeof(SurfaceData), 1)
+        && reserve(m_entryBuffer, m_entryCapacity, entryCount, sizeof(uint32_t), 3);
+    if (writeCount > 0)
+        m_device.logical.updateDescriptorSets(writeCount, writes, 0, nullptr);
+    return reserved;
+}
+
+bool TileCompositor::CreateDescriptors()
+{
+    vk::SamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.setMagFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMinFilter(vk::Filter::eLinear);
+    samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+
+    std::tie(status, m_sampler) = m_device.logical.createSampler(samplerCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create sampler." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetLayoutBinding bindings[5];
+    bindings[0] = vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute);
+    bindings[1] = vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+    bindings[2] = vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+    bindings[3] = vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute);
+    bindings[4] = vk::DescriptorSetLayoutBinding(
+        4, vk::DescriptorType::eCombinedImageSampler, m_textureCount, vk::ShaderStageFlagBits::eCompute);
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setBindingCount(5);
+    layoutCreateInfo.setPBindings(bindings);
+
+    std::tie(status, m_descriptorSetLayout) = m_device.logical.createDescriptorSetLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create descriptor set layout." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorPoolSize const poolSizes[3] = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, 1),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 3),
+        vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, m_textureCount),
+    };
+    vk::DescriptorPoolCreateInfo poolCreateInfo;
+    poolCreateInfo.setMaxSets(1);
+    poolCreateInfo.setPoolSizeCount(3);
+    poolCreateInfo.setPPoolSizes(poolSizes);
+
+    std::tie(status, m_descriptorPool) = m_device.logical.createDescriptorPool(poolCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create descriptor pool." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetAllocateInfo allocateInfo;
+    allocateInfo.setDescriptorPool(m_descriptorPool);
+    allocateInfo.setDescriptorSetCount(1);
+    allocateInfo.setPSetLayouts(&m_descriptorSetLayout);
+
+    status = m_device.logical.allocateDescriptorSets(&allocateInfo, &m_descriptorSet);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to allocate descriptor set." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorImageInfo const outputInfo(vk::Sampler(), m_outputImage.view, vk::ImageLayout::eGeneral);
+    vk::DescriptorBufferInfo const bufferInfos[3] = {
+        vk::DescriptorBufferInfo(m_surfaceBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_tileBuffer.buffer, 0, VK_WHOLE_SIZE),
+        vk::DescriptorBufferInfo(m_entryBuffer.buffer, 0, VK_WHOLE_SIZE),
+    };
+
+    vk::WriteDescriptorSet writes[2];
+    writes[0].setDstSet(m_descriptorSet);
+    writes[0].setDstBinding(0);
+    writes[0].setDescriptorCount(1);
+    writes[0].setDescriptorType(vk::DescriptorType::eStorageImage);
+    writes[0].setPImageInfo(&outputInfo);
+    writes[1].setDstSet(m_descriptorSet);
+    writes[1].setDstBinding(1);
+    writes[1].setDescriptorCount(3);
+    writes[1].setDescriptorType(vk::DescriptorType::eStorageBuffer);
+    writes[1].setPBufferInfo(bufferInfos);
+    m_device.logical.updateDescriptorSets(2, writes, 0, nullptr);
+
+    return true;
+}
+
+bool TileCompositor::CreatePipeline()
+{
+    if (!m_shader.Init(m_device, "main", "../shaders/compose.comp.spv", vk::ShaderStageFlagBits::eCompute))
+        return false;
+
+    vk::PushConstantRange const pushConstantRange(vk::ShaderStageFlagBits::eCompute, 0, sizeof(Constants));
+    vk::PipelineLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setSetLayoutCount(1);
+    layoutCreateInfo.setPSetLayouts(&m_descriptorSetLayout);
+    layoutCreateInfo.setPushConstantRangeCount(1);
+    layoutCreateInfo.setPPushConstantRanges(&pushConstantRange);
+
+    std::tie(status, m_pipelineLayout) = m_device.logical.createPipelineLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create compute pipeline layout." << std::endl;
+        return false;
+    }
+
+    // The texture array is as long as the device allows
+    vk::SpecializationMapEntry const specializationEntry(0, 0, sizeof(uint32_t));
+    vk::SpecializationInfo const specializationInfo(1, &specializationEntry, sizeof(uint32_t), &m_textureCount);
+    vk::PipelineShaderStageCreateInfo stage = m_shader.shaderStage;
+    stage.setPSpecializationInfo(&specializationInfo);
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo;
+    pipelineCreateInfo.setStage(stage);
+    pipelineCreateInfo.setLayout(m_pipelineLayout);
+
+    std::tie(status, m_pipeline) = m_device.logical.createComputePipeline(vk::PipelineCache(), pipelineCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create compute pipeline." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+} // vkc namespace
\ No newline at end of file
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <TileDamage.hpp>
+#include <algorithm>
+
+namespace vkc
+{
+
+void TileDamage::Resize(vk::Extent2D extent, uint32_t tileSize)
+{
+    m_extent = extent;
+    m_tileSize = tileSize;
+    m_tilesX = (extent.width + tileSize - 1) / tileSize;
+    m_tilesY = (extent.height + tileSize - 1) / tileSize;
+    m_damagedTiles.assign(m_tilesX * m_tilesY, true);
+    m_historyValid = false;
+}
+
+void TileDamage::Invalidate()
+{
+    m_historyValid = false;
+}
+
+uint32_t TileDamage::Update(std::vector<Surface> const& surfaces)
+{
+    // Added or removed surfaces don't necessarily come with damage, so they redraw everything
+    bool const all = !m_historyValid || surfaces.size() != m_surfaceCount;
+    std::fill(m_damagedTiles.begin(), m_damagedTiles.end(), all);
+    m_surfaceCount = surfaces.size();
+    m_historyValid = true;
+    if (all)
+        return GetTileCount();
+
+    uint32_t damagedTileCount = 0;
+    for (Surface const& surface : surfaces)
+    {
+        for (vk::Rect2D const& rect : surface.damage)
+            damagedTileCount += MarkRect(rect);
+
+        if (surface.visible && surface.contentDamaged)
+            damagedTileCount += MarkRect(surface.rect);
+    }
+
+    return damagedTileCount;
+}
+
+bool TileDamage::IsDamaged(uint32_t tile) const
+{
+    return m_damagedTiles[tile];
+}
+
+uint32_t TileDamage::GetTileCount() const
+{
+    return m_tilesX * m_tilesY;
+}
+
+uint32_t TileDamage::MarkRect(vk::Rect2D const& rect)
+{
+    int32_t const width = static_cast<int32_t>(m_extent.width);
+    int32_t const height = static_cast<int32_t>(m_extent.height);
+    int32_t const tileSize = static_cast<int32_t>(m_tileSize);
+    int32_t const x0 = std::max(rect.offset.x, 0);
+    int32_t const y0 = std::max(rect.offset.y, 0);
+    int32_t const x1 = std::min(rect.offset.x + static_cast<int32_t>(rect.extent.width), width);
+    int32_t const y1 = std::min(rect.offset.y + static_cast<int32_t>(rect.extent.height), height);
+    if (x0 >= x1 || y0 >= y1)
+        return 0;
+
+    // Only counts tiles that weren't damaged yet
+    uint32_t markedTileCount = 0;
+    for (int32_t y = y0 / tileSize; y <= (y1 - 1) / tileSize; ++y)
+    {
+        for (int32_t x = x0 / tileSize; x <= (x1 - 1) / tileSize; ++x)
+        {
+            std::vector<bool>::reference damaged = m_damagedTiles[y * m_tilesX + x];
+            markedTileCount += !damaged;
+            damaged = true;
+        }
+    }
+
+    return markedTileCount;
+}
+
+} // vkc namespace
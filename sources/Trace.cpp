@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Trace.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace vkc
+{
+
+namespace
+{
+
+struct TraceRing
+{
+    uint32_t id = 0;
+    std::string name;
+    std::atomic<bool> inUse{ false };
+    std::atomic<uint64_t> count{ 0 };
+    std::array<TraceEvent, Tracer::s_ringCapacity> events;
+};
+
+std::atomic<bool> g_enabled{ false };
+std::mutex g_ringsMutex;
+std::vector<std::unique_ptr<TraceRing>> g_rings;
+TraceRing g_gpuRing;
+
+// Short lived threads, e.g. from std::async, hand their ring on to the next thread
+struct RingHandle
+{
+    TraceRing* pRing = nullptr;
+
+    ~RingHandle()
+    {
+        if (pRing)
+            pRing->inUse.store(false, std::memory_order_release);
+    }
+};
+
+TraceRing& GetThreadRing()
+{
+    thread_local RingHandle handle;
+    if (handle.pRing)
+        return *handle.pRing;
+
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    for (std::unique_ptr<TraceRing>& pRing : g_rings)
+    {
+        bool expected = false;
+        if (pRing->inUse.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            handle.pRing = pRing.get();
+            handle.pRing->name = "Thread " + std::to_string(handle.pRing->id);
+            return *handle.pRing;
+        }
+    }
+
+    g_rings.push_back(std::make_unique<TraceRing>());
+    handle.pRing = g_rings.back().get();
+    handle.pRing->id = static_cast<uint32_t>(g_rings.size());
+    handle.pRing->name = "Thread " + std::to_string(handle.pRing->id);
+    handle.pRing->inUse.store(true, std::memory_order_relaxed);
+    return *handle.pRing;
+}
+
+void Push(TraceRing& ring, TraceEvent const& event)
+{
+    // Single writer, the exporter only reads up to the published count
+    uint64_t const index = ring.count.load(std::memory_order_relaxed);
+    ring.events[index & (Tracer::s_ringCapacity - 1)] = event;
+    ring.count.store(index + 1, std::memory_order_release);
+}
+
+double ToMicroseconds(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+void ExportRing(FILE* pOutput, TraceRing const& ring, bool& first)
+{
+    fprintf(pOutput, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+        first ? "" : ",", ring.id, ring.name.c_str());
+    first = false;
+
+    uint64_t const count = ring.count.load(std::memory_order_acquire);
+    uint64_t const begin = count > Tracer::s_ringCapacity ? count - Tracer::s_ringCapacity : 0;
+    for (uint64_t i = begin; i < count; ++i)
+    {
+        TraceEvent const& event = ring.events[i & (Tracer::s_ringCapacity - 1)];
+        fprintf(pOutput, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+            event.pName, ring.id, ToMicroseconds(event.start.time_since_epoch()), ToMicroseconds(event.duration));
+    }
+}
+
+} // anonymous namespace
+
+void Tracer::Start()
+{
+    g_enabled.store(true, std::memory_order_relaxed);
+}
+
+void Tracer::Stop()
+{
+    g_enabled.store(false, std::memory_order_relaxed);
+}
+
+bool Tracer::IsEnabled()
+{
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+void Tracer::AddEvent(char const* pName, Clock::time_point start, Clock::time_point end)
+{
+    // Scopes opened before Stop end after it, and Export may already be reading the rings
+    if (IsEnabled())
+        Push(GetThreadRing(), { pName, start, end - start });
+}
+
+void Tracer::AddGpuSpan(char const* pName, Clock::time_point start, Clock::time_point end)
+{
+    // Spans are read back after the frame fence on the compositor thread only
+    if (IsEnabled())
+        Push(g_gpuRing, { pName, start, end - start });
+}
+
+void Tracer::SetThreadName(char const* pName)
+{
+    TraceRing& ring = GetThreadRing();
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    ring.name = pName;
+}
+
+bool Tracer::Export(FILE* pOutput)
+{
+    if (!pOutput)
+        return false;
+
+    std::lock_guard<std::mutex> lock(g_ringsMutex);
+    g_gpuRing.name = "GPU";
+
+    bool first = true;
+    fprintf(pOutput, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    ExportRing(pOutput, g_gpuRing, first);
+    for (std::unique_ptr<TraceRing> const& pRing : g_rings)
+        ExportRing(pOutput, *pRing, first);
+    fprintf(pOutput, "\n]}\n");
+
+    return fflush(pOutput) == 0;
+}
+
+Clock::time_point Tracer::FromCalibratedTimestamp(uint64_t timestamp)
+{
+#ifdef _WIN32
+    // Same conversion of performance counter ticks as the steady clock
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    uint64_t const ticksPerSecond = static_cast<uint64_t>(frequency.QuadPart);
+    uint64_t const nanoseconds = timestamp / ticksPerSecond * 1000000000ull + timestamp % ticksPerSecond * 1000000000ull / ticksPerSecond;
+    return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(nanoseconds)));
+#else
+    // The steady clock is CLOCK_MONOTONIC in nanoseconds
+    return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(timestamp)));
+#endif
+}
+
+vk::TimeDomainEXT Tracer::GetHostTimeDomain()
+{
+#ifdef _WIN32
+    return vk::TimeDomainEXT::eQueryPerformanceCounter;
+#else
+    return vk::TimeDomainEXT::eClockMonotonic;
+#endif
+}
+
+} // vkc namespace
@@ -29,7 +29,11 @@ Window::~Window()
 
 bool Window::Init()
 {
-    return CreateSurface() && CreateSwapchain() && CreateSwapchainImageViews();
+    if (!CreateSurface() || !CreateSwapchain() || !CreateSwapchainImageViews())
+        return false;
+
+    QueryRefreshPeriod();
+    return true;
 }
 
 bool Window::IsValid() const
@@ -87,6 +91,7 @@ bool Window::CreateSurface()
 {
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     m_pWindow = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+    InstallInputCallbacks();
 
     VkSurfaceKHR surfaceOld;
     VkResult error = glfwCreateWindowSurface(device.instance, m_pWindow, nullptr, &surfaceOld);
@@ -150,6 +155,16 @@ bool Window::CreateSwapchain()
         return false;
     }
 
+    if (surfaceData.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst)
+    {
+        swapchainUsage |= vk::ImageUsageFlagBits::eTransferDst;
+    }
+
+    if (surfaceData.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc)
+    {
+        swapchainUsage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+
     vk::SwapchainCreateInfoKHR swapchainCreateInfo;
     swapchainCreateInfo.setSurface(surface);
     swapchainCreateInfo.setMinImageCount(swapchainImageCount);
@@ -157,7 +172,7 @@ bool Window::CreateSwapchain()
     swapchainCreateInfo.setImageColorSpace(surfaceFormat.colorSpace);
     swapchainCreateInfo.setImageExtent(vk::Extent2D(width, height));
     swapchainCreateInfo.setImageArrayLayers(1);
-    swapchainCreateInfo.setImageUsage(vk::ImageUsageFlagBits::eColorAttachment);
+    swapchainCreateInfo.setImageUsage(swapchainUsage);
     swapchainCreateInfo.setImageSharingMode(vk::SharingMode::eExclusive);
     swapchainCreateInfo.setQueueFamilyIndexCount(1);
     swapchainCreateInfo.setPQueueFamilyIndices(&device.queue.familyIndex);
@@ -217,4 +232,81 @@ bool Window::CreateSwapchainImageViews()
     return true;
 }
 
+void Window::QueryRefreshPeriod()
+{
+    if (device.displayTiming)
+    {
+        vk::RefreshCycleDurationGOOGLE refreshCycle;
+        vk::Result result;
+        std::tie(result, refreshCycle) = device.logical.getRefreshCycleDurationGOOGLE(swapchain, device.dispatch);
+        if (result == vk::Result::eSuccess && refreshCycle.refreshDuration != 0)
+        {
+            refreshPeriod = std::chrono::nanoseconds(refreshCycle.refreshDuration);
+            return;
+        }
+    }
+
+    // The window is placed on the primary monitor, its mode is the best remaining guess
+    GLFWmonitor* pMonitor = glfwGetPrimaryMonitor();
+    GLFWvidmode const* pMode = pMonitor ? glfwGetVideoMode(pMonitor) : nullptr;
+    if (pMode && pMode->refreshRate > 0)
+        refreshPeriod = std::chrono::nanoseconds(1000000000ll / pMode->refreshRate);
+}
+
+void Window::InstallInputCallbacks()
+{
+    glfwSetWindowUserPointer(m_pWindow, this);
+    glfwSetKeyCallback(m_pWindow, &Window::OnKey);
+    glfwSetMouseButtonCallback(m_pWindow, &Window::OnButton);
+    glfwSetCursorPosCallback(m_pWindow, &Window::OnMotion);
+    glfwSetScrollCallback(m_pWindow, &Window::OnScroll);
+}
+
+void Window::EmitInput(InputEvent& event)
+{
+    event.timestamp = Clock::now();
+    glfwGetCursorPos(m_pWindow, &event.pointerX, &event.pointerY);
+    if (onInput)
+        onInput(event);
+}
+
+void Window::OnKey(GLFWwindow* pWindow, int key, int, int action, int mods)
+{
+    InputEvent event;
+    event.type = InputType::eKey;
+    event.code = key;
+    event.action = action;
+    event.mods = mods;
+    static_cast<Window*>(glfwGetWindowUserPointer(pWindow))->EmitInput(event);
+}
+
+void Window::OnButton(GLFWwindow* pWindow, int button, int action, int mods)
+{
+    InputEvent event;
+    event.type = InputType::eButton;
+    event.code = button;
+    event.action = action;
+    event.mods = mods;
+    glfwGetCursorPos(pWindow, &event.x, &event.y);
+    static_cast<Window*>(glfwGetWindowUserPointer(pWindow))->EmitInput(event);
+}
+
+void Window::OnMotion(GLFWwindow* pWindow, double x, double y)
+{
+    InputEvent event;
+    event.type = InputType::eMotion;
+    event.x = x;
+    event.y = y;
+    static_cast<Window*>(glfwGetWindowUserPointer(pWindow))->EmitInput(event);
+}
+
+void Window::OnScroll(GLFWwindow* pWindow, double x, double y)
+{
+    InputEvent event;
+    event.type = InputType::eScroll;
+    event.x = x;
+    event.y = y;
+    static_cast<Window*>(glfwGetWindowUserPointer(pWindow))->EmitInput(event);
+}
+
 } // vkc namespace
\ No newline at end of file
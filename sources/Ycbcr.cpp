@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Ycbcr.hpp>
+#include <iostream>
+
+namespace vkc
+{
+
+YcbcrSamplers::YcbcrSamplers(Device & device)
+    : m_device(device)
+{
+}
+
+YcbcrSamplers::~YcbcrSamplers()
+{
+    Shutdown();
+}
+
+bool YcbcrSamplers::Init()
+{
+    status = vk::Result::eSuccess;
+    if (!m_device.samplerYcbcrConversion)
+    {
+        std::cerr << "Sampler Y'CbCr conversion is not supported, video surfaces are unavailable." << std::endl;
+        return true;
+    }
+
+    return CreateConversion(PlanarFormat::eNv12)
+        && CreateConversion(PlanarFormat::eI420);
+}
+
+void YcbcrSamplers::Shutdown()
+{
+    for (Conversion& conversion : m_conversions)
+    {
+        if (conversion.descriptorSetLayout)
+            m_device.logical.destroyDescriptorSetLayout(conversion.descriptorSetLayout);
+        if (conversion.sampler)
+            m_device.logical.destroySampler(conversion.sampler);
+        if (conversion.conversion)
+            m_device.logical.destroySamplerYcbcrConversion(conversion.conversion);
+
+        conversion = Conversion();
+    }
+}
+
+bool YcbcrSamplers::Supports(PlanarFormat format) const
+{
+    return format != PlanarFormat::eNone && m_conversions[static_cast<uint32_t>(format)].conversion;
+}
+
+vk::DescriptorSetLayout YcbcrSamplers::GetDescriptorSetLayout(PlanarFormat format) const
+{
+    return m_conversions[static_cast<uint32_t>(format)].descriptorSetLayout;
+}
+
+vk::SamplerYcbcrConversion YcbcrSamplers::GetConversion(PlanarFormat format) const
+{
+    return m_conversions[static_cast<uint32_t>(format)].conversion;
+}
+
+bool YcbcrSamplers::InitImage(Image & image, PlanarFormat format, vk::Extent2D extent) const
+{
+    if (!Supports(format))
+    {
+        std::cerr << "Unsupported planar image format." << std::endl;
+        return false;
+    }
+
+    return image.Init(m_device, GetVkFormat(format), extent,
+        vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst,
+        m_conversions[static_cast<uint32_t>(format)].conversion);
+}
+
+void YcbcrSamplers::RecordUpload(vk::CommandBuffer cmd, Image const& image, vk::Buffer planes, vk::DeviceSize offset) const
+{
+    // Planes are tightly packed one after another: Y' followed by either interleaved CbCr (NV12)
+    // or separate Cb and Cr planes (I420), chroma is subsampled by two in both directions
+    vk::Extent3D const lumaExtent(image.extent.width, image.extent.height, 1);
+    vk::Extent3D const chromaExtent((image.extent.width + 1) / 2, (image.extent.height + 1) / 2, 1);
+    vk::DeviceSize const lumaSize = lumaExtent.width * lumaExtent.height;
+    vk::DeviceSize const chromaSize = chromaExtent.width * chromaExtent.height;
+
+    vk::BufferImageCopy regions[3];
+    regions[0].setBufferOffset(offset);
+    regions[0].setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::ePlane0, 0, 0, 1));
+    regions[0].setImageExtent(lumaExtent);
+    regions[1].setBufferOffset(offset + lumaSize);
+    regions[1].setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::ePlane1, 0, 0, 1));
+    regions[1].setImageExtent(chromaExtent);
+    regions[2].setBufferOffset(offset + lumaSize + chromaSize);
+    regions[2].setImageSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::ePlane2, 0, 0, 1));
+    regions[2].setImageExtent(chromaExtent);
+    uint32_t const regionCount = GetPlanarFormat(image.format) == PlanarFormat::eI420 ? 3 : 2;
+
+    vk::ImageMemoryBarrier barrier;
+    barrier.setImage(image.image);
+    barrier.setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+    barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eShaderRead);
+    barrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barrier.setOldLayout(vk::ImageLayout::eUndefined);
+    barrier.setNewLayout(vk::ImageLayout::eTransferDstOptimal);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer,
+        {}, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    cmd.copyBufferToImage(planes, image.image, vk::ImageLayout::eTransferDstOptimal, regionCount, regions);
+
+    barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+    barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
+    barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
+    barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
+        {}, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+bool YcbcrSamplers::CreateConversion(PlanarFormat format)
+{
+    vk::FormatFeatureFlags const features = m_device.physical.getFormatProperties(GetVkFormat(format)).optimalTilingFeatures;
+    if (!(features & vk::FormatFeatureFlagBits::eSampledImage)
+        || !(features & vk::FormatFeatureFlagBits::eTransferDst)
+        || !(features & (vk::FormatFeatureFlagBits::eCositedChromaSamples | vk::FormatFeatureFlagBits::eMidpointChromaSamples)))
+    {
+        std::cerr << "Planar format " << vk::to_string(GetVkFormat(format)) << " can not be sampled." << std::endl;
+        return true;
+    }
+
+    vk::ChromaLocation const chromaLocation = (features & vk::FormatFeatureFlagBits::eCositedChromaSamples)
+        ? vk::ChromaLocation::eCositedEven : vk::ChromaLocation::eMidpoint;
+    vk::Filter const filter = (features & vk::FormatFeatureFlagBits::eSampledImageYcbcrConversionLinearFilter)
+        ? vk::Filter::eLinear : vk::Filter::eNearest;
+
+    Conversion& conversion = m_conversions[static_cast<uint32_t>(format)];
+
+    vk::SamplerYcbcrConversionCreateInfo conversionCreateInfo;
+    conversionCreateInfo.setFormat(GetVkFormat(format));
+    conversionCreateInfo.setYcbcrModel(vk::SamplerYcbcrModelConversion::eYcbcr709);
+    conversionCreateInfo.setYcbcrRange(vk::SamplerYcbcrRange::eItuNarrow);
+    conversionCreateInfo.setXChromaOffset(chromaLocation);
+    conversionCreateInfo.setYChromaOffset(chromaLocation);
+    conversionCreateInfo.setChromaFilter(filter);
+    conversionCreateInfo.setForceExplicitReconstruction(false);
+
+    std::tie(status, conversion.conversion) = m_device.logical.createSamplerYcbcrConversion(conversionCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create sampler Y'CbCr conversion." << std::endl;
+        return false;
+    }
+
+    vk::SamplerYcbcrConversionInfo conversionInfo(conversion.conversion);
+    vk::SamplerCreateInfo samplerCreateInfo;
+    samplerCreateInfo.setPNext(&conversionInfo);
+    samplerCreateInfo.setMagFilter(filter);
+    samplerCreateInfo.setMinFilter(filter);
+    samplerCreateInfo.setMipmapMode(vk::SamplerMipmapMode::eNearest);
+    samplerCreateInfo.setAddressModeU(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeV(vk::SamplerAddressMode::eClampToEdge);
+    samplerCreateInfo.setAddressModeW(vk::SamplerAddressMode::eClampToEdge);
+
+    std::tie(status, conversion.sampler) = m_device.logical.createSampler(samplerCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create Y'CbCr sampler." << std::endl;
+        return false;
+    }
+
+    vk::DescriptorSetLayoutBinding binding;
+    binding.setBinding(0);
+    binding.setDescriptorCount(1);
+    binding.setDescriptorType(vk::DescriptorType::eCombinedImageSampler);
+    binding.setStageFlags(vk::ShaderStageFlagBits::eFragment);
+    binding.setPImmutableSamplers(&conversion.sampler);
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo;
+    layoutCreateInfo.setBindingCount(1);
+    layoutCreateInfo.setPBindings(&binding);
+
+    std::tie(status, conversion.descriptorSetLayout) = m_device.logical.createDescriptorSetLayout(layoutCreateInfo);
+    if (status != vk::Result::eSuccess)
+    {
+        std::cerr << "Failed to create Y'CbCr descriptor set layout." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+} // vkc namespace
\ No newline at end of file
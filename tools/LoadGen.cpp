@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <Client.hpp>
+#include <Compositor.hpp>
+#include <LatencyHistogram.hpp>
+#include <Timing.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Synthetic client load for the compositor. Every client runs on its own thread with its
+ * own surface, commit ring and shared buffers, and commits at the rate of its damage
+ * pattern. Headless outputs are paced at --fps instead of a display. After a run the
+ * commit to present latency of every client and the compositor frame rate are reported,
+ * with --sweep the run is repeated for 1, 2, 4 up to the given number of clients to show
+ * where latency starts to climb.
+ */
+
+namespace
+{
+
+enum class Pattern
+{
+    eFull,
+    eScroll,
+    eVideo,
+    eIdle,
+    eMixed,
+};
+
+struct Options
+{
+    uint32_t clientCount = 4;
+    double seconds = 5.0;
+    double rate = 0.0;
+    double frameRate = 60.0;
+    vk::Extent2D surfaceExtent{ 480, 320 };
+    vk::Extent2D outputExtent{ 1920, 1080 };
+    Pattern pattern = Pattern::eMixed;
+    bool sweep = false;
+    bool gpu = false;
+};
+
+struct RunResult
+{
+    uint64_t frameCount = 0;
+    uint64_t commitCount = 0;
+    uint64_t droppedCommitCount = 0;
+    uint64_t stalledCommitCount = 0;
+    uint64_t evictedCommitCount = 0;
+    vkc::Milliseconds meanLatency{ 0 };
+    vkc::Milliseconds worstP99Latency{ 0 };
+};
+
+char const* GetPatternName(Pattern pattern)
+{
+    switch (pattern)
+    {
+    case Pattern::eFull: return "full";
+    case Pattern::eScroll: return "scroll";
+    case Pattern::eVideo: return "video";
+    case Pattern::eIdle: return "idle";
+    default: return "mixed";
+    }
+}
+
+double GetDefaultRate(Pattern pattern)
+{
+    switch (pattern)
+    {
+    case Pattern::eVideo: return 30.0;
+    case Pattern::eIdle: return 2.0;
+    default: return 60.0;
+    }
+}
+
+class Client
+{
+public:
+    Client(uint32_t id, uint32_t surface, Pattern pattern, double rate, vk::Extent2D extent, vkc::CommitRing& ring)
+        : m_id(id)
+        , m_surface(surface)
+        , m_pattern(pattern)
+        , m_interval(std::chrono::duration_cast<vkc::Clock::duration>(std::chrono::duration<double>(1.0 / rate)))
+        , m_extent(extent)
+        , m_ring(ring)
+    {
+    }
+
+    Client(Client&) = delete;
+    Client(Client&&) = delete;
+    Client& operator=(Client&) = delete;
+    Client& operator=(Client&&) = delete;
+
+    void Start()
+    {
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    void Stop()
+    {
+        m_stop.store(true, std::memory_order_relaxed);
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    uint64_t GetCommitCount() const { return m_commitCount; }
+
+    uint64_t GetStalledCount() const { return m_stalledCount; }
+
+private:
+    static uint32_t const s_bufferCount = 3;
+    static uint32_t const s_lineHeight = 16;
+
+    uint32_t const m_id;
+    uint32_t const m_surface;
+    Pattern const m_pattern;
+    vkc::Clock::duration const m_interval;
+    vk::Extent2D const m_extent;
+    vkc::CommitRing& m_ring;
+    std::vector<std::shared_ptr<vkc::ClientBuffer>> m_buffers;
+    std::shared_ptr<vkc::ClientBuffer> m_pLast;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{ false };
+    uint64_t m_commitCount = 0;
+    uint64_t m_stalledCount = 0;
+    uint32_t m_step = 0;
+
+    void Run()
+    {
+        size_t const pixelCount = static_cast<size_t>(m_extent.width) * m_extent.height;
+        for (uint32_t i = 0; i < s_bufferCount; ++i)
+        {
+            m_buffers.push_back(std::make_shared<vkc::ClientBuffer>());
+            m_buffers.back()->extent = m_extent;
+            m_buffers.back()->pixels.assign(pixelCount, 0xFF202020u);
+        }
+
+        vkc::Clock::time_point next = vkc::Clock::now();
+        while (!m_stop.load(std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_until(next);
+            next += m_interval;
+            Commit();
+        }
+    }
+
+    void Commit()
+    {
+        // Only a buffer the compositor has released may be drawn into
+        std::shared_ptr<vkc::ClientBuffer> pBuffer;
+        for (std::shared_ptr<vkc::ClientBuffer> const& pCandidate : m_buffers)
+        {
+            if (pCandidate != m_pLast && !pCandidate->busy.load(std::memory_order_acquire))
+            {
+                pBuffer = pCandidate;
+                break;
+            }
+        }
+        if (!pBuffer)
+        {
+            ++m_stalledCount;
+            return;
+        }
+
+        vkc::ClientCommit commit;
+        commit.surface = m_surface;
+        Draw(*pBuffer, commit.damage);
+        ++m_step;
+
+        pBuffer->busy.store(true, std::memory_order_relaxed);
+        commit.pBuffer = pBuffer;
+        commit.timestamp = vkc::Clock::now();
+        if (!m_ring.Push(commit))
+        {
+            pBuffer->busy.store(false, std::memory_order_relaxed);
+            return;
+        }
+
+        m_pLast = pBuffer;
+        ++m_commitCount;
+    }
+
+    void Draw(vkc::ClientBuffer& buffer, std::vector<vk::Rect2D>& damage)
+    {
+        uint32_t const width = m_extent.width;
+        uint32_t const height = m_extent.height;
+        uint32_t const color = 0xFF000000u | ((m_id * 2654435761u + m_step * 40503u) & 0x00FFFFFFu);
+        vk::Rect2D const whole({ 0, 0 }, m_extent);
+        switch (m_pattern)
+        {
+        case Pattern::eScroll:
+        {
+            // The previous frame moves up one text line and a new line appears below
+            uint32_t const line = height < s_lineHeight ? height : s_lineHeight;
+            std::vector<uint32_t> const& previous = m_pLast ? m_pLast->pixels : buffer.pixels;
+            std::copy(previous.begin() + static_cast<size_t>(line) * width, previous.end(), buffer.pixels.begin());
+            for (uint32_t y = height - line; y < height; ++y)
+            {
+                uint32_t* const pRow = buffer.pixels.data() + static_cast<size_t>(y) * width;
+                for (uint32_t x = 0; x < width; ++x)
+                    pRow[x] = ((x / 8 + m_step) % 3 == 0 || y == height - 1) ? 0xFF202020u : 0xFFE0E0E0u;
+            }
+            damage.push_back(whole);
+            break;
+        }
+        case Pattern::eIdle:
+        {
+            // A blinking caret, everything else stays as it was
+            if (m_pLast)
+                buffer.pixels = m_pLast->pixels;
+            uint32_t const caretWidth = width > 8 ? std::min(2u, width - 8) : 0;
+            uint32_t const caretHeight = height > 8 ? std::min(16u, height - 8) : 0;
+            for (uint32_t y = 0; y < caretHeight; ++y)
+            {
+                uint32_t* const pRow = buffer.pixels.data() + static_cast<size_t>(8 + y) * width + 8;
+                std::fill(pRow, pRow + caretWidth, m_step % 2 ? color : 0xFF202020u);
+            }
+            damage.push_back(vk::Rect2D({ 8, 8 }, { caretWidth, caretHeight }));
+            break;
+        }
+        case Pattern::eVideo:
+        {
+            // Every pixel changes every frame
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                uint32_t* const pRow = buffer.pixels.data() + static_cast<size_t>(y) * width;
+                for (uint32_t x = 0; x < width; ++x)
+                    pRow[x] = 0xFF000000u | ((x + m_step * 3) & 0xFF) << 16 | ((y + m_step) & 0xFF) << 8 | (m_step & 0xFF);
+            }
+            damage.push_back(whole);
+            break;
+        }
+        default:
+            std::fill(buffer.pixels.begin(), buffer.pixels.end(), color);
+            damage.push_back(whole);
+            break;
+        }
+    }
+};
+
+RunResult Run(Options const& options, uint32_t clientCount)
+{
+    vkc::Compositor compositor;
+    compositor.outputConfigs = { { "Load", options.outputExtent.width, options.outputExtent.height } };
+    compositor.headless = !options.gpu;
+    RunResult result;
+    if (!compositor.Init())
+        return result;
+
+    // Headless outputs have no vblank to wait for
+    if (compositor.IsHeadless())
+        compositor.GetFrameScheduler().SetFrameRateLimit(options.frameRate);
+
+    // Surfaces cascade over the output, so later clients partially cover earlier ones
+    std::vector<std::unique_ptr<Client>> clients;
+    for (uint32_t i = 0; i < clientCount; ++i)
+    {
+        uint32_t const id = i + 1;
+        uint32_t const spanX = options.outputExtent.width > options.surfaceExtent.width ? options.outputExtent.width - options.surfaceExtent.width : 1;
+        uint32_t const spanY = options.outputExtent.height > options.surfaceExtent.height ? options.outputExtent.height - options.surfaceExtent.height : 1;
+        vk::Rect2D const rect({ static_cast<int32_t>((i * 97) % spanX), static_cast<int32_t>((i * 61) % spanY) }, options.surfaceExtent);
+        uint32_t const surface = compositor.AttachSurface(id, 0, rect);
+
+        Pattern const pattern = options.pattern == Pattern::eMixed ? static_cast<Pattern>(i % 4) : options.pattern;
+        double const rate = options.rate > 0.0 ? options.rate : GetDefaultRate(pattern);
+        clients.push_back(std::make_unique<Client>(id, surface, pattern, rate, options.surfaceExtent, compositor.GetClientCommits(id)));
+    }
+
+    for (std::unique_ptr<Client>& pClient : clients)
+        pClient->Start();
+
+    vkc::Clock::time_point const end = vkc::Clock::now() + std::chrono::duration_cast<vkc::Clock::duration>(std::chrono::duration<double>(options.seconds));
+    while (compositor.IsValid() && vkc::Clock::now() < end)
+        compositor.RenderFrame();
+    result.frameCount = compositor.GetFrameCount();
+
+    for (std::unique_ptr<Client>& pClient : clients)
+        pClient->Stop();
+
+    double latencySum = 0.0;
+    for (uint32_t i = 0; i < clientCount; ++i)
+    {
+        uint32_t const id = i + 1;
+        vkc::LatencyHistogram const& latency = compositor.GetCommitLatency(id);
+        result.commitCount += clients[i]->GetCommitCount();
+        result.stalledCommitCount += clients[i]->GetStalledCount();
+        result.droppedCommitCount += compositor.GetClientCommits(id).GetDroppedCount();
+        latencySum += latency.GetMean().count();
+        result.worstP99Latency = std::max(result.worstP99Latency, latency.GetPercentile(0.99));
+    }
+    result.evictedCommitCount = compositor.GetEvictedCommitCount();
+    result.meanLatency = vkc::Milliseconds(clientCount != 0 ? latencySum / clientCount : 0.0);
+
+    if (!options.sweep)
+    {
+        compositor.LogCommitLatency();
+        if (options.gpu)
+            compositor.LogQuality();
+    }
+
+    return result;
+}
+
+void Report(uint32_t clientCount, Options const& options, RunResult const& result)
+{
+    std::cout << clientCount << " clients: " << result.frameCount / options.seconds << " frames/s"
+        << ", " << result.commitCount << " commits"
+        << ", " << result.stalledCommitCount << " stalled on buffers"
+        << ", " << result.droppedCommitCount << " dropped"
+        << ", " << result.evictedCommitCount << " evicted unpresented"
+        << ", latency mean " << result.meanLatency.count() << " ms"
+        << ", worst p99 " << result.worstP99Latency.count() << " ms" << std::endl;
+}
+
+bool ParseExtent(char const* pText, vk::Extent2D& extent)
+{
+    unsigned width = 0;
+    unsigned height = 0;
+    if (std::sscanf(pText, "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+        return false;
+
+    extent = vk::Extent2D(width, height);
+    return true;
+}
+
+bool ParsePattern(char const* pText, Pattern& pattern)
+{
+    for (Pattern candidate : { Pattern::eFull, Pattern::eScroll, Pattern::eVideo, Pattern::eIdle, Pattern::eMixed })
+    {
+        if (std::strcmp(pText, GetPatternName(candidate)) == 0)
+        {
+            pattern = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    bool valid = true;
+    for (int i = 1; i < argc && valid; ++i)
+    {
+        bool const hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--clients") == 0 && hasValue)
+            options.clientCount = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        else if (std::strcmp(argv[i], "--seconds") == 0 && hasValue)
+            options.seconds = std::max(std::atof(argv[++i]), 0.1);
+        else if (std::strcmp(argv[i], "--rate") == 0 && hasValue)
+            options.rate = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--fps") == 0 && hasValue)
+            options.frameRate = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--size") == 0 && hasValue)
+            valid = ParseExtent(argv[++i], options.surfaceExtent);
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue)
+            valid = ParseExtent(argv[++i], options.outputExtent);
+        else if (std::strcmp(argv[i], "--pattern") == 0 && hasValue)
+            valid = ParsePattern(argv[++i], options.pattern);
+        else if (std::strcmp(argv[i], "--sweep") == 0)
+            options.sweep = true;
+        else if (std::strcmp(argv[i], "--gpu") == 0)
+            options.gpu = true;
+        else
+            valid = false;
+    }
+
+    if (!valid)
+    {
+        std::cerr << "Usage: vkc_loadgen [--clients <count>] [--seconds <time>] [--rate <hz>] [--fps <hz>] [--size <w>x<h>]"
+            << " [--output <w>x<h>] [--pattern full|scroll|video|idle|mixed] [--sweep] [--gpu]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Load: " << GetPatternName(options.pattern) << " clients of " << options.surfaceExtent.width << "x"
+        << options.surfaceExtent.height << " on a " << options.outputExtent.width << "x" << options.outputExtent.height
+        << (options.gpu ? " output" : " headless output") << std::endl;
+
+    uint32_t clientCount = options.sweep ? 1 : options.clientCount;
+    while (true)
+    {
+        Report(clientCount, options, Run(options, clientCount));
+        if (clientCount >= options.clientCount)
+            break;
+        clientCount = std::min(clientCount * 2, options.clientCount);
+    }
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2018 by Ilya Glushchenko
+ * This code is licensed under the MIT license (MIT)
+ * (http://opensource.org/licenses/MIT)
+ */
+#include <CommitTrace.hpp>
+#include <LatencyHistogram.hpp>
+#include <Output.hpp>
+#include <Timing.hpp>
+#include <Trace.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Plays a recorded commit trace back against headless outputs and reports the time the
+ * software renderer spends per frame. Commits are grouped into the frames they were
+ * recorded in, at recorded speed every frame starts at its recorded time, at maximum
+ * speed frames run back to back.
+ */
+
+namespace
+{
+
+struct ReplayStats
+{
+    vkc::LatencyHistogram frameTimes;
+    uint64_t commitCount = 0;
+    uint64_t frameCount = 0;
+    uint64_t damagedPixelCount = 0;
+};
+
+void RenderFrame(std::vector<std::unique_ptr<vkc::Output>>& outputs, ReplayStats& stats)
+{
+    for (std::unique_ptr<vkc::Output>& pOutput : outputs)
+    {
+        vkc::Milliseconds frameTime{ 0 };
+        {
+            vkc::ScopedTimer timer(frameTime);
+            pOutput->Update();
+            if (!pOutput->NeedsFrame())
+                continue;
+
+            pOutput->GetSoftwareRender()->Frame(pOutput->surfaces, pOutput->GetScene());
+            pOutput->ClearDamage();
+        }
+
+        stats.frameTimes.Add(frameTime);
+        stats.damagedPixelCount += pOutput->GetSoftwareRender()->GetDamagedPixelCount();
+        ++stats.frameCount;
+    }
+}
+
+void Replay(vkc::CommitTrace& trace, bool maxSpeed, ReplayStats& stats)
+{
+    vkc::TraceHeader const& header = trace.GetHeader();
+    std::vector<std::unique_ptr<vkc::Output>> outputs;
+    for (uint32_t i = 0; i < header.outputCount; ++i)
+    {
+        vkc::OutputConfig const config{ "Replay " + std::to_string(i), header.outputExtents[i][0], header.outputExtents[i][1] };
+        outputs.push_back(std::make_unique<vkc::Output>(config));
+    }
+
+    vkc::Clock::time_point const start = vkc::Clock::now();
+    vkc::CommitTrace::Commit commit;
+    bool more = trace.Next(commit);
+    while (more)
+    {
+        if (!maxSpeed)
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(commit.pRecord->time));
+
+        uint64_t const frame = commit.pRecord->frame;
+        while (more && commit.pRecord->frame == frame)
+        {
+            if (commit.pRecord->output < outputs.size())
+                vkc::CommitTrace::Apply(commit, outputs[commit.pRecord->output]->surfaces);
+            ++stats.commitCount;
+            more = trace.Next(commit);
+        }
+
+        RenderFrame(outputs, stats);
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv)
+{
+    char const* pPath = nullptr;
+    bool maxSpeed = false;
+    uint32_t loopCount = 1;
+    char const* pTimelinePath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--max-speed") == 0)
+            maxSpeed = true;
+        else if (std::strcmp(argv[i], "--loops") == 0 && i + 1 < argc)
+            loopCount = static_cast<uint32_t>(std::max(std::atoi(argv[++i]), 1));
+        else if (std::strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+            pTimelinePath = argv[++i];
+        else
+            pPath = argv[i];
+    }
+
+    if (!pPath)
+    {
+        std::cerr << "Usage: vkc_replay <trace> [--max-speed] [--loops <count>] [--timeline <json>]" << std::endl;
+        return 1;
+    }
+
+#ifndef VKC_TRACING
+    // Without the markers the timeline would be written empty
+    if (pTimelinePath)
+    {
+        std::cerr << "--timeline needs a build with VULKAN_COMPOSITOR_TRACING" << std::endl;
+        return 1;
+    }
+#endif
+
+    vkc::CommitTrace trace;
+    if (!trace.Open(pPath))
+        return 1;
+
+    std::cout << "Replaying " << pPath << " on " << trace.GetHeader().outputCount << " headless outputs"
+        << " with " << vkc::SoftwareRender::GetKernelName() << " kernels"
+        << (maxSpeed ? " at maximum speed" : " at recorded speed") << std::endl;
+
+    // Every loop starts from empty outputs, so all of them do the same work
+    ReplayStats stats;
+    vkc::Milliseconds wallTime{ 0 };
+    if (pTimelinePath)
+        vkc::Tracer::Start();
+    {
+        vkc::ScopedTimer timer(wallTime);
+        for (uint32_t loop = 0; loop < loopCount; ++loop)
+        {
+            trace.Rewind();
+            Replay(trace, maxSpeed, stats);
+        }
+    }
+
+    std::cout << "Replayed " << stats.commitCount << " commits in " << stats.frameCount << " frames"
+        << ", " << stats.damagedPixelCount << " damaged pixels"
+        << ", wall time " << wallTime.count() << " ms" << std::endl;
+    stats.frameTimes.Log(std::cout, "Frame time");
+
+    if (pTimelinePath)
+    {
+        vkc::Tracer::Stop();
+        FILE* pTimeline = fopen(pTimelinePath, "w");
+        bool const exported = vkc::Tracer::Export(pTimeline);
+        if (pTimeline)
+            fclose(pTimeline);
+        if (!exported)
+        {
+            std::cerr << "Failed to write timeline " << pTimelinePath << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,8 @@
+# Copyright (C) 2018 by Ilya Glushchenko
+# This code is licensed under the MIT license (MIT)
+# (http://opensource.org/licenses/MIT)
+
+set(VULKAN_COMPOSITOR_TOOLS_PROJECT "VulkanCompositorTools")
+set(VULKAN_COMPOSITOR_TOOLS_ROOT "${VULKAN_COMPOSITOR_ROOT}/tools")
+set(VULKAN_COMPOSITOR_REPLAY_NAME "vkc_replay")
+set(VULKAN_COMPOSITOR_LOADGEN_NAME "vkc_loadgen")